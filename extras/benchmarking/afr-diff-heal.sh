@@ -0,0 +1,111 @@
+#!/bin/sh
+
+# Time the "diff" data self-heal of a large file with each strong checksum
+# AFR can have the bricks compute (data-self-heal-checksum). Two bricks in
+# WORK-DIR are served by their own glusterfsd on PORT and PORT+1, and a
+# replica of them is mounted by a single client process. Before each run a
+# few blocks of the file are overwritten behind AFR's back on the second
+# brick and the changelog on the first brick marks it as the source, so the
+# lookup that follows heals the file in the foreground.
+#
+# usage: afr-diff-heal.sh WORK-DIR [SIZE-MB] [CHANGED-BLOCKS] [PORT]
+
+work="$1"
+size="${2:-4096}"
+changed="${3:-16}"
+port="${4:-24100}"
+
+if [ -z "$work" ]; then
+    echo "usage: $0 WORK-DIR [SIZE-MB] [CHANGED-BLOCKS] [PORT]"
+    exit 1
+fi
+
+mount_point="$work/mnt"
+mkdir -p "$work/brick-0" "$work/brick-1" "$mount_point" || exit 1
+
+for i in 0 1; do
+    cat > "$work/brick-$i.vol" <<EOF
+volume posix
+  type storage/posix
+  option directory $work/brick-$i
+end-volume
+
+volume locks
+  type features/locks
+  subvolumes posix
+end-volume
+
+volume server
+  type protocol/server
+  option transport-type tcp
+  option transport.socket.listen-port $((port + i))
+  option auth.addr.locks.allow 127.0.0.1
+  subvolumes locks
+end-volume
+EOF
+    glusterfsd -f "$work/brick-$i.vol" --pid-file="$work/brick-$i.pid" \
+        || exit 1
+done
+
+write_volfile ()
+{
+    cat > "$work/heal.vol" <<EOF
+volume brick-0
+  type protocol/client
+  option transport-type tcp
+  option remote-host 127.0.0.1
+  option remote-port $port
+  option remote-subvolume locks
+end-volume
+
+volume brick-1
+  type protocol/client
+  option transport-type tcp
+  option remote-host 127.0.0.1
+  option remote-port $((port + 1))
+  option remote-subvolume locks
+end-volume
+
+volume replicate
+  type cluster/replicate
+  option data-self-heal-algorithm diff
+  option data-self-heal-checksum $1
+  option background-self-heal-count 0
+  subvolumes brick-0 brick-1
+end-volume
+EOF
+}
+
+write_volfile md5
+glusterfs -f "$work/heal.vol" "$mount_point" || exit 1
+dd if=/dev/urandom of="$mount_point/file" bs=1M count=$size 2>/dev/null
+umount "$mount_point"
+
+for checksum in md5 murmur3 md5 murmur3; do
+    i=0
+    while [ $i -lt $changed ]; do
+        dd if=/dev/urandom of="$work/brick-1/file" bs=128k count=1 \
+            seek=$(( (i * 8 * size) / changed )) conv=notrunc 2>/dev/null
+        i=$((i + 1))
+    done
+    setfattr -n trusted.afr.brick-1 -v 0x000000010000000000000000 \
+        "$work/brick-0/file"
+
+    write_volfile $checksum
+    glusterfs -f "$work/heal.vol" "$mount_point" || exit 1
+
+    start=$(date +%s.%N)
+    : < "$mount_point/file"
+    end=$(date +%s.%N)
+
+    umount "$mount_point"
+
+    if cmp -s "$work/brick-0/file" "$work/brick-1/file"; then
+        echo "$start $end" | awk -v c=$checksum -v s=$size \
+            '{ printf "checksum=%s size=%dMB heal=%.2fs\n", c, s, $2 - $1 }'
+    else
+        echo "checksum=$checksum: bricks still differ after the heal"
+    fi
+done
+
+kill $(cat "$work/brick-0.pid" "$work/brick-1.pid")
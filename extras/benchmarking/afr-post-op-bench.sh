@@ -0,0 +1,137 @@
+#!/bin/sh
+
+# Count the changelog xattrops AFR sends for a stream of writes through one
+# file descriptor, with the post-op of every write sent right away and with
+# it held on the fd (post-op-delay-secs). Two bricks in WORK-DIR are served
+# by their own glusterfsd on PORT and PORT+1, and a replica of them with
+# eager-lock on is mounted by a single client process, once for each delay.
+# A sequential write of SIZE-MB in 128KB blocks (dd) and WRITES random 4KB
+# writes into it (perl) are each done through one open of the file. The
+# counts are the pre_op_xattrops and post_op_xattrops of the statedump of
+# the client, taken after the file is closed, summed over both bricks.
+#
+# usage: afr-post-op-bench.sh WORK-DIR [SIZE-MB] [WRITES] [PORT]
+
+work="$1"
+size="${2:-256}"
+writes="${3:-2000}"
+port="${4:-24100}"
+
+if [ -z "$work" ]; then
+    echo "usage: $0 WORK-DIR [SIZE-MB] [WRITES] [PORT]"
+    exit 1
+fi
+
+mount_point="$work/mnt"
+mkdir -p "$work/brick-0" "$work/brick-1" "$mount_point" || exit 1
+
+for i in 0 1; do
+    cat > "$work/brick-$i.vol" <<EOF
+volume posix
+  type storage/posix
+  option directory $work/brick-$i
+end-volume
+
+volume locks
+  type features/locks
+  subvolumes posix
+end-volume
+
+volume server
+  type protocol/server
+  option transport-type tcp
+  option transport.socket.listen-port $((port + i))
+  option auth.addr.locks.allow 127.0.0.1
+  subvolumes locks
+end-volume
+EOF
+    glusterfsd -f "$work/brick-$i.vol" --pid-file="$work/brick-$i.pid" \
+        || exit 1
+done
+
+write_volfile ()
+{
+    cat > "$work/post-op.vol" <<EOF
+volume brick-0
+  type protocol/client
+  option transport-type tcp
+  option remote-host 127.0.0.1
+  option remote-port $port
+  option remote-subvolume locks
+end-volume
+
+volume brick-1
+  type protocol/client
+  option transport-type tcp
+  option remote-host 127.0.0.1
+  option remote-port $((port + 1))
+  option remote-subvolume locks
+end-volume
+
+volume replicate
+  type cluster/replicate
+  option eager-lock on
+  option post-op-delay-secs $1
+  subvolumes brick-0 brick-1
+end-volume
+EOF
+}
+
+# prints "xattrops=N delayed=N" from a statedump of the client
+xattrops ()
+{
+    pid=$(cat "$work/client.pid")
+    dump="/tmp/glusterdump.$pid.dump"
+
+    rm -f "$dump"
+    kill -USR1 $pid
+    sleep 1
+
+    awk -F= '/^pre_op_xattrops=/ || /^post_op_xattrops=/ { x += $2 }
+             /^post_ops_delayed=/ { d = $2 }
+             END { printf "xattrops=%d delayed=%d", x, d }' "$dump"
+}
+
+run ()
+{
+    delay=$1
+    pattern=$2
+
+    write_volfile $delay
+    glusterfs -f "$work/post-op.vol" --pid-file="$work/client.pid" \
+        "$mount_point" || exit 1
+
+    start=$(date +%s.%N)
+    if [ $pattern = sequential ]; then
+        dd if=/dev/zero of="$mount_point/file" bs=128k \
+            count=$((size * 8)) 2>/dev/null
+        ops=$((size * 8))
+    else
+        # one process and one open, a close would flush the held post-op
+        perl -e 'my ($file, $n, $blocks) = @ARGV;
+                 open (my $fh, "+<", $file) or die "$file: $!";
+                 srand (1);
+                 for (1 .. $n) {
+                         sysseek ($fh, int (rand ($blocks)) * 4096, 0);
+                         syswrite ($fh, "\0" x 4096) == 4096 or die "$!";
+                 }' "$mount_point/file" $writes $((size * 256))
+        ops=$writes
+    fi
+    end=$(date +%s.%N)
+
+    # the bricks are idle by now, whatever the delay
+    sleep $((delay + 2))
+
+    echo "delay=${delay}s $pattern writes=$ops $(xattrops)" \
+        "time=$(echo "$start $end" | awk '{ printf "%.2fs", $2 - $1 }')"
+
+    umount "$mount_point"
+}
+
+for pattern in sequential random; do
+    for delay in 0 1; do
+        run $delay $pattern
+    done
+done
+
+kill $(cat "$work/brick-0.pid" "$work/brick-1.pid")
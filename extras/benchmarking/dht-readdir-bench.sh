@@ -0,0 +1,117 @@
+#!/bin/sh
+
+# Time listing one large directory of a distribute volume, with the
+# sequential readdirp walk of DHT and with parallel-readdir. BRICKS bricks
+# in WORK-DIR are each served by their own glusterfsd on PORT, PORT+1, ...
+# and mounted by a single client process through md-cache. The directory
+# is populated with ENTRIES empty files on the first run and reused after
+# that. Each mode is timed for "ls -f" (readdir only) and "ls -l" (readdir
+# plus a stat of every entry) on a fresh mount.
+#
+# usage: dht-readdir-bench.sh WORK-DIR [BRICKS] [ENTRIES] [PORT]
+#
+# e.g. dht-readdir-bench.sh /export/rdp 12 1000000
+#      dht-readdir-bench.sh /export/rdp48 48 1000000
+
+work="$1"
+bricks="${2:-12}"
+entries="${3:-1000000}"
+port="${4:-24100}"
+
+if [ -z "$work" ]; then
+    echo "usage: $0 WORK-DIR [BRICKS] [ENTRIES] [PORT]"
+    exit 1
+fi
+
+mount_point="$work/mnt"
+mkdir -p "$mount_point" || exit 1
+
+i=0
+while [ $i -lt $bricks ]; do
+    mkdir -p "$work/brick-$i" || exit 1
+    cat > "$work/brick-$i.vol" <<EOF
+volume posix
+  type storage/posix
+  option directory $work/brick-$i
+end-volume
+
+volume server
+  type protocol/server
+  option transport-type tcp
+  option transport.socket.listen-port $((port + i))
+  option auth.addr.posix.allow 127.0.0.1
+  subvolumes posix
+end-volume
+EOF
+    glusterfsd -f "$work/brick-$i.vol" --pid-file="$work/brick-$i.pid" \
+        || exit 1
+    i=$((i + 1))
+done
+
+write_volfile ()
+{
+    : > "$work/dht.vol"
+    subvols=""
+    i=0
+    while [ $i -lt $bricks ]; do
+        cat >> "$work/dht.vol" <<EOF
+volume brick-$i
+  type protocol/client
+  option transport-type tcp
+  option remote-host 127.0.0.1
+  option remote-port $((port + i))
+  option remote-subvolume posix
+end-volume
+
+EOF
+        subvols="$subvols brick-$i"
+        i=$((i + 1))
+    done
+
+    cat >> "$work/dht.vol" <<EOF
+volume dht
+  type cluster/distribute
+  option parallel-readdir $1
+  subvolumes$subvols
+end-volume
+
+volume md-cache
+  type performance/md-cache
+  subvolumes dht
+end-volume
+EOF
+}
+
+write_volfile off
+glusterfs -f "$work/dht.vol" "$mount_point" || exit 1
+mkdir -p "$mount_point/dir"
+have=$(ls -f "$mount_point/dir" | wc -l)
+if [ $have -lt $((entries + 2)) ]; then
+    (cd "$mount_point/dir" && seq -f "f%.0f" 1 $entries | xargs touch)
+fi
+umount "$mount_point"
+
+for mode in off on off on; do
+    write_volfile $mode
+
+    for ls_opt in -f -l; do
+        glusterfs -f "$work/dht.vol" "$mount_point" || exit 1
+
+        start=$(date +%s.%N)
+        n=$(ls $ls_opt "$mount_point/dir" | wc -l)
+        end=$(date +%s.%N)
+
+        umount "$mount_point"
+
+        echo "$start $end" | awk -v p=$mode -v o="ls $ls_opt" -v n=$n \
+            '{ printf "parallel-readdir=%-3s %s: %d lines in %.2fs\n",
+                      p, o, n, $2 - $1 }'
+    done
+done
+echo "bricks=$bricks entries=$entries"
+
+i=0
+while [ $i -lt $bricks ]; do
+    kill $(cat "$work/brick-$i.pid")
+    i=$((i + 1))
+done
@@ -0,0 +1,217 @@
+/*
+   Copyright (c) 2011 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/* dict-bench: cost of dict_t operations on the fop path.
+ *
+ *   reply      build the xattr dict of a lookup reply on a replicated and
+ *              distributed brick (gfid, afr changelogs, dht layout, lock
+ *              and fd counts), read every key back and destroy it
+ *   serialize  dict_allocate_and_serialize of that dict
+ *   unserial   dict_unserialize of the serialized buffer into a new dict
+ *   xdata      small xdata dict of a fop: two keys set, one get, unref
+ *
+ * Build it against the headers and the libglusterfs of the tree to be
+ * measured, once for each tree to compare:
+ *
+ *   gcc -O2 -D_GNU_SOURCE -DHAVE_CONFIG_H -I$TREE -I$TREE/libglusterfs/src \
+ *       -I$TREE/contrib/uuid dict-bench.c -o dict-bench \
+ *       -L$TREE/libglusterfs/src/.libs -lglusterfs -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "dict.h"
+#include "xlator.h"
+
+#define DB_AFR_CHILDREN 2
+
+static int db_iterations = 200000;
+
+
+static double
+db_now (void)
+{
+        struct timeval tv;
+
+        gettimeofday (&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static void
+db_report (const char *name, double start)
+{
+        double elapsed = db_now () - start;
+
+        printf (" %s=%.0fns", name, elapsed * 1e9 / db_iterations);
+}
+
+
+static dict_t *
+db_lookup_reply (void)
+{
+        dict_t  *dict = NULL;
+        char     key[64];
+        char    *bin = NULL;
+        int      i = 0;
+
+        dict = dict_new ();
+        if (!dict)
+                return NULL;
+
+        bin = GF_CALLOC (1, 16, gf_common_mt_char);
+        dict_set_bin (dict, "trusted.gfid", bin, 16);
+
+        for (i = 0; i < DB_AFR_CHILDREN; i++) {
+                snprintf (key, sizeof (key), "trusted.afr.bench-client-%d", i);
+                bin = GF_CALLOC (1, 12, gf_common_mt_char);
+                dict_set_bin (dict, key, bin, 12);
+        }
+
+        bin = GF_CALLOC (1, 16, gf_common_mt_char);
+        dict_set_bin (dict, "trusted.glusterfs.dht", bin, 16);
+
+        dict_set_uint32 (dict, "glusterfs.inodelk-count", 0);
+        dict_set_uint32 (dict, "glusterfs.entrylk-count", 0);
+        dict_set_uint32 (dict, "glusterfs.open-fd-count", 1);
+        dict_set_uint64 (dict, "glusterfs.content", 0);
+
+        return dict;
+}
+
+
+static int
+db_read_reply (dict_t *dict)
+{
+        char     key[64];
+        void    *ptr = NULL;
+        uint32_t val = 0;
+        int      ret = 0;
+        int      i = 0;
+
+        ret |= dict_get_ptr (dict, "trusted.gfid", &ptr);
+        for (i = 0; i < DB_AFR_CHILDREN; i++) {
+                snprintf (key, sizeof (key), "trusted.afr.bench-client-%d", i);
+                ret |= dict_get_ptr (dict, key, &ptr);
+        }
+        ret |= dict_get_ptr (dict, "trusted.glusterfs.dht", &ptr);
+        ret |= dict_get_uint32 (dict, "glusterfs.inodelk-count", &val);
+        ret |= dict_get_uint32 (dict, "glusterfs.entrylk-count", &val);
+        ret |= dict_get_uint32 (dict, "glusterfs.open-fd-count", &val);
+        if (dict_get (dict, "glusterfs.not-there"))
+                ret = -1;
+
+        return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t *ctx = NULL;
+        dict_t          *dict = NULL;
+        dict_t          *copy = NULL;
+        char            *buf = NULL;
+        size_t           len = 0;
+        double           start = 0;
+        int32_t          val = 0;
+        int              i = 0;
+
+        if (argc > 1)
+                db_iterations = atoi (argv[1]);
+        if (db_iterations < 1)
+                db_iterations = 1;
+
+        if (glusterfs_globals_init ())
+                return 1;
+
+        ctx = glusterfs_ctx_get ();
+        INIT_LIST_HEAD (&ctx->mempool_list);
+        THIS->ctx = ctx;
+
+        ctx->dict_pool = mem_pool_new (dict_t, 1024);
+        ctx->dict_pair_pool = mem_pool_new (data_pair_t, 16 * GF_UNIT_KB);
+        ctx->dict_data_pool = mem_pool_new (data_t, 8 * GF_UNIT_KB);
+        if (!ctx->dict_pool || !ctx->dict_pair_pool || !ctx->dict_data_pool)
+                return 1;
+
+        printf ("iterations=%d", db_iterations);
+
+        start = db_now ();
+        for (i = 0; i < db_iterations; i++) {
+                dict = db_lookup_reply ();
+                if (!dict || db_read_reply (dict))
+                        goto err;
+                dict_unref (dict);
+        }
+        db_report ("reply", start);
+
+        dict = db_lookup_reply ();
+        if (!dict)
+                goto err;
+
+        start = db_now ();
+        for (i = 0; i < db_iterations; i++) {
+                if (dict_allocate_and_serialize (dict, &buf, &len))
+                        goto err;
+                GF_FREE (buf);
+        }
+        db_report ("serialize", start);
+
+        if (dict_allocate_and_serialize (dict, &buf, &len))
+                goto err;
+
+        start = db_now ();
+        for (i = 0; i < db_iterations; i++) {
+                copy = dict_new ();
+                if (!copy || dict_unserialize (buf, len, &copy))
+                        goto err;
+                if (db_read_reply (copy))
+                        goto err;
+                dict_unref (copy);
+        }
+        db_report ("unserial", start);
+
+        GF_FREE (buf);
+        dict_unref (dict);
+
+        start = db_now ();
+        for (i = 0; i < db_iterations; i++) {
+                dict = dict_new ();
+                if (!dict)
+                        goto err;
+                dict_set_int32 (dict, "glusterfs.inodelk-count", 1);
+                dict_set_str (dict, "glusterfs.entrylk-count", "1");
+                if (dict_get_int32 (dict, "glusterfs.inodelk-count", &val))
+                        goto err;
+                dict_unref (dict);
+        }
+        db_report ("xdata", start);
+
+        printf ("\n");
+        return 0;
+err:
+        fprintf (stderr, "\ndict operation failed at iteration %d\n", i);
+        return 1;
+}
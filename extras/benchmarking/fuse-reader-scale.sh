@@ -0,0 +1,29 @@
+#!/bin/sh
+
+# Measure how metadata ops/s on a fuse mount scale with the number of
+# /dev/fuse reader threads. The volume is re-mounted for each reader count
+# and md-bench is run against it.
+#
+# usage: fuse-reader-scale.sh SERVER:/VOLUME MOUNT-POINT [THREADS] [FILES]
+
+volume="$1"
+mount_point="$2"
+threads="${3:-16}"
+files="${4:-2000}"
+
+md_bench="$(dirname $0)/md-bench"
+
+if [ -z "$volume" -o -z "$mount_point" ]; then
+    echo "usage: $0 SERVER:/VOLUME MOUNT-POINT [THREADS] [FILES]"
+    exit 1
+fi
+
+for readers in 1 2 4 8; do
+    mount -t glusterfs -o reader-thread-count=$readers "$volume" \
+        "$mount_point" || exit 1
+
+    echo -n "readers=$readers "
+    $md_bench -t $threads -n $files "$mount_point"
+
+    umount "$mount_point"
+done
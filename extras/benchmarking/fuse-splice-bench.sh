@@ -0,0 +1,70 @@
+#!/bin/sh
+
+# Sequential write and read throughput of a mount, and the CPU time the
+# glusterfs client spends per GB moved, with and without the splice data
+# path of the fuse bridge (use-splice). The volume is mounted from VOLFILE
+# on MOUNT-POINT for each run, and the page cache is dropped before reading.
+#
+# usage: fuse-splice-bench.sh VOLFILE MOUNT-POINT [SIZE-MB] [BLOCK-KB]
+
+volfile="$1"
+mount_point="$2"
+size="${3:-4096}"
+block="${4:-128}"
+
+if [ -z "$volfile" ] || [ -z "$mount_point" ]; then
+    echo "usage: $0 VOLFILE MOUNT-POINT [SIZE-MB] [BLOCK-KB]"
+    exit 1
+fi
+
+pid_file="/tmp/fuse-splice-bench.$$.pid"
+hz=$(getconf CLK_TCK)
+count=$((size * 1024 / block))
+
+cpu_ticks ()
+{
+    awk '{ print $14 + $15 }' /proc/$(cat "$pid_file")/stat
+}
+
+now ()
+{
+    date +%s.%N
+}
+
+report ()
+{
+    echo "$1 $2 $3 $4 $5" | awk -v s=$size -v hz=$hz \
+        '{ printf "%-9s %-5s %8.1f MB/s %6.2f cpu-s/GB\n", $1, $2,
+                  s / ($4 - $3), ($5 / hz) * 1024 / s }'
+}
+
+for mode in plain splice plain splice; do
+    opts=""
+    [ $mode = splice ] && opts="--use-splice"
+
+    glusterfs -f "$volfile" --pid-file="$pid_file" $opts "$mount_point" \
+        || exit 1
+    while [ ! -s "$pid_file" ]; do
+        sleep 1
+    done
+
+    cpu=$(cpu_ticks)
+    start=$(now)
+    dd if=/dev/zero of="$mount_point/splice-bench" bs=${block}k \
+        count=$count conv=fsync 2>/dev/null
+    end=$(now)
+    report $mode write $start $end $(( $(cpu_ticks) - cpu ))
+
+    sync
+    echo 3 > /proc/sys/vm/drop_caches
+
+    cpu=$(cpu_ticks)
+    start=$(now)
+    dd if="$mount_point/splice-bench" of=/dev/null bs=${block}k 2>/dev/null
+    end=$(now)
+    report $mode read $start $end $(( $(cpu_ticks) - cpu ))
+
+    rm -f "$mount_point/splice-bench"
+    umount "$mount_point"
+    rm -f "$pid_file"
+done
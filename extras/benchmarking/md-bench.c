@@ -0,0 +1,239 @@
+/*
+   Copyright (c) 2011 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/* md-bench: metadata operations per second from many threads on one mount.
+ *
+ * Every thread works in its own directory under the given path and runs
+ * the phases create, stat, miss (stat of names that do not exist) and
+ * unlink over the same set of files. The aggregate ops/s of each phase
+ * is printed on one line, so that runs with different fuse
+ * reader-thread-count values can be compared directly.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <argp.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+struct mdb_config {
+        char               *path;
+        int                 thread_count;
+        long                files;
+        pthread_barrier_t   barrier;
+};
+static struct mdb_config mdb_config = {
+        .thread_count = 4,
+        .files        = 1000,
+};
+
+enum mdb_phase {
+        MDB_CREATE,
+        MDB_STAT,
+        MDB_MISS,
+        MDB_UNLINK,
+        MDB_PHASE_MAX,
+};
+
+static const char *mdb_phase_names[MDB_PHASE_MAX] = {
+        "create", "stat", "miss", "unlink",
+};
+
+static double mdb_elapsed[MDB_PHASE_MAX];
+static pthread_mutex_t mdb_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct argp_option mdb_options[] = {
+        {"threads", 't', "COUNT", 0, "number of threads [default: 4]"},
+        {"files", 'n', "COUNT", 0, "files per thread [default: 1000]"},
+        {0, 0, 0, 0, 0}
+};
+
+static error_t
+mdb_parse_opts (int key, char *arg, struct argp_state *state)
+{
+        switch (key) {
+        case 't':
+                mdb_config.thread_count = atoi (arg);
+                if (mdb_config.thread_count < 1)
+                        argp_error (state, "invalid thread count %s", arg);
+                break;
+        case 'n':
+                mdb_config.files = atol (arg);
+                if (mdb_config.files < 1)
+                        argp_error (state, "invalid file count %s", arg);
+                break;
+        case ARGP_KEY_ARG:
+                if (mdb_config.path)
+                        argp_usage (state);
+                mdb_config.path = arg;
+                break;
+        case ARGP_KEY_END:
+                if (!mdb_config.path)
+                        argp_usage (state);
+                break;
+        default:
+                return ARGP_ERR_UNKNOWN;
+        }
+
+        return 0;
+}
+
+static struct argp mdb_argp = {
+        mdb_options, mdb_parse_opts, "DIRECTORY",
+        "md-bench -- metadata ops/s from many threads"
+};
+
+
+static double
+mdb_now (void)
+{
+        struct timeval tv;
+
+        gettimeofday (&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+mdb_run_phase (const char *dir, enum mdb_phase phase)
+{
+        char        name[4096];
+        struct stat st;
+        long        i = 0;
+        int         fd = -1;
+
+        for (i = 0; i < mdb_config.files; i++) {
+                switch (phase) {
+                case MDB_CREATE:
+                        snprintf (name, sizeof (name), "%s/f%ld", dir, i);
+                        fd = open (name, O_CREAT|O_WRONLY|O_EXCL, 0644);
+                        if (fd == -1)
+                                goto err;
+                        close (fd);
+                        break;
+                case MDB_STAT:
+                        snprintf (name, sizeof (name), "%s/f%ld", dir, i);
+                        if (stat (name, &st) == -1)
+                                goto err;
+                        break;
+                case MDB_MISS:
+                        snprintf (name, sizeof (name), "%s/m%ld", dir, i);
+                        if (stat (name, &st) == 0 || errno != ENOENT)
+                                goto err;
+                        break;
+                case MDB_UNLINK:
+                        snprintf (name, sizeof (name), "%s/f%ld", dir, i);
+                        if (unlink (name) == -1)
+                                goto err;
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        return 0;
+err:
+        fprintf (stderr, "%s %s: %s\n", mdb_phase_names[phase], name,
+                 strerror (errno));
+        return -1;
+}
+
+
+static void *
+mdb_worker (void *data)
+{
+        char    dir[4096];
+        double  start = 0;
+        int     phase = 0;
+        long    idx = (long) data;
+
+        snprintf (dir, sizeof (dir), "%s/md-bench.%d.%ld", mdb_config.path,
+                  getpid (), idx);
+        if (mkdir (dir, 0755) == -1) {
+                fprintf (stderr, "mkdir %s: %s\n", dir, strerror (errno));
+                exit (1);
+        }
+
+        for (phase = 0; phase < MDB_PHASE_MAX; phase++) {
+                pthread_barrier_wait (&mdb_config.barrier);
+                start = mdb_now ();
+
+                if (mdb_run_phase (dir, phase))
+                        exit (1);
+
+                pthread_mutex_lock (&mdb_lock);
+                {
+                        mdb_elapsed[phase] += mdb_now () - start;
+                }
+                pthread_mutex_unlock (&mdb_lock);
+        }
+
+        rmdir (dir);
+        return NULL;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        pthread_t *threads = NULL;
+        long       i = 0;
+        int        phase = 0;
+        double     ops = 0;
+
+        argp_parse (&mdb_argp, argc, argv, 0, 0, NULL);
+
+        threads = calloc (mdb_config.thread_count, sizeof (*threads));
+        if (!threads)
+                return 1;
+
+        pthread_barrier_init (&mdb_config.barrier, NULL,
+                              mdb_config.thread_count);
+
+        for (i = 0; i < mdb_config.thread_count; i++) {
+                if (pthread_create (&threads[i], NULL, mdb_worker,
+                                    (void *) i)) {
+                        perror ("pthread_create");
+                        return 1;
+                }
+        }
+
+        for (i = 0; i < mdb_config.thread_count; i++)
+                pthread_join (threads[i], NULL);
+
+        printf ("threads=%d", mdb_config.thread_count);
+        for (phase = 0; phase < MDB_PHASE_MAX; phase++) {
+                /* average per-thread time, all threads ran concurrently */
+                ops = (double) mdb_config.files * mdb_config.thread_count /
+                        (mdb_elapsed[phase] / mdb_config.thread_count);
+                printf (" %s=%.0f/s", mdb_phase_names[phase], ops);
+        }
+        printf ("\n");
+
+        free (threads);
+        return 0;
+}
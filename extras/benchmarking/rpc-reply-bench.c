@@ -0,0 +1,189 @@
+/*
+   Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/* rpc-reply-bench: cost of matching a reply to its saved frame in rpc-clnt
+ * with a given number of calls outstanding on the connection.
+ *
+ * Every iteration takes the frame of one outstanding call the way a reply
+ * does (__saved_frame_get by xid) and saves the frame of a new call in its
+ * place (__saved_frames_put), so the number outstanding stays constant.
+ *
+ *   in-order   replies come back in the order the calls were sent
+ *   random     replies come back in any order (io-threads on the brick,
+ *              calls to different files)
+ *
+ * Build it against the headers and libraries of the tree to be measured,
+ * once for each tree to compare:
+ *
+ *   gcc -O2 -D_GNU_SOURCE -DHAVE_CONFIG_H -DGF_LINUX_HOST_OS -I$TREE \
+ *       -I$TREE/libglusterfs/src -I$TREE/rpc/rpc-lib/src \
+ *       -I$TREE/rpc/xdr/src -I$TREE/contrib/uuid \
+ *       rpc-reply-bench.c -o rpc-reply-bench \
+ *       -L$TREE/rpc/rpc-lib/src/.libs -lgfrpc \
+ *       -L$TREE/rpc/xdr/src/.libs -lgfxdr \
+ *       -L$TREE/libglusterfs/src/.libs -lglusterfs -lpthread
+ *
+ * usage: rpc-reply-bench [ITERATIONS] [OUTSTANDING...]
+ *        (200000 iterations at 10, 1000 and 10000 outstanding calls)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "xlator.h"
+#include "rpc-clnt.h"
+
+/* not in rpc-clnt.h, internal to rpc-clnt.c */
+struct saved_frames *saved_frames_new (void);
+struct saved_frame *__saved_frames_put (struct saved_frames *frames,
+                                        void *frame, struct rpc_req *rpcreq);
+struct saved_frame *__saved_frame_get (struct saved_frames *frames,
+                                       int64_t callid);
+void saved_frames_destroy (struct saved_frames *frames);
+
+static int rb_iterations = 200000;
+
+static rpc_clnt_prog_t rb_prog = {
+        .progname = "bench",
+};
+
+
+static double
+rb_now (void)
+{
+        struct timeval tv;
+
+        gettimeofday (&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+rb_run (struct rpc_clnt *clnt, int outstanding, int random_order)
+{
+        struct saved_frames *frames = NULL;
+        struct saved_frame  *sf     = NULL;
+        struct rpc_req      *reqs   = NULL;
+        uint32_t             xid    = 0;
+        uint32_t             seed   = 1;
+        double               start  = 0;
+        int                  slot   = 0;
+        int                  i      = 0;
+
+        frames = saved_frames_new ();
+        reqs = calloc (outstanding, sizeof (*reqs));
+        if (!frames || !reqs)
+                return -1;
+        clnt->conn.saved_frames = frames;
+
+        for (i = 0; i < outstanding; i++) {
+                reqs[i].conn = &clnt->conn;
+                reqs[i].prog = &rb_prog;
+                reqs[i].xid  = ++xid;
+                if (!__saved_frames_put (frames, NULL, &reqs[i]))
+                        return -1;
+        }
+
+        start = rb_now ();
+        for (i = 0; i < rb_iterations; i++) {
+                if (random_order) {
+                        seed = seed * 1103515245 + 12345;
+                        slot = (seed >> 8) % outstanding;
+                } else {
+                        /* slots are refilled in turn, so the next one
+                           holds the oldest call */
+                        slot = i % outstanding;
+                }
+
+                sf = __saved_frame_get (frames, reqs[slot].xid);
+                if (!sf)
+                        return -1;
+                mem_put (sf);
+
+                reqs[slot].xid = ++xid;
+                if (!__saved_frames_put (frames, NULL, &reqs[slot]))
+                        return -1;
+        }
+
+        printf (" %s=%.0fns", random_order ? "random" : "in-order",
+                (rb_now () - start) * 1e9 / rb_iterations);
+
+        for (i = 0; i < outstanding; i++) {
+                sf = __saved_frame_get (frames, reqs[i].xid);
+                if (sf)
+                        mem_put (sf);
+        }
+
+        saved_frames_destroy (frames);
+        free (reqs);
+
+        return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        static int       defaults[] = {10, 1000, 10000};
+        glusterfs_ctx_t *ctx = NULL;
+        struct rpc_clnt  clnt;
+        int              outstanding = 0;
+        int              nr = 0;
+        int              i = 0;
+
+        if (argc > 1)
+                rb_iterations = atoi (argv[1]);
+        if (rb_iterations < 1)
+                rb_iterations = 1;
+
+        if (glusterfs_globals_init ())
+                return 1;
+
+        ctx = glusterfs_ctx_get ();
+        INIT_LIST_HEAD (&ctx->mempool_list);
+        THIS->ctx = ctx;
+
+        memset (&clnt, 0, sizeof (clnt));
+        clnt.conn.rpc_clnt = &clnt;
+        clnt.saved_frames_pool = mem_pool_new (struct saved_frame, 1024);
+        if (!clnt.saved_frames_pool)
+                return 1;
+
+        nr = (argc > 2) ? argc - 2 : 3;
+        for (i = 0; i < nr; i++) {
+                outstanding = (argc > 2) ? atoi (argv[i + 2]) :
+                        defaults[i];
+                if (outstanding < 1)
+                        continue;
+
+                printf ("outstanding=%d", outstanding);
+                if (rb_run (&clnt, outstanding, 0) ||
+                    rb_run (&clnt, outstanding, 1)) {
+                        printf ("\nfailed\n");
+                        return 1;
+                }
+                printf ("\n");
+        }
+
+        return 0;
+}
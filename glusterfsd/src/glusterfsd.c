@@ -162,6 +162,8 @@ static struct argp_option gf_options[] = {
          "[default: \"off\"]"
 #endif
         },
+        {"event-threads", ARGP_EVENT_THREADS_KEY, "COUNT", 0,
+         "Number of threads dispatching socket events [default: 1]"},
         {"brick-name", ARGP_BRICK_NAME_KEY, "BRICK-NAME", OPTION_HIDDEN,
          "Brick name to be registered with Gluster portmapper" },
         {"brick-port", ARGP_BRICK_PORT_KEY, "BRICK-PORT", OPTION_HIDDEN,
@@ -177,6 +179,11 @@ static struct argp_option gf_options[] = {
         {"attribute-timeout", ARGP_ATTRIBUTE_TIMEOUT_KEY, "SECONDS", 0,
          "Set attribute timeout to SECONDS for inodes in fuse kernel module "
          "[default: 1]"},
+        {"reader-thread-count", ARGP_READER_THREAD_COUNT_KEY, "COUNT", 0,
+         "Number of threads reading requests from the fuse kernel module "
+         "[default: 1]"},
+        {"use-splice", ARGP_USE_SPLICE_KEY, 0, 0,
+         "Splice read and write payloads to and from the fuse kernel module"},
         {"client-pid", ARGP_CLIENT_PID_KEY, "PID", OPTION_HIDDEN,
          "client will authenticate itself with process id PID to server"},
         {"user-map-root", ARGP_USER_MAP_ROOT_KEY, "USER", OPTION_HIDDEN,
@@ -305,6 +312,28 @@ create_fuse_mount (glusterfs_ctx_t *ctx)
                 }
         }
 
+        if (cmd_args->fuse_reader_thread_count) {
+                ret = dict_set_uint32 (master->options, "reader-thread-count",
+                                       cmd_args->fuse_reader_thread_count);
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR,
+                                "failed to set dict value for key %s",
+                                "reader-thread-count");
+                        goto err;
+                }
+        }
+
+        if (cmd_args->fuse_use_splice) {
+                ret = dict_set_static_ptr (master->options, "use-splice",
+                                           "on");
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR,
+                                "failed to set dict value for key %s",
+                                "use-splice");
+                        goto err;
+                }
+        }
+
         if (cmd_args->dump_fuse) {
                 ret = dict_set_static_ptr (master->options, ZR_DUMP_FUSE,
                                            cmd_args->dump_fuse);
@@ -533,6 +562,20 @@ parse_opts (int key, char *arg, struct argp_state *state)
                               "Invalid limit on connect attempts %s", arg);
                 break;
 
+        case ARGP_EVENT_THREADS_KEY:
+                n = 0;
+
+                if (gf_string2uint_base10 (arg, &n) == 0
+                    && n >= 1 && n <= EVENT_MAX_THREADS) {
+                        cmd_args->event_threads = n;
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "Invalid event thread count %s "
+                              "(valid range 1-%d)", arg, EVENT_MAX_THREADS);
+                break;
+
         case ARGP_READ_ONLY_KEY:
                 cmd_args->read_only = 1;
                 break;
@@ -739,6 +782,22 @@ parse_opts (int key, char *arg, struct argp_state *state)
                 cmd_args->mount_point = gf_strdup (arg);
                 break;
 
+        case ARGP_READER_THREAD_COUNT_KEY:
+                n = 0;
+
+                if (gf_string2uint_base10 (arg, &n) == 0 && n >= 1) {
+                        cmd_args->fuse_reader_thread_count = n;
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "unknown reader thread count %s", arg);
+                break;
+
+        case ARGP_USE_SPLICE_KEY:
+                cmd_args->fuse_use_splice = 1;
+                break;
+
         case ARGP_DUMP_FUSE_KEY:
                 cmd_args->dump_fuse = gf_strdup (arg);
                 break;
@@ -1628,6 +1687,13 @@ main (int argc, char *argv[])
 
         gf_proc_dump_init();
 
+        if (ctx->cmd_args.event_threads) {
+                ret = event_pool_set_threads (ctx->event_pool,
+                                              ctx->cmd_args.event_threads);
+                if (ret)
+                        goto out;
+        }
+
         ret = create_fuse_mount (ctx);
         if (ret)
                 goto out;
@@ -81,6 +81,9 @@ enum argp_option_keys {
         ARGP_WORM_KEY                     = 155,
         ARGP_USER_MAP_ROOT_KEY            = 156,
         ARGP_MEM_ACCOUNTING_KEY           = 157,
+        ARGP_EVENT_THREADS_KEY            = 158,
+        ARGP_READER_THREAD_COUNT_KEY      = 159,
+        ARGP_USE_SPLICE_KEY               = 160,
 };
 
 struct _gfd_vol_top_priv_t {
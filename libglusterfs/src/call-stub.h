@@ -34,6 +34,7 @@ typedef struct {
 	char wind;
 	call_frame_t *frame;
 	glusterfs_fop_t fop;
+	struct timeval queued;  /* when it was queued (io-threads) */
        struct mem_pool *stub_mem_pool;    /* pointer to stub mempool in glusterfs ctx */
 
 	union {
@@ -19,6 +19,10 @@
 
 #include <inttypes.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "glusterfs.h"
 #include "md5.h"
 #include "checksum.h"
@@ -33,6 +37,68 @@
  *  (inspired by Mark Adler's Adler-32 checksum)"
  */
 
+
+#ifdef __SSE2__
+/*
+ * Runs the checksum over the leading 16 byte blocks of @buf, returning the
+ * number of bytes consumed. Byte k of a block adds (16 - k) times itself to
+ * s2 besides 16 times the s1 it started with, so the lanes keep the plain
+ * and the weighted byte sums and the running s1 of earlier blocks apart,
+ * and all of them are folded into @s1 and @s2 at the end. Sums wrap exactly
+ * as the scalar ones do, so the result is the same.
+ */
+static int32_t
+gf_rsync_weak_checksum_sse2 (signed char *buf, int32_t len, uint32_t *s1,
+                             uint32_t *s2)
+{
+        __m128i  ones     = _mm_set1_epi16 (1);
+        __m128i  weight_l = _mm_set_epi16 (9, 10, 11, 12, 13, 14, 15, 16);
+        __m128i  weight_h = _mm_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8);
+        __m128i  sum      = _mm_setzero_si128 ();
+        __m128i  prefix   = _mm_setzero_si128 ();
+        __m128i  weighted = _mm_setzero_si128 ();
+        __m128i  block    = _mm_setzero_si128 ();
+        __m128i  lo       = _mm_setzero_si128 ();
+        __m128i  hi       = _mm_setzero_si128 ();
+        uint32_t lanes[4];
+        uint32_t blocks   = 0;
+        uint32_t n        = 0;
+
+        if (len < 16)
+                return 0;
+
+        blocks = len / 16;
+
+        for (n = 0; n < blocks; n++) {
+                block = _mm_loadu_si128 ((__m128i *) (buf + n * 16));
+
+                /* sign extend the bytes to 16 bit lanes */
+                lo = _mm_srai_epi16 (_mm_unpacklo_epi8 (block, block), 8);
+                hi = _mm_srai_epi16 (_mm_unpackhi_epi8 (block, block), 8);
+
+                prefix = _mm_add_epi32 (prefix, sum);
+                sum = _mm_add_epi32 (sum, _mm_madd_epi16 (lo, ones));
+                sum = _mm_add_epi32 (sum, _mm_madd_epi16 (hi, ones));
+                weighted = _mm_add_epi32 (weighted,
+                                          _mm_madd_epi16 (lo, weight_l));
+                weighted = _mm_add_epi32 (weighted,
+                                          _mm_madd_epi16 (hi, weight_h));
+        }
+
+        _mm_storeu_si128 ((__m128i *) lanes, weighted);
+        *s2 += 16 * blocks * *s1 + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+        _mm_storeu_si128 ((__m128i *) lanes, prefix);
+        *s2 += 16 * (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+
+        _mm_storeu_si128 ((__m128i *) lanes, sum);
+        *s1 += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+        return blocks * 16;
+}
+#endif
+
+
 uint32_t
 gf_rsync_weak_checksum (char *buf1, int32_t len)
 {
@@ -43,7 +109,13 @@ gf_rsync_weak_checksum (char *buf1, int32_t len)
         uint32_t csum;
 
         s1 = s2 = 0;
-        for (i = 0; i < (len-4); i+=4) {
+        i = 0;
+
+#ifdef __SSE2__
+        i = gf_rsync_weak_checksum_sse2 (buf, len, &s1, &s2);
+#endif
+
+        for (; i < (len-4); i+=4) {
                 s2 += 4*(s1 + buf[i]) + 3*buf[i+1] + 2*buf[i+2] + buf[i+3];
 
                 s1 += buf[i+0] + buf[i+1] + buf[i+2] + buf[i+3];
@@ -76,3 +148,139 @@ gf_rsync_strong_checksum (char *buf, int32_t len, uint8_t *sum)
 
         return;
 }
+
+
+/*
+ * MurmurHash3_x64_128 by Austin Appleby (public domain), a much cheaper
+ * strong checksum than MD5 for comparing blocks which are not adversarial.
+ * Input and output are read and written little endian so that bricks on
+ * any host agree on it.
+ */
+
+#define GF_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t
+gf_murmur3_load64 (const unsigned char *p)
+{
+        return ((uint64_t) p[0]) | ((uint64_t) p[1] << 8) |
+                ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+                ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+                ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline void
+gf_murmur3_store64 (unsigned char *p, uint64_t v)
+{
+        int i = 0;
+
+        for (i = 0; i < 8; i++)
+                p[i] = (unsigned char) (v >> (8 * i));
+}
+
+static inline uint64_t
+gf_murmur3_fmix64 (uint64_t k)
+{
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+
+        return k;
+}
+
+void
+gf_rsync_murmur3_checksum (char *buf, int32_t len, uint8_t *sum)
+{
+        const unsigned char *data   = (const unsigned char *) buf;
+        const unsigned char *tail   = NULL;
+        const uint64_t       c1     = 0x87c37b91114253d5ULL;
+        const uint64_t       c2     = 0x4cf5ad432745937fULL;
+        uint64_t             h1     = 0;
+        uint64_t             h2     = 0;
+        uint64_t             k1     = 0;
+        uint64_t             k2     = 0;
+        int32_t              blocks = 0;
+        int32_t              i      = 0;
+
+        if (len < 0)
+                len = 0;
+        blocks = len / 16;
+
+        for (i = 0; i < blocks; i++) {
+                k1 = gf_murmur3_load64 (data + i * 16);
+                k2 = gf_murmur3_load64 (data + i * 16 + 8);
+
+                k1 *= c1; k1 = GF_ROTL64 (k1, 31); k1 *= c2; h1 ^= k1;
+
+                h1 = GF_ROTL64 (h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+                k2 *= c2; k2 = GF_ROTL64 (k2, 33); k2 *= c1; h2 ^= k2;
+
+                h2 = GF_ROTL64 (h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        tail = data + blocks * 16;
+        k1 = 0;
+        k2 = 0;
+
+        switch (len & 15) {
+        case 15: k2 ^= ((uint64_t) tail[14]) << 48;
+        case 14: k2 ^= ((uint64_t) tail[13]) << 40;
+        case 13: k2 ^= ((uint64_t) tail[12]) << 32;
+        case 12: k2 ^= ((uint64_t) tail[11]) << 24;
+        case 11: k2 ^= ((uint64_t) tail[10]) << 16;
+        case 10: k2 ^= ((uint64_t) tail[9]) << 8;
+        case  9: k2 ^= ((uint64_t) tail[8]);
+                k2 *= c2; k2 = GF_ROTL64 (k2, 33); k2 *= c1; h2 ^= k2;
+
+        case  8: k1 ^= ((uint64_t) tail[7]) << 56;
+        case  7: k1 ^= ((uint64_t) tail[6]) << 48;
+        case  6: k1 ^= ((uint64_t) tail[5]) << 40;
+        case  5: k1 ^= ((uint64_t) tail[4]) << 32;
+        case  4: k1 ^= ((uint64_t) tail[3]) << 24;
+        case  3: k1 ^= ((uint64_t) tail[2]) << 16;
+        case  2: k1 ^= ((uint64_t) tail[1]) << 8;
+        case  1: k1 ^= ((uint64_t) tail[0]);
+                k1 *= c1; k1 = GF_ROTL64 (k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= (uint64_t) len;
+        h2 ^= (uint64_t) len;
+
+        h1 += h2;
+        h2 += h1;
+
+        h1 = gf_murmur3_fmix64 (h1);
+        h2 = gf_murmur3_fmix64 (h2);
+
+        h1 += h2;
+        h2 += h1;
+
+        gf_murmur3_store64 (sum, h1);
+        gf_murmur3_store64 (sum + 8, h2);
+}
+
+
+struct gf_rsync_checksum_algorithm gf_rsync_strong_checksums[] = {
+        {.name = "md5",     .fn = gf_rsync_strong_checksum},
+        {.name = "murmur3", .fn = gf_rsync_murmur3_checksum},
+        {0, 0},
+};
+
+
+gf_rsync_checksum_fn
+gf_rsync_strong_checksum_get (const char *name)
+{
+        struct gf_rsync_checksum_algorithm *algo = NULL;
+
+        if (!name)
+                return NULL;
+
+        for (algo = gf_rsync_strong_checksums; algo->name; algo++) {
+                if (strcmp (algo->name, name) == 0)
+                        return algo->fn;
+        }
+
+        return NULL;
+}
@@ -20,8 +20,23 @@
 #ifndef __CHECKSUM_H__
 #define __CHECKSUM_H__
 
+/* all strong checksums are as long as an MD5 digest */
+#define GF_RSYNC_STRONG_CHECKSUM_LEN 16
+
+typedef void (*gf_rsync_checksum_fn) (char *buf, int32_t len, uint8_t *sum);
+
+struct gf_rsync_checksum_algorithm {
+        const char           *name;
+        gf_rsync_checksum_fn  fn;
+};
+
+extern struct gf_rsync_checksum_algorithm gf_rsync_strong_checksums[];
+
 uint32_t gf_rsync_weak_checksum (char *buf, int32_t len);
 
 void gf_rsync_strong_checksum (char *buf, int32_t len, uint8_t *sum);
+void gf_rsync_murmur3_checksum (char *buf, int32_t len, uint8_t *sum);
+
+gf_rsync_checksum_fn gf_rsync_strong_checksum_get (const char *name);
 
 #endif /* __CHECKSUM_H__ */
@@ -0,0 +1,409 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "compound-fop-utils.h"
+#include "common-utils.h"
+#include "mem-types.h"
+
+typedef struct {
+        compound_args_t     *args;
+        compound_args_cbk_t *args_cbk;
+        int                  idx;
+        int32_t              op_ret;
+        int32_t              op_errno;
+} compound_split_t;
+
+
+compound_args_t *
+compound_args_new (void)
+{
+        return GF_CALLOC (1, sizeof (compound_args_t),
+                          gf_common_mt_compound_args_t);
+}
+
+
+compound_req_t *
+compound_args_add (compound_args_t *args, glusterfs_fop_t fop)
+{
+        compound_req_t *req = NULL;
+
+        if (args->count == GF_COMPOUND_MAX_FOPS)
+                return NULL;
+
+        req = &args->req[args->count++];
+        req->fop = fop;
+
+        return req;
+}
+
+
+void
+compound_args_destroy (compound_args_t *args)
+{
+        compound_req_t *req = NULL;
+        int             i   = 0;
+
+        if (!args)
+                return;
+
+        for (i = 0; i < args->count; i++) {
+                req = &args->req[i];
+
+                loc_wipe (&req->loc);
+                if (req->fd)
+                        fd_unref (req->fd);
+                if (req->vector)
+                        GF_FREE (req->vector);
+                if (req->iobref)
+                        iobref_unref (req->iobref);
+                if (req->xattr)
+                        dict_unref (req->xattr);
+        }
+
+        GF_FREE (args);
+}
+
+
+compound_args_cbk_t *
+compound_args_cbk_new (int count)
+{
+        compound_args_cbk_t *args_cbk = NULL;
+        int                  i        = 0;
+
+        args_cbk = GF_CALLOC (1, sizeof (compound_args_cbk_t),
+                              gf_common_mt_compound_args_cbk_t);
+        if (!args_cbk)
+                return NULL;
+
+        args_cbk->count = count;
+        for (i = 0; i < count; i++) {
+                args_cbk->rsp[i].op_ret   = -1;
+                args_cbk->rsp[i].op_errno = ECANCELED;
+        }
+
+        return args_cbk;
+}
+
+
+void
+compound_args_cbk_destroy (compound_args_cbk_t *args_cbk)
+{
+        compound_rsp_t *rsp = NULL;
+        int             i   = 0;
+
+        if (!args_cbk)
+                return;
+
+        for (i = 0; i < args_cbk->count; i++) {
+                rsp = &args_cbk->rsp[i];
+
+                if (rsp->vector)
+                        GF_FREE (rsp->vector);
+                if (rsp->iobref)
+                        iobref_unref (rsp->iobref);
+                if (rsp->xattr)
+                        dict_unref (rsp->xattr);
+        }
+
+        GF_FREE (args_cbk);
+}
+
+
+gf_boolean_t
+compound_fop_supported (glusterfs_fop_t fop)
+{
+        switch (fop) {
+        case GF_FOP_LOOKUP:
+        case GF_FOP_OPEN:
+        case GF_FOP_CREATE:
+        case GF_FOP_READ:
+        case GF_FOP_WRITE:
+        case GF_FOP_FLUSH:
+        case GF_FOP_RELEASE:
+                return _gf_true;
+        default:
+                return _gf_false;
+        }
+}
+
+
+static int32_t compound_split_next (call_frame_t *frame, xlator_t *this,
+                                    compound_split_t *split);
+
+/* the steps after a lookup or create of a fresh inode only know it by its
+   loc, hand them the gfid the brick returned */
+static void
+compound_split_set_gfid (compound_split_t *split, inode_t *inode,
+                         struct iatt *buf)
+{
+        compound_req_t *req = NULL;
+        int             i   = 0;
+
+        for (i = split->idx + 1; i < split->args->count; i++) {
+                req = &split->args->req[i];
+
+                if ((req->loc.inode == inode) && uuid_is_null (req->loc.gfid))
+                        uuid_copy (req->loc.gfid, buf->ia_gfid);
+        }
+}
+
+
+static int32_t
+compound_split_step_done (call_frame_t *frame, xlator_t *this,
+                          compound_split_t *split, int32_t op_ret,
+                          int32_t op_errno)
+{
+        compound_rsp_t *rsp = NULL;
+
+        rsp = &split->args_cbk->rsp[split->idx];
+        rsp->op_ret   = op_ret;
+        rsp->op_errno = op_errno;
+
+        if ((op_ret < 0) && (split->op_ret == 0)) {
+                split->op_ret   = -1;
+                split->op_errno = op_errno;
+        }
+
+        split->idx++;
+
+        return compound_split_next (frame, this, split);
+}
+
+
+static int32_t
+compound_split_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno, inode_t *inode,
+                           struct iatt *buf, dict_t *xattr,
+                           struct iatt *postparent)
+{
+        compound_split_t *split = cookie;
+        compound_rsp_t   *rsp   = NULL;
+
+        rsp = &split->args_cbk->rsp[split->idx];
+
+        if (op_ret == 0) {
+                rsp->stat     = *buf;
+                rsp->poststat = *postparent;
+                if (xattr)
+                        rsp->xattr = dict_ref (xattr);
+
+                compound_split_set_gfid (split, inode, buf);
+        }
+
+        return compound_split_step_done (frame, this, split, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        return compound_split_step_done (frame, this, cookie, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno, fd_t *fd,
+                           inode_t *inode, struct iatt *buf,
+                           struct iatt *preparent, struct iatt *postparent)
+{
+        compound_split_t *split = cookie;
+        compound_rsp_t   *rsp   = NULL;
+
+        rsp = &split->args_cbk->rsp[split->idx];
+
+        if (op_ret >= 0) {
+                rsp->stat     = *buf;
+                rsp->prestat  = *preparent;
+                rsp->poststat = *postparent;
+
+                compound_split_set_gfid (split, inode, buf);
+        }
+
+        return compound_split_step_done (frame, this, split, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno,
+                          struct iovec *vector, int32_t count,
+                          struct iatt *stbuf, struct iobref *iobref)
+{
+        compound_split_t *split = cookie;
+        compound_rsp_t   *rsp   = NULL;
+
+        rsp = &split->args_cbk->rsp[split->idx];
+
+        if (op_ret >= 0) {
+                rsp->stat = *stbuf;
+                if (count) {
+                        rsp->vector = iov_dup (vector, count);
+                        if (!rsp->vector) {
+                                op_ret   = -1;
+                                op_errno = ENOMEM;
+                                goto out;
+                        }
+                        rsp->count = count;
+                }
+                if (iobref)
+                        rsp->iobref = iobref_ref (iobref);
+        }
+out:
+        return compound_split_step_done (frame, this, split, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno,
+                           struct iatt *prebuf, struct iatt *postbuf)
+{
+        compound_split_t *split = cookie;
+        compound_rsp_t   *rsp   = NULL;
+
+        rsp = &split->args_cbk->rsp[split->idx];
+
+        if (op_ret >= 0) {
+                rsp->prestat  = *prebuf;
+                rsp->poststat = *postbuf;
+        }
+
+        return compound_split_step_done (frame, this, split, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno)
+{
+        return compound_split_step_done (frame, this, cookie, op_ret,
+                                         op_errno);
+}
+
+
+static int32_t
+compound_split_next (call_frame_t *frame, xlator_t *this,
+                     compound_split_t *split)
+{
+        compound_req_t *req = NULL;
+
+        for (; split->idx < split->args->count; split->idx++) {
+                req = &split->args->req[split->idx];
+
+                if (req->fop == GF_FOP_RELEASE) {
+                        /* nothing to forget here, the fd goes away with
+                           its last ref */
+                        split->args_cbk->rsp[split->idx].op_ret   = 0;
+                        split->args_cbk->rsp[split->idx].op_errno = 0;
+                        continue;
+                }
+
+                if (split->op_ret < 0)
+                        continue;
+
+                switch (req->fop) {
+                case GF_FOP_LOOKUP:
+                        STACK_WIND_COOKIE (frame, compound_split_lookup_cbk,
+                                           split, this, this->fops->lookup,
+                                           &req->loc, req->xattr);
+                        return 0;
+                case GF_FOP_OPEN:
+                        STACK_WIND_COOKIE (frame, compound_split_open_cbk,
+                                           split, this, this->fops->open,
+                                           &req->loc, req->flags, req->fd, 0);
+                        return 0;
+                case GF_FOP_CREATE:
+                        STACK_WIND_COOKIE (frame, compound_split_create_cbk,
+                                           split, this, this->fops->create,
+                                           &req->loc, req->flags, req->mode,
+                                           req->fd, req->xattr);
+                        return 0;
+                case GF_FOP_READ:
+                        STACK_WIND_COOKIE (frame, compound_split_readv_cbk,
+                                           split, this, this->fops->readv,
+                                           req->fd, req->size, req->offset,
+                                           req->flags);
+                        return 0;
+                case GF_FOP_WRITE:
+                        STACK_WIND_COOKIE (frame, compound_split_writev_cbk,
+                                           split, this, this->fops->writev,
+                                           req->fd, req->vector, req->count,
+                                           req->offset, req->flags,
+                                           req->iobref);
+                        return 0;
+                case GF_FOP_FLUSH:
+                        STACK_WIND_COOKIE (frame, compound_split_flush_cbk,
+                                           split, this, this->fops->flush,
+                                           req->fd);
+                        return 0;
+                default:
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "%s can not be part of a compound fop",
+                                gf_fop_list[req->fop]);
+                        split->args_cbk->rsp[split->idx].op_errno = ENOTSUP;
+                        split->op_ret   = -1;
+                        split->op_errno = ENOTSUP;
+                        break;
+                }
+        }
+
+        STACK_UNWIND_STRICT (compound, frame, split->op_ret, split->op_errno,
+                             split->args_cbk);
+
+        compound_args_cbk_destroy (split->args_cbk);
+        GF_FREE (split);
+
+        return 0;
+}
+
+
+int32_t
+compound_fop_split (call_frame_t *frame, xlator_t *this,
+                    compound_args_t *args)
+{
+        compound_split_t *split = NULL;
+
+        split = GF_CALLOC (1, sizeof (*split), gf_common_mt_compound_split_t);
+        if (!split)
+                goto err;
+
+        split->args_cbk = compound_args_cbk_new (args->count);
+        if (!split->args_cbk)
+                goto err;
+
+        split->args = args;
+
+        return compound_split_next (frame, this, split);
+err:
+        GF_FREE (split);
+        STACK_UNWIND_STRICT (compound, frame, -1, ENOMEM, NULL);
+        return 0;
+}
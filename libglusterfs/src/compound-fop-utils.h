@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _COMPOUND_FOP_UTILS_H
+#define _COMPOUND_FOP_UTILS_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+
+/* A COMPOUND fop carries a short chain of fops which are executed in order,
+ * protocol/server runs the whole chain on the brick for one round trip.
+ * Execution stops at the first step that fails; the steps after it are not
+ * run and fail with ECANCELED, except RELEASE steps which always run.
+ *
+ * A step refers to the result of an earlier one of the same chain by
+ * passing the same object: the fd_t an OPEN or CREATE opened, the inode of
+ * the loc_t a LOOKUP or CREATE resolved.
+ */
+#define GF_COMPOUND_MAX_FOPS  16
+
+/*
+ * LOOKUP:   loc, xattr (xattr_req)
+ * OPEN:     loc, flags, fd
+ * CREATE:   loc, flags, mode, fd, xattr (params)
+ * READ:     fd, size, offset, flags
+ * WRITE:    fd, vector, count, offset, flags, iobref
+ * FLUSH:    fd
+ * RELEASE:  fd; the brick forgets the fd, later fops on the fd_t use an
+ *           anonymous fd
+ *
+ * A step holds its own refs, dropped in compound_args_destroy ().
+ */
+typedef struct {
+        glusterfs_fop_t  fop;
+        loc_t            loc;
+        fd_t            *fd;
+        int32_t          flags;
+        mode_t           mode;
+        size_t           size;
+        off_t            offset;
+        struct iovec    *vector;
+        int32_t          count;
+        struct iobref   *iobref;
+        dict_t          *xattr;
+} compound_req_t;
+
+/*
+ * LOOKUP:   stat, poststat (postparent), xattr
+ * CREATE:   stat, prestat (preparent), poststat (postparent)
+ * READ:     vector, count, iobref, stat
+ * WRITE:    prestat, poststat
+ */
+typedef struct {
+        int32_t          op_ret;
+        int32_t          op_errno;
+        struct iatt      stat;
+        struct iatt      prestat;
+        struct iatt      poststat;
+        struct iovec    *vector;
+        int32_t          count;
+        struct iobref   *iobref;
+        dict_t          *xattr;
+} compound_rsp_t;
+
+struct _compound_args {
+        int              count;
+        compound_req_t   req[GF_COMPOUND_MAX_FOPS];
+};
+
+/* passed to the compound cbk, which gets op_ret 0 only if every step
+   succeeded and otherwise the op_errno of the first one that failed. NULL
+   if the chain could not be run at all. */
+struct _compound_args_cbk {
+        int              count;
+        compound_rsp_t   rsp[GF_COMPOUND_MAX_FOPS];
+};
+
+compound_args_t *compound_args_new (void);
+compound_req_t *compound_args_add (compound_args_t *args, glusterfs_fop_t fop);
+void compound_args_destroy (compound_args_t *args);
+
+compound_args_cbk_t *compound_args_cbk_new (int count);
+void compound_args_cbk_destroy (compound_args_cbk_t *args_cbk);
+
+gf_boolean_t compound_fop_supported (glusterfs_fop_t fop);
+
+/* runs the chain as separate fops wound to @this itself, for translators
+   which can not pass it on as a whole */
+int32_t compound_fop_split (call_frame_t *frame, xlator_t *this,
+                            compound_args_t *args);
+
+#endif /* _COMPOUND_FOP_UTILS_H */
@@ -426,6 +426,15 @@ default_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         return 0;
 }
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      compound_args_cbk_t *args_cbk)
+{
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, args_cbk);
+        return 0;
+}
+
 int32_t
 default_getspec_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno, char *spec_data)
@@ -819,6 +828,15 @@ default_fsetattr_resume (call_frame_t *frame, xlator_t *this, fd_t *fd,
         return 0;
 }
 
+int32_t
+default_compound_resume (call_frame_t *frame, xlator_t *this,
+                         compound_args_t *args)
+{
+        STACK_WIND (frame, default_compound_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->compound, args);
+        return 0;
+}
+
 /* FOPS */
 
 int32_t
@@ -1194,6 +1212,14 @@ default_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
         return 0;
 }
 
+int32_t
+default_compound (call_frame_t *frame, xlator_t *this, compound_args_t *args)
+{
+        STACK_WIND (frame, default_compound_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->compound, args);
+        return 0;
+}
+
 
 int32_t
 default_forget (xlator_t *this, inode_t *inode)
@@ -1270,6 +1296,21 @@ default_notify (xlator_t *this, int32_t event, void *data, ...)
                 }
         }
         break;
+        case GF_EVENT_UPCALL:
+        {
+                xlator_list_t *parent = this->parents;
+                /* the invalidation has to reach the fuse bridge too */
+                if (!parent && this->ctx && this->ctx->master)
+                        xlator_notify (this->ctx->master, event, data, NULL);
+
+                while (parent) {
+                        if (parent->xlator->init_succeeded)
+                                xlator_notify (parent->xlator, event,
+                                               data, NULL);
+                        parent = parent->next;
+                }
+        }
+        break;
         default:
         {
                 xlator_list_t *parent = this->parents;
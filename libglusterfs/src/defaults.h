@@ -253,6 +253,10 @@ int32_t default_fsetattr (call_frame_t *frame,
                           struct iatt *stbuf,
                           int32_t valid);
 
+int32_t default_compound (call_frame_t *frame,
+                          xlator_t *this,
+                          compound_args_t *args);
+
 /* Resume */
 int32_t default_getspec (call_frame_t *frame,
                          xlator_t *this,
@@ -476,6 +480,10 @@ int32_t default_fsetattr_resume (call_frame_t *frame,
                           struct iatt *stbuf,
                           int32_t valid);
 
+int32_t default_compound_resume (call_frame_t *frame,
+                                 xlator_t *this,
+                                 compound_args_t *args);
+
 /* _cbk */
 
 int32_t
@@ -686,6 +694,11 @@ default_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                       int32_t op_ret, int32_t op_errno, struct iatt *statpre,
                       struct iatt *statpost);
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      compound_args_cbk_t *args_cbk);
+
 int32_t
 default_getspec_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno, char *spec_data);
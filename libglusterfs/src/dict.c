@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stddef.h>
 
 #ifndef _CONFIG_H
 #define _CONFIG_H
@@ -37,6 +38,15 @@
 #include "compat.h"
 #include "byte-order.h"
 #include "globals.h"
+#include "iobuf.h"
+
+/* marks a slot of a deleted pair in the index of a dict */
+static data_pair_t dict_deleted_pair;
+#define DICT_PAIR_DELETED (&dict_deleted_pair)
+
+#define dict_in_arena(dict, ptr) (((char *)(ptr) >= (dict)->arena) &&   \
+                                  ((char *)(ptr) < ((dict)->arena +     \
+                                                    DICT_ARENA_SIZE)))
 
 data_pair_t *
 get_new_data_pair ()
@@ -62,19 +72,119 @@ get_new_data ()
         return data;
 }
 
+/* rebuild the index of @this with @size slots from members_list */
+static int
+__dict_index_rebuild (dict_t *this, int size)
+{
+        data_pair_t **members = NULL;
+        data_pair_t  *pair = NULL;
+        int           i = 0;
+
+        if (size > DICT_INDEX_INLINE) {
+                members = GF_CALLOC (size, sizeof (*members),
+                                     gf_common_mt_dict_index);
+                if (!members)
+                        return -1;
+        } else {
+                size = DICT_INDEX_INLINE;
+                members = this->members_inline;
+                memset (members, 0, sizeof (this->members_inline));
+        }
+
+        if (this->members && (this->members != this->members_inline) &&
+            (this->members != members))
+                GF_FREE (this->members);
+
+        this->members = members;
+        this->hash_size = size;
+        this->index_used = 0;
+
+        for (pair = this->members_list; pair; pair = pair->next) {
+                i = pair->key_hash & (size - 1);
+                while (members[i])
+                        i = (i + 1) & (size - 1);
+                members[i] = pair;
+                this->index_used++;
+        }
+
+        return 0;
+}
+
+
+static int
+__dict_index_size (int count)
+{
+        int size = DICT_INDEX_INLINE;
+
+        /* keep the index at most half full after a rebuild */
+        while (count * 2 > size)
+                size <<= 1;
+
+        return size;
+}
+
+
+/* pairs and their keys are carved out of the arena of the dict while it
+   lasts, and are only given back when the dict is destroyed */
+static data_pair_t *
+__dict_pair_new (dict_t *this, char *key)
+{
+        data_pair_t *pair = NULL;
+        size_t       keylen = 0;
+        size_t       size = 0;
+
+        keylen = strlen (key) + 1;
+        size = (sizeof (*pair) + keylen + sizeof (void *) - 1) &
+                ~(sizeof (void *) - 1);
+
+        if (this->arena_used + size <= DICT_ARENA_SIZE) {
+                pair = (data_pair_t *)(this->arena + this->arena_used);
+                this->arena_used += size;
+
+                memset (pair, 0, sizeof (*pair));
+                pair->key = (char *)(pair + 1);
+        } else {
+                pair = mem_get0 (THIS->ctx->dict_pair_pool);
+                if (!pair)
+                        return NULL;
+
+                pair->key = GF_CALLOC (1, keylen, gf_common_mt_char);
+                if (!pair->key) {
+                        mem_put (pair);
+                        return NULL;
+                }
+        }
+
+        memcpy (pair->key, key, keylen);
+
+        return pair;
+}
+
+
+static void
+__dict_pair_free (dict_t *this, data_pair_t *pair)
+{
+        if (dict_in_arena (this, pair))
+                return;
+
+        GF_FREE (pair->key);
+        mem_put (pair);
+}
+
+
 dict_t *
 get_new_dict_full (int size_hint)
 {
-        dict_t *dict = mem_get0 (THIS->ctx->dict_pool);
+        dict_t *dict = mem_get (THIS->ctx->dict_pool);
 
         if (!dict) {
                 return NULL;
         }
 
-        dict->hash_size = size_hint;
-        dict->members = mem_get0 (THIS->ctx->dict_pair_pool);
+        /* the arena is not looked at beyond arena_used */
+        memset (dict, 0, offsetof (dict_t, arena));
 
-        if (!dict->members) {
+        if (__dict_index_rebuild (dict, __dict_index_size (size_hint))) {
                 mem_put (dict);
                 return NULL;
         }
@@ -136,6 +246,7 @@ data_destroy (data_t *data)
         if (data) {
                 LOCK_DESTROY (&data->lock);
 
+                /* values in inline_data are marked static as well */
                 if (!data->is_static) {
                         if (data->data) {
                                 if (data->is_stdalloc)
@@ -147,6 +258,9 @@ data_destroy (data_t *data)
                                 GF_FREE (data->vec);
                 }
 
+                if (data->iobuf)
+                        iobuf_unref (data->iobuf);
+
                 data->len = 0xbabababa;
                 if (!data->is_const)
                         mem_put (data);
@@ -196,6 +310,28 @@ err_out:
         return NULL;
 }
 
+static data_pair_t *
+__dict_index_find (dict_t *this, char *key, uint32_t hash, int *slot)
+{
+        data_pair_t *pair = NULL;
+        int          mask = this->hash_size - 1;
+        int          i = hash & mask;
+
+        /* linear probing, the index always has an empty slot */
+        while ((pair = this->members[i]) != NULL) {
+                if ((pair != DICT_PAIR_DELETED) && (pair->key_hash == hash)
+                    && !strcmp (pair->key, key)) {
+                        if (slot)
+                                *slot = i;
+                        return pair;
+                }
+                i = (i + 1) & mask;
+        }
+
+        return NULL;
+}
+
+
 static data_pair_t *
 _dict_lookup (dict_t *this, char *key)
 {
@@ -205,15 +341,8 @@ _dict_lookup (dict_t *this, char *key)
                 return NULL;
         }
 
-        int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-        data_pair_t *pair;
-
-        for (pair = this->members[hashval]; pair != NULL; pair = pair->hash_next) {
-                if (pair->key && !strcmp (pair->key, key))
-                        return pair;
-        }
-
-        return NULL;
+        return __dict_index_find (this, key, SuperFastHash (key, strlen (key)),
+                                  NULL);
 }
 
 int32_t
@@ -242,10 +371,10 @@ _dict_set (dict_t *this,
            char *key,
            data_t *value)
 {
-        int hashval;
         data_pair_t *pair;
         char key_free = 0;
-        int tmp = 0;
+        uint32_t hash = 0;
+        int i = 0;
         int ret = 0;
 
         if (!key) {
@@ -257,9 +386,8 @@ _dict_set (dict_t *this,
                 key_free = 1;
         }
 
-        tmp = SuperFastHash (key, strlen (key));
-        hashval = (tmp % this->hash_size);
-        pair = _dict_lookup (this, key);
+        hash = SuperFastHash (key, strlen (key));
+        pair = __dict_index_find (this, key, hash, NULL);
 
         if (pair) {
                 data_t *unref_data = pair->value;
@@ -270,26 +398,34 @@ _dict_set (dict_t *this,
                 /* Indicates duplicate key */
                 return 0;
         }
-        pair = mem_get0 (THIS->ctx->dict_pair_pool);
-        if (!pair) {
-                return -1;
-        }
 
-        pair->key = (char *) GF_CALLOC (1, strlen (key) + 1,
-                                        gf_common_mt_char);
-        if (!pair->key) {
-                mem_put (pair);
+        /* keep the index at most three quarters full, deleted slots
+           included */
+        if ((this->index_used + 1) * 4 > this->hash_size * 3) {
+                if (__dict_index_rebuild (this, __dict_index_size
+                                          (this->count + 1))) {
+                        if (key_free)
+                                GF_FREE (key);
+                        return -1;
+                }
+        }
 
+        pair = __dict_pair_new (this, key);
+        if (!pair) {
                 if (key_free)
                         GF_FREE (key);
                 return -1;
         }
 
-        strcpy (pair->key, key);
+        pair->key_hash = hash;
         pair->value = data_ref (value);
 
-        pair->hash_next = this->members[hashval];
-        this->members[hashval] = pair;
+        i = hash & (this->hash_size - 1);
+        while (this->members[i] && this->members[i] != DICT_PAIR_DELETED)
+                i = (i + 1) & (this->hash_size - 1);
+        if (!this->members[i])
+                this->index_used++;
+        this->members[i] = pair;
 
         pair->next = this->members_list;
         pair->prev = NULL;
@@ -358,37 +494,34 @@ dict_del (dict_t *this, char *key)
                 return;
         }
 
-        LOCK (&this->lock);
-
-        int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-        data_pair_t *pair = this->members[hashval];
-        data_pair_t *prev = NULL;
+        data_pair_t *pair = NULL;
+        int          slot = 0;
 
-        while (pair) {
-                if (strcmp (pair->key, key) == 0) {
-                        if (prev)
-                                prev->hash_next = pair->hash_next;
-                        else
-                                this->members[hashval] = pair->hash_next;
+        LOCK (&this->lock);
 
-                        data_unref (pair->value);
+        pair = __dict_index_find (this, key, SuperFastHash (key, strlen (key)),
+                                  &slot);
+        if (pair) {
+                /* a slot before an empty one ends no probe sequence */
+                if (!this->members[(slot + 1) & (this->hash_size - 1)]) {
+                        this->members[slot] = NULL;
+                        this->index_used--;
+                } else {
+                        this->members[slot] = DICT_PAIR_DELETED;
+                }
 
-                        if (pair->prev)
-                                pair->prev->next = pair->next;
-                        else
-                                this->members_list = pair->next;
+                data_unref (pair->value);
 
-                        if (pair->next)
-                                pair->next->prev = pair->prev;
+                if (pair->prev)
+                        pair->prev->next = pair->next;
+                else
+                        this->members_list = pair->next;
 
-                        GF_FREE (pair->key);
-                        mem_put (pair);
-                        this->count--;
-                        break;
-                }
+                if (pair->next)
+                        pair->next->prev = pair->prev;
 
-                prev = pair;
-                pair = pair->hash_next;
+                __dict_pair_free (this, pair);
+                this->count--;
         }
 
         UNLOCK (&this->lock);
@@ -412,12 +545,12 @@ dict_destroy (dict_t *this)
         while (prev) {
                 pair = pair->next;
                 data_unref (prev->value);
-                GF_FREE (prev->key);
-                mem_put (prev);
+                __dict_pair_free (this, prev);
                 prev = pair;
         }
 
-        mem_put (this->members);
+        if (this->members != this->members_inline)
+                GF_FREE (this->members);
 
         if (this->extra_free)
                 GF_FREE (this->extra_free);
@@ -739,19 +872,16 @@ dict_to_iovec (dict_t *this,
 data_t *
 int_to_data (int64_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
 
-        ret = gf_asprintf (&data->data, "%"PRId64, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRId64, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -759,18 +889,15 @@ int_to_data (int64_t value)
 data_t *
 data_from_int64 (int64_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRId64, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRId64, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -778,19 +905,15 @@ data_from_int64 (int64_t value)
 data_t *
 data_from_int32 (int32_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRId32, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRId32, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -798,19 +921,15 @@ data_from_int32 (int32_t value)
 data_t *
 data_from_int16 (int16_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRId16, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRId16, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -818,19 +937,15 @@ data_from_int16 (int16_t value)
 data_t *
 data_from_int8 (int8_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%d", value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%d", value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -838,19 +953,15 @@ data_from_int8 (int8_t value)
 data_t *
 data_from_uint64 (uint64_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRIu64, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRIu64, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -880,19 +991,15 @@ data_from_double (double value)
 data_t *
 data_from_uint32 (uint32_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRIu32, value);
-        if (-1 == ret) {
-                gf_log ("dict", GF_LOG_DEBUG, "asprintf failed");
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRIu32, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -901,18 +1008,15 @@ data_from_uint32 (uint32_t value)
 data_t *
 data_from_uint16 (uint16_t value)
 {
-        int     ret = 0;
         data_t *data = get_new_data ();
 
         if (!data) {
                 return NULL;
         }
-        ret = gf_asprintf (&data->data, "%"PRIu16, value);
-        if (-1 == ret) {
-                return NULL;
-        }
-
-        data->len = strlen (data->data) + 1;
+        data->len = snprintf (data->inline_data, DATA_INLINE_SIZE,
+                              "%"PRIu16, value) + 1;
+        data->data = data->inline_data;
+        data->is_static = 1;
 
         return data;
 }
@@ -1321,7 +1425,7 @@ dict_copy (dict_t *dict,
         }
 
         if (!new)
-                new = get_new_dict_full (dict->hash_size);
+                new = get_new_dict_full (dict->count);
 
         dict_foreach (dict, _copy, new);
 
@@ -1342,6 +1446,47 @@ out:
         return ret;
 }
 
+static void
+_copy_private (dict_t *unused,
+               char *key,
+               data_t *value,
+               void *newdict)
+{
+        data_t *copy = NULL;
+
+        /* a value pointing into an iobuf would keep all of it */
+        if (value->iobuf)
+                copy = data_copy (value);
+
+        if (copy)
+                dict_set ((dict_t *)newdict, key, copy);
+        else
+                dict_set ((dict_t *)newdict, key, value);
+}
+
+
+/* Like dict_copy (), but values which point into the buffer the dict was
+   unserialized from (see dict_unserialize_iobuf ()) are copied, for dicts
+   which are kept for long. */
+dict_t *
+dict_copy_private (dict_t *dict,
+                   dict_t *new)
+{
+        if (!dict) {
+                gf_log_callingfn ("dict", GF_LOG_WARNING, "dict is NULL");
+                return NULL;
+        }
+
+        if (!new)
+                new = dict_new ();
+
+        if (new)
+                dict_foreach (dict, _copy_private, new);
+
+        return new;
+}
+
+
 dict_t *
 dict_copy_with_ref (dict_t *dict,
                     dict_t *new)
@@ -2572,18 +2717,28 @@ out:
 
 
 /**
- * dict_unserialize - unserialize a buffer into a dict
+ * dict_unserialize_iobuf - unserialize a buffer into a dict without copying
+ *                          the values out of it
  *
- * @buf:  buf containing serialized dict
- * @size: size of the @buf
- * @fill: dict to fill in
+ * @buf:   buf containing serialized dict
+ * @size:  size of the @buf
+ * @iobuf: iobuf holding @buf, or NULL to copy the values
+ * @fill:  dict to fill in
+ *
+ * Values too big to be kept inline in their data_t point into @buf and hold
+ * a ref on @iobuf, so they stay valid after the caller drops its own ref
+ * and after the dict is gone. Such values are shared with the buffer and
+ * must not be written to; use data_copy () to get a private one. A dict
+ * kept for long should be copied with dict_copy_private (), or any of its
+ * values keeps the whole of @iobuf.
  *
  * @return: success: 0
  *          failure: -errno
  */
 
 int32_t
-dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
+dict_unserialize_iobuf (char *orig_buf, int32_t size, struct iobuf *iobuf,
+                        dict_t **fill)
 {
         char   *buf = NULL;
         int     ret   = -1;
@@ -2685,11 +2840,26 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                                           "available (%lu) < required (%lu)",
                                           (long)(orig_buf + size),
                                           (long)(buf + vallen));
+                        goto out;
                 }
                 value = get_new_data ();
+                if (!value) {
+                        ret = -1;
+                        goto out;
+                }
                 value->len  = vallen;
-                value->data = memdup (buf, vallen);
-                value->is_static = 0;
+                if (vallen <= DATA_INLINE_SIZE) {
+                        memcpy (value->inline_data, buf, vallen);
+                        value->data = value->inline_data;
+                        value->is_static = 1;
+                } else if (iobuf) {
+                        value->data = buf;
+                        value->is_static = 1;
+                        value->iobuf = iobuf_ref (iobuf);
+                } else {
+                        value->data = memdup (buf, vallen);
+                        value->is_static = 0;
+                }
                 buf += vallen;
 
                 dict_set (*fill, key, value);
@@ -2701,6 +2871,24 @@ out:
 }
 
 
+/**
+ * dict_unserialize - unserialize a buffer into a dict
+ *
+ * @buf:  buf containing serialized dict
+ * @size: size of the @buf
+ * @fill: dict to fill in
+ *
+ * @return: success: 0
+ *          failure: -errno
+ */
+
+int32_t
+dict_unserialize (char *buf, int32_t size, dict_t **fill)
+{
+        return dict_unserialize_iobuf (buf, size, NULL, fill);
+}
+
+
 /**
  * dict_allocate_and_serialize - serialize a dictionary into an allocated buffer
  *
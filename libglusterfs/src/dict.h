@@ -35,6 +35,8 @@ typedef struct _data data_t;
 typedef struct _dict dict_t;
 typedef struct _data_pair data_pair_t;
 
+struct iobuf;
+
 
 #define GF_PROTOCOL_DICT_SERIALIZE(this,from_dict,to,len,ope,labl) do { \
                 int    ret     = 0;                                     \
@@ -80,6 +82,29 @@ typedef struct _data_pair data_pair_t;
                 to->extra_free = buf;                                   \
         } while (0)
 
+/* @buff lies in @iob, the values of @to keep referring to it (and hold a
+   ref on @iob) instead of being copied out */
+#define GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF(xl,to,buff,len,iob,ret,ope,labl) \
+        do {                                                            \
+                if (!len)                                               \
+                        break;                                          \
+                to = dict_new();                                        \
+                GF_VALIDATE_OR_GOTO (xl->name, to, labl);               \
+                                                                        \
+                ret = dict_unserialize_iobuf (buff, len, iob, &to);     \
+                if (ret < 0) {                                          \
+                        gf_log (xl->name, GF_LOG_WARNING,               \
+                                "failed to unserialize dictionary (%s)", \
+                                (#to));                                 \
+                                                                        \
+                        ope = EINVAL;                                   \
+                        goto labl;                                      \
+                }                                                       \
+        } while (0)
+
+/* values up to this size (a decimal int64 fits) are kept in the data_t */
+#define DATA_INLINE_SIZE   24
+
 struct _data {
         unsigned char  is_static:1;
         unsigned char  is_const:1;
@@ -89,26 +114,40 @@ struct _data {
         char          *data;
         int32_t        refcount;
         gf_lock_t      lock;
+        char           inline_data[DATA_INLINE_SIZE];
+        struct iobuf  *iobuf;           /* @data points into it, see
+                                           dict_unserialize_iobuf () */
 };
 
 struct _data_pair {
-        struct _data_pair *hash_next;
+        uint32_t           key_hash;
         struct _data_pair *prev;
         struct _data_pair *next;
         data_t            *value;
         char              *key;
 };
 
+/* slots of the index and bytes of the arena which come with every dict,
+   enough for the pairs and keys of a typical xdata or xattr dict */
+#define DICT_INDEX_INLINE  16
+#define DICT_ARENA_SIZE    512
+
 struct _dict {
         unsigned char   is_static:1;
-        int32_t         hash_size;
+        int32_t         hash_size;      /* slots in members, power of 2 */
         int32_t         count;
         int32_t         refcount;
-        data_pair_t   **members;
+        data_pair_t   **members;        /* open addressed index of pairs */
         data_pair_t    *members_list;
         char           *extra_free;
         char           *extra_stdfree;
         gf_lock_t       lock;
+        int32_t         index_used;     /* live and deleted slots */
+        int32_t         arena_used;
+        data_pair_t    *members_inline[DICT_INDEX_INLINE];
+        char            arena[DICT_ARENA_SIZE];
+                                        /* pairs and keys, freed with the
+                                           dict */
 };
 
 
@@ -123,6 +162,8 @@ int dict_reset (dict_t *dict);
 int32_t dict_serialized_length (dict_t *dict);
 int32_t dict_serialize (dict_t *dict, char *buf);
 int32_t dict_unserialize (char *buf, int32_t size, dict_t **fill);
+int32_t dict_unserialize_iobuf (char *buf, int32_t size, struct iobuf *iobuf,
+                                dict_t **fill);
 
 int32_t dict_allocate_and_serialize (dict_t *this, char **buf, size_t *length);
 
@@ -192,6 +233,7 @@ dict_t *dict_copy (dict_t *this, dict_t *new);
 /* CLEANED UP FUNCTIONS DECLARATIONS */
 GF_MUST_CHECK dict_t *dict_new (void);
 dict_t *dict_copy_with_ref (dict_t *this, dict_t *new);
+dict_t *dict_copy_private (dict_t *this, dict_t *new);
 
 GF_MUST_CHECK int dict_reset (dict_t *dict);
 
@@ -29,6 +29,7 @@
 #include "event.h"
 #include "mem-pool.h"
 #include "common-utils.h"
+#include "statedump.h"
 
 #ifndef _CONFIG_H
 #define _CONFIG_H
@@ -111,6 +112,8 @@ event_pool_new_poll (int count)
                 return NULL;
         }
 
+        event_pool->eventthreadcount = 1;
+
         pthread_mutex_init (&event_pool->mutex, NULL);
 
         ret = pipe (event_pool->breaker);
@@ -198,6 +201,7 @@ event_register_poll (struct event_pool *event_pool, int fd,
                 event_pool->reg[idx].events = POLLPRI;
                 event_pool->reg[idx].handler = handler;
                 event_pool->reg[idx].data = data;
+                event_pool->reg[idx].busy = 0;
 
                 switch (poll_in) {
                 case 1:
@@ -358,6 +362,7 @@ event_dispatch_poll_handler (struct event_pool *event_pool,
 
                 handler = event_pool->reg[idx].handler;
                 data = event_pool->reg[idx].data;
+                event_pool->dispatched[0]++;
         }
 unlock:
         pthread_mutex_unlock (&event_pool->mutex);
@@ -425,6 +430,13 @@ event_dispatch_poll (struct event_pool *event_pool)
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                event_pool->pollers[0] = pthread_self ();
+                event_pool->activethreadcount = 1;
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+
         while (1) {
                 size = event_dispatch_poll_resize (event_pool, ufds, size);
                 ufds = event_pool->evcache;
@@ -503,6 +515,7 @@ event_pool_new_epoll (int count)
         event_pool->fd = epfd;
 
         event_pool->count = count;
+        event_pool->eventthreadcount = 1;
 
         pthread_mutex_init (&event_pool->mutex, NULL);
         pthread_cond_init (&event_pool->cond, NULL);
@@ -512,6 +525,23 @@ out:
 }
 
 
+/* events to hand to epoll_ctl for a registration. With more than one
+   dispatcher thread every registration is one-shot, so that a socket is
+   handled by at most one thread at a time and is re-armed only after its
+   handler returns (see event_rearm_epoll).
+*/
+static uint32_t
+__event_epoll_events (struct event_pool *event_pool, int idx)
+{
+        uint32_t events = event_pool->reg[idx].events;
+
+        if (event_pool->eventthreadcount > 1)
+                events |= EPOLLONESHOT;
+
+        return events;
+}
+
+
 int
 event_register_epoll (struct event_pool *event_pool, int fd,
                       event_handler_t handler,
@@ -548,6 +578,7 @@ event_register_epoll (struct event_pool *event_pool, int fd,
                 event_pool->reg[idx].events = EPOLLPRI;
                 event_pool->reg[idx].handler = handler;
                 event_pool->reg[idx].data = data;
+                event_pool->reg[idx].busy = 0;
 
                 switch (poll_in) {
                 case 1:
@@ -583,7 +614,7 @@ event_register_epoll (struct event_pool *event_pool, int fd,
 
                 event_pool->changed = 1;
 
-                epoll_event.events = event_pool->reg[idx].events;
+                epoll_event.events = __event_epoll_events (event_pool, idx);
                 ev_data->fd = fd;
                 ev_data->idx = idx;
 
@@ -654,18 +685,24 @@ event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
                         goto unlock;
                 }
 
-                epoll_event.events = event_pool->reg[lastidx].events;
-                ev_data->fd = event_pool->reg[lastidx].fd;
-                ev_data->idx = idx;
-
-                ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, ev_data->fd,
-                                 &epoll_event);
-                if (ret == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "fail to modify fd(=%d) index %d to %d (%s)",
-                                ev_data->fd, event_pool->used, idx,
-                                strerror (errno));
-                        goto unlock;
+                /* a registration whose handler is running stays disarmed,
+                   its new index is picked up when it is re-armed */
+                if (!event_pool->reg[lastidx].busy) {
+                        epoll_event.events = __event_epoll_events (event_pool,
+                                                                   lastidx);
+                        ev_data->fd = event_pool->reg[lastidx].fd;
+                        ev_data->idx = idx;
+
+                        ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD,
+                                         ev_data->fd, &epoll_event);
+                        if (ret == -1) {
+                                gf_log ("epoll", GF_LOG_ERROR,
+                                        "fail to modify fd(=%d) index %d to "
+                                        "%d (%s)", ev_data->fd,
+                                        event_pool->used, idx,
+                                        strerror (errno));
+                                goto unlock;
+                        }
                 }
 
                 /* just replace the unregistered idx by last one */
@@ -737,7 +774,14 @@ event_select_on_epoll (struct event_pool *event_pool, int fd, int idx_hint,
                         break;
                 }
 
-                epoll_event.events = event_pool->reg[idx].events;
+                if (event_pool->reg[idx].busy) {
+                        /* handler in progress, new events take effect
+                           when the dispatcher re-arms the fd */
+                        ret = 0;
+                        goto unlock;
+                }
+
+                epoll_event.events = __event_epoll_events (event_pool, idx);
                 ev_data->fd = fd;
                 ev_data->idx = idx;
 
@@ -757,9 +801,45 @@ out:
 }
 
 
+static void
+event_rearm_epoll (struct event_pool *event_pool, int fd, int idx_hint)
+{
+        int                 idx = -1;
+        int                 ret = -1;
+        struct epoll_event  epoll_event = {0, };
+        struct event_data  *ev_data = (void *)&epoll_event.data;
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                idx = __event_getindex (event_pool, fd, idx_hint);
+
+                /* unregistered (and possibly re-registered) while the
+                   handler was running, nothing of ours left to re-arm */
+                if (idx == -1 || !event_pool->reg[idx].busy)
+                        goto unlock;
+
+                event_pool->reg[idx].busy = 0;
+
+                epoll_event.events = __event_epoll_events (event_pool, idx);
+                ev_data->fd = fd;
+                ev_data->idx = idx;
+
+                ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, fd,
+                                 &epoll_event);
+                if (ret == -1) {
+                        gf_log ("epoll", GF_LOG_ERROR,
+                                "failed to re-arm fd(=%d) with events %d (%s)",
+                                fd, epoll_event.events, strerror (errno));
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&event_pool->mutex);
+}
+
+
 static int
 event_dispatch_epoll_handler (struct event_pool *event_pool,
-                              struct epoll_event *events, int i)
+                              struct epoll_event *events, int i, int tidx)
 {
         struct event_data  *event_data = NULL;
         event_handler_t     handler = NULL;
@@ -784,8 +864,18 @@ event_dispatch_epoll_handler (struct event_pool *event_pool,
                         goto unlock;
                 }
 
+                if (event_pool->eventthreadcount > 1) {
+                        /* re-armed by select_on before the owning thread
+                           got here; the owner re-arms once it is done */
+                        if (event_pool->reg[idx].busy)
+                                goto unlock;
+
+                        event_pool->reg[idx].busy = 1;
+                }
+
                 handler = event_pool->reg[idx].handler;
                 data = event_pool->reg[idx].data;
+                event_pool->dispatched[tidx]++;
         }
 unlock:
         pthread_mutex_unlock (&event_pool->mutex);
@@ -795,10 +885,78 @@ unlock:
                                (events[i].events & (EPOLLIN|EPOLLPRI)),
                                (events[i].events & (EPOLLOUT)),
                                (events[i].events & (EPOLLERR|EPOLLHUP)));
+
+        if (handler && event_pool->eventthreadcount > 1)
+                event_rearm_epoll (event_pool, event_data->fd,
+                                   event_data->idx);
         return ret;
 }
 
 
+static void *
+event_dispatch_epoll_worker (void *data)
+{
+        struct event_pool  *event_pool = data;
+        struct epoll_event  event = {0, };
+        int                 tidx = 0;
+        int                 ret = -1;
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                tidx = event_pool->activethreadcount++;
+                event_pool->pollers[tidx] = pthread_self ();
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+
+        gf_log ("epoll", GF_LOG_DEBUG, "started event dispatcher thread %d",
+                tidx);
+
+        while (1) {
+                ret = epoll_wait (event_pool->fd, &event, 1, -1);
+
+                if (ret == 0)
+                        /* timeout */
+                        continue;
+
+                if (ret == -1)
+                        /* EINTR or transient failure */
+                        continue;
+
+                if (!event.events)
+                        continue;
+
+                event_dispatch_epoll_handler (event_pool, &event, 0, tidx);
+        }
+
+        return NULL;
+}
+
+
+static int
+event_dispatch_epoll_multi (struct event_pool *event_pool)
+{
+        pthread_t  thread;
+        int        i = 0;
+        int        ret = -1;
+
+        for (i = 1; i < event_pool->eventthreadcount; i++) {
+                ret = pthread_create (&thread, NULL,
+                                      event_dispatch_epoll_worker, event_pool);
+                if (ret != 0) {
+                        gf_log ("epoll", GF_LOG_WARNING,
+                                "failed to start event dispatcher thread "
+                                "%d (%s)", i, strerror (ret));
+                        break;
+                }
+                pthread_detach (thread);
+        }
+
+        event_dispatch_epoll_worker (event_pool);
+
+        return 0;
+}
+
+
 static int
 event_dispatch_epoll (struct event_pool *event_pool)
 {
@@ -809,6 +967,16 @@ event_dispatch_epoll (struct event_pool *event_pool)
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
+        if (event_pool->eventthreadcount > 1)
+                return event_dispatch_epoll_multi (event_pool);
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                event_pool->pollers[0] = pthread_self ();
+                event_pool->activethreadcount = 1;
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+
         while (1) {
                 pthread_mutex_lock (&event_pool->mutex);
                 {
@@ -854,7 +1022,7 @@ event_dispatch_epoll (struct event_pool *event_pool)
                                 continue;
 
                         ret = event_dispatch_epoll_handler (event_pool,
-                                                            events, i);
+                                                            events, i, 0);
                 }
         }
 
@@ -958,3 +1126,80 @@ event_dispatch (struct event_pool *event_pool)
 out:
         return ret;
 }
+
+
+int
+event_pool_set_threads (struct event_pool *event_pool, int count)
+{
+        int ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        if (count < 1 || count > EVENT_MAX_THREADS) {
+                gf_log ("event", GF_LOG_ERROR,
+                        "invalid event thread count %d (valid range 1-%d)",
+                        count, EVENT_MAX_THREADS);
+                goto out;
+        }
+
+        if (count > 1 && event_pool->ops == &event_ops_poll) {
+                gf_log ("event", GF_LOG_WARNING,
+                        "multiple event threads need epoll, using one "
+                        "dispatcher thread");
+                count = 1;
+        }
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                /* existing registrations were added without EPOLLONESHOT */
+                if (event_pool->used || event_pool->activethreadcount) {
+                        gf_log ("event", GF_LOG_ERROR,
+                                "cannot change event thread count once "
+                                "dispatching has started");
+                        goto unlock;
+                }
+
+                event_pool->eventthreadcount = count;
+                ret = 0;
+        }
+unlock:
+        pthread_mutex_unlock (&event_pool->mutex);
+
+out:
+        return ret;
+}
+
+
+void
+event_pool_dump (struct event_pool *event_pool)
+{
+        char key[GF_DUMP_MAX_BUF_LEN];
+        int  i = 0;
+        int  ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        ret = pthread_mutex_trylock (&event_pool->mutex);
+        if (ret)
+                goto out;
+
+        gf_proc_dump_add_section ("event_pool");
+        gf_proc_dump_write ("event_pool.type", "%s",
+                            (event_pool->ops == &event_ops_poll) ?
+                            "poll" : "epoll");
+        gf_proc_dump_write ("event_pool.registered", "%d", event_pool->used);
+        gf_proc_dump_write ("event_pool.threads", "%d",
+                            event_pool->eventthreadcount);
+        gf_proc_dump_write ("event_pool.active_threads", "%d",
+                            event_pool->activethreadcount);
+
+        for (i = 0; i < event_pool->activethreadcount; i++) {
+                snprintf (key, sizeof (key), "event_pool.thread.%d.dispatched",
+                          i);
+                gf_proc_dump_write (key, "%"PRIu64, event_pool->dispatched[i]);
+        }
+
+        pthread_mutex_unlock (&event_pool->mutex);
+out:
+        return;
+}
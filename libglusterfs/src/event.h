@@ -26,6 +26,9 @@
 #endif
 
 #include <pthread.h>
+#include <stdint.h>
+
+#define EVENT_MAX_THREADS  32
 
 struct event_pool;
 struct event_ops;
@@ -50,6 +53,7 @@ struct event_pool {
     int events;
     void *data;
     event_handler_t handler;
+    int busy;      /* a dispatcher is running the handler, fd is disarmed */
   } *reg;
 
   int used;
@@ -61,6 +65,11 @@ struct event_pool {
 
   void *evcache;
   int evcache_size;
+
+  int eventthreadcount;  /* dispatcher threads, > 1 uses one-shot events */
+  int activethreadcount;
+  pthread_t pollers[EVENT_MAX_THREADS];
+  uint64_t dispatched[EVENT_MAX_THREADS];
 };
 
 struct event_ops {
@@ -86,5 +95,7 @@ int event_register (struct event_pool *event_pool, int fd,
 		    void *data, int poll_in, int poll_out);
 int event_unregister (struct event_pool *event_pool, int fd, int idx);
 int event_dispatch (struct event_pool *event_pool);
+int event_pool_set_threads (struct event_pool *event_pool, int count);
+void event_pool_dump (struct event_pool *event_pool);
 
 #endif /* _EVENT_H_ */
@@ -84,6 +84,7 @@ gf_op_list_init()
         gf_fop_list[GF_FOP_FORGET]      = "FORGET";
         gf_fop_list[GF_FOP_RELEASE]     = "RELEASE";
         gf_fop_list[GF_FOP_RELEASEDIR]  = "RELEASEDIR";
+        gf_fop_list[GF_FOP_COMPOUND]    = "COMPOUND";
 
         gf_fop_list[GF_MGMT_NULL]  = "NULL";
         return;
@@ -397,6 +398,9 @@ char eventstring[GF_EVENT_MAXVAL+1][64] = {
         "Translator Info",
         "Xlator Op",
         "Authentication Failed",
+        "Volume Defrag",
+        "Parent Down",
+        "Upcall",
         "Invalid event",
 };
 
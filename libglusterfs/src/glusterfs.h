@@ -82,6 +82,8 @@
 #define GF_XATTR_CLRLK_CMD      "glusterfs.clrlk"
 #define GF_XATTR_PATHINFO_KEY   "trusted.glusterfs.pathinfo"
 #define GF_XATTR_NODE_UUID_KEY  "trusted.glusterfs.node-uuid"
+/* strong checksum an fd's rchecksum uses, set with fsetxattr, not stored */
+#define GF_XATTR_RCHECKSUM_KEY  "glusterfs.rchecksum-algorithm"
 
 #define XATTR_IS_PATHINFO(x)  (strncmp (x, GF_XATTR_PATHINFO_KEY,       \
                                         strlen (GF_XATTR_PATHINFO_KEY)) == 0)
@@ -181,6 +183,7 @@ typedef enum {
         GF_FOP_RELEASEDIR,
         GF_FOP_GETSPEC,
         GF_FOP_FREMOVEXATTR,
+        GF_FOP_COMPOUND,
         GF_FOP_MAXVALUE,
 } glusterfs_fop_t;
 
@@ -262,6 +265,9 @@ typedef enum {
 /* key value which quick read uses to get small files in lookup cbk */
 #define GF_CONTENT_KEY "glusterfs.content"
 
+/* key value which symlink-cache uses to get symlink targets in lookup cbk */
+#define GF_READLINK_KEY "glusterfs.readlink"
+
 struct _xlator_cmdline_option {
 	struct list_head    cmd_args;
 	char               *volume;
@@ -296,6 +302,7 @@ struct _cmd_args {
         int              acl;
         int              worm;
         int              mac_compat;
+        int              event_threads;
 	struct list_head xlator_options;  /* list of xlator_option_t */
 
 	/* fuse options */
@@ -307,6 +314,8 @@ struct _cmd_args {
 	int              fuse_nodev;
 	int              fuse_nosuid;
 	char            *dump_fuse;
+        uint32_t         fuse_reader_thread_count;
+        int              fuse_use_splice;
         pid_t            client_pid;
         int              client_pid_set;
         unsigned         uid_map_root;
@@ -403,6 +412,7 @@ typedef enum {
         GF_EVENT_AUTH_FAILED,
         GF_EVENT_VOLUME_DEFRAG,
         GF_EVENT_PARENT_DOWN,
+        GF_EVENT_UPCALL,
         GF_EVENT_MAXVAL,
 } glusterfs_event_t;
 
@@ -79,11 +79,39 @@ hash_dentry (inode_t *parent, const char *name, int mod)
 static int
 hash_gfid (uuid_t uuid, int mod)
 {
-        int ret = 0;
+        uint32_t ret = 0;
 
-        ret = uuid[15] + (uuid[14] << 8);
+        ret = uuid[15] + (uuid[14] << 8) + (uuid[13] << 16) + (uuid[12] << 24);
 
-        return ret;
+        return ret % mod;
+}
+
+
+static void
+inode_table_lock (inode_table_t *table)
+{
+        if (pthread_mutex_trylock (&table->lock)) {
+                pthread_mutex_lock (&table->lock);
+                table->lock_contended++;
+        }
+        table->lock_acquired++;
+}
+
+
+static struct _inode_stripe *
+inode_table_stripe_lock (inode_table_t *table, int hash)
+{
+        struct _inode_stripe *stripe = NULL;
+
+        stripe = &table->stripes[hash % INODE_TABLE_STRIPES];
+
+        if (pthread_mutex_trylock (&stripe->lock)) {
+                pthread_mutex_lock (&stripe->lock);
+                stripe->contended++;
+        }
+        stripe->acquired++;
+
+        return stripe;
 }
 
 
@@ -258,8 +286,9 @@ __is_inode_hashed (inode_t *inode)
 static void
 __inode_hash (inode_t *inode)
 {
-        inode_table_t *table = NULL;
-        int            hash = 0;
+        inode_table_t        *table = NULL;
+        struct _inode_stripe *stripe = NULL;
+        int                   hash = 0;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
@@ -267,10 +296,14 @@ __inode_hash (inode_t *inode)
         }
 
         table = inode->table;
-        hash = hash_gfid (inode->gfid, 65536);
+        hash = hash_gfid (inode->gfid, table->inode_hashsize);
 
-        list_del_init (&inode->hash);
-        list_add (&inode->hash, &table->inode_hash[hash]);
+        stripe = inode_table_stripe_lock (table, hash);
+        {
+                list_del_init (&inode->hash);
+                list_add (&inode->hash, &table->inode_hash[hash]);
+        }
+        pthread_mutex_unlock (&stripe->lock);
 }
 
 
@@ -342,11 +375,13 @@ noctx:
 static void
 __inode_activate (inode_t *inode)
 {
-        if (!inode)
+        if (!inode || !inode->in_lru)
                 return;
 
         list_move (&inode->list, &inode->table->active);
+        inode->table->lru_size--;
         inode->table->active_size++;
+        inode->in_lru = _gf_false;
 }
 
 
@@ -361,8 +396,13 @@ __inode_passivate (inode_t *inode)
                 return;
         }
 
+        /* an inode referenced without the table lock is still on lru */
+        if (!inode->in_lru) {
+                inode->table->active_size--;
+                inode->table->lru_size++;
+                inode->in_lru = _gf_true;
+        }
         list_move_tail (&inode->list, &inode->table->lru);
-        inode->table->lru_size++;
 
         list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
                 if (!__is_dentry_hashed (dentry))
@@ -371,44 +411,78 @@ __inode_passivate (inode_t *inode)
 }
 
 
-static void
+/* returns -1 if the inode was found and referenced through the gfid hash
+   meanwhile, in which case it is left alone */
+static int
 __inode_retire (inode_t *inode)
 {
-        dentry_t      *dentry = NULL;
-        dentry_t      *t = NULL;
+        inode_table_t        *table = NULL;
+        struct _inode_stripe *stripe = NULL;
+        dentry_t             *dentry = NULL;
+        dentry_t             *t = NULL;
+        uint32_t              ref = 0;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
-                return;
+                return -1;
+        }
+
+        table = inode->table;
+
+        stripe = inode_table_stripe_lock (table, hash_gfid (inode->gfid,
+                                                            table->inode_hashsize));
+        {
+                LOCK (&inode->lock);
+                {
+                        ref = inode->ref;
+                }
+                UNLOCK (&inode->lock);
+
+                if (!ref)
+                        __inode_unhash (inode);
         }
+        pthread_mutex_unlock (&stripe->lock);
 
-        list_move_tail (&inode->list, &inode->table->purge);
-        inode->table->purge_size++;
+        if (ref)
+                return -1;
+
+        if (inode->in_lru)
+                table->lru_size--;
+        else
+                table->active_size--;
+        inode->in_lru = _gf_false;
 
-        __inode_unhash (inode);
+        list_move_tail (&inode->list, &table->purge);
+        table->purge_size++;
 
         list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
                 __dentry_unset (dentry);
         }
+
+        return 0;
 }
 
 
 static inode_t *
 __inode_unref (inode_t *inode)
 {
+        uint32_t ref = 0;
+
         if (!inode)
                 return NULL;
 
         if (__is_root_gfid(inode->gfid))
                 return inode;
 
-        GF_ASSERT (inode->ref);
-
-        --inode->ref;
+        LOCK (&inode->lock);
+        {
+                GF_ASSERT (inode->ref);
 
-        if (!inode->ref) {
-                inode->table->active_size--;
+                ref = --inode->ref;
+        }
+        UNLOCK (&inode->lock);
 
+        if (!ref) {
                 if (inode->nlookup)
                         __inode_passivate (inode);
                 else
@@ -419,17 +493,30 @@ __inode_unref (inode_t *inode)
 }
 
 
+/* take a reference without the table lock. An inode picked up from the
+   lru list stays there until the next reference under the table lock or
+   inode_table_prune () moves it to the active list */
+static inode_t *
+__inode_ref_deferred (inode_t *inode)
+{
+        LOCK (&inode->lock);
+        {
+                inode->ref++;
+        }
+        UNLOCK (&inode->lock);
+
+        return inode;
+}
+
+
 static inode_t *
 __inode_ref (inode_t *inode)
 {
         if (!inode)
                 return NULL;
 
-        if (!inode->ref) {
-                inode->table->lru_size--;
-                __inode_activate (inode);
-        }
-        inode->ref++;
+        __inode_ref_deferred (inode);
+        __inode_activate (inode);
 
         return inode;
 }
@@ -439,13 +526,27 @@ inode_t *
 inode_unref (inode_t *inode)
 {
         inode_table_t *table = NULL;
+        gf_boolean_t   last = _gf_true;
 
         if (!inode)
                 return NULL;
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        /* only the last reference moves the inode between lists */
+        LOCK (&inode->lock);
+        {
+                if (inode->ref > 1) {
+                        inode->ref--;
+                        last = _gf_false;
+                }
+        }
+        UNLOCK (&inode->lock);
+
+        if (!last)
+                return inode;
+
+        inode_table_lock (table);
         {
                 inode = __inode_unref (inode);
         }
@@ -460,20 +561,10 @@ inode_unref (inode_t *inode)
 inode_t *
 inode_ref (inode_t *inode)
 {
-        inode_table_t *table = NULL;
-
         if (!inode)
                 return NULL;
 
-        table = inode->table;
-
-        pthread_mutex_lock (&table->lock);
-        {
-                inode = __inode_ref (inode);
-        }
-        pthread_mutex_unlock (&table->lock);
-
-        return inode;
+        return __inode_ref_deferred (inode);
 }
 
 
@@ -551,6 +642,7 @@ __inode_create (inode_table_t *table)
 
         list_add (&newi->list, &table->lru);
         table->lru_size++;
+        newi->in_lru = _gf_true;
 
 out:
 
@@ -568,7 +660,7 @@ inode_new (inode_table_t *table)
                 return NULL;
         }
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 inode = __inode_create (table);
                 if (inode != NULL) {
@@ -645,7 +737,7 @@ inode_grep (inode_table_t *table, inode_t *parent, const char *name)
                 return NULL;
         }
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 dentry = __dentry_grep (table, parent, name);
 
@@ -674,7 +766,7 @@ inode_grep_for_gfid (inode_table_t *table, inode_t *parent, const char *name,
                 return ret;
         }
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 dentry = __dentry_grep (table, parent, name);
 
@@ -724,7 +816,7 @@ __inode_find (inode_table_t *table, uuid_t gfid)
         if (__is_root_gfid (gfid))
                 return table->root;
 
-        hash = hash_gfid (gfid, 65536);
+        hash = hash_gfid (gfid, table->inode_hashsize);
 
         list_for_each_entry (tmp, &table->inode_hash[hash], hash) {
                 if (uuid_compare (tmp->gfid, gfid) == 0) {
@@ -741,20 +833,28 @@ out:
 inode_t *
 inode_find (inode_table_t *table, uuid_t gfid)
 {
-        inode_t   *inode = NULL;
+        inode_t              *inode = NULL;
+        struct _inode_stripe *stripe = NULL;
 
         if (!table) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "table not found");
                 return NULL;
         }
 
-        pthread_mutex_lock (&table->lock);
+        if (__is_root_gfid (gfid))
+                return inode_ref (table->root);
+
+        /* only the stripe lock, the table lock is not needed for a lookup
+           in the gfid hash */
+        stripe = inode_table_stripe_lock (table,
+                                          hash_gfid (gfid,
+                                                     table->inode_hashsize));
         {
                 inode = __inode_find (table, gfid);
                 if (inode)
-                        __inode_ref (inode);
+                        __inode_ref_deferred (inode);
         }
-        pthread_mutex_unlock (&table->lock);
+        pthread_mutex_unlock (&stripe->lock);
 
         return inode;
 }
@@ -850,7 +950,7 @@ inode_link (inode_t *inode, inode_t *parent, const char *name,
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 linked_inode = __inode_link (inode, parent, name, iatt);
 
@@ -877,7 +977,7 @@ inode_lookup (inode_t *inode)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 __inode_lookup (inode);
         }
@@ -899,7 +999,7 @@ inode_forget (inode_t *inode, uint64_t nlookup)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 __inode_forget (inode, nlookup);
         }
@@ -939,7 +1039,7 @@ inode_unlink (inode_t *inode, inode_t *parent, const char *name)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 __inode_unlink (inode, parent, name);
         }
@@ -961,7 +1061,7 @@ inode_rename (inode_table_t *table, inode_t *srcdir, const char *srcname,
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 __inode_link (inode, dstdir, dstname, iatt);
                 __inode_unlink (inode, srcdir, srcname);
@@ -1015,7 +1115,7 @@ inode_parent (inode_t *inode, uuid_t pargfid, const char *name)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 if (pargfid && !uuid_is_null (pargfid) && name) {
                         dentry = __dentry_search_for_inode (inode, pargfid, name);
@@ -1145,7 +1245,7 @@ inode_path (inode_t *inode, const char *name, char **bufp)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 ret = __inode_path (inode, name, bufp);
         }
@@ -1169,15 +1269,19 @@ inode_table_prune (inode_table_t *table)
 
         INIT_LIST_HEAD (&purge);
 
-        pthread_mutex_lock (&table->lock);
+        inode_table_lock (table);
         {
                 while (table->lru_limit
                        && table->lru_size > (table->lru_limit)) {
 
                         entry = list_entry (table->lru.next, inode_t, list);
 
-                        table->lru_size--;
-                        __inode_retire (entry);
+                        if (__inode_retire (entry)) {
+                                /* referenced without the table lock */
+                                __inode_activate (entry);
+                                table->deferred_promotions++;
+                                continue;
+                        }
 
                         ret++;
                 }
@@ -1250,7 +1354,13 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
         if (!new->dentry_pool)
                 goto out;
 
-        new->inode_hash = (void *)GF_CALLOC (65536,
+        /* about one gfid bucket per inode kept in the table */
+        new->inode_hashsize = INODE_HASH_MIN_SIZE;
+        while (new->inode_hashsize < lru_limit &&
+               new->inode_hashsize < INODE_HASH_MAX_SIZE)
+                new->inode_hashsize <<= 1;
+
+        new->inode_hash = (void *)GF_CALLOC (new->inode_hashsize,
                                              sizeof (struct list_head),
                                              gf_common_mt_list_head);
         if (!new->inode_hash)
@@ -1269,7 +1379,7 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
         if (!new->fd_mem_pool)
                 goto out;
 
-        for (i = 0; i < 65536; i++) {
+        for (i = 0; i < new->inode_hashsize; i++) {
                 INIT_LIST_HEAD (&new->inode_hash[i]);
         }
 
@@ -1288,9 +1398,11 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
                 ;
         }
 
-        __inode_table_init_root (new);
-
         pthread_mutex_init (&new->lock, NULL);
+        for (i = 0; i < INODE_TABLE_STRIPES; i++)
+                pthread_mutex_init (&new->stripes[i].lock, NULL);
+
+        __inode_table_init_root (new);
 
         ret = 0;
 out:
@@ -1614,8 +1726,12 @@ void
 inode_table_dump (inode_table_t *itable, char *prefix)
 {
 
-        char    key[GF_DUMP_MAX_BUF_LEN];
-        int     ret = 0;
+        char     key[GF_DUMP_MAX_BUF_LEN];
+        int      ret = 0;
+        int      i = 0;
+        uint64_t stripe_acquired = 0;
+        uint64_t stripe_contended = 0;
+        uint64_t stripe_max = 0;
 
         if (!itable)
                 return;
@@ -1641,6 +1757,31 @@ inode_table_dump (inode_table_t *itable, char *prefix)
         gf_proc_dump_build_key(key, prefix, "purge_size");
         gf_proc_dump_write(key, "%d", itable->purge_size);
 
+        gf_proc_dump_build_key(key, prefix, "inode_hashsize");
+        gf_proc_dump_write(key, "%zu", itable->inode_hashsize);
+        gf_proc_dump_build_key(key, prefix, "lock_acquired");
+        gf_proc_dump_write(key, "%"PRIu64, itable->lock_acquired);
+        gf_proc_dump_build_key(key, prefix, "lock_contended");
+        gf_proc_dump_write(key, "%"PRIu64, itable->lock_contended);
+        gf_proc_dump_build_key(key, prefix, "deferred_promotions");
+        gf_proc_dump_write(key, "%"PRIu64, itable->deferred_promotions);
+
+        /* stripe counters are read without their locks */
+        for (i = 0; i < INODE_TABLE_STRIPES; i++) {
+                stripe_acquired += itable->stripes[i].acquired;
+                stripe_contended += itable->stripes[i].contended;
+                if (itable->stripes[i].contended > stripe_max)
+                        stripe_max = itable->stripes[i].contended;
+        }
+        gf_proc_dump_build_key(key, prefix, "stripe_count");
+        gf_proc_dump_write(key, "%d", INODE_TABLE_STRIPES);
+        gf_proc_dump_build_key(key, prefix, "stripe_acquired");
+        gf_proc_dump_write(key, "%"PRIu64, stripe_acquired);
+        gf_proc_dump_build_key(key, prefix, "stripe_contended");
+        gf_proc_dump_write(key, "%"PRIu64, stripe_contended);
+        gf_proc_dump_build_key(key, prefix, "stripe_contended_max");
+        gf_proc_dump_write(key, "%"PRIu64, stripe_max);
+
         INODE_DUMP_LIST(&itable->active, key, prefix, "active");
         INODE_DUMP_LIST(&itable->lru, key, prefix, "lru");
         INODE_DUMP_LIST(&itable->purge, key, prefix, "purge");
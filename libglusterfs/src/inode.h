@@ -29,6 +29,9 @@
 #include <sys/types.h>
 
 #define DEFAULT_INODE_MEMPOOL_ENTRIES   32 * 1024
+#define INODE_HASH_MIN_SIZE             65536
+#define INODE_HASH_MAX_SIZE             (1 << 22)
+#define INODE_TABLE_STRIPES             64
 struct _inode_table;
 typedef struct _inode_table inode_table_t;
 
@@ -44,9 +47,18 @@ typedef struct _dentry dentry_t;
 #include "uuid.h"
 
 
+/* lock of a range of buckets of the gfid hash */
+struct _inode_stripe {
+        pthread_mutex_t    lock;
+        uint64_t           acquired;
+        uint64_t           contended;
+};
+
 struct _inode_table {
         pthread_mutex_t    lock;
-        size_t             hashsize;    /* bucket size of inode hash and dentry hash */
+        size_t             hashsize;    /* bucket size of dentry hash */
+        size_t             inode_hashsize; /* bucket size of inode hash,
+                                              power of two */
         char              *name;        /* name of the inode table, just for gf_log() */
         inode_t           *root;        /* root directory inode, with number 1 */
         xlator_t          *xl;          /* xlator to be called to do purge */
@@ -64,6 +76,14 @@ struct _inode_table {
         struct mem_pool   *inode_pool;  /* memory pool for inodes */
         struct mem_pool   *dentry_pool; /* memory pool for dentrys */
         struct mem_pool   *fd_mem_pool; /* memory pool for fd_t */
+
+        /* inode_hash buckets are changed with both the table lock and
+           their stripe lock held, and looked up with either of them */
+        struct _inode_stripe stripes[INODE_TABLE_STRIPES];
+        uint64_t           lock_acquired;
+        uint64_t           lock_contended;
+        uint64_t           deferred_promotions; /* referenced inodes
+                                                   moved off the lru list */
 };
 
 
@@ -95,7 +115,10 @@ struct _inode {
         uuid_t               gfid;
         gf_lock_t            lock;
         uint64_t             nlookup;
-        uint32_t             ref;           /* reference count on this inode */
+        uint32_t             ref;           /* reference count on this inode,
+                                               under ->lock */
+        gf_boolean_t         in_lru;        /* on lru list, even when
+                                               referenced since */
         ia_type_t            ia_type;       /* what kind of file */
         struct list_head     fd_list;       /* list of open files on this inode */
         struct list_head     dentry_list;   /* list of directory entries for this inode */
@@ -43,6 +43,9 @@ struct iobuf_init_config gf_iobuf_init_config[] = {
         {1 * 1024 * 1024, 2},
 };
 
+static void iobuf_cache_destroy (void *data);
+void __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena);
+
 int
 gf_iobuf_get_arena_index (size_t page_size)
 {
@@ -299,10 +302,20 @@ iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp         = NULL;
+        struct iobuf_cache *cache       = NULL;
+        struct iobuf_cache *cache_tmp   = NULL;
         int                 i           = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
+        /* the iobufs held in thread caches go away with their arenas */
+        pthread_key_delete (iobuf_pool->cache_key);
+        list_for_each_entry_safe (cache, cache_tmp, &iobuf_pool->caches,
+                                  list) {
+                list_del_init (&cache->list);
+                GF_FREE (cache);
+        }
+
         for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
                 list_for_each_entry_safe (iobuf_arena, tmp,
                                           &iobuf_pool->arenas[i], list) {
@@ -333,6 +346,16 @@ iobuf_pool_new (void)
                 goto out;
 
         pthread_mutex_init (&iobuf_pool->mutex, NULL);
+        INIT_LIST_HEAD (&iobuf_pool->caches);
+        if (pthread_key_create (&iobuf_pool->cache_key,
+                                iobuf_cache_destroy)) {
+                gf_log ("iobuf", GF_LOG_ERROR,
+                        "failed to create the iobuf cache key");
+                GF_FREE (iobuf_pool);
+                iobuf_pool = NULL;
+                goto out;
+        }
+
         for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
                 INIT_LIST_HEAD (&iobuf_pool->arenas[i]);
                 INIT_LIST_HEAD (&iobuf_pool->filled[i]);
@@ -508,11 +531,166 @@ out:
         return iobuf;
 }
 
+/* called with the pool mutex held, once the iobuf is out of all caches */
+static void
+__iobuf_cache_drain (struct iobuf_cache_class *class, int count)
+{
+        struct iobuf *iobuf = NULL;
+        int           i     = 0;
+
+        if (count > class->count)
+                count = class->count;
+
+        /* the oldest entries are at the bottom of the magazine */
+        for (i = 0; i < count; i++) {
+                iobuf = class->iobufs[i];
+                __iobuf_put (iobuf, iobuf->iobuf_arena);
+        }
+
+        memmove (class->iobufs, class->iobufs + count,
+                 (class->count - count) * sizeof (struct iobuf *));
+        class->count -= count;
+}
+
+
+/* pthread key destructor, gives the magazines of an exiting thread back */
+static void
+iobuf_cache_destroy (void *data)
+{
+        struct iobuf_cache *cache      = data;
+        struct iobuf_pool  *iobuf_pool = NULL;
+        int                 i          = 0;
+
+        if (!cache)
+                return;
+
+        iobuf_pool = cache->iobuf_pool;
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+                        __iobuf_cache_drain (&cache->classes[i],
+                                             cache->classes[i].count);
+                        iobuf_pool->cache_hits[i] += cache->classes[i].hits;
+                        iobuf_pool->cache_misses[i] +=
+                                cache->classes[i].misses;
+                }
+                list_del_init (&cache->list);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        GF_FREE (cache);
+}
+
+
+static struct iobuf_cache *
+iobuf_cache_get (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+        size_t              count = 0;
+        int                 i     = 0;
+
+        cache = pthread_getspecific (iobuf_pool->cache_key);
+        if (cache)
+                goto out;
+
+        cache = GF_CALLOC (1, sizeof (*cache), gf_common_mt_iobuf_cache);
+        if (!cache)
+                goto out;
+
+        cache->iobuf_pool = iobuf_pool;
+        INIT_LIST_HEAD (&cache->list);
+
+        /* bound the memory a thread can sit on for the large page sizes */
+        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+                count = IOBUF_CACHE_BYTES / gf_iobuf_init_config[i].pagesize;
+                if (count < 2)
+                        count = 2;
+                if (count > IOBUF_CACHE_MAX)
+                        count = IOBUF_CACHE_MAX;
+                cache->classes[i].size = count;
+        }
+
+        if (pthread_setspecific (iobuf_pool->cache_key, cache)) {
+                GF_FREE (cache);
+                cache = NULL;
+                goto out;
+        }
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                list_add_tail (&cache->list, &iobuf_pool->caches);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+out:
+        return cache;
+}
+
+
+/* take an iobuf of @rounded_size from the magazine of this thread, and
+   refill half of the magazine from the arenas under one lock on a miss */
+static struct iobuf *
+iobuf_cache_get_iobuf (struct iobuf_pool *iobuf_pool, size_t rounded_size)
+{
+        struct iobuf_cache       *cache       = NULL;
+        struct iobuf_cache_class *class       = NULL;
+        struct iobuf_arena       *iobuf_arena = NULL;
+        struct iobuf             *iobuf       = NULL;
+        int                       index       = 0;
+        int                       batch       = 1;
+        int                       i           = 0;
+
+        index = gf_iobuf_get_arena_index (rounded_size);
+        if (index == -1)
+                goto out;
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache) {
+                class = &cache->classes[index];
+                if (class->count) {
+                        class->hits++;
+                        iobuf = class->iobufs[--class->count];
+                        goto out;
+                }
+
+                class->misses++;
+                batch = (class->size + 1) / 2;
+        }
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                for (i = 0; i < batch; i++) {
+                        /* most eligible arena for picking an iobuf */
+                        iobuf_arena = __iobuf_select_arena (iobuf_pool,
+                                                            rounded_size);
+                        if (!iobuf_arena)
+                                break;
+
+                        iobuf = __iobuf_get (iobuf_arena, rounded_size);
+                        if (!iobuf)
+                                break;
+
+                        if (class)
+                                class->iobufs[class->count++] = iobuf;
+                }
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        if (class)
+                iobuf = class->count ? class->iobufs[--class->count] : NULL;
+
+out:
+        if (iobuf)
+                __iobuf_ref (iobuf);
+
+        return iobuf;
+}
+
+
 struct iobuf *
 iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
-        struct iobuf       *iobuf        = NULL;
-        struct iobuf_arena *iobuf_arena  = NULL;
         size_t              rounded_size = 0;
 
         if (page_size == 0) {
@@ -528,54 +706,20 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
                 return NULL;
         }
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                /* most eligible arena for picking an iobuf */
-                iobuf_arena = __iobuf_select_arena (iobuf_pool, rounded_size);
-                if (!iobuf_arena)
-                        goto unlock;
-
-                iobuf = __iobuf_get (iobuf_arena, rounded_size);
-                if (!iobuf)
-                        goto unlock;
-
-                __iobuf_ref (iobuf);
-         }
-unlock:
-        pthread_mutex_unlock (&iobuf_pool->mutex);
-
-        return iobuf;
+        return iobuf_cache_get_iobuf (iobuf_pool, rounded_size);
 }
 
 struct iobuf *
 iobuf_get (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf       *iobuf        = NULL;
-        struct iobuf_arena *iobuf_arena  = NULL;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                /* most eligible arena for picking an iobuf */
-                iobuf_arena = __iobuf_select_arena (iobuf_pool,
-                                                    iobuf_pool->default_page_size);
-                if (!iobuf_arena) {
-                        gf_log (THIS->name, GF_LOG_WARNING, "arena not found");
-                        goto unlock;
-                }
-
-                iobuf = __iobuf_get (iobuf_arena,
-                                     iobuf_pool->default_page_size);
-                if (!iobuf) {
-                        gf_log (THIS->name, GF_LOG_WARNING, "iobuf not found");
-                        goto unlock;
-                }
-
-                __iobuf_ref (iobuf);
-        }
-unlock:
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+        iobuf = iobuf_cache_get_iobuf (iobuf_pool,
+                                       iobuf_pool->default_page_size);
+        if (!iobuf)
+                gf_log (THIS->name, GF_LOG_WARNING, "iobuf not found");
 
 out:
         return iobuf;
@@ -624,8 +768,11 @@ out:
 void
 iobuf_put (struct iobuf *iobuf)
 {
-        struct iobuf_arena *iobuf_arena = NULL;
-        struct iobuf_pool  *iobuf_pool = NULL;
+        struct iobuf_arena       *iobuf_arena = NULL;
+        struct iobuf_pool        *iobuf_pool  = NULL;
+        struct iobuf_cache       *cache       = NULL;
+        struct iobuf_cache_class *class       = NULL;
+        int                       index       = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
@@ -641,9 +788,23 @@ iobuf_put (struct iobuf *iobuf)
                 return;
         }
 
+        index = gf_iobuf_get_arena_index (iobuf_arena->page_size);
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache && index != -1) {
+                class = &cache->classes[index];
+                if (class->count < class->size) {
+                        class->iobufs[class->count++] = iobuf;
+                        goto out;
+                }
+        }
+
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
                 __iobuf_put (iobuf, iobuf_arena);
+
+                /* magazine is full, give the older half back with it */
+                if (class)
+                        __iobuf_cache_drain (class, class->size / 2);
         }
         pthread_mutex_unlock (&iobuf_pool->mutex);
 
@@ -947,6 +1108,11 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
 {
         char               msg[1024];
         struct iobuf_arena *trav = NULL;
+        struct iobuf_cache *cache = NULL;
+        uint64_t           hits = 0;
+        uint64_t           misses = 0;
+        int                cached = 0;
+        int                cache_cnt = 0;
         int                i = 1;
         int                j = 0;
         int                ret = -1;
@@ -971,6 +1137,33 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
         gf_proc_dump_write("iobuf_pool.request_misses", "%"PRId64,
                            iobuf_pool->request_misses);
 
+        list_for_each_entry (cache, &iobuf_pool->caches, list)
+                cache_cnt++;
+        gf_proc_dump_write("iobuf_pool.cache_cnt", "%d", cache_cnt);
+
+        for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++) {
+                hits = iobuf_pool->cache_hits[j];
+                misses = iobuf_pool->cache_misses[j];
+                cached = 0;
+                /* counters of live threads are read without their owners
+                   stopping, they are only approximate */
+                list_for_each_entry (cache, &iobuf_pool->caches, list) {
+                        hits += cache->classes[j].hits;
+                        misses += cache->classes[j].misses;
+                        cached += cache->classes[j].count;
+                }
+
+                snprintf(msg, sizeof(msg), "iobuf_pool.cache.%zu.hits",
+                         gf_iobuf_init_config[j].pagesize);
+                gf_proc_dump_write(msg, "%"PRIu64, hits);
+                snprintf(msg, sizeof(msg), "iobuf_pool.cache.%zu.misses",
+                         gf_iobuf_init_config[j].pagesize);
+                gf_proc_dump_write(msg, "%"PRIu64, misses);
+                snprintf(msg, sizeof(msg), "iobuf_pool.cache.%zu.cached",
+                         gf_iobuf_init_config[j].pagesize);
+                gf_proc_dump_write(msg, "%d", cached);
+        }
+
         for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++) {
                 list_for_each_entry (trav, &iobuf_pool->arenas[j], list) {
                         snprintf(msg, sizeof(msg),
@@ -105,6 +105,27 @@ struct iobuf_arena {
 };
 
 
+/* per-thread magazine of free iobufs of one page size. Buffers in a
+   magazine are still on the active list of their arena, only the pool
+   mutex is avoided when they are handed out or given back */
+#define IOBUF_CACHE_MAX    16
+#define IOBUF_CACHE_BYTES  (1 * GF_UNIT_MB) /* per size class per thread */
+
+struct iobuf_cache_class {
+        int                 count;
+        int                 size;       /* capacity, depends on page_size */
+        struct iobuf       *iobufs[IOBUF_CACHE_MAX];
+        uint64_t            hits;
+        uint64_t            misses;
+};
+
+struct iobuf_cache {
+        struct list_head          list; /* in iobuf_pool->caches */
+        struct iobuf_pool        *iobuf_pool;
+        struct iobuf_cache_class  classes[GF_VARIABLE_IOBUF_COUNT];
+};
+
+
 struct iobuf_pool {
         pthread_mutex_t     mutex;
         size_t              arena_size; /* size of memory region in
@@ -124,6 +145,12 @@ struct iobuf_pool {
 
         uint64_t            request_misses; /* mostly the requests for higher
                                                value of iobufs */
+
+        pthread_key_t       cache_key;  /* struct iobuf_cache of a thread */
+        struct list_head    caches;     /* caches of all live threads */
+        uint64_t            cache_hits[GF_VARIABLE_IOBUF_COUNT];
+        uint64_t            cache_misses[GF_VARIABLE_IOBUF_COUNT];
+        /* hits and misses of threads which have exited */
 };
 
 
@@ -317,6 +317,206 @@ free:
 }
 
 
+/* The free chunks a thread caches are kept per pool in an array indexed by
+   mem_pool->cache_id. Ids are never reused, so the slot of a destroyed
+   pool is never looked at again before the thread exits. */
+struct mem_pool_thread_caches {
+        int                     size;
+        struct mem_pool_cache **caches;
+};
+
+static pthread_key_t   mem_pool_cache_key;
+static pthread_once_t  mem_pool_cache_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t mem_pool_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int             mem_pool_cache_ids;
+
+
+/* move the counts of @cache into the pool, pool lock held */
+static void
+__mem_pool_cache_fold (struct mem_pool *pool, struct mem_pool_cache *cache)
+{
+        struct mem_pool_cache *trav = NULL;
+        int                    hot = 0;
+
+        pool->hot_count += cache->hot_count;
+        pool->cold_count -= cache->hot_count;
+        pool->alloc_count += cache->alloc_count;
+
+        cache->hot_count = 0;
+        cache->alloc_count = 0;
+
+        /* max-alloc has to see what the other threads have not folded
+           yet, it lags by at most one batch of each thread */
+        hot = pool->hot_count;
+        list_for_each_entry (trav, &pool->caches, pool_list)
+                hot += trav->hot_count;
+
+        if (pool->max_alloc < hot)
+                pool->max_alloc = hot;
+}
+
+
+/* give back the @count oldest chunks of @cache, pool lock held */
+static void
+__mem_pool_cache_drain (struct mem_pool *pool, struct mem_pool_cache *cache,
+                        int count)
+{
+        struct list_head *list = NULL;
+
+        while (count-- && cache->count) {
+                list = cache->list.prev;
+                list_del (list);
+                list_add (list, &pool->list);
+                cache->count--;
+        }
+}
+
+
+static void
+mem_pool_cache_destroy (void *data)
+{
+        struct mem_pool_thread_caches *thread = data;
+        struct mem_pool_cache         *cache = NULL;
+        struct mem_pool               *pool = NULL;
+        int                            i = 0;
+
+        pthread_mutex_lock (&mem_pool_cache_mutex);
+        {
+                for (i = 0; i < thread->size; i++) {
+                        cache = thread->caches[i];
+                        if (!cache)
+                                continue;
+
+                        pool = cache->pool;
+                        if (pool) {
+                                LOCK (&pool->lock);
+                                {
+                                        __mem_pool_cache_fold (pool, cache);
+                                        __mem_pool_cache_drain (pool, cache,
+                                                                cache->count);
+                                        list_del (&cache->pool_list);
+                                }
+                                UNLOCK (&pool->lock);
+                        }
+
+                        FREE (cache);
+                }
+        }
+        pthread_mutex_unlock (&mem_pool_cache_mutex);
+
+        FREE (thread->caches);
+        FREE (thread);
+}
+
+
+static void
+mem_pool_cache_init (void)
+{
+        int ret = 0;
+
+        ret = pthread_key_create (&mem_pool_cache_key, mem_pool_cache_destroy);
+        if (ret)
+                gf_log ("mem-pool", GF_LOG_WARNING, "failed to create the "
+                        "mem-pool cache key, per-thread caches are disabled");
+}
+
+
+static struct mem_pool_cache *
+mem_pool_cache_get (struct mem_pool *pool)
+{
+        struct mem_pool_thread_caches *thread = NULL;
+        struct mem_pool_cache         *cache = NULL;
+        struct mem_pool_cache        **caches = NULL;
+        int                            size = 0;
+
+        if (!pool->cache_size)
+                return NULL;
+
+        thread = pthread_getspecific (mem_pool_cache_key);
+        if (thread && pool->cache_id < thread->size &&
+            thread->caches[pool->cache_id])
+                return thread->caches[pool->cache_id];
+
+        if (!thread) {
+                thread = CALLOC (1, sizeof (*thread));
+                if (!thread)
+                        return NULL;
+
+                if (pthread_setspecific (mem_pool_cache_key, thread)) {
+                        FREE (thread);
+                        return NULL;
+                }
+        }
+
+        if (pool->cache_id >= thread->size) {
+                size = pool->cache_id + 16;
+                caches = realloc (thread->caches, size * sizeof (*caches));
+                if (!caches)
+                        return NULL;
+
+                memset (caches + thread->size, 0,
+                        (size - thread->size) * sizeof (*caches));
+                thread->caches = caches;
+                thread->size = size;
+        }
+
+        cache = CALLOC (1, sizeof (*cache));
+        if (!cache)
+                return NULL;
+
+        INIT_LIST_HEAD (&cache->list);
+        cache->pool = pool;
+        cache->size = pool->cache_size;
+
+        pthread_mutex_lock (&mem_pool_cache_mutex);
+        {
+                LOCK (&pool->lock);
+                {
+                        list_add (&cache->pool_list, &pool->caches);
+                }
+                UNLOCK (&pool->lock);
+        }
+        pthread_mutex_unlock (&mem_pool_cache_mutex);
+
+        thread->caches[pool->cache_id] = cache;
+
+        return cache;
+}
+
+
+void
+mem_pool_get_counts (struct mem_pool *pool, int *hot_count, int *cold_count,
+                     uint64_t *alloc_count, int *cached_count)
+{
+        struct mem_pool_cache *cache = NULL;
+        int                    hot = 0;
+        uint64_t               alloc = 0;
+        int                    cached = 0;
+
+        /* the unfolded counts of other threads are read while they run,
+           so the sums are exact only when the pool is idle */
+        LOCK (&pool->lock);
+        {
+                hot = pool->hot_count;
+                alloc = pool->alloc_count;
+                list_for_each_entry (cache, &pool->caches, pool_list) {
+                        hot += cache->hot_count;
+                        alloc += cache->alloc_count;
+                        cached += cache->count;
+                }
+
+                if (hot_count)
+                        *hot_count = hot;
+                if (cold_count)
+                        *cold_count = pool->cold_count + pool->hot_count - hot;
+                if (alloc_count)
+                        *alloc_count = alloc;
+                if (cached_count)
+                        *cached_count = cached;
+        }
+        UNLOCK (&pool->lock);
+}
+
 
 struct mem_pool *
 mem_pool_new_fn (unsigned long sizeof_type,
@@ -352,6 +552,21 @@ mem_pool_new_fn (unsigned long sizeof_type,
         LOCK_INIT (&mem_pool->lock);
         INIT_LIST_HEAD (&mem_pool->list);
         INIT_LIST_HEAD (&mem_pool->global_list);
+        INIT_LIST_HEAD (&mem_pool->caches);
+
+        /* small pools are not worth splitting between threads */
+        pthread_once (&mem_pool_cache_once, mem_pool_cache_init);
+        mem_pool->cache_size = count / MEM_POOL_CACHE_MAX;
+        if (mem_pool->cache_size > MEM_POOL_CACHE_MAX)
+                mem_pool->cache_size = MEM_POOL_CACHE_MAX;
+        if (mem_pool->cache_size < 2)
+                mem_pool->cache_size = 0;
+
+        pthread_mutex_lock (&mem_pool_cache_mutex);
+        {
+                mem_pool->cache_id = mem_pool_cache_ids++;
+        }
+        pthread_mutex_unlock (&mem_pool_cache_mutex);
 
         mem_pool->padded_sizeof_type = padded_sizeof_type;
         mem_pool->cold_count = count;
@@ -405,20 +620,57 @@ mem_get0 (struct mem_pool *mem_pool)
 void *
 mem_get (struct mem_pool *mem_pool)
 {
-        struct list_head *list = NULL;
-        void             *ptr = NULL;
-        int             *in_use = NULL;
-        struct mem_pool **pool_ptr = NULL;
+        struct list_head      *list = NULL;
+        void                  *ptr = NULL;
+        int                   *in_use = NULL;
+        struct mem_pool      **pool_ptr = NULL;
+        struct mem_pool_cache *cache = NULL;
+        int                    i = 0;
 
         if (!mem_pool) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
                 return NULL;
         }
 
+        cache = mem_pool_cache_get (mem_pool);
+        if (cache && !cache->count) {
+                LOCK (&mem_pool->lock);
+                {
+                        __mem_pool_cache_fold (mem_pool, cache);
+
+                        for (i = 0; i < (cache->size + 1) / 2; i++) {
+                                if (list_empty (&mem_pool->list))
+                                        break;
+                                list = mem_pool->list.next;
+                                list_del (list);
+                                list_add_tail (list, &cache->list);
+                                cache->count++;
+                        }
+                }
+                UNLOCK (&mem_pool->lock);
+        }
+
+        if (cache && cache->count) {
+                list = cache->list.next;
+                list_del (list);
+                cache->count--;
+                cache->hot_count++;
+                cache->alloc_count++;
+
+                ptr = list;
+                in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY + GF_MEM_POOL_PTR);
+                *in_use = 1;
+
+                pool_ptr = mem_pool_from_ptr (ptr);
+                *pool_ptr = (struct mem_pool *)mem_pool;
+
+                return mem_pool_chunkhead2ptr (ptr);
+        }
+
         LOCK (&mem_pool->lock);
         {
                 mem_pool->alloc_count++;
-                if (mem_pool->cold_count) {
+                if (!list_empty (&mem_pool->list)) {
                         list = mem_pool->list.next;
                         list_del (list);
 
@@ -507,6 +759,7 @@ mem_put (void *ptr)
         void   *head = NULL;
         struct mem_pool **tmp = NULL;
         struct mem_pool *pool = NULL;
+        struct mem_pool_cache *cache = NULL;
 
         if (!ptr) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
@@ -527,6 +780,20 @@ mem_put (void *ptr)
                                   "mem-pool ptr is NULL");
                 return;
         }
+
+        if (__is_member (pool, ptr) == 1) {
+                in_use = (head + GF_MEM_POOL_LIST_BOUNDARY + GF_MEM_POOL_PTR);
+                cache = mem_pool_cache_get (pool);
+                if (cache && cache->count < cache->size &&
+                    is_mem_chunk_in_use (in_use)) {
+                        *in_use = 0;
+                        list_add (list, &cache->list);
+                        cache->count++;
+                        cache->hot_count--;
+                        return;
+                }
+        }
+
         LOCK (&pool->lock);
         {
 
@@ -545,6 +812,13 @@ mem_put (void *ptr)
                         pool->cold_count++;
                         *in_use = 0;
                         list_add (list, &pool->list);
+
+                        /* cache is full, give its older half back too */
+                        if (cache) {
+                                __mem_pool_cache_fold (pool, cache);
+                                __mem_pool_cache_drain (pool, cache,
+                                                        cache->size / 2);
+                        }
                         break;
                 case -1:
                         /* For some reason, the address given is within
@@ -578,14 +852,32 @@ mem_put (void *ptr)
 void
 mem_pool_destroy (struct mem_pool *pool)
 {
+        struct mem_pool_cache *cache = NULL;
+        struct mem_pool_cache *tmp = NULL;
+        uint64_t               alloc_count = 0;
+
         if (!pool)
                 return;
 
+        mem_pool_get_counts (pool, NULL, NULL, &alloc_count, NULL);
         gf_log (THIS->name, GF_LOG_INFO, "size=%lu max=%d total=%"PRIu64,
-                pool->padded_sizeof_type, pool->max_alloc, pool->alloc_count);
+                pool->padded_sizeof_type, pool->max_alloc, alloc_count);
 
         list_del (&pool->global_list);
 
+        /* the caches are freed by their threads, only detach them */
+        pthread_mutex_lock (&mem_pool_cache_mutex);
+        {
+                list_for_each_entry_safe (cache, tmp, &pool->caches,
+                                          pool_list) {
+                        list_del_init (&cache->pool_list);
+                        cache->pool = NULL;
+                        cache->count = 0;
+                        INIT_LIST_HEAD (&cache->list);
+                }
+        }
+        pthread_mutex_unlock (&mem_pool_cache_mutex);
+
         LOCK_DESTROY (&pool->lock);
         GF_FREE (pool->name);
         GF_FREE (pool->pool);
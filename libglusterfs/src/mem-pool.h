@@ -137,10 +137,25 @@ char * gf_strdup (const char *src)
         return dup_str;
 }
 
+/* per-thread cache of free chunks of one mem_pool. Gets and puts on a
+   chunk in the cache do not take the pool lock, their counts are folded
+   into the pool whenever the cache is refilled or drained */
+#define MEM_POOL_CACHE_MAX  32
+
+struct mem_pool_cache {
+        struct list_head  pool_list;   /* in mem_pool->caches */
+        struct mem_pool  *pool;        /* NULL once the pool is destroyed */
+        struct list_head  list;        /* free chunks */
+        int               count;
+        int               size;
+        int               hot_count;   /* not yet folded into the pool */
+        uint64_t          alloc_count; /* not yet folded into the pool */
+};
+
 struct mem_pool {
         struct list_head  list;
         int               hot_count;
-        int               cold_count;
+        int               cold_count;  /* includes the chunks in caches */
         gf_lock_t         lock;
         unsigned long     padded_sizeof_type;
         void             *pool;
@@ -153,6 +168,9 @@ struct mem_pool {
         int               max_stdalloc;
         char             *name;
         struct list_head  global_list;
+        int               cache_id;    /* slot in the caches of a thread */
+        int               cache_size;  /* chunks per thread, 0 for none */
+        struct list_head  caches;
 };
 
 struct mem_pool *
@@ -165,6 +183,9 @@ void *mem_get (struct mem_pool *pool);
 void *mem_get0 (struct mem_pool *pool);
 
 void mem_pool_destroy (struct mem_pool *pool);
+void mem_pool_get_counts (struct mem_pool *pool, int *hot_count,
+                          int *cold_count, uint64_t *alloc_count,
+                          int *cached_count);
 
 int gf_mem_acct_is_enabled ();
 void gf_mem_acct_enable_set ();
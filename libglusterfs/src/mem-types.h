@@ -111,6 +111,12 @@ enum gf_common_mem_types_ {
         gf_common_mt_buffer_t             = 86,
         gf_common_mt_circular_buffer_t    = 87,
         gf_common_mt_eh_t                 = 88,
-        gf_common_mt_end                  = 89
+        gf_common_mt_iobuf_cache          = 89,
+        gf_common_mt_dict_index           = 90,
+        gf_common_mt_compound_args_t      = 91,
+        gf_common_mt_compound_args_cbk_t  = 92,
+        gf_common_mt_compound_split_t     = 93,
+        gf_common_mt_rpcclnt_savedframe_hash_t = 94,
+        gf_common_mt_end                  = 95
 };
 #endif
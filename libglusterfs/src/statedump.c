@@ -21,6 +21,7 @@
 #include "glusterfs.h"
 #include "logging.h"
 #include "iobuf.h"
+#include "event.h"
 #include "statedump.h"
 #include "stack.h"
 #include "common-utils.h"
@@ -294,17 +295,25 @@ void
 gf_proc_dump_mempool_info (glusterfs_ctx_t *ctx)
 {
         struct mem_pool *pool = NULL;
+        int              hot_count = 0;
+        int              cold_count = 0;
+        int              cached_count = 0;
+        uint64_t         alloc_count = 0;
 
         gf_proc_dump_add_section ("mempool");
 
         list_for_each_entry (pool, &ctx->mempool_list, global_list) {
+                mem_pool_get_counts (pool, &hot_count, &cold_count,
+                                     &alloc_count, &cached_count);
+
                 gf_proc_dump_write ("-----", "-----");
                 gf_proc_dump_write ("pool-name", "%s", pool->name);
-                gf_proc_dump_write ("hot-count", "%d", pool->hot_count);
-                gf_proc_dump_write ("cold-count", "%d", pool->cold_count);
+                gf_proc_dump_write ("hot-count", "%d", hot_count);
+                gf_proc_dump_write ("cold-count", "%d", cold_count);
+                gf_proc_dump_write ("cached-count", "%d", cached_count);
                 gf_proc_dump_write ("padded_sizeof", "%lu",
                                     pool->padded_sizeof_type);
-                gf_proc_dump_write ("alloc-count", "%"PRIu64, pool->alloc_count);
+                gf_proc_dump_write ("alloc-count", "%"PRIu64, alloc_count);
                 gf_proc_dump_write ("max-alloc", "%d", pool->max_alloc);
 
                 gf_proc_dump_write ("pool-misses", "%"PRIu64, pool->pool_misses);
@@ -319,11 +328,17 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
         char            key[GF_DUMP_MAX_BUF_LEN] = {0,};
         int             count = 0;
         int             ret = -1;
+        int             hot_count = 0;
+        int             cold_count = 0;
+        uint64_t        alloc_count = 0;
 
         if (!ctx || !dict)
                 return;
 
         list_for_each_entry (pool, &ctx->mempool_list, global_list) {
+                mem_pool_get_counts (pool, &hot_count, &cold_count,
+                                     &alloc_count, NULL);
+
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.name", count);
                 ret = dict_set_str (dict, key, pool->name);
@@ -332,13 +347,13 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.hotcount", count);
-                ret = dict_set_int32 (dict, key, pool->hot_count);
+                ret = dict_set_int32 (dict, key, hot_count);
                 if (ret)
                         return;
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.coldcount", count);
-                ret = dict_set_int32 (dict, key, pool->cold_count);
+                ret = dict_set_int32 (dict, key, cold_count);
                 if (ret)
                         return;
 
@@ -350,7 +365,7 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.alloccount", count);
-                ret = dict_set_uint64 (dict, key, pool->alloc_count);
+                ret = dict_set_uint64 (dict, key, alloc_count);
                 if (ret)
                         return;
 
@@ -485,6 +500,7 @@ gf_proc_dump_enable_all_options ()
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_mem, _gf_true);
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_iobuf, _gf_true);
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_callpool, _gf_true);
+        GF_PROC_DUMP_SET_OPTION (dump_options.dump_event, _gf_true);
         GF_PROC_DUMP_SET_OPTION (dump_options.xl_options.dump_priv, _gf_true);
         GF_PROC_DUMP_SET_OPTION (dump_options.xl_options.dump_inode, _gf_true);
         GF_PROC_DUMP_SET_OPTION (dump_options.xl_options.dump_fd, _gf_true);
@@ -504,6 +520,7 @@ gf_proc_dump_disable_all_options ()
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_mem, _gf_false);
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_iobuf, _gf_false);
         GF_PROC_DUMP_SET_OPTION (dump_options.dump_callpool, _gf_false);
+        GF_PROC_DUMP_SET_OPTION (dump_options.dump_event, _gf_false);
         GF_PROC_DUMP_SET_OPTION (dump_options.xl_options.dump_priv, _gf_false);
         GF_PROC_DUMP_SET_OPTION (dump_options.xl_options.dump_inode,
                                  _gf_false);
@@ -533,6 +550,8 @@ gf_proc_dump_parse_set_option (char *key, char *value)
                 opt_key = &dump_options.dump_iobuf;
         } else if (!strcasecmp (key, "callpool")) {
                 opt_key = &dump_options.dump_callpool;
+        } else if (!strcasecmp (key, "event")) {
+                opt_key = &dump_options.dump_event;
         } else if (!strcasecmp (key, "priv")) {
                 opt_key = &dump_options.xl_options.dump_priv;
         } else if (!strcasecmp (key, "fd")) {
@@ -657,6 +676,8 @@ gf_proc_dump_info (int signum)
                 iobuf_stats_dump (ctx->iobuf_pool);
         if (GF_PROC_DUMP_IS_OPTION_ENABLED (callpool))
                 gf_proc_dump_pending_frames (ctx->pool);
+        if (GF_PROC_DUMP_IS_OPTION_ENABLED (event))
+                event_pool_dump (ctx->event_pool);
 
         if (ctx->master) {
                 gf_proc_dump_add_section ("fuse");
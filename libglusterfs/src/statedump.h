@@ -39,6 +39,7 @@ typedef struct gf_dump_options_ {
         gf_boolean_t            dump_mem;
         gf_boolean_t            dump_iobuf;
         gf_boolean_t            dump_callpool;
+        gf_boolean_t            dump_event;
         gf_dump_xl_options_t    xl_options; //options for all xlators
 } gf_dump_options_t;
 
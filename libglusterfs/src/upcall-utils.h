@@ -0,0 +1,62 @@
+/*
+   Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __UPCALL_UTILS_H__
+#define __UPCALL_UTILS_H__
+
+#include "uuid.h"
+#include "xlator.h"
+#include "inode.h"
+
+/* what changed on the brick, and so which cached state must go */
+#define GF_UPCALL_ATTR    0x1   /* iatt and xattrs */
+#define GF_UPCALL_DATA    0x2   /* file contents */
+#define GF_UPCALL_ENTRY   0x4   /* names pointing to the inode */
+
+/* Passed as the data of GF_EVENT_UPCALL. On the brick, features/upcall
+ * sends it up to protocol/server with 'client' set to the connection to
+ * push the invalidation to. On the client, protocol/client sends it up the
+ * graph (and on to the fuse bridge) with 'client' set to NULL.
+ */
+struct gf_upcall {
+        void      *client;
+        uuid_t     gfid;
+        uint32_t   flags;
+};
+
+/* Caching translators on the client look the inode up in the table the fuse
+ * bridge keeps on the top of their graph. Returns it with a ref held, or
+ * NULL if it is not in memory (and so nothing can be cached for it).
+ */
+static inline inode_t *
+gf_upcall_inode_find (xlator_t *this, struct gf_upcall *upcall)
+{
+        xlator_t *top = NULL;
+
+        if (!this->graph)
+                return NULL;
+
+        top = this->graph->top;
+        if (!top || !top->itable)
+                return NULL;
+
+        return inode_find (top->itable, upcall->gfid);
+}
+
+#endif /* __UPCALL_UTILS_H__ */
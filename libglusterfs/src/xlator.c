@@ -27,6 +27,7 @@
 #include <netdb.h>
 #include <fnmatch.h>
 #include "defaults.h"
+#include "compound-fop-utils.h"
 
 #define SET_DEFAULT_FOP(fn) do {			\
                 if (!xl->fops->fn)			\
@@ -47,6 +48,14 @@ fill_defaults (xlator_t *xl)
                 return;
         }
 
+        /* passing a compound fop on as a whole would bypass what the
+           translator does for the fops in it, split it unless the
+           translator handles compound fops itself */
+        if (!xl->fops->compound &&
+            (xl->fops->lookup || xl->fops->open || xl->fops->create ||
+             xl->fops->readv || xl->fops->writev || xl->fops->flush))
+                xl->fops->compound = compound_fop_split;
+
         SET_DEFAULT_FOP (create);
         SET_DEFAULT_FOP (open);
         SET_DEFAULT_FOP (stat);
@@ -88,6 +97,7 @@ fill_defaults (xlator_t *xl)
         SET_DEFAULT_FOP (fxattrop);
         SET_DEFAULT_FOP (setattr);
         SET_DEFAULT_FOP (fsetattr);
+        SET_DEFAULT_FOP (compound);
 
         SET_DEFAULT_FOP (getspec);
 
@@ -61,6 +61,10 @@ struct _gf_dirent_t;
 typedef struct _gf_dirent_t gf_dirent_t;
 struct _loc;
 typedef struct _loc loc_t;
+struct _compound_args;
+typedef struct _compound_args compound_args_t;
+struct _compound_args_cbk;
+typedef struct _compound_args_cbk compound_args_cbk_t;
 
 
 typedef int32_t (*event_notify_fn_t) (xlator_t *this, int32_t event, void *data,
@@ -425,6 +429,13 @@ typedef int32_t (*fop_fsetattr_cbk_t) (call_frame_t *frame,
                                        struct iatt *preop_stbuf,
                                        struct iatt *postop_stbuf);
 
+typedef int32_t (*fop_compound_cbk_t) (call_frame_t *frame,
+                                       void *cookie,
+                                       xlator_t *this,
+                                       int32_t op_ret,
+                                       int32_t op_errno,
+                                       compound_args_cbk_t *args_cbk);
+
 typedef int32_t (*fop_lookup_t) (call_frame_t *frame,
                                  xlator_t *this,
                                  loc_t *loc,
@@ -646,6 +657,10 @@ typedef int32_t (*fop_fsetattr_t) (call_frame_t *frame,
                                    struct iatt *stbuf,
                                    int32_t valid);
 
+typedef int32_t (*fop_compound_t) (call_frame_t *frame,
+                                   xlator_t *this,
+                                   compound_args_t *args);
+
 
 struct xlator_fops {
         fop_lookup_t         lookup;
@@ -690,6 +705,7 @@ struct xlator_fops {
         fop_setattr_t        setattr;
         fop_fsetattr_t       fsetattr;
         fop_getspec_t        getspec;
+        fop_compound_t       compound;
 
         /* these entries are used for a typechecking hack in STACK_WIND _only_ */
         fop_lookup_cbk_t         lookup_cbk;
@@ -734,6 +750,7 @@ struct xlator_fops {
         fop_setattr_cbk_t        setattr_cbk;
         fop_fsetattr_cbk_t       fsetattr_cbk;
         fop_getspec_cbk_t        getspec_cbk;
+        fop_compound_cbk_t       compound_cbk;
 };
 
 typedef int32_t (*cbk_forget_t) (xlator_t *this,
@@ -65,9 +65,14 @@ enum gf_fop_procnum {
         GFS3_OP_RELEASE,
         GFS3_OP_RELEASEDIR,
         GFS3_OP_FREMOVEXATTR,
+        GFS3_OP_COMPOUND,
         GFS3_OP_MAXVALUE,
 } ;
 
+/* fd of a GFS3_OP_COMPOUND step that uses the fd opened or created by an
+   earlier step of the same chain (-1 is 'no fd' and -2 an anonymous fd) */
+#define GF_COMPOUND_CHAIN_FD     -3
+
 enum gf_handshake_procnum {
         GF_HNDSK_NULL,
         GF_HNDSK_SETVOLUME,
@@ -118,6 +123,7 @@ enum gf_cbk_procnum {
         GF_CBK_NULL = 0,
         GF_CBK_FETCHSPEC,
         GF_CBK_INO_FLUSH,
+        GF_CBK_CACHE_INVALIDATION,
         GF_CBK_MAXVALUE,
 };
 
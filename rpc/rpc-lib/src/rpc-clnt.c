@@ -52,18 +52,73 @@ rpc_clnt_new_callid (struct rpc_clnt *clnt)
 }
 
 
+#define SAVED_FRAMES_HASH_MIN  64
+
+static inline struct list_head *
+__saved_frames_bucket (struct saved_frames *frames, uint32_t xid)
+{
+        return &frames->hash[xid & (frames->hash_size - 1)];
+}
+
+
+static int
+__saved_frames_hash_resize (struct saved_frames *frames, uint32_t size)
+{
+        struct list_head   *hash = NULL;
+        struct list_head   *old  = NULL;
+        struct saved_frame *trav = NULL;
+        struct saved_frame *tmp  = NULL;
+        uint32_t            i    = 0;
+
+        hash = GF_CALLOC (size, sizeof (*hash),
+                          gf_common_mt_rpcclnt_savedframe_hash_t);
+        if (!hash)
+                return -1;
+
+        for (i = 0; i < size; i++)
+                INIT_LIST_HEAD (&hash[i]);
+
+        old = frames->hash;
+        for (i = 0; i < frames->hash_size; i++) {
+                list_for_each_entry_safe (trav, tmp, &old[i], hash_list) {
+                        list_move_tail (&trav->hash_list,
+                                        &hash[trav->rpcreq->xid & (size - 1)]);
+                }
+        }
+
+        frames->hash      = hash;
+        frames->hash_size = size;
+
+        if (old)
+                GF_FREE (old);
+
+        return 0;
+}
+
+
+static void
+__saved_frames_unlink (struct saved_frames *frames,
+                       struct saved_frame *saved_frame)
+{
+        list_del_init (&saved_frame->list);
+        list_del_init (&saved_frame->hash_list);
+        frames->count--;
+}
+
+
 struct saved_frame *
 __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
                              struct timeval *current)
 {
 	struct saved_frame *bailout_frame = NULL, *tmp = NULL;
 
+        /* sf is in the order the frames were sent, only its head can be
+           due. Lock fops in lk_sf may block for long and never bail out */
 	if (!list_empty(&frames->sf.list)) {
 		tmp = list_entry (frames->sf.list.next, typeof (*tmp), list);
 		if ((tmp->saved_at.tv_sec + timeout) < current->tv_sec) {
 			bailout_frame = tmp;
-			list_del_init (&bailout_frame->list);
-			frames->count--;
+                        __saved_frames_unlink (frames, bailout_frame);
 		}
 	}
 
@@ -100,6 +155,7 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 
         memset (saved_frame, 0, sizeof (*saved_frame));
 	INIT_LIST_HEAD (&saved_frame->list);
+        INIT_LIST_HEAD (&saved_frame->hash_list);
 
 	saved_frame->capital_this = THIS;
 	saved_frame->frame        = frame;
@@ -113,6 +169,14 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 
 	frames->count++;
 
+        /* keep the chains short; if the table can not grow the longer
+           chains still work */
+        if (frames->count > frames->hash_size)
+                __saved_frames_hash_resize (frames, frames->hash_size * 2);
+
+        list_add_tail (&saved_frame->hash_list,
+                       __saved_frames_bucket (frames, rpcreq->xid));
+
 out:
 	return saved_frame;
 }
@@ -127,8 +191,7 @@ saved_frames_delete (struct saved_frame *saved_frame,
 
         pthread_mutex_lock (&conn->lock);
         {
-                list_del_init (&saved_frame->list);
-                conn->saved_frames->count--;
+                __saved_frames_unlink (conn->saved_frames, saved_frame);
         }
         pthread_mutex_unlock (&conn->lock);
 
@@ -276,10 +339,31 @@ saved_frames_new (void)
 	INIT_LIST_HEAD (&saved_frames->sf.list);
 	INIT_LIST_HEAD (&saved_frames->lk_sf.list);
 
+        if (__saved_frames_hash_resize (saved_frames,
+                                        SAVED_FRAMES_HASH_MIN)) {
+                GF_FREE (saved_frames);
+                return NULL;
+        }
+
 	return saved_frames;
 }
 
 
+static struct saved_frame *
+__saved_frame_find (struct saved_frames *frames, int64_t callid)
+{
+	struct saved_frame *tmp = NULL;
+
+	list_for_each_entry (tmp, __saved_frames_bucket (frames, callid),
+                             hash_list) {
+		if (tmp->rpcreq->xid == callid)
+                        return tmp;
+        }
+
+        return NULL;
+}
+
+
 int
 __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                     struct saved_frame *saved_frame)
@@ -292,21 +376,11 @@ __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                 goto out;
         }
 
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
-
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
+        tmp = __saved_frame_find (frames, callid);
+        if (tmp) {
+                *saved_frame = *tmp;
+                ret = 0;
+        }
 
 out:
 	return ret;
@@ -317,28 +391,10 @@ struct saved_frame *
 __saved_frame_get (struct saved_frames *frames, int64_t callid)
 {
 	struct saved_frame *saved_frame = NULL;
-	struct saved_frame *tmp = NULL;
-
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
 
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
-
-out:
+        saved_frame = __saved_frame_find (frames, callid);
 	if (saved_frame) {
+                __saved_frames_unlink (frames, saved_frame);
                 THIS  = saved_frame->capital_this;
         }
 
@@ -391,6 +447,7 @@ saved_frames_unwind (struct saved_frames *saved_frames)
 
                 clnt = rpc_clnt_unref (clnt);
 		list_del_init (&trav->list);
+                list_del_init (&trav->hash_list);
                 mem_put (trav);
 	}
 }
@@ -404,6 +461,7 @@ saved_frames_destroy (struct saved_frames *frames)
 
 	saved_frames_unwind (frames);
 
+        GF_FREE (frames->hash);
 	GF_FREE (frames);
 }
 
@@ -469,7 +527,7 @@ rpc_clnt_reconnect (void *trans_ptr)
 int
 rpc_clnt_fill_request_info (struct rpc_clnt *clnt, rpc_request_info_t *info)
 {
-        struct saved_frame  saved_frame = {{}, 0};
+        struct saved_frame  saved_frame = {{}, {0, }, 0};
         int                 ret         = -1;
 
         pthread_mutex_lock (&clnt->conn.lock);
@@ -751,7 +809,8 @@ rpc_clnt_handle_cbk (struct rpc_clnt *clnt, rpc_transport_pollin_t *msg)
 
         if (found && (procnum < program->numactors) &&
             (program->actors[procnum].actor)) {
-                program->actors[procnum].actor (&progmsg);
+                program->actors[procnum].actor (clnt, clnt->mydata,
+                                                &progmsg);
         }
 
 out:
@@ -828,6 +887,62 @@ out:
 }
 
 
+/* The xid of the last call submitted on @rpc. */
+uint32_t
+rpc_clnt_last_xid (struct rpc_clnt *rpc)
+{
+        uint32_t xid = 0;
+
+        pthread_mutex_lock (&rpc->lock);
+        {
+                xid = rpc->xid;
+        }
+        pthread_mutex_unlock (&rpc->lock);
+
+        return xid;
+}
+
+
+static int
+__saved_frames_xid_outstanding (struct saved_frame *head, uint32_t xid)
+{
+        struct saved_frame *trav = NULL;
+
+        list_for_each_entry (trav, &head->list, list) {
+                /* xids wrap around */
+                if ((int32_t)(trav->rpcreq->xid - xid) <= 0)
+                        return 1;
+        }
+
+        return 0;
+}
+
+
+/* Whether a call submitted on @rpc up to the one with @xid is still waiting
+   for its reply. Walks all the outstanding calls, the list is in the order
+   the calls were saved, which is not quite the order of their xids. */
+int
+rpc_clnt_xid_outstanding (struct rpc_clnt *rpc, uint32_t xid)
+{
+        rpc_clnt_connection_t *conn = NULL;
+        int                    ret  = 0;
+
+        conn = &rpc->conn;
+
+        pthread_mutex_lock (&conn->lock);
+        {
+                if (conn->saved_frames)
+                        ret = __saved_frames_xid_outstanding
+                                (&conn->saved_frames->sf, xid) ||
+                              __saved_frames_xid_outstanding
+                                (&conn->saved_frames->lk_sf, xid);
+        }
+        pthread_mutex_unlock (&conn->lock);
+
+        return ret;
+}
+
+
 void
 rpc_clnt_unset_connected (rpc_clnt_connection_t *conn)
 {
@@ -58,6 +58,7 @@ struct saved_frame {
 			struct saved_frame *frame_prev;
 		};
 	};
+        struct list_head         hash_list;
         void                    *capital_this;
 	void                    *frame;
 	struct timeval           saved_at;
@@ -65,10 +66,16 @@ struct saved_frame {
         rpc_transport_rsp_t      rsp;
 };
 
+/* sf and lk_sf keep the frames in the order they were sent, which is what
+   call_bail and the unwind on disconnect walk. A reply finds its frame by
+   xid in hash, which grows with the number of outstanding frames; xids are
+   handed out in sequence, so "xid & (hash_size - 1)" spreads them evenly */
 struct saved_frames {
 	int64_t            count;
 	struct saved_frame sf;
 	struct saved_frame lk_sf;
+        struct list_head  *hash;
+        uint32_t           hash_size;
 };
 
 
@@ -87,7 +94,8 @@ typedef struct rpc_clnt_program {
         int                   numproc;
 } rpc_clnt_prog_t;
 
-typedef int (*rpcclnt_cb_fn) (void *data);
+typedef int (*rpcclnt_cb_fn) (struct rpc_clnt *rpc, void *mydata,
+                              void *data);
 
 /* The descriptor for each procedure/actor that runs
  * over the RPC service.
@@ -237,6 +245,10 @@ void rpc_clnt_reconnect (void *trans_ptr);
 
 void rpc_clnt_reconfig (struct rpc_clnt *rpc, struct rpc_clnt_config *config);
 
+uint32_t rpc_clnt_last_xid (struct rpc_clnt *rpc);
+
+int rpc_clnt_xid_outstanding (struct rpc_clnt *rpc, uint32_t xid);
+
 /* All users of RPC services should use this API to register their
  * procedure handlers.
  */
@@ -37,6 +37,7 @@
  */
 #include "xlator.h"
 #include "list.h"
+#include "statedump.h"
 
 #ifndef GF_OPTION_LIST_EMPTY
 #define GF_OPTION_LIST_EMPTY(_opt) (_opt->value[0] == NULL)
@@ -619,3 +620,31 @@ out:
 
         return ret;
 }
+
+
+/* Writes the traffic counters of a transport into the statedump section
+   being written, the keys prefixed with "@prefix." if @prefix is given. */
+void
+rpc_transport_stats_dump (rpc_transport_t *this, const char *prefix)
+{
+        char key[GF_DUMP_MAX_BUF_LEN];
+
+#define RPC_TRANSPORT_STAT_DUMP(name, field)                            \
+        do {                                                            \
+                snprintf (key, sizeof (key), "%s%s%s", prefix ? prefix : "", \
+                          prefix ? "." : "", name);                     \
+                gf_proc_dump_write (key, "%"PRIu64, this->field);       \
+        } while (0)
+
+        RPC_TRANSPORT_STAT_DUMP ("total_bytes_read", total_bytes_read);
+        RPC_TRANSPORT_STAT_DUMP ("total_bytes_written", total_bytes_write);
+        RPC_TRANSPORT_STAT_DUMP ("total_read_calls", total_read_calls);
+        RPC_TRANSPORT_STAT_DUMP ("total_write_calls", total_write_calls);
+        RPC_TRANSPORT_STAT_DUMP ("total_msgs_written", total_msgs_write);
+        RPC_TRANSPORT_STAT_DUMP ("total_zerocopy_sends",
+                                 total_zerocopy_sends);
+        RPC_TRANSPORT_STAT_DUMP ("total_zerocopy_copied",
+                                 total_zerocopy_copied);
+
+#undef RPC_TRANSPORT_STAT_DUMP
+}
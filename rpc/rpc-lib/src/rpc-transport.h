@@ -211,6 +211,13 @@ struct rpc_transport {
 
         uint64_t                   total_bytes_read;
         uint64_t                   total_bytes_write;
+        uint64_t                   total_read_calls;  /* system calls */
+        uint64_t                   total_write_calls;
+        uint64_t                   total_msgs_write;  /* rpc records sent */
+        uint64_t                   total_zerocopy_sends;
+        uint64_t                   total_zerocopy_copied; /* sends the
+                                                             kernel copied
+                                                             anyway */
 
         struct list_head           list;
         int                        bind_insecure;
@@ -306,4 +313,7 @@ rpc_transport_keepalive_options_set (dict_t *options, int32_t interval,
 
 int
 rpc_transport_inet_options_build (dict_t **options, const char *hostname, int port);
+
+void
+rpc_transport_stats_dump (rpc_transport_t *this, const char *prefix);
 #endif /* __RPC_TRANSPORT_H__ */
@@ -829,10 +829,12 @@ rpcsvc_callback_submit (rpcsvc_t *rpc, rpc_transport_t *trans,
                         struct iovec *proghdr, int proghdrcount)
 {
         struct iobuf          *request_iob = NULL;
+        struct iobref         *iobref      = NULL;
         struct iovec           rpchdr      = {0,};
         rpc_transport_req_t    req;
         int                    ret         = -1;
         int                    proglen     = 0;
+        int                    i           = 0;
         uint64_t               callid      = 0;
 
         if (!rpc) {
@@ -857,10 +859,26 @@ rpcsvc_callback_submit (rpcsvc_t *rpc, rpc_transport_t *trans,
                 goto out;
         }
 
+        /* The record was sized for the payload too: copy it in behind the
+         * header so that the whole message lives in one iobuf, which the
+         * transport holds on to if it cannot send it right away.
+         */
+        for (i = 0; i < proghdrcount; i++) {
+                memcpy ((char *)rpchdr.iov_base + rpchdr.iov_len,
+                        proghdr[i].iov_base, proghdr[i].iov_len);
+                rpchdr.iov_len += proghdr[i].iov_len;
+        }
+
+        iobref = iobref_new ();
+        if (!iobref) {
+                goto out;
+        }
+
+        iobref_add (iobref, request_iob);
+
         req.msg.rpchdr = &rpchdr;
         req.msg.rpchdrcount = 1;
-        req.msg.proghdr = proghdr;
-        req.msg.proghdrcount = proghdrcount;
+        req.msg.iobref = iobref;
 
         ret = rpc_transport_submit_request (trans, &req);
         if (ret == -1) {
@@ -872,6 +890,9 @@ rpcsvc_callback_submit (rpcsvc_t *rpc, rpc_transport_t *trans,
         ret = 0;
 
 out:
+        if (iobref)
+                iobref_unref (iobref);
+
         iobuf_unref (request_iob);
 
         return ret;
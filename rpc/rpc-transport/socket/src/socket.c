@@ -44,6 +44,9 @@
 #include <errno.h>
 #include <netinet/tcp.h>
 #include <rpc/xdr.h>
+#ifdef HAVE_SOCKET_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 #define GF_LOG_ERRNO(errno) ((errno == ENOTCONN) ? GF_LOG_DEBUG : GF_LOG_ERROR)
 #define SA(ptr) ((struct sockaddr *)ptr)
 
@@ -171,6 +174,7 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
         while (opcount) {
                 if (write) {
                         ret = writev (sock, opvector, opcount);
+                        this->total_write_calls++;
 
                         if (ret == 0 || (ret == -1 && errno == EAGAIN)) {
                                 /* done for now */
@@ -179,6 +183,7 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
                         this->total_bytes_write += ret;
                 } else {
                         ret = readv (sock, opvector, opcount);
+                        this->total_read_calls++;
                         if (ret == -1 && errno == EAGAIN) {
                                 /* done for now */
                                 break;
@@ -518,12 +523,15 @@ socket_set_last_frag_header_size (uint32_t size, char *haddr)
 struct ioq *
 __socket_ioq_new (rpc_transport_t *this, rpc_transport_msg_t *msg)
 {
+        socket_private_t *priv  = NULL;
         struct ioq       *entry = NULL;
         int               count = 0;
         uint32_t          size  = 0;
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
 
+        priv = this->private;
+
         /* TODO: use mem-pool */
         entry = GF_CALLOC (1, sizeof (*entry), gf_common_mt_ioq);
         if (!entry)
@@ -572,6 +580,11 @@ __socket_ioq_new (rpc_transport_t *this, rpc_transport_msg_t *msg)
         entry->pending_vector = entry->vector;
         entry->pending_count  = entry->count;
 
+        if (priv->zerocopy &&
+            (iov_length (msg->progpayload, msg->progpayloadcount) >=
+             priv->zerocopy_threshold))
+                entry->zerocopy = 1;
+
         if (msg->iobref != NULL)
                 entry->iobref = iobref_ref (msg->iobref);
 
@@ -615,37 +628,86 @@ __socket_ioq_flush (rpc_transport_t *this)
                 __socket_ioq_entry_free (entry);
         }
 
+        /* the socket is going away, the kernel drops its page references
+           with it */
+        while (!list_empty (&priv->zc_pending)) {
+                entry = list_entry (priv->zc_pending.next, struct ioq, list);
+                __socket_ioq_entry_free (entry);
+        }
+
 out:
         return;
 }
 
 
-int
-__socket_ioq_churn_entry (rpc_transport_t *this, struct ioq *entry)
+/* moves @entry past @bytes written bytes, returns what is left of @bytes
+   once the entry is done */
+static size_t
+__socket_ioq_entry_advance (struct ioq *entry, size_t bytes)
 {
-        int ret = -1;
+        while (entry->pending_count) {
+                if (bytes < entry->pending_vector->iov_len) {
+                        entry->pending_vector->iov_base =
+                                (char *)entry->pending_vector->iov_base + bytes;
+                        entry->pending_vector->iov_len -= bytes;
+                        return 0;
+                }
 
-        ret = __socket_writev (this, entry->pending_vector,
-                               entry->pending_count,
-                               &entry->pending_vector,
-                               &entry->pending_count);
+                bytes -= entry->pending_vector->iov_len;
+                entry->pending_vector++;
+                entry->pending_count--;
+        }
 
-        if (ret == 0) {
-                /* current entry was completely written */
-                GF_ASSERT (entry->pending_count == 0);
-                __socket_ioq_entry_free (entry);
+        return bytes;
+}
+
+
+static void
+__socket_ioq_entry_done (rpc_transport_t *this, struct ioq *entry)
+{
+        socket_private_t *priv = NULL;
+
+        priv = this->private;
+
+        this->total_msgs_write++;
+
+        if (entry->zc_sent) {
+                /* the iobufs stay referenced until the kernel is done with
+                   the pages */
+                list_move_tail (&entry->list, &priv->zc_pending);
+                return;
         }
 
-        return ret;
+        __socket_ioq_entry_free (entry);
 }
 
 
+/* Writes out the queued messages. As many of them as fit in
+ * SOCKET_BATCH_IOVEC vectors go out in one sendmsg (), so a backlog of small
+ * replies or requests costs one system call instead of one each. When more
+ * is queued behind a batch it is sent with MSG_MORE, which keeps TCP from
+ * pushing out a short segment at the end of it, the way TCP_CORK would
+ * without the setsockopt () calls around each burst.
+ *
+ * return value:
+ *   0 = queue written out
+ *  -1 = error
+ * > 0 = incomplete, socket buffer full
+ */
 int
-__socket_ioq_churn (rpc_transport_t *this)
+__socket_ioq_write (rpc_transport_t *this)
 {
-        socket_private_t *priv = NULL;
-        int               ret = 0;
-        struct ioq       *entry = NULL;
+        socket_private_t *priv     = NULL;
+        struct ioq       *entry    = NULL;
+        struct ioq       *tmp      = NULL;
+        struct iovec      vector[SOCKET_BATCH_IOVEC];
+        struct msghdr     msg;
+        int               count    = 0;
+        int               flags    = 0;
+        char              zerocopy = 0;
+        char              zc_off   = 0;
+        ssize_t           ret      = 0;
+        size_t            bytes    = 0;
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
         GF_VALIDATE_OR_GOTO ("socket", this->private, out);
@@ -653,15 +715,101 @@ __socket_ioq_churn (rpc_transport_t *this)
         priv = this->private;
 
         while (!list_empty (&priv->ioq)) {
-                /* pick next entry */
-                entry = priv->ioq_next;
+                count    = 0;
+                flags    = 0;
+                zerocopy = 0;
+
+                list_for_each_entry (entry, &priv->ioq, list) {
+                        if ((count + entry->pending_count) >
+                            SOCKET_BATCH_IOVEC) {
+                                flags |= MSG_MORE;
+                                break;
+                        }
+
+                        memcpy (&vector[count], entry->pending_vector,
+                                entry->pending_count * sizeof (*vector));
+                        count += entry->pending_count;
+                        zerocopy |= entry->zerocopy;
+                }
+
+#ifdef HAVE_SOCKET_ZEROCOPY
+                if (zerocopy && !zc_off)
+                        flags |= MSG_ZEROCOPY;
+#endif
+
+                memset (&msg, 0, sizeof (msg));
+                msg.msg_iov    = vector;
+                msg.msg_iovlen = count;
+
+                ret = sendmsg (priv->sock, &msg, flags);
+                this->total_write_calls++;
 
-                ret = __socket_ioq_churn_entry (this, entry);
+                if (ret == 0 || (ret == -1 && errno == EAGAIN)) {
+                        /* done for now */
+                        ret = 1;
+                        break;
+                }
 
-                if (ret != 0)
+                if (ret == -1) {
+                        if (errno == EINTR)
+                                continue;
+#ifdef HAVE_SOCKET_ZEROCOPY
+                        if ((errno == ENOBUFS) && (flags & MSG_ZEROCOPY)) {
+                                /* no more pages can be pinned (optmem),
+                                   copy this time */
+                                zc_off = 1;
+                                continue;
+                        }
+#endif
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "sendmsg failed (%s)", strerror (errno));
                         break;
+                }
+
+                this->total_bytes_write += ret;
+
+                bytes = ret;
+                list_for_each_entry_safe (entry, tmp, &priv->ioq, list) {
+#ifdef HAVE_SOCKET_ZEROCOPY
+                        if (bytes && (flags & MSG_ZEROCOPY)) {
+                                entry->zc_sent = 1;
+                                entry->zc_seq  = priv->zc_next;
+                        }
+#endif
+                        bytes = __socket_ioq_entry_advance (entry, bytes);
+                        if (entry->pending_count)
+                                break;
+
+                        __socket_ioq_entry_done (this, entry);
+                }
+
+#ifdef HAVE_SOCKET_ZEROCOPY
+                if (flags & MSG_ZEROCOPY) {
+                        priv->zc_next++;
+                        this->total_zerocopy_sends++;
+                }
+#endif
+                ret = 0;
         }
 
+out:
+        return ret;
+}
+
+
+int
+__socket_ioq_churn (rpc_transport_t *this)
+{
+        socket_private_t *priv = NULL;
+        int               ret = 0;
+
+        GF_VALIDATE_OR_GOTO ("socket", this, out);
+        GF_VALIDATE_OR_GOTO ("socket", this->private, out);
+
+        priv = this->private;
+
+        ret = __socket_ioq_write (this);
+
         if (list_empty (&priv->ioq)) {
                 /* all pending writes done, not interested in POLLOUT */
                 priv->idx = event_select_on (this->ctx->event_pool,
@@ -673,6 +821,127 @@ out:
 }
 
 
+#ifdef HAVE_SOCKET_ZEROCOPY
+/* Reads the completions of MSG_ZEROCOPY sends off the error queue and lets
+ * go of the messages the kernel no longer needs. Each notification covers a
+ * range of send seqs; TCP completes them in order, so everything below the
+ * end of the range is done. Returns the number of notifications read, -1 if
+ * the socket has a real error. */
+static int
+__socket_zerocopy_reap (rpc_transport_t *this)
+{
+        socket_private_t         *priv  = NULL;
+        struct ioq               *entry = NULL;
+        struct ioq               *tmp   = NULL;
+        struct sock_extended_err *serr  = NULL;
+        struct cmsghdr           *cm    = NULL;
+        struct msghdr             msg;
+        char                      control[128];
+        int                       sockerr = 0;
+        socklen_t                 len   = sizeof (sockerr);
+        int                       count = 0;
+        int                       ret   = 0;
+
+        priv = this->private;
+
+        for (;;) {
+                memset (&msg, 0, sizeof (msg));
+                msg.msg_control    = control;
+                msg.msg_controllen = sizeof (control);
+
+                ret = recvmsg (priv->sock, &msg, MSG_ERRQUEUE);
+                if (ret == -1) {
+                        if (errno == EINTR)
+                                continue;
+                        break;
+                }
+                count++;
+
+                for (cm = CMSG_FIRSTHDR (&msg); cm;
+                     cm = CMSG_NXTHDR (&msg, cm)) {
+                        serr = (struct sock_extended_err *) CMSG_DATA (cm);
+                        if ((serr->ee_errno != 0) ||
+                            (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+                                continue;
+
+                        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                                this->total_zerocopy_copied +=
+                                        serr->ee_data - serr->ee_info + 1;
+
+                        if ((int32_t)(serr->ee_data + 1 - priv->zc_done) > 0)
+                                priv->zc_done = serr->ee_data + 1;
+                }
+        }
+
+        list_for_each_entry_safe (entry, tmp, &priv->zc_pending, list) {
+                if ((int32_t)(entry->zc_seq - priv->zc_done) >= 0)
+                        break;
+                __socket_ioq_entry_free (entry);
+        }
+
+        ret = getsockopt (priv->sock, SOL_SOCKET, SO_ERROR, &sockerr, &len);
+        if (ret == -1 || sockerr)
+                return -1;
+
+        return count;
+}
+
+
+/* completions of MSG_ZEROCOPY sends come as POLLERR too, returns 1 if that
+   is all the POLLERR was about */
+static int
+socket_event_poll_errqueue (rpc_transport_t *this)
+{
+        socket_private_t *priv = NULL;
+        int               ret  = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                ret = __socket_zerocopy_reap (this);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return (ret > 0);
+}
+
+
+/* turns on SO_ZEROCOPY for a newly connected socket if the
+   zerocopy-threshold option asks for it */
+static void
+__socket_zerocopy_init (rpc_transport_t *this)
+{
+        socket_private_t *priv = NULL;
+        int               on   = 1;
+
+        priv = this->private;
+
+        priv->zerocopy = 0;
+        priv->zc_next  = 0;
+        priv->zc_done  = 0;
+
+        if (!priv->zerocopy_threshold)
+                return;
+
+        if (setsockopt (priv->sock, SOL_SOCKET, SO_ZEROCOPY, &on,
+                        sizeof (on)) == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "setsockopt() on SO_ZEROCOPY failed (%s), sending "
+                        "with copies", strerror (errno));
+                return;
+        }
+
+        priv->zerocopy = 1;
+}
+#else
+static void
+__socket_zerocopy_init (rpc_transport_t *this)
+{
+}
+#endif /* HAVE_SOCKET_ZEROCOPY */
+
+
 int
 socket_event_poll_err (rpc_transport_t *this)
 {
@@ -1801,6 +2070,13 @@ socket_event_handler (int fd, int idx, void *data,
                 ret = socket_event_poll_in (this);
         }
 
+#ifdef HAVE_SOCKET_ZEROCOPY
+        if (!ret && poll_err && priv->zerocopy) {
+                if (socket_event_poll_errqueue (this))
+                        poll_err = 0;
+        }
+#endif
+
         if ((ret < 0) || poll_err) {
                 /* Logging has happened already in earlier cases */
                 gf_log ("transport", ((ret >= 0) ? GF_LOG_INFO : GF_LOG_DEBUG),
@@ -1921,11 +2197,14 @@ socket_server_event_handler (int fd, int idx, void *data,
                         new_trans->notify = this->notify;
                         new_trans->listener = this;
                         new_priv = new_trans->private;
+                        new_priv->zerocopy_threshold =
+                                priv->zerocopy_threshold;
 
                         pthread_mutex_lock (&new_priv->lock);
                         {
                                 new_priv->sock = new_sock;
                                 new_priv->connected = 1;
+                                __socket_zerocopy_init (new_trans);
                                 rpc_transport_ref (new_trans);
 
                                 new_priv->idx =
@@ -2093,6 +2372,8 @@ socket_connect (rpc_transport_t *this, int port)
                                         strerror (errno));
                 }
 
+                __socket_zerocopy_init (this);
+
                 SA (&this->myinfo.sockaddr)->sa_family =
                         SA (&this->peerinfo.sockaddr)->sa_family;
 
@@ -2295,7 +2576,6 @@ socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
         socket_private_t *priv = NULL;
         int               ret = -1;
         char              need_poll_out = 0;
-        char              need_append = 1;
         struct ioq       *entry = NULL;
         glusterfs_ctx_t  *ctx = NULL;
 
@@ -2323,19 +2603,16 @@ socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
                         goto unlock;
 
                 if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry);
-
-                        if (ret == 0)
-                                need_append = 0;
+                        list_add_tail (&entry->list, &priv->ioq);
 
-                        if (ret > 0)
+                        if (__socket_ioq_write (this) > 0)
                                 need_poll_out = 1;
-                }
-
-                if (need_append) {
+                } else {
+                        /* goes out with the rest of the queue, batched, on
+                           POLLOUT */
                         list_add_tail (&entry->list, &priv->ioq);
-                        ret = 0;
                 }
+                ret = 0;
 
                 if (need_poll_out) {
                         /* first entry to wait. continue writing on POLLOUT */
@@ -2358,7 +2635,6 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
         socket_private_t *priv = NULL;
         int               ret = -1;
         char              need_poll_out = 0;
-        char              need_append = 1;
         struct ioq       *entry = NULL;
         glusterfs_ctx_t  *ctx = NULL;
 
@@ -2384,19 +2660,16 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
                 if (!entry)
                         goto unlock;
                 if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry);
-
-                        if (ret == 0)
-                                need_append = 0;
+                        list_add_tail (&entry->list, &priv->ioq);
 
-                        if (ret > 0)
+                        if (__socket_ioq_write (this) > 0)
                                 need_poll_out = 1;
-                }
-
-                if (need_append) {
+                } else {
+                        /* goes out with the rest of the queue, batched, on
+                           POLLOUT */
                         list_add_tail (&entry->list, &priv->ioq);
-                        ret = 0;
                 }
+                ret = 0;
 
                 if (need_poll_out) {
                         /* first entry to wait. continue writing on POLLOUT */
@@ -2589,6 +2862,7 @@ socket_init (rpc_transport_t *this)
         priv->bio = 0;
         priv->windowsize = GF_DEFAULT_SOCKET_WINDOW_SIZE;
         INIT_LIST_HEAD (&priv->ioq);
+        INIT_LIST_HEAD (&priv->zc_pending);
 
         /* All the below section needs 'this->options' to be present */
         if (!this->options)
@@ -2696,6 +2970,24 @@ socket_init (rpc_transport_t *this)
                 }
         }
 
+        optstr = NULL;
+        if (dict_get_str (this->options, "transport.socket.zerocopy-threshold",
+                          &optstr) == 0) {
+                if (gf_string2bytesize (optstr,
+                                        &priv->zerocopy_threshold) != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid number format: %s", optstr);
+                        return -1;
+                }
+#ifndef HAVE_SOCKET_ZEROCOPY
+                if (priv->zerocopy_threshold)
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "MSG_ZEROCOPY is not supported here, "
+                                "ignoring transport.socket.zerocopy-threshold");
+                priv->zerocopy_threshold = 0;
+#endif
+        }
+
         optstr = NULL;
 out:
         this->private = priv;
@@ -2804,5 +3096,13 @@ struct volume_options options[] = {
         { .key   = {"transport.socket.read-fail-log"},
           .type  = GF_OPTION_TYPE_BOOL
         },
+        { .key   = {"transport.socket.zerocopy-threshold"},
+          .type  = GF_OPTION_TYPE_SIZET,
+          .description = "Messages with a payload of at least this many "
+                         "bytes (the data of writes and reads) are sent with "
+                         "MSG_ZEROCOPY, without copying it into the socket "
+                         "buffer. Only pays off for payloads of several tens "
+                         "of KB, 0 turns it off. Linux only."
+        },
         { .key = {NULL} }
 };
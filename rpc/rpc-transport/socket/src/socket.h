@@ -33,10 +33,28 @@
 #include "mem-pool.h"
 #include "globals.h"
 
+#include <limits.h>
+#include <sys/socket.h>
+
 #ifndef MAX_IOVEC
 #define MAX_IOVEC 16
 #endif /* MAX_IOVEC */
 
+/* vectors gathered from the queued messages into one sendmsg () */
+#ifdef IOV_MAX
+#define SOCKET_BATCH_IOVEC IOV_MAX
+#else
+#define SOCKET_BATCH_IOVEC 1024
+#endif
+
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+#if defined(GF_LINUX_HOST_OS) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define HAVE_SOCKET_ZEROCOPY 1
+#endif
+
 #define GF_DEFAULT_SOCKET_LISTEN_PORT  GF_DEFAULT_BASE_PORT
 
 #define RPC_MAX_FRAGMENT_SIZE 0x7fffffff
@@ -107,6 +125,12 @@ struct ioq {
         struct iovec      *pending_vector;
         int                pending_count;
         struct iobref     *iobref;
+        char               zerocopy;    /* payload big enough for
+                                           MSG_ZEROCOPY */
+        char               zc_sent;     /* some of it went out with
+                                           MSG_ZEROCOPY, the kernel may still
+                                           use the buffers */
+        uint32_t           zc_seq;      /* of the last such send */
 };
 
 typedef struct {
@@ -195,6 +219,12 @@ typedef struct {
         int                    keepaliveintvl;
         uint32_t               backlog;
         gf_boolean_t           read_fail_log;
+        uint64_t               zerocopy_threshold; /* 0: no MSG_ZEROCOPY */
+        char                   zerocopy;   /* SO_ZEROCOPY is on */
+        uint32_t               zc_next;    /* seq of the next zerocopy send */
+        uint32_t               zc_done;    /* all seqs below it completed */
+        struct list_head       zc_pending; /* written ioq entries waiting for
+                                              their zerocopy completion */
 } socket_private_t;
 
 
@@ -1101,6 +1101,67 @@ struct gf_set_lk_ver_req {
 };
 typedef struct gf_set_lk_ver_req gf_set_lk_ver_req;
 
+struct gfs3_cbk_cache_invalidation_req {
+	char gfid[16];
+	u_int flags;
+};
+typedef struct gfs3_cbk_cache_invalidation_req gfs3_cbk_cache_invalidation_req;
+
+struct gfs3_compound_req_entry {
+	int op;
+	char gfid[16];
+	char pargfid[16];
+	quad_t fd;
+	u_int flags;
+	u_int mode;
+	u_quad_t offset;
+	u_int size;
+	char *bname;
+	struct {
+		u_int dict_len;
+		char *dict_val;
+	} dict;
+	struct gfs3_compound_req_entry *nextentry;
+};
+typedef struct gfs3_compound_req_entry gfs3_compound_req_entry;
+
+struct gfs3_compound_req {
+	struct gfs3_compound_req_entry *request;
+	struct {
+		u_int xdata_len;
+		char *xdata_val;
+	} xdata;
+};
+typedef struct gfs3_compound_req gfs3_compound_req;
+
+struct gfs3_compound_rsp_entry {
+	int op;
+	int op_ret;
+	int op_errno;
+	u_quad_t fd;
+	struct gf_iatt stat;
+	struct gf_iatt prestat;
+	struct gf_iatt poststat;
+	u_int size;
+	struct {
+		u_int dict_len;
+		char *dict_val;
+	} dict;
+	struct gfs3_compound_rsp_entry *nextentry;
+};
+typedef struct gfs3_compound_rsp_entry gfs3_compound_rsp_entry;
+
+struct gfs3_compound_rsp {
+	int op_ret;
+	int op_errno;
+	struct gfs3_compound_rsp_entry *reply;
+	struct {
+		u_int xdata_len;
+		char *xdata_val;
+	} xdata;
+};
+typedef struct gfs3_compound_rsp gfs3_compound_rsp;
+
 /* the xdr functions */
 
 #if defined(__STDC__) || defined(__cplusplus)
@@ -1192,6 +1253,11 @@ extern  bool_t xdr_gfs3_dirplist (XDR *, gfs3_dirplist*);
 extern  bool_t xdr_gfs3_readdirp_rsp (XDR *, gfs3_readdirp_rsp*);
 extern  bool_t xdr_gf_set_lk_ver_rsp (XDR *, gf_set_lk_ver_rsp*);
 extern  bool_t xdr_gf_set_lk_ver_req (XDR *, gf_set_lk_ver_req*);
+extern  bool_t xdr_gfs3_cbk_cache_invalidation_req (XDR *, gfs3_cbk_cache_invalidation_req*);
+extern  bool_t xdr_gfs3_compound_req_entry (XDR *, gfs3_compound_req_entry*);
+extern  bool_t xdr_gfs3_compound_req (XDR *, gfs3_compound_req*);
+extern  bool_t xdr_gfs3_compound_rsp_entry (XDR *, gfs3_compound_rsp_entry*);
+extern  bool_t xdr_gfs3_compound_rsp (XDR *, gfs3_compound_rsp*);
 
 #else /* K&R C */
 extern bool_t xdr_gf_statfs ();
@@ -1282,6 +1348,11 @@ extern bool_t xdr_gfs3_dirplist ();
 extern bool_t xdr_gfs3_readdirp_rsp ();
 extern bool_t xdr_gf_set_lk_ver_rsp ();
 extern bool_t xdr_gf_set_lk_ver_req ();
+extern bool_t xdr_gfs3_cbk_cache_invalidation_req ();
+extern bool_t xdr_gfs3_compound_req_entry ();
+extern bool_t xdr_gfs3_compound_req ();
+extern bool_t xdr_gfs3_compound_rsp_entry ();
+extern bool_t xdr_gfs3_compound_rsp ();
 
 #endif /* K&R C */
 
@@ -685,3 +685,47 @@ struct gf_set_lk_ver_req {
        string uid<>;
        int lk_ver;
 };
+
+struct gfs3_cbk_cache_invalidation_req {
+        opaque gfid[16];
+        unsigned int flags;
+};
+
+struct gfs3_compound_req_entry {
+        int op;
+        opaque gfid[16];
+        opaque pargfid[16];
+        hyper fd;
+        unsigned int flags;
+        unsigned int mode;
+        unsigned hyper offset;
+        unsigned int size;
+        string bname<>;
+        opaque dict<>;
+        struct gfs3_compound_req_entry *nextentry;
+};
+
+struct gfs3_compound_req {
+        struct gfs3_compound_req_entry *request;
+        opaque   xdata<>; /* Extra data */
+};
+
+struct gfs3_compound_rsp_entry {
+        int op;
+        int op_ret;
+        int op_errno;
+        unsigned hyper fd;
+        struct gf_iatt stat;
+        struct gf_iatt prestat;
+        struct gf_iatt poststat;
+        unsigned int size;
+        opaque dict<>;
+        struct gfs3_compound_rsp_entry *nextentry;
+};
+
+struct gfs3_compound_rsp {
+        int op_ret;
+        int op_errno;
+        struct gfs3_compound_rsp_entry *reply;
+        opaque   xdata<>; /* Extra data */
+};
@@ -649,19 +649,215 @@ out:
         return next_call_child;
 }
 
+int
+afr_read_policy_from_str (const char *str)
+{
+        if (!strcmp (str, "gfid-hash"))
+                return AFR_READ_POLICY_GFID_HASH;
+        if (!strcmp (str, "least-outstanding"))
+                return AFR_READ_POLICY_LEAST_OUTSTANDING;
+        if (!strcmp (str, "least-latency"))
+                return AFR_READ_POLICY_LEAST_LATENCY;
+
+        return AFR_READ_POLICY_STICKY;
+}
+
+static const char *
+afr_read_policy_str (afr_read_policy_t policy)
+{
+        switch (policy) {
+        case AFR_READ_POLICY_GFID_HASH:
+                return "gfid-hash";
+        case AFR_READ_POLICY_LEAST_OUTSTANDING:
+                return "least-outstanding";
+        case AFR_READ_POLICY_LEAST_LATENCY:
+                return "least-latency";
+        default:
+                return "sticky";
+        }
+}
+
+/* afr_read_policy_select ()
+ * Picks the child a read-type fop on @inode goes to, among the fresh children
+ * which are up, by the read-policy option. Returns -1 to leave it to the read
+ * child of the inode.
+ *
+ * gfid-hash spreads files over the children, the same way on every client.
+ * least-outstanding takes the child with the fewest reads in flight, and
+ * least-latency the one with the smallest average read latency times the
+ * reads in flight on it, so a slow child is still tried again once the
+ * others queue up. Both break ties by the gfid hash, a set read-subvolume
+ * overrides all of them. Unless @per_call, they fall back to gfid-hash:
+ * readdir carries offsets which only the child that gave them knows.
+ */
+static int32_t
+afr_read_policy_select (xlator_t *this, unsigned char *child_up,
+                        int32_t *fresh_children, inode_t *inode,
+                        gf_boolean_t per_call)
+{
+        afr_private_t    *priv      = NULL;
+        afr_read_stats_t *stats     = NULL;
+        uint32_t          hash      = 0;
+        uint64_t          score     = 0;
+        uint64_t          min_score = 0;
+        int32_t           child     = -1;
+        int32_t           selected  = -1;
+        int               count     = 0;
+        int               nth       = 0;
+        int               rank      = 0;
+        int               min_rank  = 0;
+        int               i         = 0;
+        int               policy    = 0;
+
+        priv = this->private;
+
+        policy = priv->read_policy;
+        if (policy == AFR_READ_POLICY_STICKY)
+                goto out;
+
+        if (!per_call)
+                policy = AFR_READ_POLICY_GFID_HASH;
+
+        if ((priv->read_child >= 0) && child_up[priv->read_child] &&
+            afr_is_child_present (fresh_children, priv->child_count,
+                                  priv->read_child)) {
+                selected = priv->read_child;
+                goto out;
+        }
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (fresh_children[i] == -1)
+                        break;
+                if (child_up[fresh_children[i]])
+                        count++;
+        }
+        if (count == 0)
+                goto out;
+
+        if (inode && !uuid_is_null (inode->gfid))
+                hash = (inode->gfid[12] << 24) | (inode->gfid[13] << 16) |
+                        (inode->gfid[14] << 8) | inode->gfid[15];
+        hash %= count;
+
+        LOCK (&priv->read_child_lock);
+        {
+                for (i = 0; i < priv->child_count; i++) {
+                        child = fresh_children[i];
+                        if (child == -1)
+                                break;
+                        if (!child_up[child])
+                                continue;
+
+                        /* the up fresh child at the hash comes first */
+                        rank = (nth++ + priv->child_count - hash) %
+                                priv->child_count;
+
+                        stats = &priv->read_stats[child];
+                        switch (policy) {
+                        case AFR_READ_POLICY_LEAST_OUTSTANDING:
+                                score = stats->outstanding;
+                                break;
+                        case AFR_READ_POLICY_LEAST_LATENCY:
+                                score = (stats->latency_ewma + 1) *
+                                        (stats->outstanding + 1);
+                                break;
+                        default:
+                                score = 0;
+                                break;
+                        }
+
+                        if ((selected == -1) || (score < min_score) ||
+                            ((score == min_score) && (rank < min_rank))) {
+                                selected  = child;
+                                min_score = score;
+                                min_rank  = rank;
+                        }
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+
+out:
+        return selected;
+}
+
+/* afr_read_stats_begin () and afr_read_stats_end () account a readv wound to
+ * @child in read_stats, for the statedump and the read-policy. */
+void
+afr_read_stats_begin (xlator_t *this, afr_local_t *local, int32_t child)
+{
+        afr_private_t *priv = NULL;
+
+        priv = this->private;
+
+        LOCK (&priv->read_child_lock);
+        {
+                priv->read_stats[child].reads++;
+                priv->read_stats[child].outstanding++;
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        local->read_stats_child = child;
+        gettimeofday (&local->read_stats_start, NULL);
+}
+
+void
+afr_read_stats_end (xlator_t *this, afr_local_t *local, int32_t op_ret)
+{
+        afr_private_t    *priv    = NULL;
+        afr_read_stats_t *stats   = NULL;
+        struct timeval    now     = {0, };
+        int64_t           latency = 0;
+
+        if (!local->read_stats_start.tv_sec)
+                return;
+
+        priv = this->private;
+
+        gettimeofday (&now, NULL);
+        latency = (now.tv_sec - local->read_stats_start.tv_sec) * 1000000 +
+                (now.tv_usec - local->read_stats_start.tv_usec);
+        if (latency < 0)
+                latency = 0;
+
+        stats = &priv->read_stats[local->read_stats_child];
+
+        LOCK (&priv->read_child_lock);
+        {
+                stats->outstanding--;
+                if (op_ret < 0) {
+                        stats->errors++;
+                } else {
+                        stats->latency_total += latency;
+                        if (latency > stats->latency_max)
+                                stats->latency_max = latency;
+                        if (stats->latency_ewma)
+                                stats->latency_ewma = (stats->latency_ewma * 7
+                                                       + latency) / 8;
+                        else
+                                stats->latency_ewma = latency;
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        memset (&local->read_stats_start, 0,
+                sizeof (local->read_stats_start));
+}
+
  /* This function should not be called with the inode's read_children array.
  * The fop's handler should make a copy of the inode's read_children,
  * preferred read_child into the local vars, because while this function is
  * in execution there is a chance for inode's read_ctx to change.
  */
-int32_t
-afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
-                    int32_t *fresh_children,
-                    int32_t *call_child, int32_t *last_index)
+static int32_t
+afr_call_child_select (xlator_t *this, unsigned char *child_up,
+                       int32_t read_child, int32_t *fresh_children,
+                       inode_t *inode, gf_boolean_t per_call,
+                       int32_t *call_child, int32_t *last_index)
 {
         int             ret   = 0;
         afr_private_t   *priv = NULL;
         int             i     = 0;
+        int32_t         child = -1;
 
         GF_ASSERT (child_up);
         GF_ASSERT (call_child);
@@ -673,6 +869,11 @@ afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
         *call_child = -1;
         *last_index = -1;
 
+        child = afr_read_policy_select (this, child_up, fresh_children, inode,
+                                        per_call);
+        if (child >= 0)
+                read_child = child;
+
         if (child_up[read_child]) {
                 *call_child = read_child;
         } else {
@@ -699,6 +900,30 @@ out:
         return ret;
 }
 
+/* The child an inode read fop goes to, chosen anew for every call. */
+int32_t
+afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
+                    int32_t *fresh_children, inode_t *inode,
+                    int32_t *call_child, int32_t *last_index)
+{
+        return afr_call_child_select (this, child_up, read_child,
+                                      fresh_children, inode, _gf_true,
+                                      call_child, last_index);
+}
+
+/* The child a readdir(p) goes to: the same for all the calls on a directory
+ * as long as the children up stay the same, whatever the read-policy. */
+int32_t
+afr_get_readdir_call_child (xlator_t *this, unsigned char *child_up,
+                            int32_t read_child, int32_t *fresh_children,
+                            inode_t *inode, int32_t *call_child,
+                            int32_t *last_index)
+{
+        return afr_call_child_select (this, child_up, read_child,
+                                      fresh_children, inode, _gf_false,
+                                      call_child, last_index);
+}
+
 void
 afr_reset_xattr (dict_t **xattr, unsigned int child_count)
 {
@@ -2334,6 +2559,10 @@ afr_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
 
         priv = this->private;
 
+        /* sends the held post-op, without waiting for it, the pre-op
+           still marks the file until it is done */
+        afr_delayed_changelog_wake (this, fd);
+
         transaction_frame = copy_frame (frame);
         if (!transaction_frame) {
                 op_errno = ENOMEM;
@@ -2525,6 +2754,8 @@ afr_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd,
 
         priv = this->private;
 
+        afr_delayed_changelog_wake (this, fd);
+
         AFR_LOCAL_ALLOC_OR_GOTO (frame->local, out);
         local = frame->local;
 
@@ -2842,6 +3073,8 @@ afr_inodelk (call_frame_t *frame, xlator_t *this,
 
         priv = this->private;
 
+        afr_delayed_changelog_wake_inode (this, loc->inode, NULL);
+
         AFR_LOCAL_ALLOC_OR_GOTO (frame->local, out);
         local = frame->local;
 
@@ -2917,6 +3150,8 @@ afr_finodelk (call_frame_t *frame, xlator_t *this,
 
         priv = this->private;
 
+        afr_delayed_changelog_wake_inode (this, fd->inode, NULL);
+
         AFR_LOCAL_ALLOC_OR_GOTO (frame->local, out);
         local = frame->local;
 
@@ -3327,6 +3562,8 @@ afr_lk (call_frame_t *frame, xlator_t *this,
 
         priv = this->private;
 
+        afr_delayed_changelog_wake_inode (this, fd->inode, NULL);
+
         AFR_LOCAL_ALLOC_OR_GOTO (frame->local, out);
         local = frame->local;
 
@@ -3386,6 +3623,8 @@ afr_priv_dump (xlator_t *this)
         char  key_prefix[GF_DUMP_MAX_BUF_LEN];
         char  key[GF_DUMP_MAX_BUF_LEN];
         int   i = 0;
+        afr_read_stats_t *stats = NULL;
+        uint64_t completed = 0;
 
 
         GF_ASSERT (this);
@@ -3409,6 +3648,41 @@ afr_priv_dump (xlator_t *this)
         gf_proc_dump_write("metadata_change_log", "%d", priv->metadata_change_log);
         gf_proc_dump_write("entry-change_log", "%d", priv->entry_change_log);
         gf_proc_dump_write("read_child", "%d", priv->read_child);
+        gf_proc_dump_write("read_policy", "%s",
+                           afr_read_policy_str (priv->read_policy));
+        LOCK (&priv->read_child_lock);
+        for (i = 0; priv->read_stats && (i < priv->child_count); i++) {
+                stats = &priv->read_stats[i];
+                sprintf (key, "child[%d].reads", i);
+                gf_proc_dump_write (key, "%"PRIu64, stats->reads);
+                sprintf (key, "child[%d].read_errors", i);
+                gf_proc_dump_write (key, "%"PRIu64, stats->errors);
+                sprintf (key, "child[%d].reads_outstanding", i);
+                gf_proc_dump_write (key, "%d", stats->outstanding);
+                sprintf (key, "child[%d].read_latency_avg_usec", i);
+                completed = stats->reads - stats->errors - stats->outstanding;
+                gf_proc_dump_write (key, "%"PRIu64, completed ?
+                                    stats->latency_total / completed : 0);
+                sprintf (key, "child[%d].read_latency_ewma_usec", i);
+                gf_proc_dump_write (key, "%"PRIu64, stats->latency_ewma);
+                sprintf (key, "child[%d].read_latency_max_usec", i);
+                gf_proc_dump_write (key, "%"PRIu64, stats->latency_max);
+        }
+        UNLOCK (&priv->read_child_lock);
+        gf_proc_dump_write("post_op_delay_secs", "%u",
+                           priv->post_op_delay_secs);
+        LOCK (&priv->lock);
+        {
+                gf_proc_dump_write ("pre_op_xattrops", "%"PRIu64,
+                                    priv->pre_op_xattrops);
+                gf_proc_dump_write ("post_op_xattrops", "%"PRIu64,
+                                    priv->post_op_xattrops);
+                gf_proc_dump_write ("post_ops_delayed", "%"PRIu64,
+                                    priv->post_ops_delayed);
+                gf_proc_dump_write ("post_ops_held", "%d",
+                                    priv->post_ops_held);
+        }
+        UNLOCK (&priv->lock);
         gf_proc_dump_write("favorite_child", "%d", priv->favorite_child);
         gf_proc_dump_write("wait_count", "%u", priv->wait_count);
 
@@ -3461,6 +3735,10 @@ afr_notify (xlator_t *this, int32_t event,
         if (!priv)
                 return 0;
 
+        /* not from a child: 'data' is the invalidation itself */
+        if (event == GF_EVENT_UPCALL)
+                return default_notify (this, event, data);
+
         had_heard_from_all = 1;
         for (i = 0; i < priv->child_count; i++) {
                 if (!priv->last_event[i]) {
@@ -4007,6 +4285,7 @@ afr_priv_destroy (afr_private_t *priv)
                 eh_destroy (priv->shd.split_brain);
 
         GF_FREE (priv->last_event);
+        GF_FREE (priv->read_stats);
         if (priv->pending_key) {
                 for (i = 0; i < priv->child_count; i++)
                         GF_FREE (priv->pending_key[i]);
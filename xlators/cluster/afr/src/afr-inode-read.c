@@ -142,6 +142,7 @@ afr_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask)
                                              local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     loc->inode,
                                      &call_child,
                                      &local->cont.access.last_index);
         if (ret < 0) {
@@ -256,6 +257,7 @@ afr_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
                                              local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     loc->inode,
                                      &call_child,
                                      &local->cont.stat.last_index);
         if (ret < 0) {
@@ -374,6 +376,7 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
 
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     fd->inode,
                                      &call_child,
                                      &local->cont.fstat.last_index);
         if (ret < 0) {
@@ -491,6 +494,7 @@ afr_readlink (call_frame_t *frame, xlator_t *this,
                                              local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     loc->inode,
                                      &call_child,
                                      &local->cont.readlink.last_index);
         if (ret < 0) {
@@ -1067,6 +1071,7 @@ afr_getxattr (call_frame_t *frame, xlator_t *this,
         read_child = afr_inode_get_read_ctx (this, loc->inode, local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     loc->inode,
                                      &call_child,
                                      &local->cont.getxattr.last_index);
         if (ret < 0) {
@@ -1196,6 +1201,7 @@ afr_fgetxattr (call_frame_t *frame, xlator_t *this,
         read_child = afr_inode_get_read_ctx (this, fd->inode, local->fresh_children);
         op_ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     fd->inode,
                                      &call_child,
                                      &local->cont.getxattr.last_index);
         if (op_ret < 0) {
@@ -1228,8 +1234,8 @@ out:
  *
  * if the user has specified a read subvolume, use it
  * otherwise -
- *   use the inode number to hash it to one of the subvolumes, and
- *   read from there (to balance read load)
+ *   pick one of the fresh subvolumes by the read-policy option (the read
+ *   child of the inode by default), and read from there
  *
  * if any of the above read's fail, try the children in sequence
  * beginning at the beginning
@@ -1263,6 +1269,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_read_stats_end (this, local, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.readv.last_index;
                 fresh_children = local->fresh_children;
@@ -1275,6 +1283,7 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_read_stats_begin (this, local, next_call_child);
                 STACK_WIND_COOKIE (frame, afr_readv_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1330,6 +1339,7 @@ afr_readv (call_frame_t *frame, xlator_t *this,
         read_child = afr_inode_get_read_ctx (this, fd->inode, local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     fd->inode,
                                      &call_child,
                                      &local->cont.readv.last_index);
         if (ret < 0) {
@@ -1348,6 +1358,8 @@ afr_readv (call_frame_t *frame, xlator_t *this,
                 op_errno = -ret;
                 goto out;
         }
+
+        afr_read_stats_begin (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_readv_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -769,10 +769,138 @@ out:
         return 0;
 }
 
+static int
+sh_diff_checksum_set (call_frame_t *sh_frame, xlator_t *this,
+                      const char *algo, fop_fsetxattr_cbk_t cbk)
+{
+        afr_private_t           *priv       = NULL;
+        afr_local_t             *local      = NULL;
+        afr_self_heal_t         *sh         = NULL;
+        dict_t                  *dict       = NULL;
+        int                     call_count  = 0;
+        int                     i           = 0;
+        int                     ret         = -1;
+
+        priv  = this->private;
+        local = sh_frame->local;
+        sh    = &local->self_heal;
+
+        dict = dict_new ();
+        if (!dict)
+                goto out;
+
+        ret = dict_set_str (dict, GF_XATTR_RCHECKSUM_KEY, (char *) algo);
+        if (ret)
+                goto out;
+
+        call_count = sh->active_sinks + 1;  /* sinks and source */
+
+        local->call_count = call_count;
+
+        STACK_WIND_COOKIE (sh_frame, cbk, (void *) (long) sh->source,
+                           priv->children[sh->source],
+                           priv->children[sh->source]->fops->fsetxattr,
+                           sh->healing_fd, dict, 0);
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (sh->sources[i] || !local->child_up[i])
+                        continue;
+
+                STACK_WIND_COOKIE (sh_frame, cbk, (void *) (long) i,
+                                   priv->children[i],
+                                   priv->children[i]->fops->fsetxattr,
+                                   sh->healing_fd, dict, 0);
+
+                if (!--call_count)
+                        break;
+        }
+out:
+        if (dict)
+                dict_unref (dict);
+
+        return ret;
+}
+
+static int
+sh_diff_checksum_reset_cbk (call_frame_t *sh_frame, void *cookie,
+                            xlator_t *this, int32_t op_ret, int32_t op_errno)
+{
+        int                     call_count  = 0;
+
+        call_count = afr_frame_return (sh_frame);
+
+        if (call_count == 0)
+                afr_sh_start_loops (sh_frame, this, sh_diff_checksum);
+
+        return 0;
+}
+
+static int
+sh_diff_checksum_offer_cbk (call_frame_t *sh_frame, void *cookie,
+                            xlator_t *this, int32_t op_ret, int32_t op_errno)
+{
+        afr_private_t           *priv        = NULL;
+        afr_local_t             *local       = NULL;
+        afr_self_heal_t         *sh          = NULL;
+        int                     child_index  = 0;
+        int                     call_count   = 0;
+
+        priv  = this->private;
+        local = sh_frame->local;
+        sh    = &local->self_heal;
+
+        child_index = (long) cookie;
+
+        if (op_ret < 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "subvolume %s refused %s checksums for %s (%s)",
+                        priv->children[child_index]->name,
+                        priv->data_self_heal_checksum, local->loc.path,
+                        strerror (op_errno));
+
+                LOCK (&sh_frame->lock);
+                {
+                        sh->checksum_refused = _gf_true;
+                }
+                UNLOCK (&sh_frame->lock);
+        }
+
+        call_count = afr_frame_return (sh_frame);
+
+        if (call_count)
+                return 0;
+
+        if (!sh->checksum_refused) {
+                afr_sh_start_loops (sh_frame, this, sh_diff_checksum);
+                return 0;
+        }
+
+        /* the subvolumes which took it must agree with those on md5 */
+        gf_log (this->name, GF_LOG_INFO,
+                "using md5 checksums to self-heal %s", local->loc.path);
+
+        if (sh_diff_checksum_set (sh_frame, this, "md5",
+                                  sh_diff_checksum_reset_cbk))
+                afr_sh_start_loops (sh_frame, this, sh_diff_checksum);
+
+        return 0;
+}
+
 int
 afr_sh_algo_diff (call_frame_t *sh_frame, xlator_t *this)
 {
-        afr_sh_start_loops (sh_frame, this, sh_diff_checksum);
+        afr_private_t           *priv       = NULL;
+
+        priv = this->private;
+
+        /* bricks compute md5 unless the healing fd is told otherwise */
+        if (!priv->data_self_heal_checksum ||
+            !strcmp (priv->data_self_heal_checksum, "md5") ||
+            sh_diff_checksum_set (sh_frame, this,
+                                  priv->data_self_heal_checksum,
+                                  sh_diff_checksum_offer_cbk))
+                afr_sh_start_loops (sh_frame, this, sh_diff_checksum);
+
         return 0;
 }
 
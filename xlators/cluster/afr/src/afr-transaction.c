@@ -156,33 +156,6 @@ out:
 }
 
 
-static void
-__mark_pre_op_undone_on_fd (call_frame_t *frame, xlator_t *this, int child_index)
-{
-        afr_local_t   *local = NULL;
-        afr_fd_ctx_t  *fd_ctx = NULL;
-
-        local = frame->local;
-
-        if (!local->fd)
-                return;
-
-        fd_ctx = afr_fd_ctx_get (local->fd, this);
-
-        if (!fd_ctx)
-                goto out;
-
-        LOCK (&local->fd->lock);
-        {
-                if (local->transaction.type == AFR_DATA_TRANSACTION)
-                        fd_ctx->pre_op_done[child_index]--;
-        }
-        UNLOCK (&local->fd->lock);
-out:
-        return;
-}
-
-
 static void
 __mark_down_children (int32_t *pending[], int child_count,
                       unsigned char *child_up, afr_transaction_type type)
@@ -371,6 +344,14 @@ afr_changelog_post_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         local    = frame->local;
         int_lock = &local->internal_lock;
 
+        if (op_ret != 1) {
+                LOCK (&priv->lock);
+                {
+                        priv->post_op_xattrops++;
+                }
+                UNLOCK (&priv->lock);
+        }
+
         LOCK (&frame->lock);
         {
                 call_count = --local->call_count;
@@ -499,8 +480,8 @@ afr_changelog_post_op_call_count (afr_transaction_type type,
         return call_count;
 }
 
-int
-afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
+static int
+afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
 {
         afr_private_t * priv = this->private;
         afr_internal_lock_t *int_lock = NULL;
@@ -587,12 +568,19 @@ afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
                                 break;
                         }
 
+                        /* a piggybacked post-op (even one which has to
+                           mark a failure) leaves the pre-op in place for
+                           the others, only the last one out takes it back,
+                           in the same critical section so that no pre-op
+                           can piggyback on one about to be undone */
                         LOCK (&local->fd->lock);
                         {
                                 piggyback = 0;
                                 if (fdctx->pre_op_piggyback[i]) {
                                         fdctx->pre_op_piggyback[i]--;
                                         piggyback = 1;
+                                } else {
+                                        fdctx->pre_op_done[i]--;
                                 }
                         }
                         UNLOCK (&local->fd->lock);
@@ -606,7 +594,6 @@ afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
                                 afr_changelog_post_op_cbk (frame, (void *)(long)i,
                                                            this, 1, 0, xattr[i]);
                         } else {
-                                __mark_pre_op_undone_on_fd (frame, this, i);
                                 STACK_WIND_COOKIE (frame,
                                                    afr_changelog_post_op_cbk,
                                                    (void *) (long) i,
@@ -709,6 +696,272 @@ out:
 }
 
 
+/* {{{ delayed post-op */
+
+/*
+ * With post-op-delay-secs the post-op of a write which went fine on every
+ * child is held: the frame stays parked on the fd, keeping its pre-op and
+ * its eager lock. The next write on the fd piggybacks on both, and when it
+ * gets to its post-op it takes the parked slot and sends the post-op of the
+ * frame it replaces, which finds the piggyback and only drops it. A burst of
+ * writes thus costs one pre-op and one post-op per child. The post-op of the
+ * parked frame is sent when the timer armed by the first of the burst fires,
+ * or when afr_delayed_changelog_wake () is called (fsync, flush, lock
+ * requests, transactions through other fds of the inode).
+ */
+
+static gf_boolean_t
+afr_changelog_post_op_delayable (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv  = NULL;
+        afr_local_t   *local = NULL;
+        int            index = 0;
+        int            i     = 0;
+
+        priv  = this->private;
+        local = frame->local;
+
+        if (!priv->post_op_delay_secs || !local->fd ||
+            (local->op != GF_FOP_WRITE) ||
+            (local->transaction.type != AFR_DATA_TRANSACTION))
+                return _gf_false;
+
+        index = afr_index_for_transaction_type (local->transaction.type);
+
+        for (i = 0; i < priv->child_count; i++) {
+                /* a failure has to be marked right away */
+                if (!local->child_up[i] || !local->transaction.pre_op[i] ||
+                    !local->pending[i][index])
+                        return _gf_false;
+
+                /* and the lock has to stay with the fd */
+                if (!local->transaction.eager_lock ||
+                    !local->transaction.eager_lock[i])
+                        return _gf_false;
+        }
+
+        return _gf_true;
+}
+
+
+/* a parked frame was taken off its fd to have its post-op sent */
+static void
+afr_delayed_changelog_unparked (xlator_t *this)
+{
+        afr_private_t *priv = NULL;
+
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                priv->post_ops_held--;
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+static void
+afr_delayed_changelog_timer_cbk (void *data)
+{
+        fd_t          *fd     = NULL;
+        xlator_t      *this   = NULL;
+        afr_fd_ctx_t  *fd_ctx = NULL;
+        call_frame_t  *frame  = NULL;
+        gf_timer_t    *timer  = NULL;
+
+        fd   = data;
+        this = THIS;
+
+        fd_ctx = afr_fd_ctx_get (fd, this);
+        if (!fd_ctx)
+                goto out;
+
+        LOCK (&fd->lock);
+        {
+                timer = fd_ctx->delay_timer;
+                fd_ctx->delay_timer = NULL;
+
+                frame = fd_ctx->delay_frame;
+                fd_ctx->delay_frame = NULL;
+        }
+        UNLOCK (&fd->lock);
+
+        /* frees the event, which has already fired */
+        if (timer)
+                gf_timer_call_cancel (this->ctx, timer);
+
+        if (frame) {
+                afr_delayed_changelog_unparked (this);
+                afr_changelog_post_op_now (frame, this);
+        }
+out:
+        fd_unref (fd);
+}
+
+
+/*
+ * Parks @frame on its fd. Returns 0 and the frame parked before it (if any)
+ * in @prev, whose post-op is now for the caller to send, or -1 if the
+ * post-op of @frame cannot be held.
+ */
+static int
+afr_delayed_changelog_park (call_frame_t *frame, xlator_t *this,
+                            call_frame_t **prev)
+{
+        afr_private_t  *priv   = NULL;
+        afr_local_t    *local  = NULL;
+        afr_fd_ctx_t   *fd_ctx = NULL;
+        fd_t           *fd     = NULL;
+        gf_timer_t     *timer  = NULL;
+        struct timeval  delta  = {0, };
+        int             ret    = -1;
+
+        priv  = this->private;
+        local = frame->local;
+        fd    = local->fd;
+
+        fd_ctx = afr_fd_ctx_get (fd, this);
+        if (!fd_ctx)
+                goto out;
+
+        delta.tv_sec = priv->post_op_delay_secs;
+
+        /* the timer keeps its own ref, it is not cancelled when the parked
+           frame goes early, it just finds nothing to do */
+        fd_ref (fd);
+
+        LOCK (&fd->lock);
+        {
+                if (!fd_ctx->delay_timer) {
+                        timer = gf_timer_call_after (this->ctx, delta,
+                                        afr_delayed_changelog_timer_cbk, fd);
+                        if (!timer)
+                                goto unlock;
+                        fd_ctx->delay_timer = timer;
+                }
+
+                *prev = fd_ctx->delay_frame;
+                fd_ctx->delay_frame = frame;
+                ret = 0;
+        }
+unlock:
+        UNLOCK (&fd->lock);
+
+        if (!timer)
+                fd_unref (fd);
+out:
+        return ret;
+}
+
+
+/* goes by the parked frames rather than by post-op-delay-secs, which can
+   have been turned off since they were parked */
+void
+afr_delayed_changelog_wake (xlator_t *this, fd_t *fd)
+{
+        afr_fd_ctx_t  *fd_ctx = NULL;
+        call_frame_t  *frame  = NULL;
+
+        if (!fd)
+                return;
+
+        fd_ctx = afr_fd_ctx_get (fd, this);
+        if (!fd_ctx)
+                return;
+
+        LOCK (&fd->lock);
+        {
+                frame = fd_ctx->delay_frame;
+                fd_ctx->delay_frame = NULL;
+        }
+        UNLOCK (&fd->lock);
+
+        if (frame) {
+                afr_delayed_changelog_unparked (this);
+                afr_changelog_post_op_now (frame, this);
+        }
+}
+
+
+void
+afr_delayed_changelog_wake_inode (xlator_t *this, inode_t *inode, fd_t *skip)
+{
+        afr_private_t  *priv  = NULL;
+        fd_t           *iter  = NULL;
+        fd_t          **fds   = NULL;
+        int             count = 0;
+        int             i     = 0;
+
+        priv = this->private;
+
+        /* unlocked, a frame parked meanwhile is sent by its timer */
+        if (!priv->post_ops_held || !inode)
+                return;
+
+        LOCK (&inode->lock);
+        {
+                list_for_each_entry (iter, &inode->fd_list, inode_list) {
+                        if (iter != skip)
+                                count++;
+                }
+
+                if (count)
+                        fds = GF_CALLOC (count, sizeof (*fds),
+                                         gf_afr_mt_fd_t);
+                if (fds) {
+                        count = 0;
+                        list_for_each_entry (iter, &inode->fd_list,
+                                             inode_list) {
+                                if (iter != skip)
+                                        fds[count++] = __fd_ref (iter);
+                        }
+                }
+        }
+        UNLOCK (&inode->lock);
+
+        if (!fds)
+                return;
+
+        for (i = 0; i < count; i++) {
+                afr_delayed_changelog_wake (this, fds[i]);
+                fd_unref (fds[i]);
+        }
+
+        GF_FREE (fds);
+}
+
+
+int
+afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv = NULL;
+        call_frame_t  *prev = NULL;
+
+        priv = this->private;
+
+        if (!afr_changelog_post_op_delayable (frame, this) ||
+            afr_delayed_changelog_park (frame, this, &prev))
+                return afr_changelog_post_op_now (frame, this);
+
+        LOCK (&priv->lock);
+        {
+                priv->post_ops_delayed++;
+                /* @frame takes the place of @prev */
+                if (!prev)
+                        priv->post_ops_held++;
+        }
+        UNLOCK (&priv->lock);
+
+        /* piggybacks on the pre-op of @frame */
+        if (prev)
+                afr_changelog_post_op_now (prev, this);
+
+        return 0;
+}
+
+/* }}} */
+
+
 int32_t
 afr_changelog_pre_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                           int32_t op_ret, int32_t op_errno, dict_t *xattr)
@@ -720,6 +973,14 @@ afr_changelog_pre_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (op_ret != 1) {
+                LOCK (&priv->lock);
+                {
+                        priv->pre_op_xattrops++;
+                }
+                UNLOCK (&priv->lock);
+        }
+
         LOCK (&frame->lock);
         {
                 switch (op_ret) {
@@ -1258,6 +1519,14 @@ afr_transaction (call_frame_t *frame, xlator_t *this, afr_transaction_type type)
 
         afr_transaction_local_init (local, this);
 
+        /* the held post-op of another fd keeps its eager lock */
+        if ((type == AFR_DATA_TRANSACTION) ||
+            (type == AFR_METADATA_TRANSACTION))
+                afr_delayed_changelog_wake_inode (this, local->fd ?
+                                                  local->fd->inode :
+                                                  local->loc.inode,
+                                                  local->fd);
+
         local->transaction.resume = afr_transaction_resume;
         local->transaction.type   = type;
 
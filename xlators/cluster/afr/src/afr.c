@@ -119,6 +119,7 @@ reconfigure (xlator_t *this, dict_t *options)
         int            ret         = -1;
         int            index       = -1;
         char          *qtype       = NULL;
+        char          *read_policy = NULL;
 
         priv = this->private;
 
@@ -154,6 +155,9 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("data-self-heal-algorithm",
                           priv->data_self_heal_algorithm, options, str, out);
 
+        GF_OPTION_RECONF ("data-self-heal-checksum",
+                          priv->data_self_heal_checksum, options, str, out);
+
         GF_OPTION_RECONF ("self-heal-daemon", priv->shd.enabled, options, bool, out);
 
         GF_OPTION_RECONF ("read-subvolume", read_subvol, options, xlator, out);
@@ -168,7 +172,12 @@ reconfigure (xlator_t *this, dict_t *options)
                 priv->read_child = index;
         }
 
+        GF_OPTION_RECONF ("read-policy", read_policy, options, str, out);
+        priv->read_policy = afr_read_policy_from_str (read_policy);
+
         GF_OPTION_RECONF ("eager-lock", priv->eager_lock, options, bool, out);
+        GF_OPTION_RECONF ("post-op-delay-secs", priv->post_op_delay_secs,
+                          options, uint32, out);
         GF_OPTION_RECONF ("quorum-type", qtype, options, str, out);
         GF_OPTION_RECONF ("quorum-count", priv->quorum_count, options,
                           uint32, out);
@@ -202,6 +211,7 @@ init (xlator_t *this)
         xlator_t      *read_subvol = NULL;
         xlator_t      *fav_child   = NULL;
         char          *qtype       = NULL;
+        char          *read_policy = NULL;
 
         if (!this->children) {
                 gf_log (this->name, GF_LOG_ERROR,
@@ -244,6 +254,9 @@ init (xlator_t *this)
                 }
         }
 
+        GF_OPTION_INIT ("read-policy", read_policy, str, out);
+        priv->read_policy = afr_read_policy_from_str (read_policy);
+
         priv->favorite_child = -1;
         GF_OPTION_INIT ("favorite-child", fav_child, xlator, out);
         if (fav_child) {
@@ -267,6 +280,9 @@ init (xlator_t *this)
         GF_OPTION_INIT ("data-self-heal-algorithm",
                         priv->data_self_heal_algorithm, str, out);
 
+        GF_OPTION_INIT ("data-self-heal-checksum",
+                        priv->data_self_heal_checksum, str, out);
+
         GF_OPTION_INIT ("data-self-heal-window-size",
                         priv->data_self_heal_window_size, uint32, out);
 
@@ -296,6 +312,8 @@ init (xlator_t *this)
         GF_OPTION_INIT ("strict-readdir", priv->strict_readdir, bool, out);
 
         GF_OPTION_INIT ("eager-lock", priv->eager_lock, bool, out);
+        GF_OPTION_INIT ("post-op-delay-secs", priv->post_op_delay_secs,
+                        uint32, out);
         GF_OPTION_INIT ("quorum-type", qtype, str, out);
         GF_OPTION_INIT ("quorum-count", priv->quorum_count, uint32, out);
         fix_quorum_options(this,priv,qtype);
@@ -357,6 +375,13 @@ init (xlator_t *this)
                 goto out;
         }
 
+        priv->read_stats = GF_CALLOC (child_count, sizeof (*priv->read_stats),
+                                      gf_afr_mt_read_stats_t);
+        if (!priv->read_stats) {
+                ret = -ENOMEM;
+                goto out;
+        }
+
         /* keep more local here as we may need them for self-heal etc */
         this->local_pool = mem_pool_new (afr_local_t, 512);
         if (!this->local_pool) {
@@ -505,6 +530,24 @@ struct volume_options options[] = {
         { .key  = {"read-subvolume" },
           .type = GF_OPTION_TYPE_XLATOR
         },
+        { .key  = {"read-policy"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = { "sticky", "gfid-hash", "least-outstanding",
+                     "least-latency" },
+          .default_value = "sticky",
+          .description = "Which subvolume serves reads when read-subvolume "
+                         "is not set. \"sticky\" reads a file from the one "
+                         "picked when it was looked up, \"gfid-hash\" "
+                         "spreads files over the subvolumes by their gfid, "
+                         "the same on every client. \"least-outstanding\" "
+                         "sends each read to the subvolume with the fewest "
+                         "reads in flight, \"least-latency\" to the one "
+                         "with the smallest recent read latency weighted by "
+                         "its reads in flight. Only the inode read fops are "
+                         "balanced per call, readdir of a directory stays on "
+                         "one subvolume (by gfid) with every policy but "
+                         "sticky."
+        },
         { .key  = {"favorite-child"},
           .type = GF_OPTION_TYPE_XLATOR
         },
@@ -531,6 +574,16 @@ struct volume_options options[] = {
                            "with those of source.",
           .value = { "diff", "full", "" }
         },
+        { .key  = {"data-self-heal-checksum"},
+          .type = GF_OPTION_TYPE_STR,
+          .default_value = "md5",
+          .description   = "Strong checksum the \"diff\" algorithm compares "
+                           "blocks with. \"murmur3\" costs the bricks a "
+                           "fraction of the CPU time of \"md5\". Heals fall "
+                           "back to \"md5\" when a brick does not support "
+                           "the one selected.",
+          .value = { "md5", "murmur3" }
+        },
         { .key  = {"data-self-heal-window-size"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 1,
@@ -579,6 +632,19 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "off",
         },
+        { .key = {"post-op-delay-secs"},
+          .type = GF_OPTION_TYPE_INT,
+          .min = 0,
+          .max = 60,
+          .default_value = "0",
+          .description = "Hold the changelog post-op of a write which "
+                         "succeeded on all bricks for up to this many "
+                         "seconds, so that the following writes on the "
+                         "file descriptor need neither pre-op nor post-op. "
+                         "It is sent on fsync, flush, a lock request or a "
+                         "change through another file descriptor of the "
+                         "file. Takes effect only with eager-lock on.",
+        },
         { .key = {"self-heal-daemon"},
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "off",
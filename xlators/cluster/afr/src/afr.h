@@ -107,12 +107,32 @@ typedef struct afr_self_heald_ {
         eh_t             *split_brain;
 } afr_self_heald_t;
 
+typedef enum {
+        AFR_READ_POLICY_STICKY = 0,       /* the read child of the inode */
+        AFR_READ_POLICY_GFID_HASH,
+        AFR_READ_POLICY_LEAST_OUTSTANDING,
+        AFR_READ_POLICY_LEAST_LATENCY,
+} afr_read_policy_t;
+
+/* readv traffic of a child, under read_child_lock */
+typedef struct {
+        uint64_t reads;
+        uint64_t errors;
+        int32_t  outstanding;
+        uint64_t latency_total;   /* usec, of the completed reads */
+        uint64_t latency_max;
+        uint64_t latency_ewma;    /* usec, weight 1/8 to the latest read */
+} afr_read_stats_t;
+
 typedef struct _afr_private {
         gf_lock_t lock;               /* to guard access to child_count, etc */
         unsigned int child_count;     /* total number of children   */
 
         unsigned int read_child_rr;   /* round-robin index of the read_child */
-        gf_lock_t read_child_lock;    /* lock to protect above */
+        gf_lock_t read_child_lock;    /* lock to protect above and
+                                         read_stats */
+        afr_read_stats_t *read_stats; /* per child */
+        afr_read_policy_t read_policy;
 
         xlator_t **children;
 
@@ -125,6 +145,8 @@ typedef struct _afr_private {
 
         char         *data_self_heal;              /* on/off/open */
         char *       data_self_heal_algorithm;    /* name of algorithm */
+        char *       data_self_heal_checksum;     /* strong checksum of
+                                                     the diff algorithm */
         unsigned int data_self_heal_window_size;  /* max number of pipelined
                                                      read/writes */
 
@@ -158,6 +180,13 @@ typedef struct _afr_private {
         struct list_head saved_fds;   /* list of fds on which locks have succeeded */
         gf_boolean_t      optimistic_change_log;
         gf_boolean_t      eager_lock;
+        uint32_t          post_op_delay_secs; /* hold a write's post-op on
+                                                 the fd this long (needs
+                                                 eager_lock) */
+        uint64_t          pre_op_xattrops;   /* changelog xattrops sent, */
+        uint64_t          post_op_xattrops;  /* protected by lock */
+        uint64_t          post_ops_delayed;
+        int32_t           post_ops_held;     /* frames parked on fds now */
         unsigned int      quorum_count;
 
         char                   vol_uuid[UUID_SIZE + 1];
@@ -251,6 +280,7 @@ typedef struct {
         off_t offset;
         unsigned char *write_needed;
         uint8_t *checksum;
+        gf_boolean_t checksum_refused;
         afr_post_remove_call_t post_remove_call;
 
         loc_t parent_loc;
@@ -381,6 +411,8 @@ typedef struct _afr_local {
 
         unsigned int read_child_index;
         unsigned char read_child_returned;
+        int32_t read_stats_child;     /* child a readv is outstanding on, */
+        struct timeval read_stats_start; /* since then (zero if none) */
         unsigned int first_up_child;
 
         pid_t saved_pid;
@@ -721,6 +753,9 @@ typedef struct {
         unsigned int *lock_piggyback;
         unsigned int *lock_acquired;
 
+        call_frame_t *delay_frame; /* write whose post-op is held */
+        gf_timer_t   *delay_timer; /* sends it at the latest */
+
         int flags;
         int32_t wbflags;
         uint64_t up_count;   /* number of CHILD_UPs this fd has seen */
@@ -950,9 +985,30 @@ afr_set_read_ctx_from_policy (xlator_t *this, inode_t *inode,
 
 int32_t
 afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
-                    int32_t *fresh_children,
+                    int32_t *fresh_children, inode_t *inode,
                     int32_t *call_child, int32_t *last_index);
 
+int32_t
+afr_get_readdir_call_child (xlator_t *this, unsigned char *child_up,
+                            int32_t read_child, int32_t *fresh_children,
+                            inode_t *inode, int32_t *call_child,
+                            int32_t *last_index);
+
+int
+afr_read_policy_from_str (const char *str);
+
+void
+afr_read_stats_begin (xlator_t *this, afr_local_t *local, int32_t child);
+
+void
+afr_read_stats_end (xlator_t *this, afr_local_t *local, int32_t op_ret);
+
+void
+afr_delayed_changelog_wake (xlator_t *this, fd_t *fd);
+
+void
+afr_delayed_changelog_wake_inode (xlator_t *this, inode_t *inode, fd_t *skip);
+
 int32_t
 afr_next_call_child (int32_t *fresh_children, unsigned char *child_up,
                      size_t child_count, int32_t *last_index,
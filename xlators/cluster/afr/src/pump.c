@@ -1443,6 +1443,7 @@ pump_getxattr (call_frame_t *frame, xlator_t *this,
         read_child = afr_inode_get_read_ctx (this, loc->inode, local->fresh_children);
         ret = afr_get_call_child (this, local->child_up, read_child,
                                      local->fresh_children,
+                                     loc->inode,
                                      &call_child,
                                      &local->cont.getxattr.last_index);
         if (ret < 0) {
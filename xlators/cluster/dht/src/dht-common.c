@@ -2920,6 +2920,7 @@ dht_do_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 off_t yoff, int whichop, dict_t *dict)
 {
         dht_local_t  *local  = NULL;
+        dht_conf_t   *conf = NULL;
         int           op_errno = -1;
         xlator_t     *xvol = NULL;
         off_t         xoff = 0;
@@ -2958,6 +2959,12 @@ dht_do_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                                         " key");
                 }
 
+                conf = this->private;
+                if (conf->parallel_readdir &&
+                    (dht_parallel_readdirp (frame, this, xvol, yoff,
+                                            xoff) == 0))
+                        return 0;
+
                 STACK_WIND (frame, dht_readdirp_cbk, xvol, xvol->fops->readdirp,
                             fd, size, xoff, local->xattr);
         } else {
@@ -166,6 +166,16 @@ struct dht_local {
         glusterfs_fop_t      fop;
 
         struct dht_rebalance_ rebalance;
+
+        /* parallel readdirp prefetch */
+        struct {
+                int              idx;
+                uint32_t         gen;
+                off_t            off;
+                off_t            yoff;    /* as the client asked */
+                char             started;
+                struct list_head wait;    /* in dht_rdp_t's waiters */
+        } rdp;
 };
 typedef struct dht_local dht_local_t;
 
@@ -237,6 +247,8 @@ struct dht_conf {
         void          *private;     /* Can be used by wrapper xlators over
                                        dht */
         gf_boolean_t   use_readdirp;
+        gf_boolean_t   parallel_readdir;
+        uint64_t       readdir_prefetch;
         char           vol_uuid[UUID_SIZE + 1];
         gf_boolean_t   assert_no_child_down;
         time_t        *subvol_up_time;
@@ -526,6 +538,10 @@ int32_t dht_flush (call_frame_t *frame,
                    xlator_t *this,
                    fd_t     *fd);
 
+int32_t dht_compound (call_frame_t *frame,
+                      xlator_t *this,
+                      compound_args_t *args);
+
 int32_t dht_fsync (call_frame_t *frame,
                    xlator_t *this,
                    fd_t     *fd,
@@ -620,6 +636,9 @@ int32_t dht_fxattrop (call_frame_t *frame,
                       dict_t             *dict);
 
 int32_t dht_forget (xlator_t *this, inode_t *inode);
+int dht_releasedir (xlator_t *this, fd_t *fd);
+int dht_parallel_readdirp (call_frame_t *frame, xlator_t *this, xlator_t *xvol,
+                           off_t yoff, off_t xoff);
 int32_t dht_setattr (call_frame_t  *frame, xlator_t *this, loc_t *loc,
                      struct iatt   *stbuf, int32_t valid);
 int32_t dht_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
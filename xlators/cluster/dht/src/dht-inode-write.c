@@ -24,6 +24,7 @@
 #endif
 
 #include "dht-common.h"
+#include "compound-fop-utils.h"
 
 int dht_writev2 (xlator_t *this, call_frame_t *frame, int ret);
 int dht_truncate2 (xlator_t *this, call_frame_t *frame, int ret);
@@ -614,3 +615,101 @@ err:
 
         return 0;
 }
+
+
+
+/* A chain of writes and a flush on one fd, as write-behind sends it, goes to
+ * the cached subvolume as a whole, anything else is split into separate
+ * fops. A chain which finds the file being migrated is run once more as
+ * separate fops, which take the writes to the destination as well. Writing
+ * the same data at the same offsets again does no harm, chains on O_APPEND
+ * fds are never sent as a whole.
+ */
+static xlator_t *
+dht_compound_subvol (xlator_t *this, compound_args_t *args)
+{
+        compound_req_t *req = NULL;
+        fd_t           *fd  = NULL;
+        int             i   = 0;
+
+        for (i = 0; i < args->count; i++) {
+                req = &args->req[i];
+                if ((req->fop != GF_FOP_WRITE) && (req->fop != GF_FOP_FLUSH))
+                        return NULL;
+
+                if (!req->fd || (fd && (req->fd != fd)))
+                        return NULL;
+                fd = req->fd;
+        }
+
+        if (!fd || (fd->flags & O_APPEND))
+                return NULL;
+
+        /* open on the destination of a migration as well */
+        if (fd_ctx_get (fd, this, NULL) == 0)
+                return NULL;
+
+        return dht_subvol_get_cached (this, fd->inode);
+}
+
+
+int
+dht_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int op_ret, int op_errno, compound_args_cbk_t *args_cbk)
+{
+        compound_args_t *args = NULL;
+        compound_rsp_t  *rsp  = NULL;
+        int              i    = 0;
+
+        args = cookie;
+
+        if (!args_cbk)
+                goto out;
+
+        for (i = 0; i < args_cbk->count; i++) {
+                rsp = &args_cbk->rsp[i];
+                if ((args->req[i].fop == GF_FOP_WRITE) && (rsp->op_ret >= 0)
+                    && (IS_DHT_MIGRATION_PHASE1 (&rsp->poststat)
+                        || IS_DHT_MIGRATION_PHASE2 (&rsp->poststat))) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "file is being migrated, sending the "
+                                "compound fop again as separate fops");
+                        return compound_fop_split (frame, this, args);
+                }
+        }
+
+        for (i = 0; i < args_cbk->count; i++) {
+                DHT_STRIP_PHASE1_FLAGS (&args_cbk->rsp[i].prestat);
+                DHT_STRIP_PHASE1_FLAGS (&args_cbk->rsp[i].poststat);
+        }
+
+out:
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, args_cbk);
+
+        return 0;
+}
+
+
+int
+dht_compound (call_frame_t *frame, xlator_t *this, compound_args_t *args)
+{
+        xlator_t *subvol = NULL;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (args, err);
+
+        subvol = dht_compound_subvol (this, args);
+        if (!subvol)
+                return compound_fop_split (frame, this, args);
+
+        STACK_WIND_COOKIE (frame, dht_compound_cbk, args,
+                           subvol, subvol->fops->compound, args);
+
+        return 0;
+
+err:
+        STACK_UNWIND_STRICT (compound, frame, -1, EINVAL, NULL);
+
+        return 0;
+}
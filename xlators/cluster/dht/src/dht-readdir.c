@@ -0,0 +1,612 @@
+/*
+  Copyright (c) 2009-2011 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+/* parallel readdirp: all subvolumes of an open directory are read ahead
+ * concurrently, each into its own buffer in the fd context. The client is
+ * still served in subvolume order (everything of subvolume 0, then 1, ...)
+ * and the offsets handed out are the same dht_itransform()ed offsets the
+ * sequential walk produces, so telldir/seekdir keep working. An offset
+ * other than the one the buffer expects is a seek: the buffer is dropped
+ * and refilled from that offset. Requests which cannot be answered yet wait
+ * on the fd and are served in the order they came, so a second reader never
+ * goes down to a subvolume on its own while a fetch may be on the wire
+ * there. Entries are buffered for the xattr keys of the last request, a
+ * request with other keys has them fetched again.
+ */
+
+#include "glusterfs.h"
+#include "xlator.h"
+#include "dht-common.h"
+#include "defaults.h"
+
+/* size of a single readdirp sent to a subvolume. Kept well below the
+ * default iobuf page size, the reply has to fit in one. */
+#define DHT_RDP_FETCH_SIZE (64 * GF_UNIT_KB)
+
+struct dht_rdp_subvol {
+        gf_dirent_t            entries;  /* d_off is still the subvol's */
+        uint64_t               bytes;
+        uint64_t               pos;      /* offset the client is at */
+        uint64_t               next;     /* offset to fetch from */
+        uint32_t               gen;      /* bumped on every seek */
+        char                   inflight;
+        char                   eof;
+};
+
+struct dht_rdp {
+        gf_lock_t              lock;
+        dict_t                *xattr;    /* the buffers were fetched with */
+        struct list_head       waiters;  /* client requests waiting for
+                                            data, oldest first */
+        int                    cur;      /* subvol the client is reading */
+        int                    cnt;
+        struct dht_rdp_subvol  sv[0];
+};
+typedef struct dht_rdp dht_rdp_t;
+
+
+static dht_rdp_t *
+dht_rdp_get (xlator_t *this, fd_t *fd)
+{
+        dht_conf_t *conf  = NULL;
+        dht_rdp_t  *rdp   = NULL;
+        uint64_t    value = 0;
+        int         ret   = -1;
+        int         i     = 0;
+
+        conf = this->private;
+
+        LOCK (&fd->lock);
+        {
+                ret = __fd_ctx_get (fd, this, &value);
+                if (ret == 0) {
+                        rdp = (void *)(long) value;
+                        goto unlock;
+                }
+
+                rdp = GF_CALLOC (1, sizeof (*rdp) + (conf->subvolume_cnt *
+                                                     sizeof (rdp->sv[0])),
+                                 gf_dht_mt_rdp_t);
+                if (!rdp)
+                        goto unlock;
+
+                LOCK_INIT (&rdp->lock);
+                INIT_LIST_HEAD (&rdp->waiters);
+                rdp->cnt = conf->subvolume_cnt;
+                for (i = 0; i < rdp->cnt; i++)
+                        INIT_LIST_HEAD (&rdp->sv[i].entries.list);
+
+                ret = __fd_ctx_set (fd, this, (uint64_t)(long) rdp);
+                if (ret) {
+                        LOCK_DESTROY (&rdp->lock);
+                        GF_FREE (rdp);
+                        rdp = NULL;
+                }
+        }
+unlock:
+        UNLOCK (&fd->lock);
+
+        return rdp;
+}
+
+
+static void
+__dht_rdp_reset (struct dht_rdp_subvol *sv, uint64_t off)
+{
+        gf_dirent_free (&sv->entries);
+        INIT_LIST_HEAD (&sv->entries.list);
+
+        sv->bytes    = 0;
+        sv->pos      = off;
+        sv->next     = off;
+        sv->eof      = 0;
+        /* a fetch still on the wire belongs to the old generation, its
+           reply is dropped when it comes back */
+        sv->gen++;
+}
+
+
+struct dht_rdp_keys {
+        dict_t *other;
+        int     missing;
+};
+
+static void
+dht_rdp_key_missing (dict_t *dict, char *key, data_t *value, void *data)
+{
+        struct dht_rdp_keys *keys = data;
+
+        if (!dict_get (keys->other, key))
+                keys->missing = 1;
+}
+
+
+/* Fetch with the xattr request @xattr from now on. Unless it asks for the
+ * same keys as the one the buffers were filled with, they are dropped and
+ * filled again from where the client is on each subvol.
+ */
+static void
+__dht_rdp_xattr (dht_rdp_t *rdp, dict_t *xattr)
+{
+        struct dht_rdp_keys keys = {0, };
+        int                 i    = 0;
+
+        if (xattr == rdp->xattr)
+                return;
+
+        if (xattr && rdp->xattr && (xattr->count == rdp->xattr->count)) {
+                keys.other = rdp->xattr;
+                dict_foreach (xattr, dht_rdp_key_missing, &keys);
+                if (!keys.missing)
+                        return;
+        }
+
+        if (rdp->xattr)
+                dict_unref (rdp->xattr);
+        rdp->xattr = (xattr) ? dict_ref (xattr) : NULL;
+
+        for (i = 0; i < rdp->cnt; i++)
+                __dht_rdp_reset (&rdp->sv[i], rdp->sv[i].pos);
+}
+
+
+/* Move up to @size bytes worth of entries for the subvol at *idx_p into
+ * @entries, stepping on to the following subvols while the current one is
+ * at its end. Returns the number of entries, 0 at the end of the
+ * directory, or -1 when the subvol in *idx_p has nothing buffered yet.
+ */
+static int
+__dht_rdp_serve (xlator_t *this, dht_rdp_t *rdp, int *idx_p, size_t size,
+                 gf_dirent_t *entries, int *op_errno_p)
+{
+        dht_conf_t            *conf   = NULL;
+        struct dht_rdp_subvol *sv     = NULL;
+        gf_dirent_t           *entry  = NULL;
+        gf_dirent_t           *tmp    = NULL;
+        size_t                 filled = 0;
+        size_t                 esize  = 0;
+        int                    count  = 0;
+        int                    idx    = 0;
+
+        conf = this->private;
+        idx  = *idx_p;
+
+        for (;;) {
+                sv = &rdp->sv[idx];
+                if (!list_empty (&sv->entries.list))
+                        break;
+
+                if (!sv->eof) {
+                        *idx_p = idx;
+                        return -1;
+                }
+
+                if ((idx + 1) == rdp->cnt) {
+                        *idx_p = idx;
+                        *op_errno_p = ENOENT;
+                        return 0;
+                }
+
+                idx++;
+                if (rdp->sv[idx].pos != 0)
+                        __dht_rdp_reset (&rdp->sv[idx], 0);
+        }
+
+        list_for_each_entry_safe (entry, tmp, &sv->entries.list, list) {
+                esize = gf_dirent_size (entry->d_name);
+                if (count && ((filled + esize) > size))
+                        break;
+
+                filled    += esize;
+                sv->bytes -= esize;
+                sv->pos    = entry->d_off;
+
+                dht_itransform (this, conf->subvolumes[idx], entry->d_off,
+                                &entry->d_off);
+
+                list_move_tail (&entry->list, &entries->list);
+                count++;
+        }
+
+        *idx_p = idx;
+        *op_errno_p = 0;
+
+        return count;
+}
+
+
+/* Take on a client request: its xattr request, a rewind or a seek may drop
+ * what is buffered, then whatever is there is served. Returns as
+ * __dht_rdp_serve ().
+ */
+static int
+__dht_rdp_start (xlator_t *this, dht_rdp_t *rdp, dht_local_t *local,
+                 gf_dirent_t *entries, int *op_errno_p)
+{
+        struct dht_rdp_subvol *sv    = NULL;
+        int                    count = 0;
+        int                    i     = 0;
+
+        local->rdp.started = 1;
+
+        __dht_rdp_xattr (rdp, local->xattr);
+
+        /* rewinddir: start over everywhere, not just on the first subvol */
+        if (local->rdp.yoff == 0) {
+                for (i = 0; i < rdp->cnt; i++) {
+                        sv = &rdp->sv[i];
+                        if (sv->pos || sv->eof)
+                                __dht_rdp_reset (sv, 0);
+                }
+        }
+
+        sv = &rdp->sv[local->rdp.idx];
+        if (sv->pos != local->rdp.off)
+                __dht_rdp_reset (sv, local->rdp.off);
+
+        count = __dht_rdp_serve (this, rdp, &local->rdp.idx, local->size,
+                                 entries, op_errno_p);
+        rdp->cur = local->rdp.idx;
+
+        return count;
+}
+
+
+/* The oldest waiting client request, taken off the queue with its entries
+ * in @entries, if it can be answered now. The ones behind it are started
+ * only when it is gone.
+ */
+static call_frame_t *
+__dht_rdp_wake (xlator_t *this, dht_rdp_t *rdp, gf_dirent_t *entries,
+                int *count_p, int *op_errno_p)
+{
+        dht_local_t *local = NULL;
+        int          count = 0;
+
+        if (list_empty (&rdp->waiters))
+                return NULL;
+
+        local = list_entry (rdp->waiters.next, dht_local_t, rdp.wait);
+        if (local->rdp.started) {
+                count = __dht_rdp_serve (this, rdp, &local->rdp.idx,
+                                         local->size, entries, op_errno_p);
+                rdp->cur = local->rdp.idx;
+        } else {
+                count = __dht_rdp_start (this, rdp, local, entries,
+                                         op_errno_p);
+        }
+
+        if (count < 0)
+                return NULL;
+
+        list_del_init (&local->rdp.wait);
+        *count_p = count;
+
+        return local->main_frame;
+}
+
+
+/* Prepare a fetch for every subvol from the one the client is reading
+ * onwards that is neither at its end nor holding its share of buffer
+ * already. The frames are wound by the caller once the lock is dropped.
+ */
+static int
+__dht_rdp_pick (xlator_t *this, dht_rdp_t *rdp, call_frame_t *frame,
+                fd_t *fd, call_frame_t **fetch)
+{
+        dht_conf_t            *conf        = NULL;
+        dht_local_t           *local       = NULL;
+        struct dht_rdp_subvol *sv          = NULL;
+        call_frame_t          *fetch_frame = NULL;
+        int                    n           = 0;
+        int                    i           = 0;
+
+        conf = this->private;
+
+        for (i = rdp->cur; i < rdp->cnt; i++) {
+                sv = &rdp->sv[i];
+                if (sv->inflight || sv->eof ||
+                    (sv->bytes >= conf->readdir_prefetch))
+                        continue;
+
+                fetch_frame = copy_frame (frame);
+                if (!fetch_frame)
+                        break;
+
+                local = dht_local_init (fetch_frame, NULL, fd,
+                                        GF_FOP_READDIRP);
+                if (!local) {
+                        DHT_STACK_DESTROY (fetch_frame);
+                        break;
+                }
+
+                local->size      = DHT_RDP_FETCH_SIZE;
+                local->rdp.idx   = i;
+                local->rdp.gen   = sv->gen;
+                local->rdp.off   = sv->next;
+                /* the next request may bring another one */
+                if (rdp->xattr)
+                        local->xattr = dict_ref (rdp->xattr);
+
+                sv->inflight = 1;
+                fetch[n++] = fetch_frame;
+        }
+
+        return n;
+}
+
+
+int dht_rdp_fetch_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int op_ret, int op_errno, gf_dirent_t *orig_entries);
+
+static void
+dht_rdp_wind (xlator_t *this, dht_rdp_t *rdp, call_frame_t **fetch, int n)
+{
+        dht_conf_t  *conf   = NULL;
+        dht_local_t *local  = NULL;
+        xlator_t    *subvol = NULL;
+        int          i      = 0;
+
+        conf = this->private;
+
+        for (i = 0; i < n; i++) {
+                local  = fetch[i]->local;
+                subvol = conf->subvolumes[local->rdp.idx];
+
+                STACK_WIND (fetch[i], dht_rdp_fetch_cbk,
+                            subvol, subvol->fops->readdirp,
+                            local->fd, local->size, local->rdp.off,
+                            local->xattr);
+        }
+}
+
+
+int
+dht_rdp_fetch_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int op_ret, int op_errno, gf_dirent_t *orig_entries)
+{
+        dht_local_t           *local      = NULL;
+        dht_conf_t            *conf       = NULL;
+        dht_rdp_t             *rdp        = NULL;
+        struct dht_rdp_subvol *sv         = NULL;
+        call_frame_t          *prev       = NULL;
+        call_frame_t          *waiter     = NULL;
+        call_frame_t         **fetch      = NULL;
+        xlator_t              *first_up   = NULL;
+        xlator_t              *subvol     = NULL;
+        gf_dirent_t            entries;
+        gf_dirent_t            served;
+        gf_dirent_t           *orig_entry = NULL;
+        gf_dirent_t           *entry      = NULL;
+        gf_dirent_t           *tmp        = NULL;
+        uint64_t               value      = 0;
+        uint64_t               next       = 0;
+        uint64_t               bytes      = 0;
+        int                    count      = 0;
+        int                    w_errno    = 0;
+        int                    n          = 0;
+
+        INIT_LIST_HEAD (&entries.list);
+        INIT_LIST_HEAD (&served.list);
+        prev  = cookie;
+        local = frame->local;
+        conf  = this->private;
+
+        fd_ctx_get (local->fd, this, &value);
+        rdp = (void *)(long) value;
+
+        if (op_ret < 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "readdirp on %s failed (%s)", prev->this->name,
+                        strerror (op_errno));
+                goto filled;
+        }
+
+        first_up = dht_first_up_subvol (this);
+
+        list_for_each_entry (orig_entry, (&orig_entries->list), list) {
+                next = orig_entry->d_off;
+                if ((check_is_dir (NULL, (&orig_entry->d_stat), NULL) &&
+                     (prev->this != first_up)) ||
+                    check_is_linkfile (NULL, (&orig_entry->d_stat),
+                                       orig_entry->dict)) {
+                        continue;
+                }
+
+                entry = gf_dirent_for_name (orig_entry->d_name);
+                if (!entry) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "memory allocation failed :(");
+                        op_ret = -1;
+                        break;
+                }
+
+                if (local->layout && (conf->search_unhashed ==
+                                      GF_DHT_LOOKUP_UNHASHED_AUTO)) {
+                        subvol = dht_layout_search (this, local->layout,
+                                                    orig_entry->d_name);
+                        if (!subvol || (subvol != prev->this))
+                                local->layout->search_unhashed++;
+                }
+
+                entry->d_off  = orig_entry->d_off;
+                entry->d_stat = orig_entry->d_stat;
+                entry->d_ino  = orig_entry->d_ino;
+                entry->d_type = orig_entry->d_type;
+                entry->d_len  = orig_entry->d_len;
+
+                list_add_tail (&entry->list, &entries.list);
+                bytes += gf_dirent_size (entry->d_name);
+        }
+
+filled:
+        fetch = alloca (rdp->cnt * sizeof (*fetch));
+
+        LOCK (&rdp->lock);
+        {
+                /* at most one readdirp per subvol is on the wire, posix
+                   does not serialize seekdir/readdir on a shared fd */
+                sv = &rdp->sv[local->rdp.idx];
+                sv->inflight = 0;
+
+                if (sv->gen == local->rdp.gen) {
+                        /* a failed subvolume is skipped, as the
+                           sequential walk does */
+                        if (op_ret <= 0)
+                                sv->eof = 1;
+                        else
+                                sv->next = next;
+
+                        list_for_each_entry_safe (entry, tmp, &entries.list,
+                                                  list) {
+                                list_move_tail (&entry->list,
+                                                &sv->entries.list);
+                        }
+                        sv->bytes += bytes;
+                }
+
+                waiter = __dht_rdp_wake (this, rdp, &served, &count,
+                                         &w_errno);
+
+                n = __dht_rdp_pick (this, rdp, frame, local->fd, fetch);
+        }
+        UNLOCK (&rdp->lock);
+
+        gf_dirent_free (&entries);
+
+        /* the requests queued behind an answered one may be served from
+           the buffers already, or want fetches of their own. A subvol
+           has only one fetch on the wire, so @fetch does not overflow */
+        while (waiter) {
+                DHT_STACK_UNWIND (readdirp, waiter, count, w_errno, &served);
+                gf_dirent_free (&served);
+
+                LOCK (&rdp->lock);
+                {
+                        waiter = __dht_rdp_wake (this, rdp, &served, &count,
+                                                 &w_errno);
+
+                        n += __dht_rdp_pick (this, rdp, frame, local->fd,
+                                             fetch + n);
+                }
+                UNLOCK (&rdp->lock);
+        }
+
+        dht_rdp_wind (this, rdp, fetch, n);
+
+        DHT_STACK_DESTROY (frame);
+
+        return 0;
+}
+
+
+/* Serve a readdirp from the prefetch buffers. Returns -1 when the request
+ * was not taken and has to go down the sequential path instead.
+ */
+int
+dht_parallel_readdirp (call_frame_t *frame, xlator_t *this, xlator_t *xvol,
+                       off_t yoff, off_t xoff)
+{
+        dht_local_t           *local    = NULL;
+        dht_rdp_t             *rdp      = NULL;
+        call_frame_t         **fetch    = NULL;
+        gf_dirent_t            entries;
+        int                    idx      = 0;
+        int                    count    = 0;
+        int                    op_errno = 0;
+        int                    n        = 0;
+        int                    ret      = -1;
+
+        INIT_LIST_HEAD (&entries.list);
+        local = frame->local;
+
+        idx = dht_subvol_cnt (this, xvol);
+        if (idx < 0)
+                goto out;
+
+        rdp = dht_rdp_get (this, local->fd);
+        if (!rdp)
+                goto out;
+
+        fetch = alloca (rdp->cnt * sizeof (*fetch));
+
+        local->main_frame = frame;
+        local->rdp.idx    = idx;
+        local->rdp.yoff   = yoff;
+        local->rdp.off    = xoff;
+
+        LOCK (&rdp->lock);
+        {
+                /* concurrent readers of the fd are answered in order, one
+                   waiting for data holds up the ones behind it */
+                if (list_empty (&rdp->waiters))
+                        count = __dht_rdp_start (this, rdp, local, &entries,
+                                                 &op_errno);
+                else
+                        count = -1;
+
+                if (count < 0)
+                        list_add_tail (&local->rdp.wait, &rdp->waiters);
+
+                n = __dht_rdp_pick (this, rdp, frame, local->fd, fetch);
+        }
+        UNLOCK (&rdp->lock);
+
+        ret = 0;
+
+        if (count >= 0) {
+                DHT_STACK_UNWIND (readdirp, frame, count, op_errno, &entries);
+                gf_dirent_free (&entries);
+        }
+
+        dht_rdp_wind (this, rdp, fetch, n);
+out:
+        return ret;
+}
+
+
+int
+dht_releasedir (xlator_t *this, fd_t *fd)
+{
+        dht_rdp_t *rdp   = NULL;
+        uint64_t   value = 0;
+        int        i     = 0;
+
+        fd_ctx_del (fd, this, &value);
+        rdp = (void *)(long) value;
+        if (!rdp)
+                goto out;
+
+        for (i = 0; i < rdp->cnt; i++)
+                gf_dirent_free (&rdp->sv[i].entries);
+
+        if (rdp->xattr)
+                dict_unref (rdp->xattr);
+
+        LOCK_DESTROY (&rdp->lock);
+        GF_FREE (rdp);
+out:
+        return 0;
+}
@@ -135,6 +135,9 @@ dht_priv_dump (xlator_t *this)
         gf_proc_dump_write("disk_unit", "%c", conf->disk_unit);
         gf_proc_dump_write("refresh_interval", "%d", conf->refresh_interval);
         gf_proc_dump_write("unhashed_sticky_bit", "%d", conf->unhashed_sticky_bit);
+        gf_proc_dump_write("parallel_readdir", "%d", conf->parallel_readdir);
+        gf_proc_dump_write("readdir_prefetch", "%"PRIu64,
+                           conf->readdir_prefetch);
         if (conf ->du_stats) {
                 gf_proc_dump_write("du_stats.avail_percent", "%lf",
                                    conf->du_stats->avail_percent);
@@ -340,6 +343,10 @@ reconfigure (xlator_t *this, dict_t *options)
                           percent, out);
         GF_OPTION_RECONF ("directory-layout-spread", conf->dir_spread_cnt,
                           options, uint32, out);
+        GF_OPTION_RECONF ("parallel-readdir", conf->parallel_readdir,
+                          options, bool, out);
+        GF_OPTION_RECONF ("readdir-prefetch-size", conf->readdir_prefetch,
+                          options, size, out);
 
         if (dict_get_str (options, "decommissioned-bricks", &temp_str) == 0) {
                 ret = dht_parse_decommissioned_bricks (this, conf, temp_str);
@@ -428,6 +435,11 @@ init (xlator_t *this)
 
         GF_OPTION_INIT ("use-readdirp", conf->use_readdirp, bool, err);
 
+        GF_OPTION_INIT ("parallel-readdir", conf->parallel_readdir, bool, err);
+
+        GF_OPTION_INIT ("readdir-prefetch-size", conf->readdir_prefetch, size,
+                        err);
+
 	GF_OPTION_INIT ("min-free-disk", conf->min_free_disk, percent_or_size,
 			err);
 
@@ -549,6 +561,7 @@ struct xlator_fops fops = {
         .truncate    = dht_truncate,
         .ftruncate   = dht_ftruncate,
         .writev      = dht_writev,
+        .compound    = dht_compound,
         .xattrop     = dht_xattrop,
         .fxattrop    = dht_fxattrop,
         .setattr     = dht_setattr,
@@ -563,7 +576,7 @@ struct xlator_dumpops dumpops = {
 
 struct xlator_cbks cbks = {
 //      .release    = dht_release,
-//      .releasedir = dht_releasedir,
+        .releasedir = dht_releasedir,
         .forget     = dht_forget
 };
 
@@ -595,6 +608,20 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "on",
         },
+        { .key = {"parallel-readdir"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Read all subvolumes of a directory concurrently "
+                         "and serve readdirp from per-subvolume buffers."
+        },
+        { .key = {"readdir-prefetch-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 64 * GF_UNIT_KB,
+          .max  = 64 * GF_UNIT_MB,
+          .default_value = "256KB",
+          .description = "Directory entries buffered per subvolume and "
+                         "open directory with parallel-readdir."
+        },
         { .key = {"assert-no-child-down"},
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "off",
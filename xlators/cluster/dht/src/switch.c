@@ -987,6 +987,7 @@ struct xlator_fops fops = {
         .readv       = dht_readv,
         .writev      = dht_writev,
         .flush       = dht_flush,
+        .compound    = dht_compound,
         .fsync       = dht_fsync,
         .statfs      = dht_statfs,
         .lk          = dht_lk,
@@ -0,0 +1,292 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/* glusterfs-iostat: samples the counters io-stats publishes in shared memory
+ * (the shm-stats option) and prints the rates of every interval, without any
+ * RPC to the glusterfs process.
+ *
+ * usage: glusterfs-iostat
+ *            lists the segments in /dev/shm
+ *        glusterfs-iostat [-i MSEC] [-c COUNT] SEGMENT|PID
+ *            prints MB/s and per fop ops/s, average, median and 99th
+ *            percentile latency every MSEC (1000) for COUNT intervals (until
+ *            interrupted or the process exits), and the maximum latency
+ *            since the process started
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "io-stats-shm.h"
+
+#define SHM_DIR  "/dev/shm"
+
+
+static void
+usage (const char *prog)
+{
+        fprintf (stderr, "usage: %s [-i MSEC] [-c COUNT] [SEGMENT|PID]\n",
+                 prog);
+        exit (2);
+}
+
+
+static int
+list_segments (const char *pid_prefix, char *found, size_t size)
+{
+        const struct ios_shm *shm    = NULL;
+        DIR                  *dir    = NULL;
+        struct dirent        *entry  = NULL;
+        char                  name[IOS_SHM_NAME_MAX + 2];
+        int                   count  = 0;
+        int                   alive  = 0;
+
+        dir = opendir (SHM_DIR);
+        if (!dir) {
+                perror (SHM_DIR);
+                return -1;
+        }
+
+        while ((entry = readdir (dir))) {
+                if (strncmp (entry->d_name, IOS_SHM_PREFIX + 1,
+                             strlen (IOS_SHM_PREFIX) - 1))
+                        continue;
+                snprintf (name, sizeof (name), "/%s", entry->d_name);
+
+                if (pid_prefix) {
+                        if (strncmp (name, pid_prefix, strlen (pid_prefix)))
+                                continue;
+                        if (!count)
+                                snprintf (found, size, "%s", name);
+                        count++;
+                        continue;
+                }
+
+                shm = ios_shm_attach (name);
+                if (!shm) {
+                        printf ("%-48s  (%s)\n", name, strerror (errno));
+                        continue;
+                }
+
+                alive = (kill (shm->hdr.pid, 0) == 0) || (errno == EPERM);
+                printf ("%-48s  pid %-6d %s %s\n", name, shm->hdr.pid,
+                        shm->hdr.name, alive ? "" : "(exited)");
+                ios_shm_detach (shm);
+                count++;
+        }
+
+        closedir (dir);
+
+        return count;
+}
+
+
+static uint64_t
+hist_percentile (const uint64_t *hist, int buckets, uint64_t total,
+                 double pct)
+{
+        uint64_t seen = 0;
+        int      i    = 0;
+
+        for (i = 0; i < buckets; i++) {
+                seen += hist[i];
+                if (seen * 100.0 >= total * pct)
+                        break;
+        }
+
+        if (i == buckets)
+                i--;
+
+        /* the upper bound of the bucket */
+        return 2ULL << i;
+}
+
+
+static void
+print_interval (const struct ios_shm *prev, const struct ios_shm *cur,
+                double secs)
+{
+        const struct ios_shm_fop *p    = NULL;
+        const struct ios_shm_fop *c    = NULL;
+        uint64_t                  hist[IOS_SHM_LAT_BUCKETS];
+        uint64_t                  hits = 0;
+        uint64_t                  timed = 0;
+        int                       buckets = 0;
+        int                       op   = 0;
+        int                       i    = 0;
+        struct timeval            now  = {0, };
+        char                      stamp[32];
+
+        gettimeofday (&now, NULL);
+        strftime (stamp, sizeof (stamp), "%H:%M:%S", localtime (&now.tv_sec));
+
+        printf ("%s.%03ld  read %.2f MB/s  write %.2f MB/s\n", stamp,
+                (long)now.tv_usec / 1000,
+                (cur->data_read - prev->data_read) / secs / 1048576.0,
+                (cur->data_written - prev->data_written) / secs / 1048576.0);
+
+        buckets = cur->hdr.nr_lat_buckets;
+
+        for (op = 0; op < cur->hdr.nr_fops; op++) {
+                p = &prev->fop[op];
+                c = &cur->fop[op];
+
+                hits = c->hits - p->hits;
+                if (!hits)
+                        continue;
+
+                timed = c->lat_count - p->lat_count;
+                if (!timed) {
+                        printf ("  %-14s %10.1f ops/s\n",
+                                cur->hdr.fop_names[op], hits / secs);
+                        continue;
+                }
+
+                for (i = 0; i < buckets; i++)
+                        hist[i] = c->lat_hist[i] - p->lat_hist[i];
+
+                printf ("  %-14s %10.1f ops/s  avg %8.1f  p50 <%-8"PRIu64
+                        " p99 <%-8"PRIu64" max %"PRIu64" usec\n",
+                        cur->hdr.fop_names[op], hits / secs,
+                        (double)(c->lat_total - p->lat_total) / timed,
+                        hist_percentile (hist, buckets, timed, 50),
+                        hist_percentile (hist, buckets, timed, 99),
+                        c->lat_max);
+        }
+        fflush (stdout);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        const struct ios_shm *shm      = NULL;
+        struct ios_shm       *snap[2]  = {NULL, };
+        char                  name[IOS_SHM_NAME_MAX + 2];
+        char                  prefix[64];
+        char                 *end      = NULL;
+        long                  interval = 1000;
+        long                  count    = -1;
+        long                  pid      = 0;
+        struct timeval        then     = {0, };
+        struct timeval        now      = {0, };
+        double                secs     = 0;
+        int                   cur      = 0;
+        int                   opt      = 0;
+
+        while ((opt = getopt (argc, argv, "i:c:")) != -1) {
+                switch (opt) {
+                case 'i':
+                        interval = strtol (optarg, NULL, 10);
+                        break;
+                case 'c':
+                        count = strtol (optarg, NULL, 10);
+                        break;
+                default:
+                        usage (argv[0]);
+                }
+        }
+
+        if (interval <= 0)
+                usage (argv[0]);
+
+        if (optind == argc)
+                return (list_segments (NULL, NULL, 0) < 0);
+
+        if (optind != argc - 1)
+                usage (argv[0]);
+
+        pid = strtol (argv[optind], &end, 10);
+        if (*end == '\0') {
+                snprintf (prefix, sizeof (prefix), IOS_SHM_PREFIX"%ld.", pid);
+                switch (list_segments (prefix, name, sizeof (name))) {
+                case 1:
+                        break;
+                case 0:
+                        fprintf (stderr, "no segment of pid %ld\n", pid);
+                        return 1;
+                case -1:
+                        return 1;
+                default:
+                        fprintf (stderr, "pid %ld has more than one segment,"
+                                 " name one\n", pid);
+                        return 1;
+                }
+        } else {
+                snprintf (name, sizeof (name), "%s%s",
+                          (argv[optind][0] == '/') ? "" : "/", argv[optind]);
+        }
+
+        shm = ios_shm_attach (name);
+        if (!shm) {
+                fprintf (stderr, "%s: %s\n", name, strerror (errno));
+                return 1;
+        }
+
+        snap[0] = calloc (1, sizeof (struct ios_shm));
+        snap[1] = calloc (1, sizeof (struct ios_shm));
+        if (!snap[0] || !snap[1]) {
+                perror ("calloc");
+                return 1;
+        }
+
+        printf ("%s: pid %d, %s\n", name, shm->hdr.pid, shm->hdr.name);
+
+        if (ios_shm_snapshot (shm, snap[cur]) == -1) {
+                perror ("snapshot");
+                return 1;
+        }
+        gettimeofday (&then, NULL);
+
+        while (count) {
+                usleep (interval * 1000);
+
+                if ((kill (shm->hdr.pid, 0) == -1) && (errno == ESRCH)) {
+                        printf ("pid %d exited\n", shm->hdr.pid);
+                        break;
+                }
+
+                if (ios_shm_snapshot (shm, snap[!cur]) == -1)
+                        continue;
+                gettimeofday (&now, NULL);
+
+                secs = (now.tv_sec - then.tv_sec) +
+                        (now.tv_usec - then.tv_usec) / 1e6;
+                print_interval (snap[cur], snap[!cur], secs);
+
+                cur = !cur;
+                then = now;
+                if (count > 0)
+                        count--;
+        }
+
+        ios_shm_detach (shm);
+        free (snap[0]);
+        free (snap[1]);
+
+        return 0;
+}
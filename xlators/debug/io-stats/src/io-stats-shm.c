@@ -0,0 +1,195 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/* Only plain libc in here, the file is also built into glusterfs-iostat,
+   which does not link libglusterfs. */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "io-stats-shm.h"
+
+#define IOS_SHM_SNAPSHOT_TRIES  1000
+
+
+int
+ios_shm_name (char *buf, size_t size, pid_t pid, const char *xlname)
+{
+        int   len = 0;
+        char *p   = NULL;
+
+        len = snprintf (buf, size, IOS_SHM_PREFIX"%d.%s", (int)pid, xlname);
+        if ((len < 0) || (len >= size) || (len > IOS_SHM_NAME_MAX)) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+
+        for (p = buf + 1; *p; p++) {
+                if (*p == '/')
+                        *p = '-';
+        }
+
+        return 0;
+}
+
+
+struct ios_shm *
+ios_shm_create (const char *name)
+{
+        struct ios_shm *shm = NULL;
+        void           *map = NULL;
+        int             fd  = -1;
+
+        /* a segment left behind by a process which had our pid */
+        shm_unlink (name);
+
+        fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd == -1)
+                return NULL;
+
+        if (ftruncate (fd, sizeof (*shm)) == -1)
+                goto err;
+
+        map = mmap (NULL, sizeof (*shm), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+        if (map == MAP_FAILED)
+                goto err;
+
+        close (fd);
+
+        /* fresh pages are zero, the caller fills in the header and then
+           sets magic */
+        shm = map;
+        shm->hdr.size = sizeof (*shm);
+
+        return shm;
+err:
+        close (fd);
+        shm_unlink (name);
+        return NULL;
+}
+
+
+void
+ios_shm_destroy (const char *name, struct ios_shm *shm)
+{
+        if (!shm)
+                return;
+
+        /* readers which still have it mapped keep seeing the last values */
+        munmap (shm, sizeof (*shm));
+        shm_unlink (name);
+}
+
+
+const struct ios_shm *
+ios_shm_attach (const char *name)
+{
+        const struct ios_shm *shm = NULL;
+        struct stat           st  = {0, };
+        void                 *map = NULL;
+        int                   fd  = -1;
+
+        fd = shm_open (name, O_RDONLY, 0);
+        if (fd == -1)
+                return NULL;
+
+        if (fstat (fd, &st) == -1)
+                goto err;
+
+        if (st.st_size < sizeof (struct ios_shm_header)) {
+                errno = EPROTO;
+                goto err;
+        }
+
+        map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+                goto err;
+
+        close (fd);
+
+        shm = map;
+        ios_shm_barrier ();
+
+        if (shm->hdr.magic != IOS_SHM_MAGIC) {
+                /* zero while the writer is still filling in the header */
+                errno = (shm->hdr.magic == 0) ? EAGAIN : EPROTO;
+                goto unmap;
+        }
+
+        if ((shm->hdr.version != IOS_SHM_VERSION) ||
+            (shm->hdr.size != sizeof (*shm)) ||
+            (shm->hdr.size > st.st_size) ||
+            (shm->hdr.nr_fops > IOS_SHM_MAX_FOPS) ||
+            (shm->hdr.nr_lat_buckets > IOS_SHM_LAT_BUCKETS)) {
+                errno = EPROTO;
+                goto unmap;
+        }
+
+        return shm;
+
+unmap:
+        munmap (map, st.st_size);
+        return NULL;
+err:
+        close (fd);
+        return NULL;
+}
+
+
+void
+ios_shm_detach (const struct ios_shm *shm)
+{
+        if (!shm)
+                return;
+
+        munmap ((void *)shm, shm->hdr.size);
+}
+
+
+int
+ios_shm_snapshot (const struct ios_shm *shm, struct ios_shm *snap)
+{
+        uint64_t begin = 0;
+        int      tries = 0;
+
+        for (tries = 0; tries < IOS_SHM_SNAPSHOT_TRIES; tries++) {
+                begin = shm->seq;
+                if (begin & 1) {
+                        sched_yield ();
+                        continue;
+                }
+                ios_shm_barrier ();
+
+                memcpy (snap, (const void *)shm, sizeof (*snap));
+
+                ios_shm_barrier ();
+                if (shm->seq == begin)
+                        return 0;
+        }
+
+        errno = EAGAIN;
+        return -1;
+}
@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __IO_STATS_SHM_H__
+#define __IO_STATS_SHM_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* With the shm-stats option on, io-stats publishes its counters in a POSIX
+ * shared memory segment named
+ *
+ *         /glusterfs-iostat.<pid>.<translator name>
+ *
+ * ('/' in the translator name replaced by '-'), which a monitor maps read
+ * only and samples without any RPC to the process (see glusterfs-iostat).
+ *
+ * The layout is versioned: a reader checks magic and version, and only uses
+ * as many fops and histogram buckets as the header says. The header is
+ * written once before magic is set. The counters after it are updated under
+ * a sequence lock: the writer (io-stats, serialized by its conf->lock) makes
+ * seq odd before an update and even again after it, a reader copies the
+ * counters and retries if seq was odd or changed meanwhile. The writer never
+ * waits for readers.
+ *
+ * All the counters count from the start of the process and only grow, a
+ * monitor gets rates from the difference of two snapshots.
+ */
+
+#define IOS_SHM_MAGIC          0x47465349      /* "GFSI" */
+#define IOS_SHM_VERSION        1
+
+#define IOS_SHM_PREFIX         "/glusterfs-iostat."
+#define IOS_SHM_NAME_MAX       255
+
+#define IOS_SHM_MAX_FOPS       64
+#define IOS_SHM_FOP_NAME_MAX   32
+#define IOS_SHM_LAT_BUCKETS    32
+#define IOS_SHM_BLOCK_BUCKETS  32
+
+struct ios_shm_fop {
+        uint64_t        hits;
+        uint64_t        lat_count;      /* hits which were timed */
+        uint64_t        lat_total;      /* usec */
+        uint64_t        lat_min;
+        uint64_t        lat_max;
+        /* lat_hist[0] counts fops which took less than 2usec, lat_hist[i]
+           those which took [2^i, 2^(i+1)) usec, the last bucket anything
+           longer */
+        uint64_t        lat_hist[IOS_SHM_LAT_BUCKETS];
+};
+
+struct ios_shm_header {
+        uint32_t        magic;
+        uint32_t        version;
+        uint32_t        size;           /* of the whole segment */
+        uint32_t        nr_fops;
+        uint32_t        nr_lat_buckets;
+        int32_t         pid;
+        uint64_t        started_at;     /* usec since the epoch */
+        char            name[IOS_SHM_NAME_MAX + 1];
+        char            fop_names[IOS_SHM_MAX_FOPS][IOS_SHM_FOP_NAME_MAX];
+};
+
+struct ios_shm {
+        struct ios_shm_header   hdr;
+
+        volatile uint64_t       seq;
+
+        uint64_t        data_read;
+        uint64_t        data_written;
+        /* block_count_*[i] counts reads/writes of [2^i, 2^(i+1)) bytes */
+        uint64_t        block_count_read[IOS_SHM_BLOCK_BUCKETS];
+        uint64_t        block_count_write[IOS_SHM_BLOCK_BUCKETS];
+        struct ios_shm_fop      fop[IOS_SHM_MAX_FOPS];
+};
+
+#define ios_shm_barrier()       __sync_synchronize ()
+
+static inline void
+ios_shm_write_begin (struct ios_shm *shm)
+{
+        shm->seq++;
+        ios_shm_barrier ();
+}
+
+static inline void
+ios_shm_write_end (struct ios_shm *shm)
+{
+        ios_shm_barrier ();
+        shm->seq++;
+}
+
+/* writer side, used by io-stats */
+int ios_shm_name (char *buf, size_t size, pid_t pid, const char *xlname);
+struct ios_shm *ios_shm_create (const char *name);
+void ios_shm_destroy (const char *name, struct ios_shm *shm);
+
+/* reader side. ios_shm_attach () returns NULL with errno EPROTO for a
+   segment of an unknown layout. ios_shm_snapshot () returns -1 with errno
+   EAGAIN if it could not get a consistent copy in a bounded number of
+   tries. */
+const struct ios_shm *ios_shm_attach (const char *name);
+void ios_shm_detach (const struct ios_shm *shm);
+int ios_shm_snapshot (const struct ios_shm *shm, struct ios_shm *snap);
+
+#endif /* __IO_STATS_SHM_H__ */
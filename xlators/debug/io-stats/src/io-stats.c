@@ -43,6 +43,7 @@
 #include "glusterfs.h"
 #include "xlator.h"
 #include "io-stats-mem-types.h"
+#include "io-stats-shm.h"
 #include <stdarg.h>
 #include "defaults.h"
 #include "logging.h"
@@ -124,6 +125,10 @@ struct ios_conf {
         gf_boolean_t              measure_latency;
         struct ios_stat_head      list[IOS_STATS_TYPE_MAX];
         struct ios_stat_head      thru_list[IOS_STATS_THRU_MAX];
+        gf_boolean_t              shm_stats;
+        char                      shm_name[IOS_SHM_NAME_MAX + 1];
+        struct ios_shm           *shm;
+        struct list_head          shm_list;
 };
 
 
@@ -185,7 +190,7 @@ is_fop_latency_started (call_frame_t *frame)
                 struct ios_conf  *conf = NULL;                           \
                                                                          \
                 conf = this->private;                                    \
-                if (conf && conf->measure_latency) {                     \
+                if (conf && (conf->measure_latency || conf->shm)) {      \
                         gettimeofday (&frame->begin, NULL);              \
                 } else {                                                 \
                         memset (&frame->begin, 0, sizeof (frame->begin));\
@@ -213,12 +218,14 @@ is_fop_latency_started (call_frame_t *frame)
                 conf = this->private;                                         \
                 LOCK (&conf->lock);                                           \
                 {                                                             \
+                        gettimeofday (&frame->end, NULL);                     \
                         if (conf && conf->measure_latency &&                  \
                             conf->count_fop_hits) {                           \
                                 BUMP_FOP(op);                                 \
-                                gettimeofday (&frame->end, NULL);             \
                                 update_ios_latency (conf, frame, GF_FOP_##op);\
                         }                                                     \
+                        if (conf->shm)                                        \
+                                ios_shm_update_fop (conf, frame, GF_FOP_##op);\
                 }                                                             \
                 UNLOCK (&conf->lock);                                         \
         } while (0)
@@ -242,6 +249,12 @@ is_fop_latency_started (call_frame_t *frame)
                         conf->cumulative.block_count_read[lb2]++;       \
                         conf->incremental.block_count_read[lb2]++;      \
                                                                         \
+                        if (conf->shm) {                                \
+                                ios_shm_write_begin (conf->shm);        \
+                                conf->shm->data_read += len;            \
+                                conf->shm->block_count_read[lb2]++;     \
+                                ios_shm_write_end (conf->shm);          \
+                        }                                               \
                         if (iosfd) {                                    \
                                 iosfd->data_read += len;                \
                                 iosfd->block_count_read[lb2]++;         \
@@ -270,6 +283,12 @@ is_fop_latency_started (call_frame_t *frame)
                         conf->cumulative.block_count_write[lb2]++;      \
                         conf->incremental.block_count_write[lb2]++;     \
                                                                         \
+                        if (conf->shm) {                                \
+                                ios_shm_write_begin (conf->shm);        \
+                                conf->shm->data_written += len;         \
+                                conf->shm->block_count_write[lb2]++;    \
+                                ios_shm_write_end (conf->shm);          \
+                        }                                               \
                         if (iosfd) {                                    \
                                 iosfd->data_written += len;             \
                                 iosfd->block_count_write[lb2]++;        \
@@ -1069,6 +1088,190 @@ update_ios_latency (struct ios_conf *conf, call_frame_t *frame,
         return 0;
 }
 
+
+/* called with conf->lock held, @frame NULL for the fops which are not
+   timed (release, releasedir, forget) */
+static void
+ios_shm_update_fop (struct ios_conf *conf, call_frame_t *frame,
+                    glusterfs_fop_t op)
+{
+        struct ios_shm_fop *fop     = NULL;
+        struct timeval     *begin   = NULL;
+        struct timeval     *end     = NULL;
+        int64_t             elapsed = 0;
+        int                 bucket  = 0;
+
+        fop = &conf->shm->fop[op];
+
+        if (frame) {
+                begin = &frame->begin;
+                end   = &frame->end;
+
+                elapsed = (end->tv_sec - begin->tv_sec) * 1000000LL
+                        + (end->tv_usec - begin->tv_usec);
+                if (elapsed < 0)
+                        elapsed = 0;
+
+                bucket = elapsed ? log_base2 (elapsed) : 0;
+                if (bucket >= IOS_SHM_LAT_BUCKETS)
+                        bucket = IOS_SHM_LAT_BUCKETS - 1;
+        }
+
+        ios_shm_write_begin (conf->shm);
+        {
+                fop->hits++;
+                if (frame) {
+                        if (!fop->lat_count || (elapsed < fop->lat_min))
+                                fop->lat_min = elapsed;
+                        if (elapsed > fop->lat_max)
+                                fop->lat_max = elapsed;
+                        fop->lat_count++;
+                        fop->lat_total += elapsed;
+                        fop->lat_hist[bucket]++;
+                }
+        }
+        ios_shm_write_end (conf->shm);
+}
+
+
+#define BUMP_SHM_FOP(op)                                                \
+        do {                                                            \
+                struct ios_conf  *conf = NULL;                          \
+                                                                        \
+                conf = this->private;                                   \
+                if (!conf || !conf->shm)                                \
+                        break;                                          \
+                LOCK (&conf->lock);                                     \
+                {                                                       \
+                        if (conf->shm)                                  \
+                                ios_shm_update_fop (conf, NULL,         \
+                                                    GF_FOP_##op);       \
+                }                                                       \
+                UNLOCK (&conf->lock);                                   \
+        } while (0)
+
+
+/* glusterfsd exits without calling fini (), the segments of the process
+   are unlinked at exit instead */
+static pthread_once_t    ios_shm_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t   ios_shm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head  ios_shm_confs = {&ios_shm_confs, &ios_shm_confs};
+
+static void
+ios_shm_atexit (void)
+{
+        struct ios_conf *conf = NULL;
+
+        pthread_mutex_lock (&ios_shm_mutex);
+        {
+                list_for_each_entry (conf, &ios_shm_confs, shm_list)
+                        shm_unlink (conf->shm_name);
+        }
+        pthread_mutex_unlock (&ios_shm_mutex);
+}
+
+
+static void
+ios_shm_register_atexit (void)
+{
+        atexit (ios_shm_atexit);
+}
+
+
+static int
+ios_shm_start (xlator_t *this, struct ios_conf *conf)
+{
+        struct ios_shm *shm = NULL;
+        int             i   = 0;
+        int             ret = -1;
+
+        if (GF_FOP_MAXVALUE > IOS_SHM_MAX_FOPS) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "%d fops do not fit the shared memory layout",
+                        GF_FOP_MAXVALUE);
+                goto out;
+        }
+
+        ret = ios_shm_name (conf->shm_name, sizeof (conf->shm_name),
+                            getpid (), this->name);
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "no shared memory segment name for %s", this->name);
+                goto out;
+        }
+
+        shm = ios_shm_create (conf->shm_name);
+        if (!shm) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create shared memory segment %s (%s)",
+                        conf->shm_name, strerror (errno));
+                ret = -1;
+                goto out;
+        }
+
+        shm->hdr.version        = IOS_SHM_VERSION;
+        shm->hdr.nr_fops        = GF_FOP_MAXVALUE;
+        shm->hdr.nr_lat_buckets = IOS_SHM_LAT_BUCKETS;
+        shm->hdr.pid            = getpid ();
+        shm->hdr.started_at     = conf->cumulative.started_at.tv_sec *
+                                  1000000ULL +
+                                  conf->cumulative.started_at.tv_usec;
+        strncpy (shm->hdr.name, this->name, IOS_SHM_NAME_MAX);
+        for (i = 0; i < GF_FOP_MAXVALUE; i++) {
+                if (gf_fop_list[i])
+                        strncpy (shm->hdr.fop_names[i], gf_fop_list[i],
+                                 IOS_SHM_FOP_NAME_MAX - 1);
+        }
+
+        ios_shm_barrier ();
+        shm->hdr.magic = IOS_SHM_MAGIC;
+
+        pthread_once (&ios_shm_once, ios_shm_register_atexit);
+        pthread_mutex_lock (&ios_shm_mutex);
+        {
+                list_add_tail (&conf->shm_list, &ios_shm_confs);
+        }
+        pthread_mutex_unlock (&ios_shm_mutex);
+
+        LOCK (&conf->lock);
+        {
+                conf->shm = shm;
+        }
+        UNLOCK (&conf->lock);
+
+        gf_log (this->name, GF_LOG_INFO,
+                "publishing stats in shared memory segment %s",
+                conf->shm_name);
+        ret = 0;
+out:
+        return ret;
+}
+
+
+static void
+ios_shm_stop (struct ios_conf *conf)
+{
+        struct ios_shm *shm = NULL;
+
+        LOCK (&conf->lock);
+        {
+                shm = conf->shm;
+                conf->shm = NULL;
+        }
+        UNLOCK (&conf->lock);
+
+        if (!shm)
+                return;
+
+        pthread_mutex_lock (&ios_shm_mutex);
+        {
+                list_del_init (&conf->shm_list);
+        }
+        pthread_mutex_unlock (&ios_shm_mutex);
+
+        ios_shm_destroy (conf->shm_name, shm);
+}
+
 int32_t
 io_stats_dump_stats_to_dict (xlator_t *this, dict_t *resp,
                              ios_stats_type_t flags, int32_t list_cnt)
@@ -2417,6 +2620,7 @@ io_stats_release (xlator_t *this, fd_t *fd)
         struct ios_conf *conf = NULL;
 
         BUMP_FOP (RELEASE);
+        BUMP_SHM_FOP (RELEASE);
 
         conf = this->private;
 
@@ -2443,6 +2647,7 @@ int
 io_stats_releasedir (xlator_t *this, fd_t *fd)
 {
         BUMP_FOP (RELEASEDIR);
+        BUMP_SHM_FOP (RELEASEDIR);
 
         return 0;
 }
@@ -2452,6 +2657,7 @@ int
 io_stats_forget (xlator_t *this, inode_t *inode)
 {
         BUMP_FOP (FORGET);
+        BUMP_SHM_FOP (FORGET);
         ios_stats_cleanup (this, inode);
         return 0;
 }
@@ -2466,6 +2672,7 @@ reconfigure (xlator_t *this, dict_t *options)
         int                 sys_log_level = -1;
         char               *log_str = NULL;
         int                 log_level = -1;
+        gf_boolean_t        shm_stats = _gf_false;
 
         if (!this || !this->private)
                 goto out;
@@ -2481,6 +2688,16 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("latency-measurement", conf->measure_latency,
                           options, bool, out);
 
+        GF_OPTION_RECONF ("shm-stats", shm_stats, options, bool, out);
+        if (shm_stats && !conf->shm_stats) {
+                ret = ios_shm_start (this, conf);
+                if (ret)
+                        goto out;
+        } else if (!shm_stats && conf->shm_stats) {
+                ios_shm_stop (conf);
+        }
+        conf->shm_stats = shm_stats;
+
         GF_OPTION_RECONF ("sys-log-level", sys_log_str, options, str, out);
         if (sys_log_str) {
                 sys_log_level = glusterd_check_log_level (sys_log_str);
@@ -2609,6 +2826,13 @@ init (xlator_t *this)
                 gf_log_set_loglevel (log_level);
         }
 
+        GF_OPTION_INIT ("shm-stats", conf->shm_stats, bool, out);
+        if (conf->shm_stats) {
+                ret = ios_shm_start (this, conf);
+                if (ret)
+                        goto out;
+        }
+
         this->private = conf;
         ret = 0;
 out:
@@ -2666,6 +2890,8 @@ fini (xlator_t *this)
                 }
         }
 
+        ios_shm_stop (conf);
+
         if (conf)
                 GF_FREE(conf);
 
@@ -2801,6 +3027,14 @@ struct volume_options options[] = {
         { .key  = {"count-fop-hits"},
           .type = GF_OPTION_TYPE_BOOL,
         },
+        { .key  = {"shm-stats"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "If on the counters and latency histograms of all "
+                         "fops are published in the shared memory segment "
+                         "/glusterfs-iostat.<pid>.<translator name>, which "
+                         "glusterfs-iostat reads without any RPC."
+        },
         { .key = {"log-level"},
           .type = GF_OPTION_TYPE_STR,
           .value = { "DEBUG", "WARNING", "ERROR", "INFO",
@@ -0,0 +1,1182 @@
+/*
+   Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "upcall.h"
+#include "statedump.h"
+
+/* Brick side half of cache invalidation: remember, per inode, which clients
+ * have been handed its attributes or contents, and when one of them changes
+ * it tell the others (through protocol/server) to drop what they cached.
+ * A client is forgotten once it has not touched the inode for 'timeout'
+ * seconds (its caches have expired by then), and once it has been sent an
+ * invalidation (it has to come back to the brick for fresh state anyway).
+ */
+
+static upcall_inode_ctx_t *
+upcall_inode_ctx_get (xlator_t *this, inode_t *inode, gf_boolean_t create)
+{
+        upcall_inode_ctx_t *ctx   = NULL;
+        uint64_t            value = 0;
+        int                 ret   = 0;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &value);
+                if (ret == 0) {
+                        ctx = (upcall_inode_ctx_t *)(long)value;
+                        goto unlock;
+                }
+
+                if (!create)
+                        goto unlock;
+
+                ctx = GF_CALLOC (1, sizeof (*ctx), gf_upcall_mt_inode_ctx_t);
+                if (!ctx)
+                        goto unlock;
+
+                LOCK_INIT (&ctx->lock);
+                INIT_LIST_HEAD (&ctx->clients);
+
+                ret = __inode_ctx_put (inode, this, (uint64_t)(long)ctx);
+                if (ret) {
+                        LOCK_DESTROY (&ctx->lock);
+                        GF_FREE (ctx);
+                        ctx = NULL;
+                }
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        return ctx;
+}
+
+
+static void
+upcall_cache_register (call_frame_t *frame, xlator_t *this, inode_t *inode)
+{
+        upcall_private_t   *priv   = NULL;
+        upcall_inode_ctx_t *ctx    = NULL;
+        upcall_client_t    *up     = NULL;
+        void               *client = NULL;
+        int                 added  = 0;
+
+        priv   = this->private;
+        client = frame->root->trans;
+
+        /* frames wound by the brick itself have nobody to tell */
+        if (!client || !inode)
+                return;
+
+        ctx = upcall_inode_ctx_get (this, inode, _gf_true);
+        if (!ctx)
+                return;
+
+        LOCK (&ctx->lock);
+        {
+                list_for_each_entry (up, &ctx->clients, list) {
+                        if (up->client == client)
+                                goto touch;
+                }
+
+                up = GF_CALLOC (1, sizeof (*up), gf_upcall_mt_client_t);
+                if (!up)
+                        goto unlock;
+
+                up->client = client;
+                list_add_tail (&up->list, &ctx->clients);
+                added = 1;
+touch:
+                time (&up->access_time);
+        }
+unlock:
+        UNLOCK (&ctx->lock);
+
+        if (added) {
+                LOCK (&priv->lock);
+                {
+                        priv->registered++;
+                }
+                UNLOCK (&priv->lock);
+        }
+}
+
+
+static void
+upcall_cache_invalidate (call_frame_t *frame, xlator_t *this, inode_t *inode,
+                         uint32_t flags)
+{
+        upcall_private_t   *priv    = NULL;
+        upcall_inode_ctx_t *ctx     = NULL;
+        upcall_client_t    *up      = NULL;
+        upcall_client_t    *tmp     = NULL;
+        void               *client  = NULL;
+        struct gf_upcall    upcall  = {0, };
+        struct list_head    notify;
+        time_t              now     = 0;
+        uint64_t            expired = 0;
+        uint64_t            sent    = 0;
+
+        priv   = this->private;
+        client = frame->root->trans;
+
+        if (!inode || uuid_is_null (inode->gfid))
+                return;
+
+        ctx = upcall_inode_ctx_get (this, inode, _gf_false);
+        if (!ctx)
+                return;
+
+        INIT_LIST_HEAD (&notify);
+        time (&now);
+
+        LOCK (&ctx->lock);
+        {
+                list_for_each_entry_safe (up, tmp, &ctx->clients, list) {
+                        if (now > (up->access_time + priv->timeout)) {
+                                list_del (&up->list);
+                                GF_FREE (up);
+                                expired++;
+                                continue;
+                        }
+
+                        /* the modifying client updates its own caches */
+                        if (up->client == client)
+                                continue;
+
+                        list_move_tail (&up->list, &notify);
+                }
+        }
+        UNLOCK (&ctx->lock);
+
+        uuid_copy (upcall.gfid, inode->gfid);
+        upcall.flags = flags;
+
+        list_for_each_entry_safe (up, tmp, &notify, list) {
+                upcall.client = up->client;
+                default_notify (this, GF_EVENT_UPCALL, &upcall);
+
+                list_del (&up->list);
+                GF_FREE (up);
+                sent++;
+        }
+
+        if (!expired && !sent)
+                return;
+
+        LOCK (&priv->lock);
+        {
+                priv->expired += expired;
+                priv->invalidations += sent;
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+static upcall_local_t *
+upcall_local_get (call_frame_t *frame, xlator_t *this)
+{
+        upcall_local_t *local = NULL;
+
+        local = mem_get0 (this->local_pool);
+        frame->local = local;
+
+        return local;
+}
+
+
+static void
+upcall_local_add (upcall_local_t *local, inode_t *inode, uint32_t flags)
+{
+        if (!inode || (local->count == UPCALL_MAX_INODES))
+                return;
+
+        local->inodes[local->count] = inode_ref (inode);
+        local->flags[local->count] = flags;
+        local->count++;
+}
+
+
+void
+upcall_local_wipe (xlator_t *this, upcall_local_t *local)
+{
+        int i = 0;
+
+        if (!local)
+                return;
+
+        for (i = 0; i < local->count; i++)
+                inode_unref (local->inodes[i]);
+
+        mem_put (local);
+}
+
+
+static void
+upcall_local_invalidate (call_frame_t *frame, xlator_t *this, int32_t op_ret)
+{
+        upcall_local_t *local = NULL;
+        int             i     = 0;
+
+        local = frame->local;
+        if (!local || (op_ret < 0))
+                return;
+
+        for (i = 0; i < local->count; i++)
+                upcall_cache_invalidate (frame, this, local->inodes[i],
+                                         local->flags[i]);
+}
+
+
+/* fops handing out state that clients cache */
+
+int32_t
+upcall_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               dict_t *xattr_req)
+{
+        upcall_cache_register (frame, this, loc->inode);
+        /* the client may remember the name does not exist in the parent */
+        upcall_cache_register (frame, this, loc->parent);
+
+        STACK_WIND (frame, default_lookup_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->lookup, loc, xattr_req);
+        return 0;
+}
+
+
+int32_t
+upcall_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        upcall_cache_register (frame, this, loc->inode);
+
+        STACK_WIND (frame, default_stat_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->stat, loc);
+        return 0;
+}
+
+
+int32_t
+upcall_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
+{
+        upcall_cache_register (frame, this, fd->inode);
+
+        STACK_WIND (frame, default_fstat_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fstat, fd);
+        return 0;
+}
+
+
+int32_t
+upcall_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+             fd_t *fd, int32_t wbflags)
+{
+        upcall_cache_register (frame, this, loc->inode);
+
+        STACK_WIND (frame, default_open_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->open, loc, flags, fd, wbflags);
+        return 0;
+}
+
+
+int32_t
+upcall_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+              off_t offset, uint32_t flags)
+{
+        upcall_cache_register (frame, this, fd->inode);
+
+        STACK_WIND (frame, default_readv_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readv, fd, size, offset, flags);
+        return 0;
+}
+
+
+int32_t
+upcall_readlink (call_frame_t *frame, xlator_t *this, loc_t *loc, size_t size)
+{
+        upcall_cache_register (frame, this, loc->inode);
+
+        STACK_WIND (frame, default_readlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readlink, loc, size);
+        return 0;
+}
+
+
+int32_t
+upcall_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 const char *name)
+{
+        upcall_cache_register (frame, this, loc->inode);
+
+        STACK_WIND (frame, default_getxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->getxattr, loc, name);
+        return 0;
+}
+
+
+int32_t
+upcall_fgetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  const char *name)
+{
+        upcall_cache_register (frame, this, fd->inode);
+
+        STACK_WIND (frame, default_fgetxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fgetxattr, fd, name);
+        return 0;
+}
+
+
+int32_t
+upcall_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, gf_dirent_t *entries)
+{
+        gf_dirent_t *entry = NULL;
+
+        if (op_ret <= 0)
+                goto out;
+
+        list_for_each_entry (entry, &entries->list, list) {
+                upcall_cache_register (frame, this, entry->inode);
+        }
+out:
+        STACK_UNWIND_STRICT (readdirp, frame, op_ret, op_errno, entries);
+        return 0;
+}
+
+
+int32_t
+upcall_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+                 off_t off, dict_t *dict)
+{
+        /* and which names a listed directory has */
+        upcall_cache_register (frame, this, fd->inode);
+
+        STACK_WIND (frame, upcall_readdirp_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readdirp, fd, size, off, dict);
+        return 0;
+}
+
+
+/* fops changing state that clients cache */
+
+int32_t
+upcall_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                   struct iatt *postbuf)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (writev, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+
+int32_t
+upcall_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+               struct iovec *vector, int32_t count, off_t off, uint32_t flags,
+               struct iobref *iobref)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, fd->inode, GF_UPCALL_DATA | GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_writev_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->writev, fd, vector, count, off,
+                    flags, iobref);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (writev, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (truncate, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+
+int32_t
+upcall_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 off_t offset)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_DATA | GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_truncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->truncate, loc, offset);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (truncate, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                      struct iatt *postbuf)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (ftruncate, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+
+int32_t
+upcall_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, fd->inode, GF_UPCALL_DATA | GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_ftruncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->ftruncate, fd, offset);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (ftruncate, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, struct iatt *preop,
+                    struct iatt *postop)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (setattr, frame, op_ret, op_errno, preop, postop);
+        return 0;
+}
+
+
+int32_t
+upcall_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                struct iatt *stbuf, int32_t valid)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_setattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setattr, loc, stbuf, valid);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (setattr, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *preop,
+                     struct iatt *postop)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (fsetattr, frame, op_ret, op_errno, preop, postop);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                 struct iatt *stbuf, int32_t valid)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, fd->inode, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_fsetattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fsetattr, fd, stbuf, valid);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (fsetattr, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (setxattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+
+int32_t
+upcall_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 dict_t *dict, int32_t flags)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_setxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setxattr, loc, dict, flags);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (setxattr, frame, -1, ENOMEM);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (fsetxattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  dict_t *dict, int32_t flags)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, fd->inode, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_fsetxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fsetxattr, fd, dict, flags);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (fsetxattr, frame, -1, ENOMEM);
+        return 0;
+}
+
+
+int32_t
+upcall_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (removexattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+
+int32_t
+upcall_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                    const char *name)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_removexattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->removexattr, loc, name);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (removexattr, frame, -1, ENOMEM);
+        return 0;
+}
+
+
+int32_t
+upcall_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                   struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (unlink, frame, op_ret, op_errno, preparent,
+                             postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_ATTR | GF_UPCALL_ENTRY);
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_unlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->unlink, loc);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (unlink, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                  struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (rmdir, frame, op_ret, op_errno, preparent,
+                             postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->inode, GF_UPCALL_ATTR | GF_UPCALL_ENTRY);
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_rmdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rmdir, loc, flags);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (rmdir, frame, -1, ENOMEM, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                   struct iatt *preoldparent, struct iatt *postoldparent,
+                   struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (rename, frame, op_ret, op_errno, buf,
+                             preoldparent, postoldparent, prenewparent,
+                             postnewparent);
+        return 0;
+}
+
+
+int32_t
+upcall_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+               loc_t *newloc)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, oldloc->inode,
+                          GF_UPCALL_ATTR | GF_UPCALL_ENTRY);
+        upcall_local_add (local, oldloc->parent, GF_UPCALL_ATTR);
+        if (newloc->parent != oldloc->parent)
+                upcall_local_add (local, newloc->parent, GF_UPCALL_ATTR);
+        upcall_local_add (local, newloc->inode,
+                          GF_UPCALL_ATTR | GF_UPCALL_ENTRY);
+
+        STACK_WIND (frame, upcall_rename_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rename, oldloc, newloc);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (rename, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, inode_t *inode,
+                 struct iatt *buf, struct iatt *preparent,
+                 struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (link, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+             loc_t *newloc)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, oldloc->inode, GF_UPCALL_ATTR);
+        upcall_local_add (local, newloc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_link_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->link, oldloc, newloc);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (link, frame, -1, ENOMEM, NULL, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, fd_t *fd, inode_t *inode,
+                   struct iatt *buf, struct iatt *preparent,
+                   struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (create, frame, op_ret, op_errno, fd, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_create_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->create, loc, flags, mode, fd,
+                    params);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (create, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, struct iatt *preparent,
+                  struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              dev_t rdev, dict_t *params)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_mknod_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mknod, loc, mode, rdev, params);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (mknod, frame, -1, ENOMEM, NULL, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, struct iatt *preparent,
+                  struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (mkdir, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              dict_t *params)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_mkdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mkdir, loc, mode, params);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (mkdir, frame, -1, ENOMEM, NULL, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, inode_t *inode,
+                    struct iatt *buf, struct iatt *preparent,
+                    struct iatt *postparent)
+{
+        upcall_local_invalidate (frame, this, op_ret);
+
+        UPCALL_STACK_UNWIND (symlink, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_symlink (call_frame_t *frame, xlator_t *this, const char *linkpath,
+                loc_t *loc, dict_t *params)
+{
+        upcall_local_t *local = NULL;
+
+        local = upcall_local_get (frame, this);
+        if (!local)
+                goto err;
+
+        upcall_local_add (local, loc->parent, GF_UPCALL_ATTR);
+
+        STACK_WIND (frame, upcall_symlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->symlink, linkpath, loc, params);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (symlink, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_forget (xlator_t *this, inode_t *inode)
+{
+        upcall_inode_ctx_t *ctx   = NULL;
+        upcall_client_t    *up    = NULL;
+        upcall_client_t    *tmp   = NULL;
+        uint64_t            value = 0;
+
+        if (inode_ctx_del (inode, this, &value))
+                return 0;
+
+        ctx = (upcall_inode_ctx_t *)(long)value;
+
+        list_for_each_entry_safe (up, tmp, &ctx->clients, list) {
+                list_del (&up->list);
+                GF_FREE (up);
+        }
+
+        LOCK_DESTROY (&ctx->lock);
+        GF_FREE (ctx);
+
+        return 0;
+}
+
+
+int32_t
+upcall_priv_dump (xlator_t *this)
+{
+        upcall_private_t *priv                            = NULL;
+        char              key_prefix[GF_DUMP_MAX_BUF_LEN] = {0, };
+
+        priv = this->private;
+        if (!priv)
+                goto out;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.features.upcall", "priv");
+        gf_proc_dump_add_section (key_prefix);
+
+        LOCK (&priv->lock);
+        {
+                gf_proc_dump_write ("cache_invalidation_timeout", "%d",
+                                    priv->timeout);
+                gf_proc_dump_write ("registered", "%"PRIu64,
+                                    priv->registered);
+                gf_proc_dump_write ("expired", "%"PRIu64, priv->expired);
+                gf_proc_dump_write ("invalidations", "%"PRIu64,
+                                    priv->invalidations);
+        }
+        UNLOCK (&priv->lock);
+out:
+        return 0;
+}
+
+
+int32_t
+upcall_inodectx_dump (xlator_t *this, inode_t *inode)
+{
+        upcall_inode_ctx_t *ctx     = NULL;
+        upcall_client_t    *up      = NULL;
+        uint64_t            value   = 0;
+        time_t              now     = 0;
+        int                 i       = 0;
+        char                key[GF_DUMP_MAX_BUF_LEN]        = {0, };
+        char                key_prefix[GF_DUMP_MAX_BUF_LEN] = {0, };
+
+        if (inode_ctx_get (inode, this, &value))
+                goto out;
+
+        ctx = (upcall_inode_ctx_t *)(long)value;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.features.upcall",
+                                "inodectx");
+        gf_proc_dump_add_section (key_prefix);
+
+        time (&now);
+
+        LOCK (&ctx->lock);
+        {
+                list_for_each_entry (up, &ctx->clients, list) {
+                        gf_proc_dump_build_key (key, "client", "%d", i++);
+                        gf_proc_dump_write (key, "%p, last access %lds ago",
+                                            up->client,
+                                            (long)(now - up->access_time));
+                }
+        }
+        UNLOCK (&ctx->lock);
+out:
+        return 0;
+}
+
+
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        upcall_private_t *priv = NULL;
+        int               ret  = -1;
+
+        priv = this->private;
+
+        GF_OPTION_RECONF ("cache-invalidation-timeout", priv->timeout, options,
+                          int32, out);
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int ret = -1;
+
+        if (!this)
+                return ret;
+
+        ret = xlator_mem_acct_init (this, gf_upcall_mt_end + 1);
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Memory accounting init "
+                        "failed");
+                return ret;
+        }
+
+        return ret;
+}
+
+
+int
+init (xlator_t *this)
+{
+        upcall_private_t *priv = NULL;
+        int               ret  = -1;
+
+        if (!this->children || this->children->next) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "FATAL: upcall should have exactly one child");
+                goto out;
+        }
+
+        if (!this->parents) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dangling volume. check volfile ");
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_upcall_mt_private_t);
+        if (!priv)
+                goto out;
+
+        LOCK_INIT (&priv->lock);
+
+        GF_OPTION_INIT ("cache-invalidation-timeout", priv->timeout, int32,
+                        out);
+
+        this->local_pool = mem_pool_new (upcall_local_t, 512);
+        if (!this->local_pool) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to create local_t's memory pool");
+                goto out;
+        }
+
+        this->private = priv;
+        ret = 0;
+out:
+        if (ret && priv) {
+                LOCK_DESTROY (&priv->lock);
+                GF_FREE (priv);
+        }
+
+        return ret;
+}
+
+
+void
+fini (xlator_t *this)
+{
+        upcall_private_t *priv = NULL;
+
+        priv = this->private;
+        if (!priv)
+                return;
+
+        this->private = NULL;
+        LOCK_DESTROY (&priv->lock);
+        GF_FREE (priv);
+
+        return;
+}
+
+
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        return default_notify (this, event, data);
+}
+
+
+struct xlator_fops fops = {
+        .lookup      = upcall_lookup,
+        .stat        = upcall_stat,
+        .fstat       = upcall_fstat,
+        .open        = upcall_open,
+        .readv       = upcall_readv,
+        .readlink    = upcall_readlink,
+        .getxattr    = upcall_getxattr,
+        .fgetxattr   = upcall_fgetxattr,
+        .readdirp    = upcall_readdirp,
+
+        .writev      = upcall_writev,
+        .truncate    = upcall_truncate,
+        .ftruncate   = upcall_ftruncate,
+        .setattr     = upcall_setattr,
+        .fsetattr    = upcall_fsetattr,
+        .setxattr    = upcall_setxattr,
+        .fsetxattr   = upcall_fsetxattr,
+        .removexattr = upcall_removexattr,
+        .unlink      = upcall_unlink,
+        .rmdir       = upcall_rmdir,
+        .rename      = upcall_rename,
+        .link        = upcall_link,
+        .create      = upcall_create,
+        .mknod       = upcall_mknod,
+        .mkdir       = upcall_mkdir,
+        .symlink     = upcall_symlink,
+};
+
+struct xlator_cbks cbks = {
+        .forget      = upcall_forget,
+};
+
+struct xlator_dumpops dumpops = {
+        .priv        = upcall_priv_dump,
+        .inodectx    = upcall_inodectx_dump,
+};
+
+struct volume_options options[] = {
+        { .key  = {"cache-invalidation-timeout"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 3600,
+          .default_value = "600",
+          .description = "How long (in seconds) a client is sent "
+                         "invalidations for an inode after it last accessed "
+                         "it. Must be at least as long as the cache timeouts "
+                         "of the clients."
+        },
+        { .key  = {NULL} },
+};
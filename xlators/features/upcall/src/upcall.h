@@ -0,0 +1,76 @@
+/*
+   Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __UPCALL_H__
+#define __UPCALL_H__
+
+#include "xlator.h"
+#include "defaults.h"
+#include "upcall-utils.h"
+#include "upcall-mem-types.h"
+
+/* a rename touches at most both parents, the source and the target */
+#define UPCALL_MAX_INODES 4
+
+/* A client which has been handed the attributes or the contents of the
+ * inode, and may still be serving them from its caches.
+ */
+typedef struct upcall_client {
+        struct list_head  list;
+        void             *client;       /* connection, from frame->root */
+        time_t            access_time;
+} upcall_client_t;
+
+typedef struct upcall_inode_ctx {
+        gf_lock_t         lock;
+        struct list_head  clients;
+} upcall_inode_ctx_t;
+
+typedef struct upcall_private {
+        gf_lock_t         lock;
+        int32_t           timeout;
+        uint64_t          registered;   /* clients added to an inode */
+        uint64_t          expired;      /* clients dropped on timeout */
+        uint64_t          invalidations;/* upcalls sent */
+} upcall_private_t;
+
+typedef struct upcall_local {
+        inode_t          *inodes[UPCALL_MAX_INODES];
+        uint32_t          flags[UPCALL_MAX_INODES];
+        int               count;
+} upcall_local_t;
+
+#define UPCALL_STACK_UNWIND(fop, frame, params ...)             \
+do {                                                            \
+        upcall_local_t *__local = NULL;                         \
+        xlator_t       *__this  = NULL;                         \
+        if (frame) {                                            \
+                __local = frame->local;                         \
+                __this  = frame->this;                          \
+                frame->local = NULL;                            \
+        }                                                       \
+        STACK_UNWIND_STRICT (fop, frame, params);               \
+        upcall_local_wipe (__this, __local);                    \
+} while (0)
+
+void
+upcall_local_wipe (xlator_t *this, upcall_local_t *local);
+
+#endif /* __UPCALL_H__ */
@@ -112,9 +112,12 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.lookup-unhashed",              "cluster/distribute", NULL, NULL, NO_DOC, 0    },
         {"cluster.min-free-disk",                "cluster/distribute", NULL, NULL, NO_DOC, 0    },
         {"cluster.min-free-inodes",              "cluster/distribute", NULL, NULL, NO_DOC, 0    },
+        {"cluster.parallel-readdir",             "cluster/distribute", NULL, NULL, NO_DOC, 0    },
+        {"cluster.readdir-prefetch-size",        "cluster/distribute", NULL, NULL, NO_DOC, 0    },
 
         {"cluster.entry-change-log",             "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.read-subvolume",               "cluster/replicate",  NULL, NULL, NO_DOC, 0    },
+        {"cluster.read-policy",                  "cluster/replicate",  NULL, NULL, NO_DOC, 0    },
         {"cluster.background-self-heal-count",   "cluster/replicate",  NULL, NULL, NO_DOC, 0    },
         {"cluster.metadata-self-heal",           "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.data-self-heal",               "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
@@ -125,7 +128,9 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.data-change-log",              "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.metadata-change-log",          "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.data-self-heal-algorithm",     "cluster/replicate",         "data-self-heal-algorithm", NULL,DOC, 0},
+        {"cluster.data-self-heal-checksum",      "cluster/replicate",         "data-self-heal-checksum", NULL, DOC, 0},
         {"cluster.eager-lock",                   "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
+        {"cluster.post-op-delay-secs",           "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.quorum-type",                  "cluster/replicate",  "quorum-type", NULL, NO_DOC, 0},
         {"cluster.quorum-count",                 "cluster/replicate",  "quorum-count", NULL, NO_DOC, 0},
 
@@ -134,6 +139,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {VKEY_DIAG_LAT_MEASUREMENT,              "debug/io-stats",     "latency-measurement", "off", NO_DOC, 0},
         {"diagnostics.dump-fd-stats",            "debug/io-stats",     NULL, NULL, NO_DOC, 0},
         {VKEY_DIAG_CNT_FOP_HITS,                 "debug/io-stats",     "count-fop-hits", "off", NO_DOC, 0},
+        {"diagnostics.shm-stats",                "debug/io-stats",     "shm-stats", NULL, DOC, 0},
 
         {"diagnostics.brick-log-level",          "debug/io-stats",     "!brick-log-level", NULL, DOC, 0},
         {"diagnostics.client-log-level",         "debug/io-stats",     "!client-log-level", NULL, DOC, 0},
@@ -147,6 +153,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"performance.cache-size",               "performance/io-cache",      NULL, NULL, NO_DOC, 0 },
         {"performance.cache-size",               "performance/quick-read",    NULL, NULL, NO_DOC, 0 },
         {"performance.flush-behind",             "performance/write-behind",  "flush-behind", NULL, DOC, 0},
+        {"performance.write-behind-compound-fops", "performance/write-behind", "compound-fops", NULL, DOC, 0},
 
         {"performance.io-thread-count",          "performance/io-threads",    "thread-count", DOC, 0},
         {"performance.disk-usage-limit",         "performance/quota",         NULL, NULL, NO_DOC, 0},
@@ -157,6 +164,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"network.frame-timeout",                "protocol/client",           NULL, NULL, NO_DOC, 0},
         {"network.ping-timeout",                 "protocol/client",           NULL, NULL, NO_DOC, 0},
         {"network.tcp-window-size",              "protocol/client",           NULL, NULL, NO_DOC, 0},
+        {"network.channel-count",                "protocol/client",           NULL, NULL, DOC, 0},
 
         {"network.tcp-window-size",              "protocol/server",           NULL, NULL, NO_DOC, 0},
         {"network.inode-lru-limit",              "protocol/server",           NULL, NULL, NO_DOC, 0},
@@ -215,6 +223,8 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"client.grace-timeout",                 "protocol/client",           "grace-timeout", NULL, DOC, 0},
         {"server.grace-timeout",                 "protocol/server",           "grace-timeout", NULL, DOC, 0},
         {"feature.read-only",                    "features/read-only",        "!read-only", "off", DOC, 0},
+        {"features.cache-invalidation",          "features/upcall",           "!cache-invalidation", "off", DOC, 0},
+        {"features.cache-invalidation-timeout",  "features/upcall",           "cache-invalidation-timeout", NULL, DOC, 0},
         {NULL,                                                                }
 };
 
@@ -1728,6 +1738,16 @@ server_graph_builder (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
                 }
         }
 
+        /* Track which clients cache what, and tell them when it changes */
+        if (dict_get_str_boolean (set_dict, "features.cache-invalidation",
+                                  0)) {
+                xl = volgen_graph_add (graph, "features/upcall", volname);
+                if (!xl) {
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         xl = volgen_graph_add_as (graph, "debug/io-stats", path);
         if (!xl)
                 return -1;
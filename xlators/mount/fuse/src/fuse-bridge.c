@@ -72,6 +72,192 @@ out:
 }
 
 
+static void
+fuse_pipe_destroy (void *data)
+{
+        fuse_pipe_t *pipe = data;
+
+        close (pipe->fds[0]);
+        close (pipe->fds[1]);
+        GF_FREE (pipe);
+}
+
+
+#ifdef GF_LINUX_HOST_OS
+/* pipe of the calling thread, big enough for a request or a reply with the
+   largest payload, so that a message always goes through it in one go */
+static fuse_pipe_t *
+fuse_pipe_get (xlator_t *this)
+{
+        fuse_private_t *priv = NULL;
+        fuse_pipe_t    *pipe = NULL;
+        int             size = 0;
+
+        priv = this->private;
+
+        pipe = pthread_getspecific (priv->pipe_key);
+        if (pipe)
+                return pipe;
+
+        pipe = GF_CALLOC (1, sizeof (*pipe), gf_fuse_mt_fuse_pipe_t);
+        if (!pipe)
+                return NULL;
+
+        if (pipe2 (pipe->fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+                gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                        "cannot create splice pipe (%s)", strerror (errno));
+                GF_FREE (pipe);
+                return NULL;
+        }
+
+        size = 2 * ((struct iobuf_pool *)this->ctx->iobuf_pool)
+                ->default_page_size;
+        size = fcntl (pipe->fds[0], F_SETPIPE_SZ, size);
+        if (size == -1) {
+                gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                        "cannot resize splice pipe (%s)", strerror (errno));
+                fuse_pipe_destroy (pipe);
+                return NULL;
+        }
+        pipe->size = size;
+
+        pthread_setspecific (priv->pipe_key, pipe);
+
+        return pipe;
+}
+
+
+static void
+fuse_pipe_drain (fuse_pipe_t *pipe)
+{
+        char buf[4096];
+
+        while (read (pipe->fds[0], buf, sizeof (buf)) > 0)
+                ;
+}
+
+
+/* Sends a reply by mapping its buffers into the pipe of the thread and
+ * splicing that into /dev/fuse. Returns -1 with nothing sent if the reply
+ * has to go through writev instead.
+ */
+static ssize_t
+fuse_splice_iov (xlator_t *this, struct iovec *iov_out, int count,
+                 size_t len)
+{
+        fuse_private_t *priv = NULL;
+        fuse_pipe_t    *pipe = NULL;
+        struct iovec    vec[FUSE_SPLICE_IOV];
+        struct iovec   *cur = vec;
+        ssize_t         res = 0;
+        size_t          done = 0;
+
+        priv = this->private;
+
+        if (count > FUSE_SPLICE_IOV)
+                return -1;
+
+        pipe = fuse_pipe_get (this);
+        if (!pipe || len > pipe->size)
+                return -1;
+
+        memcpy (vec, iov_out, count * sizeof (*vec));
+
+        /* the pipe only references the pages of the reply, it is emptied
+           into /dev/fuse before the caller can release them */
+        while (done < len) {
+                res = vmsplice (pipe->fds[1], cur, count, SPLICE_F_NONBLOCK);
+                if (res <= 0)
+                        goto err;
+
+                done += res;
+                while (count && res >= cur->iov_len) {
+                        res -= cur->iov_len;
+                        cur++;
+                        count--;
+                }
+                if (count) {
+                        cur->iov_base += res;
+                        cur->iov_len  -= res;
+                }
+        }
+
+        res = splice (pipe->fds[0], NULL, priv->fd, NULL, len, SPLICE_F_MOVE);
+        if (res == len)
+                return res;
+
+err:
+        if (res == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                priv->splice_write = 0;
+                gf_log ("glusterfs-fuse", GF_LOG_INFO,
+                        "splicing replies into /dev/fuse failed (%s), "
+                        "using writev", strerror (errno));
+        }
+        fuse_pipe_drain (pipe);
+
+        return -1;
+}
+
+
+/* Reads a request by splicing it from /dev/fuse into the pipe of the
+ * thread and laying it out over @iov_in just like readv would. Returns
+ * -2 with nothing read if the request has to be read with readv instead.
+ */
+static ssize_t
+fuse_splice_readv (xlator_t *this, struct iovec *iov_in, int count)
+{
+        fuse_private_t *priv = NULL;
+        fuse_pipe_t    *pipe = NULL;
+        ssize_t         res = 0;
+        size_t          len = 0;
+        int             i = 0;
+
+        priv = this->private;
+
+        for (i = 0; i < count; i++)
+                len += iov_in[i].iov_len;
+
+        pipe = fuse_pipe_get (this);
+        if (!pipe || len > pipe->size)
+                return -2;
+
+        res = splice (priv->fd, NULL, pipe->fds[1], NULL, len, SPLICE_F_MOVE);
+        if (res == -1) {
+                if (errno == EINVAL || errno == ENOSYS) {
+                        priv->splice_read = 0;
+                        gf_log ("glusterfs-fuse", GF_LOG_INFO,
+                                "splicing requests from /dev/fuse failed "
+                                "(%s), using readv", strerror (errno));
+                        return -2;
+                }
+                return -1;
+        }
+
+        if (readv (pipe->fds[0], iov_in, count) != res) {
+                fuse_pipe_drain (pipe);
+                errno = EIO;
+                return -1;
+        }
+
+        return res;
+}
+#else
+static ssize_t
+fuse_splice_iov (xlator_t *this, struct iovec *iov_out, int count,
+                 size_t len)
+{
+        return -1;
+}
+
+
+static ssize_t
+fuse_splice_readv (xlator_t *this, struct iovec *iov_in, int count)
+{
+        return -2;
+}
+#endif /* GF_LINUX_HOST_OS */
+
+
 /*
  * iov_out should contain a fuse_out_header at zeroth position.
  * The error value of this header is sent to kernel.
@@ -97,7 +283,11 @@ send_fuse_iov (xlator_t *this, fuse_in_header_t *finh, struct iovec *iov_out,
                 fouh->len += iov_out[i].iov_len;
         fouh->unique = finh->unique;
 
-        res = writev (priv->fd, iov_out, count);
+        res = -1;
+        if (priv->splice_write && fouh->len >= FUSE_SPLICE_MIN)
+                res = fuse_splice_iov (this, iov_out, count, fouh->len);
+        if (res == -1)
+                res = writev (priv->fd, iov_out, count);
 
         if (res == -1)
                 return errno;
@@ -187,6 +377,81 @@ fuse_invalidate (xlator_t *this, uint64_t fuse_ino)
         }
 }
 
+static void
+fuse_invalidate_inode (xlator_t *this, uint64_t fuse_ino)
+{
+        struct fuse_out_header             *fouh   = NULL;
+        struct fuse_notify_inval_inode_out *fniio  = NULL;
+        fuse_private_t                     *priv   = NULL;
+        int                                 rv     = 0;
+
+        char inval_buf[INVAL_BUF_SIZE] = {0,};
+
+        fouh  = (struct fuse_out_header *)inval_buf;
+        fniio = (struct fuse_notify_inval_inode_out *)(fouh + 1);
+
+        priv = this->private;
+        if (priv->revchan_out == -1)
+                return;
+
+        fouh->unique = 0;
+        fouh->error = FUSE_NOTIFY_INVAL_INODE;
+        fouh->len = sizeof (*fouh) + sizeof (*fniio);
+
+        /* attributes and all of the page cache */
+        fniio->ino = fuse_ino;
+        fniio->off = 0;
+        fniio->len = 0;
+
+        rv = write (priv->revchan_out, inval_buf, fouh->len);
+        if (rv != fouh->len) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "kernel notification daemon defunct");
+
+                close (priv->fd);
+                return;
+        }
+
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE, "INVALIDATE inode: %"PRIu64,
+                fuse_ino);
+}
+
+
+/* A brick told us another client changed this inode: have the kernel drop
+ * what it cached for it too.
+ */
+static int
+fuse_upcall (xlator_t *this, struct gf_upcall *upcall)
+{
+        fuse_private_t *priv   = NULL;
+        xlator_t       *top    = NULL;
+        inode_t        *inode  = NULL;
+        uint64_t        nodeid = 0;
+
+        priv = this->private;
+
+        top = priv->active_subvol;
+        if (!top || !top->itable)
+                return 0;
+
+        inode = inode_find (top->itable, upcall->gfid);
+        if (!inode)
+                return 0;
+
+        nodeid = inode_to_fuse_nodeid (inode);
+
+        if (upcall->flags & (GF_UPCALL_ATTR | GF_UPCALL_DATA))
+                fuse_invalidate_inode (this, nodeid);
+
+        if (upcall->flags & GF_UPCALL_ENTRY)
+                fuse_invalidate (this, nodeid);
+
+        inode_unref (inode);
+
+        return 0;
+}
+
+
 int
 send_fuse_err (xlator_t *this, fuse_in_header_t *finh, int error)
 {
@@ -2009,8 +2274,6 @@ void
 fuse_write_resume (fuse_state_t *state)
 {
         struct iobref *iobref = NULL;
-        struct iobuf  *iobuf = NULL;
-
 
         iobref = iobref_new ();
         if (!iobref) {
@@ -2023,8 +2286,7 @@ fuse_write_resume (fuse_state_t *state)
                 return;
         }
 
-        iobuf = ((fuse_private_t *) (state->this->private))->iobuf;
-        iobref_add (iobref, iobuf);
+        iobref_add (iobref, state->iobuf);
 
         gf_log ("glusterfs-fuse", GF_LOG_TRACE,
                 "%"PRIu64": WRITE (%p, size=%"PRId64", offset=%"PRId64")",
@@ -2048,6 +2310,7 @@ fuse_write (xlator_t *this, fuse_in_header_t *finh, void *msg)
         fuse_private_t  *priv = NULL;
         fuse_state_t    *state = NULL;
         fd_t            *fd = NULL;
+        fuse_reader_t   *reader = NULL;
 
         priv = this->private;
 
@@ -2057,6 +2320,11 @@ fuse_write (xlator_t *this, fuse_in_header_t *finh, void *msg)
         state->size = fwi->size;
         state->off  = fwi->offset;
 
+        /* payload lives in the iobuf the reader thread read it into,
+           keep it around until the write is resumed */
+        reader = pthread_getspecific (priv->reader_key);
+        state->iobuf = iobuf_ref (reader->iobuf);
+
         /* lets ignore 'fwi->write_flags', but just consider 'fwi->flags' */
         state->io_flags = fwi->flags;
         /* TODO: may need to handle below flag
@@ -3331,7 +3599,7 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                 fino.congestion_threshold = 48;
         }
         if (fini->minor < 9)
-                *priv->msg0_len_p = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
+                priv->msg0_len = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
 #endif
         ret = send_fuse_obj (this, finh, &fino);
         if (ret == 0)
@@ -3803,12 +4071,57 @@ unlock:
 }
 
 
+/* wait till every request read from /dev/fuse before this one has been
+   handed to its fop handler */
+static void
+fuse_reader_wait_ordered (fuse_private_t *priv, fuse_reader_t *reader)
+{
+        int  i = 0;
+        int  earlier = 0;
+
+        pthread_mutex_lock (&priv->order_mutex);
+        {
+                do {
+                        earlier = 0;
+                        for (i = 0; i < priv->reader_thread_count; i++) {
+                                if (priv->readers[i].seq &&
+                                    priv->readers[i].seq < reader->seq) {
+                                        earlier = 1;
+                                        break;
+                                }
+                        }
+
+                        if (earlier)
+                                pthread_cond_wait (&priv->order_cond,
+                                                   &priv->order_mutex);
+                } while (earlier);
+        }
+        pthread_mutex_unlock (&priv->order_mutex);
+}
+
+
+static void
+fuse_reader_done (fuse_private_t *priv, fuse_reader_t *reader)
+{
+        pthread_mutex_lock (&priv->order_mutex);
+        {
+                if (reader->seq) {
+                        reader->seq = 0;
+                        reader->requests++;
+                        pthread_cond_broadcast (&priv->order_cond);
+                }
+        }
+        pthread_mutex_unlock (&priv->order_mutex);
+}
+
+
 static void *
 fuse_thread_proc (void *data)
 {
         char           *mount_point = NULL;
         xlator_t       *this = NULL;
         fuse_private_t *priv = NULL;
+        fuse_reader_t  *reader = NULL;
         ssize_t         res = 0;
         struct iobuf   *iobuf = NULL;
         fuse_in_header_t *finh;
@@ -3816,17 +4129,19 @@ fuse_thread_proc (void *data)
         void *msg = NULL;
         const size_t msg0_size = sizeof (*finh) + 128;
         fuse_handler_t **fuse_ops = NULL;
+        char            exiting = 0;
 
-        this = data;
+        reader = data;
+        this = reader->this;
         priv = this->private;
         fuse_ops = priv->fuse_ops;
 
         THIS = this;
 
-        iov_in[0].iov_len = sizeof (*finh) + sizeof (struct fuse_write_in);
+        pthread_setspecific (priv->reader_key, reader);
+
         iov_in[1].iov_len = ((struct iobuf_pool *)this->ctx->iobuf_pool)
                               ->default_page_size;
-        priv->msg0_len_p = &iov_in[0].iov_len;
 
         for (;;) {
                 /* THIS has to be reset here */
@@ -3863,7 +4178,27 @@ fuse_thread_proc (void *data)
 
                 iov_in[1].iov_base = iobuf->ptr;
 
-                res = readv (priv->fd, iov_in, 2);
+                /* one reader at a time, so that read tickets follow the
+                   order in which the kernel handed out requests */
+                pthread_mutex_lock (&priv->reader_mutex);
+                {
+                        iov_in[0].iov_len = priv->msg0_len;
+
+                        res = -2;
+                        if (priv->splice_read)
+                                res = fuse_splice_readv (this, iov_in, 2);
+                        if (res == -2)
+                                res = readv (priv->fd, iov_in, 2);
+
+                        if (res > 0) {
+                                pthread_mutex_lock (&priv->order_mutex);
+                                {
+                                        reader->seq = ++priv->read_seq;
+                                }
+                                pthread_mutex_unlock (&priv->order_mutex);
+                        }
+                }
+                pthread_mutex_unlock (&priv->reader_mutex);
 
                 if (res == -1) {
                         if (errno == ENODEV || errno == EBADF) {
@@ -3906,7 +4241,7 @@ fuse_thread_proc (void *data)
                         break;
                 }
 
-                priv->iobuf = iobuf;
+                reader->iobuf = iobuf;
 
                 if (finh->opcode == FUSE_WRITE)
                         msg = iov_in[1].iov_base;
@@ -3937,6 +4272,9 @@ fuse_thread_proc (void *data)
                     finh->uid == priv->uid_map_root)
                         finh->uid = 0;
 
+                if (FUSE_OP_IS_ORDERED (finh->opcode))
+                        fuse_reader_wait_ordered (priv, reader);
+
 #ifdef GF_DARWIN_HOST_OS
                 if (finh->opcode >= FUSE_OP_HIGH)
                         /* turn down MacFUSE specific messages */
@@ -3945,17 +4283,37 @@ fuse_thread_proc (void *data)
 #endif
                 fuse_ops[finh->opcode] (this, finh, msg);
 
+                fuse_reader_done (priv, reader);
+                reader->iobuf = NULL;
+
                 iobuf_unref (iobuf);
                 continue;
 
  cont_err:
+                fuse_reader_done (priv, reader);
+                reader->iobuf = NULL;
+
                 iobuf_unref (iobuf);
                 GF_FREE (iov_in[0].iov_base);
         }
 
+        fuse_reader_done (priv, reader);
+        reader->iobuf = NULL;
+
         iobuf_unref (iobuf);
         GF_FREE (iov_in[0].iov_base);
 
+        /* the first reader to stop takes the mount down */
+        pthread_mutex_lock (&priv->order_mutex);
+        {
+                exiting = priv->readers_exiting;
+                priv->readers_exiting = 1;
+        }
+        pthread_mutex_unlock (&priv->order_mutex);
+
+        if (exiting)
+                return NULL;
+
         if (dict_get (this->options, ZR_MOUNTPOINT_OPT))
                 mount_point = data_to_str (dict_get (this->options,
                                                      ZR_MOUNTPOINT_OPT));
@@ -3987,6 +4345,8 @@ int32_t
 fuse_priv_dump (xlator_t  *this)
 {
         fuse_private_t  *private = NULL;
+        char             key[GF_DUMP_MAX_BUF_LEN];
+        int              i = 0;
 
         if (!this)
                 return -1;
@@ -4007,12 +4367,21 @@ fuse_priv_dump (xlator_t  *this)
                             private->volfile_size);
         gf_proc_dump_write("mount_point", "%s",
                             private->mount_point);
-        gf_proc_dump_write("iobuf", "%u",
-                            private->iobuf);
         gf_proc_dump_write("fuse_thread_started", "%d",
                             (int)private->fuse_thread_started);
+        gf_proc_dump_write("reader_thread_count", "%u",
+                            private->reader_thread_count);
+        for (i = 0; private->fuse_thread_started &&
+                    i < private->reader_thread_count; i++) {
+                snprintf (key, sizeof (key), "reader[%d].requests", i);
+                gf_proc_dump_write(key, "%"PRIu64,
+                                   private->readers[i].requests);
+        }
         gf_proc_dump_write("direct_io_mode", "%d",
                             private->direct_io_mode);
+        gf_proc_dump_write("use_splice", "%d", (int)private->use_splice);
+        gf_proc_dump_write("splice_read", "%d", (int)private->splice_read);
+        gf_proc_dump_write("splice_write", "%d", (int)private->splice_write);
         gf_proc_dump_write("entry_timeout", "%lf",
                             private->entry_timeout);
         gf_proc_dump_write("attribute_timeout", "%lf",
@@ -4074,9 +4443,13 @@ notify (xlator_t *this, int32_t event, void *data, ...)
         int32_t             ret     = 0;
         fuse_private_t     *private = NULL;
         glusterfs_graph_t  *graph = NULL;
+        int                 i = 0;
 
         private = this->private;
 
+        if (event == GF_EVENT_UPCALL)
+                return fuse_upcall (this, data);
+
         graph = data;
 
         gf_log ("fuse", GF_LOG_DEBUG, "got event %d on graph %d",
@@ -4111,13 +4484,16 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                 if (!private->fuse_thread_started) {
                         private->fuse_thread_started = 1;
 
-                        ret = pthread_create (&private->fuse_thread, NULL,
-                                              fuse_thread_proc, this);
-                        if (ret != 0) {
-                                gf_log (this->name, GF_LOG_DEBUG,
-                                        "pthread_create() failed (%s)",
-                                        strerror (errno));
-                                break;
+                        for (i = 0; i < private->reader_thread_count; i++) {
+                                ret = pthread_create (&private->readers[i].thread,
+                                                      NULL, fuse_thread_proc,
+                                                      &private->readers[i]);
+                                if (ret != 0) {
+                                        gf_log (this->name, GF_LOG_DEBUG,
+                                                "pthread_create() failed (%s)",
+                                                strerror (errno));
+                                        break;
+                                }
                         }
                 }
 
@@ -4344,6 +4720,32 @@ init (xlator_t *this_xl)
         if (ret != 0)
                 priv->uid_map_root = 0;
 
+        ret = dict_get_uint32 (options, "reader-thread-count",
+                               &priv->reader_thread_count);
+        if (ret != 0)
+                priv->reader_thread_count = 1; /* default */
+        if (priv->reader_thread_count < 1 ||
+            priv->reader_thread_count > FUSE_MAX_READER_THREADS) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "invalid reader-thread-count %u (valid range 1-%d)",
+                        priv->reader_thread_count, FUSE_MAX_READER_THREADS);
+                goto cleanup_exit;
+        }
+
+        priv->readers = GF_CALLOC (priv->reader_thread_count,
+                                   sizeof (*priv->readers),
+                                   gf_fuse_mt_fuse_reader_t);
+        if (!priv->readers) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "Out of memory");
+
+                goto cleanup_exit;
+        }
+        for (i = 0; i < priv->reader_thread_count; i++) {
+                priv->readers[i].this = this_xl;
+                priv->readers[i].idx  = i;
+        }
+
         priv->direct_io_mode = 2;
         ret = dict_get_str (options, ZR_DIRECT_IO_OPT, &value_string);
         if (ret == 0) {
@@ -4375,6 +4777,21 @@ init (xlator_t *this_xl)
                 GF_ASSERT (ret == 0);
         }
 
+        priv->use_splice = 0;
+        ret = dict_get_str (options, "use-splice", &value_string);
+        if (ret == 0) {
+                ret = gf_string2boolean (value_string, &priv->use_splice);
+                GF_ASSERT (ret == 0);
+        }
+#ifndef GF_LINUX_HOST_OS
+        if (priv->use_splice) {
+                gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                        "splice is only supported on Linux");
+                priv->use_splice = 0;
+        }
+#endif
+        priv->splice_read = priv->splice_write = priv->use_splice;
+
         priv->fuse_dump_fd = -1;
         ret = dict_get_str (options, "dump-fuse", &value_string);
         if (ret == 0) {
@@ -4445,6 +4862,28 @@ init (xlator_t *this_xl)
         pthread_mutex_init (&priv->sync_mutex, NULL);
         priv->event_recvd = 0;
 
+        pthread_mutex_init (&priv->reader_mutex, NULL);
+        pthread_mutex_init (&priv->order_mutex, NULL);
+        pthread_cond_init (&priv->order_cond, NULL);
+        priv->msg0_len = sizeof (struct fuse_in_header) +
+                         sizeof (struct fuse_write_in);
+
+        ret = pthread_key_create (&priv->reader_key, NULL);
+        if (ret != 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "failed to create reader thread key (%s)",
+                        strerror (ret));
+                goto cleanup_exit;
+        }
+
+        ret = pthread_key_create (&priv->pipe_key, fuse_pipe_destroy);
+        if (ret != 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "failed to create splice pipe key (%s)",
+                        strerror (ret));
+                goto cleanup_exit;
+        }
+
         for (i = 0; i < FUSE_OP_HIGH; i++) {
                 if (!fuse_std_ops[i])
                         fuse_std_ops[i] = fuse_enosys;
@@ -4469,6 +4908,7 @@ cleanup_exit:
                 GF_FREE (fsname);
         if (priv) {
                 GF_FREE (priv->mount_point);
+                GF_FREE (priv->readers);
                 close (priv->fd);
                 close (priv->fuse_dump_fd);
                 GF_FREE (priv);
@@ -4551,5 +4991,20 @@ struct volume_options options[] = {
         { .key = {"read-only"},
           .type = GF_OPTION_TYPE_BOOL
         },
+        { .key = {"reader-thread-count"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = FUSE_MAX_READER_THREADS,
+          .default_value = "1",
+          .description = "Number of threads reading requests from "
+                         "/dev/fuse."
+        },
+        { .key = {"use-splice"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Splice read replies into /dev/fuse and requests "
+                         "out of it through a pipe instead of copying them "
+                         "with writev and readv."
+        },
         { .key = {NULL} },
 };
@@ -55,6 +55,7 @@
 #include "list.h"
 #include "dict.h"
 #include "syncop.h"
+#include "upcall-utils.h"
 
 #if defined(GF_LINUX_HOST_OS) || defined(__NetBSD__)
 #define FUSE_OP_HIGH (FUSE_POLL + 1)
@@ -66,25 +67,67 @@
 
 #define MAX_FUSE_PROC_DELAY 1
 
+#define FUSE_MAX_READER_THREADS 64
+
+/* replies smaller than this are not worth a trip through a pipe */
+#define FUSE_SPLICE_MIN   4096
+#define FUSE_SPLICE_IOV   16
+
+/* requests that must not overtake anything read from /dev/fuse before them */
+#define FUSE_OP_IS_ORDERED(op) ((op) == FUSE_FORGET || (op) == FUSE_INTERRUPT)
+
 #define DISABLE_SELINUX 1
 
 typedef struct fuse_in_header fuse_in_header_t;
 typedef void (fuse_handler_t) (xlator_t *this, fuse_in_header_t *finh,
                                void *msg);
 
+struct fuse_reader {
+        xlator_t            *this;
+        int                  idx;
+        pthread_t            thread;
+        struct iobuf        *iobuf;     /* payload of the request in hand */
+        uint64_t             seq;       /* read ticket, 0 while idle */
+        uint64_t             requests;  /* requests dispatched */
+};
+typedef struct fuse_reader fuse_reader_t;
+
+/* per thread pipe for splicing to and from /dev/fuse */
+struct fuse_pipe {
+        int                  fds[2];
+        size_t               size;
+};
+typedef struct fuse_pipe fuse_pipe_t;
+
 struct fuse_private {
         int                  fd;
         uint32_t             proto_minor;
         char                *volfile;
         size_t               volfile_size;
         char                *mount_point;
-        struct iobuf        *iobuf;
 
-        pthread_t            fuse_thread;
         char                 fuse_thread_started;
+        uint32_t             reader_thread_count;
+        fuse_reader_t       *readers;
+        pthread_key_t        reader_key;
+
+        /* serialises readv on /dev/fuse and hands out read tickets */
+        pthread_mutex_t      reader_mutex;
+        uint64_t             read_seq;
+
+        /* ordered requests wait here for earlier tickets to dispatch */
+        pthread_mutex_t      order_mutex;
+        pthread_cond_t       order_cond;
+        char                 readers_exiting;
 
         uint32_t             direct_io_mode;
-        size_t              *msg0_len_p;
+        size_t               msg0_len;
+
+        /* splice data path, turned off for good if the kernel refuses it */
+        gf_boolean_t         use_splice;
+        char                 splice_read;
+        char                 splice_write;
+        pthread_key_t        pipe_key;
 
         double               entry_timeout;
         double               attribute_timeout;
@@ -322,6 +365,7 @@ typedef struct {
         uuid_t         gfid;
         uint32_t       io_flags;
         int32_t        fd_no;
+        struct iobuf  *iobuf;
 } fuse_state_t;
 
 typedef struct fuse_fd_ctx {
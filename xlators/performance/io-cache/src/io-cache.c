@@ -26,9 +26,11 @@
 #include "logging.h"
 #include "dict.h"
 #include "xlator.h"
+#include "defaults.h"
 #include "io-cache.h"
 #include "ioc-mem-types.h"
 #include "statedump.h"
+#include "upcall-utils.h"
 #include <assert.h>
 #include <sys/time.h>
 
@@ -53,43 +55,6 @@ ioc_hashfn (void *data, int len)
         return (offset >> ioc_log2_page_size);
 }
 
-inline ioc_inode_t *
-ioc_inode_reupdate (ioc_inode_t *ioc_inode)
-{
-        ioc_table_t *table = NULL;
-
-        table = ioc_inode->table;
-
-        list_add_tail (&ioc_inode->inode_lru,
-                       &table->inode_lru[ioc_inode->weight]);
-
-        return ioc_inode;
-}
-
-inline ioc_inode_t *
-ioc_get_inode (dict_t *dict, char *name)
-{
-        ioc_inode_t *ioc_inode      = NULL;
-        data_t      *ioc_inode_data = NULL;
-        ioc_table_t *table          = NULL;
-
-        ioc_inode_data = dict_get (dict, name);
-        if (ioc_inode_data) {
-                ioc_inode = data_to_ptr (ioc_inode_data);
-                table = ioc_inode->table;
-
-                ioc_table_lock (table);
-                {
-                        if (list_empty (&ioc_inode->inode_lru)) {
-                                ioc_inode = ioc_inode_reupdate (ioc_inode);
-                        }
-                }
-                ioc_table_unlock (table);
-        }
-
-        return ioc_inode;
-}
-
 int32_t
 ioc_inode_need_revalidate (ioc_inode_t *ioc_inode)
 {
@@ -135,22 +100,12 @@ __ioc_inode_flush (ioc_inode_t *ioc_inode)
 void
 ioc_inode_flush (ioc_inode_t *ioc_inode)
 {
-        int64_t destroy_size = 0;
-
         ioc_inode_lock (ioc_inode);
         {
-                destroy_size = __ioc_inode_flush (ioc_inode);
+                __ioc_inode_flush (ioc_inode);
         }
         ioc_inode_unlock (ioc_inode);
 
-        if (destroy_size) {
-                ioc_table_lock (ioc_inode->table);
-                {
-                        ioc_inode->table->cache_used -= destroy_size;
-                }
-                ioc_table_unlock (ioc_inode->table);
-        }
-
         return;
 }
 
@@ -250,13 +205,6 @@ ioc_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 ioc_inode_flush (ioc_inode);
         }
 
-        ioc_table_lock (ioc_inode->table);
-        {
-                list_move_tail (&ioc_inode->inode_lru,
-                                &table->inode_lru[ioc_inode->weight]);
-        }
-        ioc_table_unlock (ioc_inode->table);
-
 out:
         if (frame->local != NULL) {
                 local = frame->local;
@@ -342,7 +290,6 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         ioc_local_t *local        = NULL;
         ioc_inode_t *ioc_inode    = NULL;
-        size_t       destroy_size = 0;
         struct iatt *local_stbuf  = NULL;
 
         local = frame->local;
@@ -360,7 +307,7 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                  */
                 ioc_inode_lock (ioc_inode);
                 {
-                        destroy_size = __ioc_inode_flush (ioc_inode);
+                        __ioc_inode_flush (ioc_inode);
                         if (op_ret >= 0) {
                                 ioc_inode->cache.mtime = stbuf->ia_mtime;
                                 ioc_inode->cache.mtime_nsec
@@ -371,14 +318,6 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 local_stbuf = NULL;
         }
 
-        if (destroy_size) {
-                ioc_table_lock (ioc_inode->table);
-                {
-                        ioc_inode->table->cache_used -= destroy_size;
-                }
-                ioc_table_unlock (ioc_inode->table);
-        }
-
         if (op_ret < 0)
                 local_stbuf = NULL;
 
@@ -549,13 +488,6 @@ ioc_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                 inode_ctx_get (fd->inode, this, &tmp_ioc_inode);
                 ioc_inode = (ioc_inode_t *)(long)tmp_ioc_inode;
 
-                ioc_table_lock (ioc_inode->table);
-                {
-                        list_move_tail (&ioc_inode->inode_lru,
-                                        &table->inode_lru[ioc_inode->weight]);
-                }
-                ioc_table_unlock (ioc_inode->table);
-
                 ioc_inode_lock (ioc_inode);
                 {
                         if ((table->min_file_size > ioc_inode->ia_size)
@@ -897,23 +829,6 @@ ioc_readv_disabled_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
-int32_t
-ioc_need_prune (ioc_table_t *table)
-{
-        int64_t cache_difference = 0;
-
-        ioc_table_lock (table);
-        {
-                cache_difference = table->cache_used - table->cache_size;
-        }
-        ioc_table_unlock (table);
-
-        if (cache_difference > 0)
-                return 1;
-        else
-                return 0;
-}
-
 /*
  * ioc_dispatch_requests -
  *
@@ -986,6 +901,8 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
                                         local->op_errno = ENOMEM;
                                         goto out;
                                 }
+                        } else {
+                                __ioc_page_touch (trav);
                         }
 
                         __ioc_wait_on_page (trav, frame, local_offset,
@@ -1036,7 +953,6 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 
                 if (fault) {
                         fault = 0;
-                        /* new page created, increase the table->cache_used */
                         ioc_page_fault (ioc_inode, frame, fd, trav_offset);
                 }
 
@@ -1067,10 +983,6 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 out:
         ioc_frame_return (frame);
 
-        if (ioc_need_prune (ioc_inode->table)) {
-                ioc_prune (ioc_inode->table);
-        }
-
         return;
 }
 
@@ -1092,7 +1004,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         uint64_t     tmp_ioc_inode = 0;
         ioc_inode_t *ioc_inode     = NULL;
         ioc_local_t *local         = NULL;
-        uint32_t     weight        = 0;
         ioc_table_t *table         = NULL;
         int32_t      op_errno      = -1;
 
@@ -1167,15 +1078,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 "NEW REQ (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET"",
                 frame, offset, size);
 
-        weight = ioc_inode->weight;
-
-        ioc_table_lock (ioc_inode->table);
-        {
-                list_move_tail (&ioc_inode->inode_lru,
-                                &ioc_inode->table->inode_lru[weight]);
-        }
-        ioc_table_unlock (ioc_inode->table);
-
         ioc_dispatch_requests (frame, ioc_inode, fd, offset, size);
         return 0;
 
@@ -1436,9 +1338,6 @@ ioc_get_priority_list (const char *opt_str, struct list_head *first)
         /* Get the pattern for cache priority.
          * "option priority *.jpg:1,abc*:2" etc
          */
-        /* TODO: inode_lru in table is statically hard-coded to 5,
-         * should be changed to run-time configuration
-         */
         stripe_str = strtok_r (string, ",", &tmp_str);
         while (stripe_str) {
                 curr = GF_CALLOC (1, sizeof (struct ioc_priority),
@@ -1632,6 +1531,10 @@ reconfigure (xlator_t *this, dict_t *options)
         }
 unlock:
         ioc_table_unlock (table);
+
+        /* the shards may be over their share of a smaller cache */
+        if (ret == 0)
+                ioc_prune (table);
 out:
         return ret;
 }
@@ -1647,7 +1550,6 @@ init (xlator_t *this)
 {
         ioc_table_t     *table             = NULL;
         dict_t          *xl_options        = NULL;
-        uint32_t         index             = 0;
         int32_t          ret               = -1;
         glusterfs_ctx_t *ctx               = NULL;
         data_t          *data              = 0;
@@ -1717,16 +1619,13 @@ init (xlator_t *this)
                 goto out;
         }
 
-        table->inode_lru = GF_CALLOC (table->max_pri,
-                                      sizeof (struct list_head),
-                                      gf_ioc_mt_list_head);
-        if (table->inode_lru == NULL) {
+        /* priorities set by reconfigure beyond the classes allocated here
+           share the highest class */
+        table->class_count = table->max_pri;
+        if (ioc_shards_init (table) == -1) {
                 goto out;
         }
 
-        for (index = 0; index < (table->max_pri); index++)
-                INIT_LIST_HEAD (&table->inode_lru[index]);
-
         this->local_pool = mem_pool_new (ioc_local_t, 64);
         if (!this->local_pool) {
                 ret = -1;
@@ -1757,7 +1656,8 @@ init (xlator_t *this)
 out:
         if (ret == -1) {
                 if (table != NULL) {
-                        GF_FREE (table->inode_lru);
+                        if (table->shards[0].classes != NULL)
+                                ioc_shards_fini (table);
                         GF_FREE (table);
                 }
         }
@@ -1814,6 +1714,9 @@ __ioc_page_dump (ioc_page_t *page, char *prefix)
                 gf_proc_dump_write ("size", "%"PRId64, page->size);
                 gf_proc_dump_write ("dirty", "%s", page->dirty ? "yes" : "no");
                 gf_proc_dump_write ("ready", "%s", page->ready ? "yes" : "no");
+                gf_proc_dump_write ("queue", "%s",
+                                    (page->queue == IOC_QUEUE_FREQUENT)
+                                    ? "frequent" : "recent");
                 ioc_page_waitq_dump (page, prefix);
         }
         ioc_page_unlock (page);
@@ -1880,11 +1783,57 @@ out:
         return;
 }
 
+void
+ioc_class_dump (ioc_table_t *table, uint32_t index)
+{
+        ioc_shard_t *shard                    = NULL;
+        ioc_class_t  total                    = {{0, }, };
+        ioc_class_t *class                    = NULL;
+        char         key[GF_DUMP_MAX_BUF_LEN] = {0, };
+        int          i                        = 0;
+
+        for (i = 0; i < IOC_TABLE_SHARDS; i++) {
+                shard = &table->shards[i];
+
+                ioc_shard_lock (shard);
+                {
+                        class = &shard->classes[index];
+                        total.recent_used += class->recent_used;
+                        total.frequent_used += class->frequent_used;
+                        total.hits += class->hits;
+                        total.misses += class->misses;
+                        total.evictions += class->evictions;
+                        total.promotions += class->promotions;
+                }
+                ioc_shard_unlock (shard);
+        }
+
+        sprintf (key, "priority[%u].hits", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.hits);
+        sprintf (key, "priority[%u].misses", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.misses);
+        sprintf (key, "priority[%u].hit_rate", index);
+        gf_proc_dump_write (key, "%.2f%%", (total.hits + total.misses)
+                            ? 100.0 * total.hits / (total.hits + total.misses)
+                            : 0.0);
+        sprintf (key, "priority[%u].evictions", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.evictions);
+        sprintf (key, "priority[%u].promotions", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.promotions);
+        sprintf (key, "priority[%u].recent_used", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.recent_used);
+        sprintf (key, "priority[%u].frequent_used", index);
+        gf_proc_dump_write (key, "%"PRIu64, total.frequent_used);
+}
+
 int
 ioc_priv_dump (xlator_t *this)
 {
         ioc_table_t *priv                            = NULL;
         ioc_inode_t *ioc_inode                       = NULL;
+        uint64_t     cache_used                      = 0;
+        uint32_t     index                           = 0;
+        int          i                               = 0;
         char         key_prefix[GF_DUMP_MAX_BUF_LEN] = {0, };
 
         if (!this || !this->private)
@@ -1895,11 +1844,24 @@ ioc_priv_dump (xlator_t *this)
                                 "priv");
         gf_proc_dump_add_section (key_prefix);
 
+        for (i = 0; i < IOC_TABLE_SHARDS; i++) {
+                ioc_shard_lock (&priv->shards[i]);
+                {
+                        cache_used += priv->shards[i].cache_used;
+                }
+                ioc_shard_unlock (&priv->shards[i]);
+        }
+
         ioc_table_lock (priv);
         {
                 gf_proc_dump_write ("page_size", "%ld", priv->page_size);
                 gf_proc_dump_write ("cache_size", "%ld", priv->cache_size);
-                gf_proc_dump_write ("cache_used", "%ld", priv->cache_used);
+                gf_proc_dump_write ("cache_used", "%ld", cache_used);
+                gf_proc_dump_write ("shard_count", "%d", IOC_TABLE_SHARDS);
+
+                for (index = 0; index < priv->class_count; index++)
+                        ioc_class_dump (priv, index);
+
                 gf_proc_dump_write ("inode_count", "%u", priv->inode_count);
                 gf_proc_dump_write ("cache_timeout", "%u", priv->cache_timeout);
                 gf_proc_dump_write ("min-file-size", "%u", priv->min_file_size);
@@ -1925,7 +1887,6 @@ fini (xlator_t *this)
 {
         ioc_table_t         *table = NULL;
         struct ioc_priority *curr  = NULL, *tmp = NULL;
-        int                  i     = 0;
 
         table = this->private;
 
@@ -1945,9 +1906,7 @@ fini (xlator_t *this)
                 GF_FREE (curr);
         }
 
-        for (i = 0; i < table->max_pri; i++) {
-                GF_ASSERT (list_empty (&table->inode_lru[i]));
-        }
+        ioc_shards_fini (table);
 
         GF_ASSERT (list_empty (&table->inodes));
         pthread_mutex_destroy (&table->table_lock);
@@ -1957,6 +1916,36 @@ fini (xlator_t *this)
         return;
 }
 
+/* Another client changed a file on the brick: whatever pages we hold for
+ * it may be stale.
+ */
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        struct gf_upcall *upcall    = NULL;
+        inode_t          *inode     = NULL;
+        uint64_t          ioc_inode = 0;
+
+        if (event != GF_EVENT_UPCALL)
+                goto out;
+
+        upcall = data;
+        if (!(upcall->flags & (GF_UPCALL_DATA | GF_UPCALL_ATTR)))
+                goto out;
+
+        inode = gf_upcall_inode_find (this, upcall);
+        if (!inode)
+                goto out;
+
+        inode_ctx_get (inode, this, &ioc_inode);
+        if (ioc_inode)
+                ioc_inode_flush ((ioc_inode_t *)(long)ioc_inode);
+
+        inode_unref (inode);
+out:
+        return default_notify (this, event, data);
+}
+
 struct xlator_fops fops = {
         .open        = ioc_open,
         .create      = ioc_create,
@@ -1994,11 +1983,12 @@ struct volume_options options[] = {
         { .key  = {"cache-timeout", "force-revalidate-timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 0,
-          .max  = 60,
+          .max  = 600,
           .default_value = "1",
           .description = "The cached data for a file will be retained till "
           "'cache-refresh-timeout' seconds, after which data "
-          "re-validation is performed."
+          "re-validation is performed. Values above a few seconds are only "
+          "safe when the bricks send cache invalidations."
         },
         { .key  = {"cache-size"},
           .type = GF_OPTION_TYPE_SIZET,
@@ -42,11 +42,19 @@
 #define IOC_PAGE_SIZE    (1024 * 128)   /* 128KB */
 #define IOC_CACHE_SIZE   (32 * 1024 * 1024)
 #define IOC_PAGE_TABLE_BUCKET_COUNT 1
+#define IOC_TABLE_SHARDS 8              /* separately locked page queues */
+#define IOC_GHOST_MAX    1024           /* evicted pages remembered, a shard */
+#define IOC_GHOST_SLOTS  4096           /* power of two */
+
+#define IOC_QUEUE_NONE     0
+#define IOC_QUEUE_RECENT   1
+#define IOC_QUEUE_FREQUENT 2
 
 struct ioc_table;
 struct ioc_local;
 struct ioc_page;
 struct ioc_inode;
+struct ioc_shard;
 
 struct ioc_priority {
         struct list_head list;
@@ -128,6 +136,46 @@ struct ioc_page {
         pthread_mutex_t     page_lock;
         int32_t             op_errno;
         char                stale;
+        struct list_head    queue_list; /* in a queue of its shard */
+        struct ioc_shard    *shard;
+        uint32_t            class;      /* priority class in the shard */
+        char                queue;      /* IOC_QUEUE_* */
+        uint64_t            charged;    /* bytes counted in the shard */
+};
+
+/*
+ * ioc_class - pages of one priority class in a shard, replaced as in 2Q.
+ * A page read in for the first time waits in @recent in FIFO order, and
+ * is remembered in the ghosts of the shard when it is evicted from there.
+ * A page read in again while it is still remembered lives in @frequent in
+ * LRU order. A scan through a large file only cycles through @recent, so
+ * it cannot push the pages which are read over and over out of the cache.
+ */
+struct ioc_class {
+        struct list_head recent;
+        struct list_head frequent;
+        uint64_t         recent_used;
+        uint64_t         frequent_used;
+        uint64_t         hits;
+        uint64_t         misses;
+        uint64_t         evictions;
+        uint64_t         promotions;   /* misses which were ghosts */
+};
+
+/*
+ * ioc_shard - a part of the cache with a lock of its own. A page belongs
+ * to a shard by the hash of its inode and offset, so the pages of a large
+ * file are spread over all the shards. Each shard gets an equal part of
+ * cache-size.
+ */
+struct ioc_shard {
+        pthread_mutex_t   lock;
+        struct ioc_class *classes;
+        uint64_t          cache_used;
+        uint32_t          ghost_head;              /* oldest ghost */
+        uint32_t          ghost_count;
+        uint16_t          ghost_ring[IOC_GHOST_MAX];
+        uint16_t          ghosts[IOC_GHOST_SLOTS]; /* counts of ghost keys */
 };
 
 struct ioc_cache {
@@ -152,7 +200,6 @@ struct ioc_inode {
                                             * list of inodes, maintained by
                                             * io-cache translator
                                             */
-        struct list_head       inode_lru;
         struct ioc_waitq      *waitq;
         pthread_mutex_t        inode_lock;
         uint32_t               weight;      /*
@@ -165,12 +212,12 @@ struct ioc_inode {
 struct ioc_table {
         uint64_t         page_size;
         uint64_t         cache_size;
-        uint64_t         cache_used;
         uint64_t         min_file_size;
         uint64_t         max_file_size;
         struct list_head inodes; /* list of inodes cached */
         struct list_head active;
-        struct list_head *inode_lru;
+        struct ioc_shard shards[IOC_TABLE_SHARDS];
+        uint32_t         class_count;
         struct list_head priority_list;
         int32_t          readv_count;
         pthread_mutex_t  table_lock;
@@ -187,6 +234,8 @@ typedef struct ioc_page ioc_page_t;
 typedef struct ioc_inode ioc_inode_t;
 typedef struct ioc_waitq ioc_waitq_t;
 typedef struct ioc_fill ioc_fill_t;
+typedef struct ioc_shard ioc_shard_t;
+typedef struct ioc_class ioc_class_t;
 
 void *
 str_to_ptr (char *string);
@@ -206,6 +255,12 @@ __ioc_page_get (ioc_inode_t *ioc_inode, off_t offset);
 ioc_page_t *
 __ioc_page_create (ioc_inode_t *ioc_inode, off_t offset);
 
+void
+__ioc_page_touch (ioc_page_t *page);
+
+void
+__ioc_page_charge (ioc_page_t *page, uint64_t size);
+
 void
 ioc_page_fault (ioc_inode_t *ioc_inode, call_frame_t *frame, fd_t *fd,
                 off_t offset);
@@ -296,6 +351,14 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
         } while (0)
 
 
+#define ioc_shard_lock(shard)                                           \
+        pthread_mutex_lock (&(shard)->lock)
+
+
+#define ioc_shard_unlock(shard)                                         \
+        pthread_mutex_unlock (&(shard)->lock)
+
+
 static inline uint64_t
 time_elapsed (struct timeval *now,
               struct timeval *then)
@@ -336,8 +399,14 @@ ioc_cache_still_valid (ioc_inode_t *ioc_inode, struct iatt *stbuf);
 int32_t
 ioc_prune (ioc_table_t *table);
 
+void
+ioc_shard_prune (ioc_table_t *table, ioc_shard_t *shard);
+
 int32_t
-ioc_need_prune (ioc_table_t *table);
+ioc_shards_init (ioc_table_t *table);
+
+void
+ioc_shards_fini (ioc_table_t *table);
 
 inline uint32_t
 ioc_hashfn (void *data, int len);
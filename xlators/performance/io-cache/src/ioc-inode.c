@@ -202,13 +202,11 @@ ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight)
         {
                 table->inode_count++;
                 list_add (&ioc_inode->inode_list, &table->inodes);
-                list_add_tail (&ioc_inode->inode_lru,
-                               &table->inode_lru[weight]);
         }
         ioc_table_unlock (table);
 
         gf_log (table->xl->name, GF_LOG_TRACE,
-                "adding to inode_lru[%d]", weight);
+                "adding inode with weight %d", weight);
 
 out:
         return ioc_inode;
@@ -235,7 +233,6 @@ ioc_inode_destroy (ioc_inode_t *ioc_inode)
         {
                 table->inode_count--;
                 list_del (&ioc_inode->inode_list);
-                list_del (&ioc_inode->inode_lru);
         }
         ioc_table_unlock (table);
 
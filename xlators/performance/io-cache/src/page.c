@@ -31,6 +31,9 @@
 #include <assert.h>
 #include <sys/time.h>
 
+static void
+__ioc_shard_unlink (ioc_shard_t *shard, ioc_page_t *page);
+
 char
 ioc_empty (struct ioc_cache *cache)
 {
@@ -117,6 +120,14 @@ __ioc_page_destroy (ioc_page_t *page)
                                 sizeof (page->offset));
                 list_del (&page->page_lru);
 
+                if (page->queue != IOC_QUEUE_NONE) {
+                        ioc_shard_lock (page->shard);
+                        {
+                                __ioc_shard_unlink (page->shard, page);
+                        }
+                        ioc_shard_unlock (page->shard);
+                }
+
                 gf_log (page->inode->table->xl->name, GF_LOG_TRACE,
                         "destroying page = %p, offset = %"PRId64" "
                         "&& inode = %p",
@@ -160,43 +171,298 @@ out:
         return ret;
 }
 
-int32_t
-__ioc_inode_prune (ioc_inode_t *curr, uint64_t *size_pruned,
-                   uint64_t size_to_prune, uint32_t index)
+static inline uint64_t
+ioc_page_key (ioc_inode_t *ioc_inode, off_t offset)
 {
-        ioc_page_t  *page  = NULL, *next = NULL;
-        int32_t      ret   = 0;
-        ioc_table_t *table = NULL;
+        return ((uint64_t)(long)ioc_inode >> 4)
+                + (offset / ioc_inode->table->page_size);
+}
 
-        if (curr == NULL) {
-                goto out;
+
+static inline uint32_t
+ioc_ghost_slot (uint64_t key)
+{
+        return (key * 0x9E3779B97F4A7C15ULL) >> 52;
+}
+
+
+/* most ghosts a shard keeps: half of the pages which fit in it */
+static inline uint32_t
+ioc_ghost_limit (ioc_table_t *table)
+{
+        uint64_t limit = 0;
+
+        limit = table->cache_size / table->page_size / IOC_TABLE_SHARDS / 2;
+
+        return min (max (limit, 1), IOC_GHOST_MAX);
+}
+
+
+static void
+__ioc_ghost_add (ioc_table_t *table, ioc_shard_t *shard, uint32_t slot)
+{
+        uint32_t limit = 0;
+        uint32_t old   = 0;
+
+        limit = ioc_ghost_limit (table);
+
+        while (shard->ghost_count >= limit) {
+                old = shard->ghost_ring[shard->ghost_head];
+                shard->ghosts[old]--;
+                shard->ghost_head = (shard->ghost_head + 1) % IOC_GHOST_MAX;
+                shard->ghost_count--;
         }
 
-        table = curr->table;
+        if (shard->ghosts[slot] == (uint16_t)~0)
+                return;
 
-        list_for_each_entry_safe (page, next, &curr->cache.page_lru, page_lru) {
-                *size_pruned += page->size;
-                ret = __ioc_page_destroy (page);
+        shard->ghost_ring[(shard->ghost_head + shard->ghost_count)
+                          % IOC_GHOST_MAX] = slot;
+        shard->ghosts[slot]++;
+        shard->ghost_count++;
+}
 
-                if (ret != -1)
-                        table->cache_used -= ret;
 
-                gf_log (table->xl->name, GF_LOG_TRACE,
-                        "index = %d && table->cache_used = %"PRIu64" && table->"
-                        "cache_size = %"PRIu64, index, table->cache_used,
-                        table->cache_size);
+/* assumes the shard is locked */
+static void
+__ioc_shard_unlink (ioc_shard_t *shard, ioc_page_t *page)
+{
+        ioc_class_t *class = NULL;
+
+        class = &shard->classes[page->class];
+
+        if (page->queue == IOC_QUEUE_RECENT)
+                class->recent_used -= page->charged;
+        else
+                class->frequent_used -= page->charged;
+
+        shard->cache_used -= page->charged;
+        list_del_init (&page->queue_list);
+        page->queue = IOC_QUEUE_NONE;
+        page->charged = 0;
+}
+
+
+/*
+ * __ioc_page_link - queue a page which was just created in its shard: in
+ * the frequent queue if it has been evicted not long ago, in the recent
+ * queue otherwise.
+ *
+ * assumes the inode of the page is locked
+ */
+static void
+__ioc_page_link (ioc_page_t *page)
+{
+        ioc_inode_t *ioc_inode = NULL;
+        ioc_table_t *table     = NULL;
+        ioc_shard_t *shard     = NULL;
+        ioc_class_t *class     = NULL;
+        uint64_t     key       = 0;
+
+        ioc_inode = page->inode;
+        table = ioc_inode->table;
+
+        key = ioc_page_key (ioc_inode, page->offset);
+        shard = &table->shards[key % IOC_TABLE_SHARDS];
+
+        page->shard = shard;
+        page->class = min (ioc_inode->weight, table->class_count - 1);
+
+        ioc_shard_lock (shard);
+        {
+                class = &shard->classes[page->class];
+                class->misses++;
+
+                if (shard->ghosts[ioc_ghost_slot (key)]) {
+                        class->promotions++;
+                        page->queue = IOC_QUEUE_FREQUENT;
+                        list_add_tail (&page->queue_list, &class->frequent);
+                } else {
+                        page->queue = IOC_QUEUE_RECENT;
+                        list_add_tail (&page->queue_list, &class->recent);
+                }
+        }
+        ioc_shard_unlock (shard);
+}
+
+
+/*
+ * __ioc_page_touch - account a read served by a page already in the
+ * cache. Reads of a page in the recent queue are taken to be part of the
+ * same burst that brought it in, and leave it where it is.
+ *
+ * assumes the inode of the page is locked
+ */
+void
+__ioc_page_touch (ioc_page_t *page)
+{
+        ioc_shard_t *shard = NULL;
+        ioc_class_t *class = NULL;
+
+        shard = page->shard;
+        if (shard == NULL)
+                return;
+
+        ioc_shard_lock (shard);
+        {
+                class = &shard->classes[page->class];
+
+                if (page->ready)
+                        class->hits++;
+
+                if (page->queue == IOC_QUEUE_FREQUENT)
+                        list_move_tail (&page->queue_list, &class->frequent);
+        }
+        ioc_shard_unlock (shard);
+}
+
+
+/*
+ * __ioc_page_charge - count @size bytes of data held by @page in its shard
+ *
+ * assumes the inode of the page is locked
+ */
+void
+__ioc_page_charge (ioc_page_t *page, uint64_t size)
+{
+        ioc_shard_t *shard = NULL;
+        ioc_class_t *class = NULL;
+
+        shard = page->shard;
+        if ((shard == NULL) || (page->queue == IOC_QUEUE_NONE))
+                return;
+
+        ioc_shard_lock (shard);
+        {
+                class = &shard->classes[page->class];
+
+                if (page->queue == IOC_QUEUE_RECENT)
+                        class->recent_used += size - page->charged;
+                else
+                        class->frequent_used += size - page->charged;
+
+                shard->cache_used += size - page->charged;
+                page->charged = size;
+        }
+        ioc_shard_unlock (shard);
+}
+
+
+/*
+ * __ioc_queue_victim - oldest page of a queue which can be evicted now.
+ * Inodes are locked before shards, so the inode of a candidate is only
+ * tried, and the page skipped if the inode is busy. The inode of the page
+ * returned is locked.
+ *
+ * assumes the shard is locked
+ */
+static ioc_page_t *
+__ioc_queue_victim (struct list_head *queue)
+{
+        ioc_page_t *page = NULL;
+
+        list_for_each_entry (page, queue, queue_list) {
+                if (pthread_mutex_trylock (&page->inode->inode_lock))
+                        continue;
+
+                if (page->ready && !page->waitq)
+                        return page;
+
+                pthread_mutex_unlock (&page->inode->inode_lock);
+        }
+
+        return NULL;
+}
+
+
+/*
+ * __ioc_shard_victim - page to evict from a shard. The lowest priority
+ * class that has pages gives it up. In a class, the recent queue is
+ * emptied first while it holds more than a quarter of the shard, then
+ * the least recently used page of the frequent queue goes.
+ *
+ * assumes the shard is locked
+ */
+static ioc_page_t *
+__ioc_shard_victim (ioc_table_t *table, ioc_shard_t *shard)
+{
+        ioc_class_t *class  = NULL;
+        ioc_page_t  *page   = NULL;
+        uint64_t     budget = 0;
+        uint32_t     index  = 0;
+
+        budget = table->cache_size / IOC_TABLE_SHARDS;
+
+        for (index = 0; index < table->class_count; index++) {
+                class = &shard->classes[index];
+
+                if ((class->recent_used > budget / 4)
+                    || list_empty (&class->frequent)) {
+                        page = __ioc_queue_victim (&class->recent);
+                        if (page == NULL)
+                                page = __ioc_queue_victim (&class->frequent);
+                } else {
+                        page = __ioc_queue_victim (&class->frequent);
+                        if (page == NULL)
+                                page = __ioc_queue_victim (&class->recent);
+                }
 
-                if ((*size_pruned) >= size_to_prune)
+                if (page != NULL)
                         break;
         }
 
-        if (ioc_empty (&curr->cache)) {
-                list_del_init (&curr->inode_lru);
+        return page;
+}
+
+
+/*
+ * ioc_shard_prune - evict pages from a shard till it fits in its part of
+ * the cache.
+ */
+void
+ioc_shard_prune (ioc_table_t *table, ioc_shard_t *shard)
+{
+        ioc_page_t  *page      = NULL;
+        ioc_inode_t *ioc_inode = NULL;
+        uint64_t     budget    = 0;
+
+        GF_VALIDATE_OR_GOTO ("io-cache", table, out);
+
+        budget = table->cache_size / IOC_TABLE_SHARDS;
+
+        ioc_shard_lock (shard);
+        {
+                while (shard->cache_used > budget) {
+                        page = __ioc_shard_victim (table, shard);
+                        if (page == NULL)
+                                break;
+
+                        ioc_inode = page->inode;
+
+                        shard->classes[page->class].evictions++;
+                        if (page->queue == IOC_QUEUE_RECENT) {
+                                __ioc_ghost_add (table, shard, ioc_ghost_slot
+                                                 (ioc_page_key (ioc_inode,
+                                                                page->offset)));
+                        }
+
+                        __ioc_shard_unlink (shard, page);
+                        __ioc_page_destroy (page);
+
+                        pthread_mutex_unlock (&ioc_inode->inode_lock);
+                }
+
+                gf_log (table->xl->name, GF_LOG_TRACE,
+                        "shard = %p && cache_used = %"PRIu64" && "
+                        "budget = %"PRIu64, shard, shard->cache_used, budget);
         }
+        ioc_shard_unlock (shard);
 
 out:
-        return 0;
+        return;
 }
+
+
 /*
  * ioc_prune - prune the cache. we have a limit to the number of pages we
  *             can have in-memory.
@@ -207,44 +473,75 @@ out:
 int32_t
 ioc_prune (ioc_table_t *table)
 {
-        ioc_inode_t *curr          = NULL, *next_ioc_inode = NULL;
-        int32_t      index         = 0;
-        uint64_t     size_to_prune = 0;
-        uint64_t     size_pruned   = 0;
+        int i = 0;
 
         GF_VALIDATE_OR_GOTO ("io-cache", table, out);
 
-        ioc_table_lock (table);
-        {
-                size_to_prune = table->cache_used - table->cache_size;
-                /* take out the least recently used inode */
-                for (index=0; index < table->max_pri; index++) {
-                        list_for_each_entry_safe (curr, next_ioc_inode,
-                                                  &table->inode_lru[index],
-                                                  inode_lru) {
-                                /* prune page-by-page for this inode, till
-                                 * we reach the equilibrium */
-                                ioc_inode_lock (curr);
-                                {
-                                        __ioc_inode_prune (curr, &size_pruned,
-                                                           size_to_prune,
-                                                           index);
-                                }
-                                ioc_inode_unlock (curr);
+        for (i = 0; i < IOC_TABLE_SHARDS; i++)
+                ioc_shard_prune (table, &table->shards[i]);
 
-                                if (size_pruned >= size_to_prune)
-                                        break;
-                        } /* list_for_each_entry_safe (curr...) */
+out:
+        return 0;
+}
 
-                        if (size_pruned >= size_to_prune)
-                                break;
-                } /* for(index=0;...) */
 
-        } /* ioc_inode_table locked region end */
-        ioc_table_unlock (table);
+int32_t
+ioc_shards_init (ioc_table_t *table)
+{
+        ioc_shard_t *shard = NULL;
+        uint32_t     index = 0;
+        int          i     = 0;
+
+        for (i = 0; i < IOC_TABLE_SHARDS; i++) {
+                shard = &table->shards[i];
+
+                shard->classes = GF_CALLOC (table->class_count,
+                                            sizeof (ioc_class_t),
+                                            gf_ioc_mt_ioc_class_t);
+                if (shard->classes == NULL)
+                        goto err;
+
+                for (index = 0; index < table->class_count; index++) {
+                        INIT_LIST_HEAD (&shard->classes[index].recent);
+                        INIT_LIST_HEAD (&shard->classes[index].frequent);
+                }
+
+                pthread_mutex_init (&shard->lock, NULL);
+        }
 
-out:
         return 0;
+
+err:
+        while (i--) {
+                pthread_mutex_destroy (&table->shards[i].lock);
+                GF_FREE (table->shards[i].classes);
+                table->shards[i].classes = NULL;
+        }
+
+        return -1;
+}
+
+
+void
+ioc_shards_fini (ioc_table_t *table)
+{
+        ioc_shard_t *shard = NULL;
+        uint32_t     index = 0;
+        int          i     = 0;
+
+        for (i = 0; i < IOC_TABLE_SHARDS; i++) {
+                shard = &table->shards[i];
+
+                for (index = 0; index < table->class_count; index++) {
+                        GF_ASSERT (list_empty (&shard->classes[index].recent));
+                        GF_ASSERT (list_empty
+                                   (&shard->classes[index].frequent));
+                }
+
+                pthread_mutex_destroy (&shard->lock);
+                GF_FREE (shard->classes);
+                shard->classes = NULL;
+        }
 }
 
 /*
@@ -282,12 +579,14 @@ __ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
 
         newpage->offset = rounded_offset;
         newpage->inode = ioc_inode;
+        INIT_LIST_HEAD (&newpage->queue_list);
         pthread_mutex_init (&newpage->page_lock, NULL);
 
         rbthash_insert (ioc_inode->cache.page_table, newpage, &rounded_offset,
                         sizeof (rounded_offset));
 
         list_add_tail (&newpage->page_lru, &ioc_inode->cache.page_lru);
+        __ioc_page_link (newpage);
 
         page = newpage;
 
@@ -424,10 +723,9 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         ioc_inode_t *ioc_inode        = NULL;
         ioc_table_t *table            = NULL;
         ioc_page_t  *page             = NULL;
-        int32_t      destroy_size     = 0;
+        ioc_shard_t *shard            = NULL;
         size_t       page_size        = 0;
         ioc_waitq_t *waitq            = NULL;
-        size_t       iobref_page_size = 0;
         char         zero_filled      = 0;
 
         GF_ASSERT (frame);
@@ -452,7 +750,7 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         gf_log (ioc_inode->table->xl->name, GF_LOG_TRACE,
                                 "cache for inode(%p) is invalid. flushing "
                                 "all pages", ioc_inode);
-                        destroy_size = __ioc_inode_flush (ioc_inode);
+                        __ioc_inode_flush (ioc_inode);
                 }
 
                 if ((op_ret >= 0) && !zero_filled) {
@@ -520,7 +818,9 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 page->size = page_size;
                                 page->op_errno = op_errno;
 
-                                iobref_page_size = iobref_size (page->iobref);
+                                __ioc_page_charge (page,
+                                                   iobref_size (page->iobref));
+                                shard = page->shard;
 
                                 if (page->waitq) {
                                         /* wake up all the frames waiting on
@@ -537,24 +837,8 @@ unlock:
 
         ioc_waitq_return (waitq);
 
-        if (iobref_page_size) {
-                ioc_table_lock (table);
-                {
-                        table->cache_used += iobref_page_size;
-                }
-                ioc_table_unlock (table);
-        }
-
-        if (destroy_size) {
-                ioc_table_lock (table);
-                {
-                        table->cache_used -= destroy_size;
-                }
-                ioc_table_unlock (table);
-        }
-
-        if (ioc_need_prune (ioc_inode->table)) {
-                ioc_prune (ioc_inode->table);
+        if (shard != NULL) {
+                ioc_shard_prune (table, shard);
         }
 
         gf_log (frame->this->name, GF_LOG_TRACE, "fault frame %p returned",
@@ -979,8 +1263,6 @@ __ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 {
         ioc_waitq_t  *waitq = NULL, *trav = NULL;
         call_frame_t *frame = NULL;
-        int64_t       ret   = 0;
-        ioc_table_t  *table = NULL;
         ioc_local_t  *local = NULL;
 
         GF_VALIDATE_OR_GOTO ("io-cache", page, out);
@@ -1006,12 +1288,7 @@ __ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
                 ioc_local_unlock (local);
         }
 
-        table = page->inode->table;
-        ret = __ioc_page_destroy (page);
-
-        if (ret != -1) {
-                table->cache_used -= ret;
-        }
+        __ioc_page_destroy (page);
 
 out:
         return waitq;
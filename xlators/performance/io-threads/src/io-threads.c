@@ -32,50 +32,207 @@
 #include <sys/time.h>
 #include <time.h>
 #include "locking.h"
+#include "statedump.h"
 
 void *iot_worker (void *arg);
 int iot_workers_scale (iot_conf_t *conf);
 int __iot_workers_scale (iot_conf_t *conf);
 struct volume_options options[];
 
-call_stub_t *
-__iot_dequeue (iot_conf_t *conf, int *pri)
+static uint64_t
+iot_client_key (call_frame_t *frame)
+{
+        uint64_t  key = 0;
+        int       i = 0;
+
+        /* the connection on a server, the lock owner anywhere else */
+        if (frame->root->trans)
+                return (uint64_t) (unsigned long) frame->root->trans;
+
+        for (i = 0; i < frame->root->lk_owner.len; i++)
+                key = key * 31 + (unsigned char) frame->root->lk_owner.data[i];
+
+        return key;
+}
+
+
+static int
+iot_client_slot (iot_conf_t *conf, uint64_t key)
+{
+        key *= 0x9e3779b97f4a7c15ULL;
+
+        return (key >> 32) % (conf->queue_count * IOT_QUEUE_CLIENTS);
+}
+
+
+static int
+iot_wait_bucket (struct timeval *from, struct timeval *to)
+{
+        int64_t  usec = 0;
+        int      bucket = 0;
+
+        usec = (to->tv_sec - from->tv_sec) * 1000000LL +
+                (to->tv_usec - from->tv_usec);
+
+        while (usec > 0 && bucket < IOT_WAIT_BUCKETS - 1) {
+                usec >>= 1;
+                bucket++;
+        }
+
+        return bucket;
+}
+
+
+/* next request of the queue at @pri, taking turns between the clients */
+static call_stub_t *
+__iot_queue_dequeue (iot_queue_t *queue, int pri, struct timeval *now)
 {
+        iot_client_t *client = NULL;
         call_stub_t  *stub = NULL;
-        int           i = 0;
 
-        *pri = -1;
+        if (list_empty (&queue->active[pri]))
+                return NULL;
+
+        client = list_entry (queue->active[pri].next, iot_client_t,
+                             active[pri]);
+        stub = list_entry (client->reqs[pri].next, call_stub_t, list);
+        list_del_init (&stub->list);
+
+        list_del_init (&client->active[pri]);
+        if (!list_empty (&client->reqs[pri]))
+                list_add_tail (&client->active[pri], &queue->active[pri]);
+
+        client->depth--;
+        client->served++;
+        client->wait_hist[iot_wait_bucket (&stub->queued, now)]++;
+
+        return stub;
+}
+
+
+static int
+__iot_runnable (iot_conf_t *conf)
+{
+        int  i = 0;
+
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                if (list_empty (&conf->reqs[i]) ||
-                   (conf->ac_iot_count[i] >= conf->ac_iot_limit[i]))
-                        continue;
-                stub = list_entry (conf->reqs[i].next, call_stub_t, list);
-                conf->ac_iot_count[i]++;
-                *pri = i;
-                break;
+                if (conf->queued[i] &&
+                    (conf->ac_iot_count[i] < conf->ac_iot_limit[i]))
+                        return 1;
         }
 
-        if (!stub)
+        return 0;
+}
+
+
+/* Releases the priority of the request the worker ran last and takes one
+   of the first priority with requests queued and workers to spare. */
+call_stub_t *
+iot_dequeue (iot_conf_t *conf, int home, int *pri)
+{
+        call_stub_t    *stub = NULL;
+        iot_queue_t    *queue = NULL;
+        struct timeval  now = {0, };
+        int             i = 0;
+
+        LOCK (&conf->lock);
+        {
+                if (*pri != -1)
+                        conf->ac_iot_count[*pri]--;
+
+                *pri = -1;
+                for (i = 0; i < IOT_PRI_MAX; i++) {
+                        if (!conf->queued[i] ||
+                            (conf->ac_iot_count[i] >= conf->ac_iot_limit[i]))
+                                continue;
+                        conf->queued[i]--;
+                        conf->queue_size--;
+                        conf->ac_iot_count[i]++;
+                        *pri = i;
+                        break;
+                }
+        }
+        UNLOCK (&conf->lock);
+
+        if (*pri == -1)
                 return NULL;
 
-        conf->queue_size--;
-        list_del_init (&stub->list);
+        gettimeofday (&now, NULL);
+
+        /* requests are counted only once on their queue, so the one just
+           accounted for is on some queue, if not on the home one */
+        for (i = 0; !stub; i++) {
+                queue = &conf->queues[(home + i) % conf->queue_count];
+                if (list_empty (&queue->active[*pri]))
+                        continue;
+
+                pthread_mutex_lock (&queue->mutex);
+                {
+                        stub = __iot_queue_dequeue (queue, *pri, &now);
+                        if (stub && (i % conf->queue_count))
+                                queue->steals++;
+                }
+                pthread_mutex_unlock (&queue->mutex);
+        }
 
         return stub;
 }
 
 
-void
-__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
+int
+iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
 {
+        iot_queue_t  *queue = NULL;
+        iot_client_t *client = NULL;
+        uint64_t      key = 0;
+        int           slot = 0;
+        int           queue_size = 0;
+        int           sleepers = 0;
+
         if (pri < 0 || pri >= IOT_PRI_MAX)
                 pri = IOT_PRI_MAX-1;
 
-        list_add_tail (&stub->list, &conf->reqs[pri]);
+        key = iot_client_key (stub->frame);
+        slot = iot_client_slot (conf, key);
 
-        conf->queue_size++;
+        queue = &conf->queues[slot / IOT_QUEUE_CLIENTS];
+        client = &queue->clients[slot % IOT_QUEUE_CLIENTS];
 
-        return;
+        /* the wait of the request in the queue starts here */
+        gettimeofday (&stub->queued, NULL);
+
+        pthread_mutex_lock (&queue->mutex);
+        {
+                client->key = key;
+                list_add_tail (&stub->list, &client->reqs[pri]);
+                if (list_empty (&client->active[pri]))
+                        list_add_tail (&client->active[pri],
+                                       &queue->active[pri]);
+
+                if (++client->depth > client->max_depth)
+                        client->max_depth = client->depth;
+        }
+        pthread_mutex_unlock (&queue->mutex);
+
+        LOCK (&conf->lock);
+        {
+                conf->queued[pri]++;
+                queue_size = ++conf->queue_size;
+                sleepers = conf->sleep_count;
+        }
+        UNLOCK (&conf->lock);
+
+        /* a worker going to sleep holds the mutex from the time it found
+           nothing to run until it waits, so it cannot miss this signal */
+        if (sleepers) {
+                pthread_mutex_lock (&conf->mutex);
+                {
+                        pthread_cond_signal (&conf->cond);
+                }
+                pthread_mutex_unlock (&conf->mutex);
+        }
+
+        return queue_size;
 }
 
 
@@ -88,66 +245,66 @@ iot_worker (void *data)
         struct timespec   sleep_till = {0, };
         int               ret = 0;
         int               pri = -1;
-        char              timeout = 0;
+        int               home = 0;
+        int               runnable = 0;
         char              bye = 0;
 
         conf = data;
         this = conf->this;
         THIS = this;
 
+        LOCK (&conf->lock);
+        {
+                home = conf->next_home++ % conf->queue_count;
+        }
+        UNLOCK (&conf->lock);
+
         for (;;) {
+                stub = iot_dequeue (conf, home, &pri);
+                if (stub) {
+                        call_resume (stub);
+                        continue;
+                }
+
                 sleep_till.tv_sec = time (NULL) + conf->idle_time;
 
                 pthread_mutex_lock (&conf->mutex);
                 {
-                        if (pri != -1) {
-                                conf->ac_iot_count[pri]--;
-                                pri = -1;
+                        LOCK (&conf->lock);
+                        {
+                                runnable = __iot_runnable (conf);
+                                if (!runnable)
+                                        conf->sleep_count++;
                         }
-                        while (conf->queue_size == 0) {
-                                conf->sleep_count++;
+                        UNLOCK (&conf->lock);
 
+                        if (!runnable) {
                                 ret = pthread_cond_timedwait (&conf->cond,
                                                               &conf->mutex,
                                                               &sleep_till);
-                                conf->sleep_count--;
-
-                                if (ret == ETIMEDOUT) {
-                                        timeout = 1;
-                                        break;
+                                LOCK (&conf->lock);
+                                {
+                                        conf->sleep_count--;
+                                        runnable = __iot_runnable (conf);
                                 }
-                        }
+                                UNLOCK (&conf->lock);
 
-                        if (timeout) {
-                                if (conf->curr_count > IOT_MIN_THREADS) {
+                                if ((ret == ETIMEDOUT) && !runnable &&
+                                    (conf->curr_count > IOT_MIN_THREADS)) {
                                         conf->curr_count--;
                                         bye = 1;
                                         gf_log (conf->this->name, GF_LOG_DEBUG,
                                                 "timeout, terminated. conf->curr_count=%d",
                                                 conf->curr_count);
-                                } else {
-                                        timeout = 0;
                                 }
                         }
-
-                        stub = __iot_dequeue (conf, &pri);
                 }
                 pthread_mutex_unlock (&conf->mutex);
 
-                if (stub) /* guard against spurious wakeups */
-                        call_resume (stub);
-
                 if (bye)
                         break;
         }
 
-        if (pri != -1) {
-                pthread_mutex_lock (&conf->mutex);
-                {
-                        conf->ac_iot_count[pri]--;
-                }
-                pthread_mutex_unlock (&conf->mutex);
-        }
         return NULL;
 }
 
@@ -156,16 +313,14 @@ int
 do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
 {
         int   ret = 0;
+        int   queue_size = 0;
 
-        pthread_mutex_lock (&conf->mutex);
-        {
-                __iot_enqueue (conf, stub, pri);
-
-                pthread_cond_signal (&conf->cond);
+        queue_size = iot_enqueue (conf, stub, pri);
 
-                ret = __iot_workers_scale (conf);
-        }
-        pthread_mutex_unlock (&conf->mutex);
+        /* curr_count is only read here, __iot_workers_scale checks it */
+        if ((conf->curr_count < conf->max_count) &&
+            (conf->curr_count < log_base2 (queue_size)))
+                ret = iot_workers_scale (conf);
 
         return ret;
 }
@@ -264,6 +419,7 @@ iot_schedule (call_frame_t *frame, xlator_t *this, call_stub_t *stub)
         case GF_FOP_RELEASE:
         case GF_FOP_RELEASEDIR:
         case GF_FOP_GETSPEC:
+        case GF_FOP_COMPOUND:
         case GF_FOP_MAXVALUE:
                 //fail compilation on missing fop
                 //new fop must choose priority.
@@ -2406,6 +2562,151 @@ mem_acct_init (xlator_t *this)
 }
 
 
+static int
+iot_queues_init (iot_conf_t *conf, int count)
+{
+        iot_queue_t  *queue = NULL;
+        int           i = 0;
+        int           j = 0;
+        int           pri = 0;
+
+        conf->queues = GF_CALLOC (count, sizeof (*conf->queues),
+                                  gf_iot_mt_iot_queue_t);
+        if (!conf->queues)
+                return -1;
+
+        for (i = 0; i < count; i++) {
+                queue = &conf->queues[i];
+
+                pthread_mutex_init (&queue->mutex, NULL);
+
+                for (pri = 0; pri < IOT_PRI_MAX; pri++) {
+                        INIT_LIST_HEAD (&queue->active[pri]);
+
+                        for (j = 0; j < IOT_QUEUE_CLIENTS; j++) {
+                                INIT_LIST_HEAD (&queue->clients[j].reqs[pri]);
+                                INIT_LIST_HEAD (&queue->clients[j].active[pri]);
+                        }
+                }
+        }
+
+        conf->queue_count = count;
+
+        return 0;
+}
+
+
+static void
+iot_client_dump (iot_client_t *client, char *prefix)
+{
+        char      hist[IOT_WAIT_BUCKETS * 32] = {0, };
+        int       len = 0;
+        int       i = 0;
+
+        gf_proc_dump_add_section (prefix);
+
+        gf_proc_dump_write ("key", "%016"PRIx64, client->key);
+        gf_proc_dump_write ("queue_depth", "%d", client->depth);
+        gf_proc_dump_write ("max_queue_depth", "%d", client->max_depth);
+        gf_proc_dump_write ("served", "%"PRIu64, client->served);
+
+        /* bucket i holds the waits shorter than 2^i usec */
+        for (i = 0; i < IOT_WAIT_BUCKETS; i++) {
+                if (!client->wait_hist[i])
+                        continue;
+                len += snprintf (hist + len, sizeof (hist) - len,
+                                 "%s%s%llu:%"PRIu64, len ? " " : "",
+                                 (i == IOT_WAIT_BUCKETS - 1) ? ">=" : "<",
+                                 1ULL << ((i == IOT_WAIT_BUCKETS - 1) ?
+                                          i - 1 : i),
+                                 client->wait_hist[i]);
+        }
+
+        gf_proc_dump_write ("wait_usec_histogram", "%s", hist);
+}
+
+
+static const char *iot_pri_keys[IOT_PRI_MAX] = {
+        "high", "normal", "low", "least",
+};
+
+
+int
+iot_priv_dump (xlator_t *this)
+{
+        iot_conf_t      *conf = NULL;
+        iot_queue_t     *queue = NULL;
+        iot_client_t    *client = NULL;
+        char             key_prefix[GF_DUMP_MAX_BUF_LEN];
+        char             key[GF_DUMP_MAX_BUF_LEN];
+        int              i = 0;
+        int              j = 0;
+
+        if (!this)
+                return 0;
+
+        conf = this->private;
+        if (!conf) {
+                gf_log (this->name, GF_LOG_WARNING, "conf null in xlator");
+                return -1;
+        }
+
+        gf_proc_dump_build_key (key_prefix, "xlator.performance.io-threads",
+                                "priv");
+
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_write ("maximum_threads_count", "%d", conf->max_count);
+        gf_proc_dump_write ("current_threads_count", "%d", conf->curr_count);
+        gf_proc_dump_write ("sleep_count", "%d", conf->sleep_count);
+        gf_proc_dump_write ("idle_time", "%d", conf->idle_time);
+        gf_proc_dump_write ("queue_count", "%d", conf->queue_count);
+
+        LOCK (&conf->lock);
+        {
+                gf_proc_dump_write ("queue_size", "%d", conf->queue_size);
+
+                for (i = 0; i < IOT_PRI_MAX; i++) {
+                        snprintf (key, sizeof (key), "%s_prio_fops",
+                                  iot_pri_keys[i]);
+                        gf_proc_dump_write (key, "queued=%d running=%d/%d",
+                                            conf->queued[i],
+                                            conf->ac_iot_count[i],
+                                            conf->ac_iot_limit[i]);
+                }
+        }
+        UNLOCK (&conf->lock);
+
+        for (i = 0; i < conf->queue_count; i++) {
+                queue = &conf->queues[i];
+
+                pthread_mutex_lock (&queue->mutex);
+                {
+                        gf_proc_dump_build_key (key_prefix,
+                                                "xlator.performance.io-threads",
+                                                "queue.%d", i);
+                        gf_proc_dump_add_section (key_prefix);
+                        gf_proc_dump_write ("steals", "%"PRIu64,
+                                            queue->steals);
+
+                        for (j = 0; j < IOT_QUEUE_CLIENTS; j++) {
+                                client = &queue->clients[j];
+                                if (!client->served && !client->depth)
+                                        continue;
+
+                                gf_proc_dump_build_key (key,
+                                                        key_prefix,
+                                                        "client.%d", j);
+                                iot_client_dump (client, key);
+                        }
+                }
+                pthread_mutex_unlock (&queue->mutex);
+        }
+
+        return 0;
+}
+
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
@@ -2443,7 +2744,6 @@ init (xlator_t *this)
 {
         iot_conf_t      *conf = NULL;
         int              ret = -1;
-        int              i = 0;
 
 	if (!this->children || this->children->next) {
 		gf_log ("io-threads", GF_LOG_ERROR,
@@ -2496,8 +2796,14 @@ init (xlator_t *this)
 
         conf->this = this;
 
-        for (i = 0; i < IOT_PRI_MAX; i++) {
-                INIT_LIST_HEAD (&conf->reqs[i]);
+        LOCK_INIT (&conf->lock);
+
+        /* one queue per thread, even if thread-count is raised later */
+        ret = iot_queues_init (conf, conf->max_count);
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                GF_FREE (conf);
+                goto out;
         }
 
 	ret = iot_workers_scale (conf);
@@ -2521,6 +2827,8 @@ fini (xlator_t *this)
 {
 	iot_conf_t *conf = this->private;
 
+        if (conf)
+                GF_FREE (conf->queues);
 	GF_FREE (conf);
 
 	this->private = NULL;
@@ -2575,6 +2883,10 @@ struct xlator_fops fops = {
 struct xlator_cbks cbks = {
 };
 
+struct xlator_dumpops dumpops = {
+        .priv    = iot_priv_dump,
+};
+
 struct volume_options options[] = {
 	{ .key  = {"thread-count"},
 	  .type = GF_OPTION_TYPE_INT,
@@ -62,8 +62,40 @@ typedef enum {
 } iot_pri_t;
 
 
-struct iot_conf {
+#define IOT_QUEUE_CLIENTS       8       /* fair queueing slots per queue */
+#define IOT_WAIT_BUCKETS        24      /* log2 usec, the last one is 4s+ */
+
+
+/* Requests of every client hashed to the same slot share its lists, so a
+   busy client only delays the few others which collide with it. */
+struct iot_client {
+        struct list_head     reqs[IOT_PRI_MAX];
+        struct list_head     active[IOT_PRI_MAX];  /* in queue->active[] */
+
+        uint64_t             key;         /* last client seen in the slot */
+        int32_t              depth;
+        int32_t              max_depth;
+        uint64_t             served;
+        uint64_t             wait_hist[IOT_WAIT_BUCKETS];
+};
+
+typedef struct iot_client iot_client_t;
+
+
+/* A worker drains its home queue first and steals from the other ones once
+   it is empty. Within a priority the clients of a queue take turns. */
+struct iot_queue {
         pthread_mutex_t      mutex;
+        struct list_head     active[IOT_PRI_MAX];  /* clients with requests */
+        iot_client_t         clients[IOT_QUEUE_CLIENTS];
+        uint64_t             steals;      /* requests served by strangers */
+};
+
+typedef struct iot_queue iot_queue_t;
+
+
+struct iot_conf {
+        pthread_mutex_t      mutex;       /* workers sleep and scale on it */
         pthread_cond_t       cond;
 
         int32_t              max_count;   /* configured maximum */
@@ -72,10 +104,15 @@ struct iot_conf {
 
         int32_t              idle_time;   /* in seconds */
 
-        struct list_head     reqs[IOT_PRI_MAX];
+        iot_queue_t         *queues;
+        int32_t              queue_count;
+        int32_t              next_home;
 
+        /* counters shared by all the queues, under lock */
+        gf_lock_t            lock;
         int32_t              ac_iot_limit[IOT_PRI_MAX];
         int32_t              ac_iot_count[IOT_PRI_MAX];
+        int32_t              queued[IOT_PRI_MAX];
         int                  queue_size;
         pthread_attr_t       w_attr;
 
@@ -25,6 +25,7 @@
 
 enum gf_iot_mem_types_ {
         gf_iot_mt_iot_conf_t  = gf_common_mt_end + 1,
+        gf_iot_mt_iot_queue_t,
         gf_iot_mt_end
 };
 #endif
@@ -27,6 +27,10 @@ enum gf_mdc_mem_types_ {
         gf_mdc_mt_mdc_local_t   = gf_common_mt_end + 1,
 	gf_mdc_mt_md_cache_t,
 	gf_mdc_mt_mdc_conf_t,
+        gf_mdc_mt_mdc_neg_t,
+        gf_mdc_mt_mdc_neg_entry_t,
+        gf_mdc_mt_mdc_listing_t,
+        gf_mdc_mt_dir_bits_t,
         gf_mdc_mt_end
 };
 #endif
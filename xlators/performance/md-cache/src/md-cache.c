@@ -26,7 +26,10 @@
 #include "logging.h"
 #include "dict.h"
 #include "xlator.h"
+#include "defaults.h"
+#include "hashfn.h"
 #include "md-cache-mem-types.h"
+#include "upcall-utils.h"
 #include <assert.h>
 #include <sys/time.h>
 
@@ -38,7 +41,9 @@
 
 
 struct mdc_conf {
-	int  timeout;
+	int           timeout;
+        int           neg_max;
+        gf_boolean_t  complete_dirs;
 };
 
 
@@ -125,16 +130,60 @@ struct md_cache {
         char         *linkname;
 	time_t        ia_time;
 	time_t        xa_time;
+
+        /* directories only: names known not to exist in it, and the names
+           the last complete listing of it returned */
+        struct mdc_neg *neg;
+        uint8_t      *dir_bits;
+        time_t        dir_time;
+        uint32_t      dir_gen;     /* bumped when a name may have appeared */
+
         gf_lock_t     lock;
 };
 
 
+#define MDC_NEG_BUCKETS  32
+
+struct mdc_neg_entry {
+        struct list_head  list;
+        time_t            time;
+        uint32_t          hash;
+        char              name[0];
+};
+
+struct mdc_neg {
+        struct list_head  buckets[MDC_NEG_BUCKETS];
+        int               count;
+};
+
+
+/* A name is in a listed directory only if both its bits are set: a
+   false positive costs a lookup, never a wrong ENOENT. */
+#define MDC_DIR_BITS     8192
+#define MDC_DIR_MAX      (MDC_DIR_BITS / 4)
+
+struct mdc_listing {
+        gf_lock_t     lock;
+        int           active;
+        uint64_t      next;        /* offset the next readdirp must ask for */
+        uint32_t      gen;
+        time_t        start;
+        uint32_t      count;
+        uint8_t       bits[MDC_DIR_BITS / 8];
+};
+
+
+void __mdc_dentry_drop (struct md_cache *mdc);
+
+
 struct mdc_local {
-        loc_t   loc;
-        loc_t   loc2;
-        fd_t   *fd;
-        char   *linkname;
-        dict_t *xattr;
+        loc_t     loc;
+        loc_t     loc2;
+        fd_t     *fd;
+        char     *linkname;
+        dict_t   *xattr;
+        off_t     offset;
+        uint32_t  dir_gen;
 };
 
 
@@ -259,6 +308,8 @@ mdc_inode_wipe (xlator_t *this, inode_t *inode)
         if (mdc->linkname)
                 GF_FREE (mdc->linkname);
 
+        __mdc_dentry_drop (mdc);
+
         GF_FREE (mdc);
 
         ret = 0;
@@ -413,6 +464,28 @@ out:
 }
 
 
+int
+mdc_inode_invalidate (xlator_t *this, inode_t *inode)
+{
+        int              ret = -1;
+        struct md_cache *mdc = NULL;
+
+        if (mdc_inode_ctx_get (this, inode, &mdc) != 0)
+                goto out;
+
+        LOCK (&mdc->lock);
+        {
+                mdc->ia_time = 0;
+                mdc->xa_time = 0;
+                __mdc_dentry_drop (mdc);
+        }
+        UNLOCK (&mdc->lock);
+        ret = 0;
+out:
+        return ret;
+}
+
+
 int
 mdc_inode_iatt_get (xlator_t *this, inode_t *inode, struct iatt *iatt)
 {
@@ -460,7 +533,8 @@ mdc_inode_xatt_set (xlator_t *this, inode_t *inode, dict_t *dict)
                 if (mdc->xattr)
                         dict_unref (mdc->xattr);
 
-                mdc->xattr = dict_ref (dict);
+                /* not a ref on @dict, its values may hold the reply */
+                mdc->xattr = dict_copy_private (dict, NULL);
 
                 time (&mdc->xa_time);
         }
@@ -487,11 +561,9 @@ mdc_inode_xatt_update (xlator_t *this, inode_t *inode, dict_t *dict)
         LOCK (&mdc->lock);
         {
                 if (!mdc->xattr)
-                        mdc->xattr = dict_ref (dict);
+                        mdc->xattr = dict_copy_private (dict, NULL);
                 else
-                        dict_copy (dict, mdc->xattr);
-
-                mdc->xattr = dict_ref (dict);
+                        dict_copy_private (dict, mdc->xattr);
 
                 time (&mdc->xa_time);
         }
@@ -532,6 +604,375 @@ out:
         return ret;
 }
 
+static void
+mdc_name_bits (const char *name, uint32_t *hash, uint32_t *b1, uint32_t *b2)
+{
+        *hash = SuperFastHash (name, strlen (name));
+        *b1 = *hash % MDC_DIR_BITS;
+        *b2 = (*hash >> 13) % MDC_DIR_BITS;
+}
+
+#define mdc_bit_set(bits, b)  ((bits)[(b) / 8] |= (1 << ((b) % 8)))
+#define mdc_bit_isset(bits, b)  ((bits)[(b) / 8] & (1 << ((b) % 8)))
+
+
+static void
+__mdc_neg_free (struct mdc_neg *neg, gf_boolean_t expired_only, time_t now,
+                int timeout)
+{
+        struct mdc_neg_entry *entry = NULL, *tmp = NULL;
+        int                   i = 0;
+
+        for (i = 0; i < MDC_NEG_BUCKETS; i++) {
+                list_for_each_entry_safe (entry, tmp, &neg->buckets[i], list) {
+                        if (expired_only && (now <= entry->time + timeout))
+                                continue;
+
+                        list_del (&entry->list);
+                        GF_FREE (entry);
+                        neg->count--;
+                }
+        }
+}
+
+
+static struct mdc_neg_entry *
+__mdc_neg_find (struct mdc_neg *neg, const char *name, uint32_t hash)
+{
+        struct mdc_neg_entry *entry = NULL;
+
+        list_for_each_entry (entry, &neg->buckets[hash % MDC_NEG_BUCKETS],
+                             list) {
+                if ((entry->hash == hash) && (strcmp (entry->name, name) == 0))
+                        return entry;
+        }
+
+        return NULL;
+}
+
+
+/* forget everything known about the names in a directory */
+void
+__mdc_dentry_drop (struct md_cache *mdc)
+{
+        if (mdc->neg) {
+                __mdc_neg_free (mdc->neg, _gf_false, 0, 0);
+                GF_FREE (mdc->neg);
+                mdc->neg = NULL;
+        }
+
+        if (mdc->dir_bits) {
+                GF_FREE (mdc->dir_bits);
+                mdc->dir_bits = NULL;
+        }
+
+        mdc->dir_gen++;
+}
+
+
+uint32_t
+mdc_dentry_gen (xlator_t *this, inode_t *parent)
+{
+        struct md_cache *mdc = NULL;
+        uint32_t         gen = 0;
+
+        mdc = mdc_inode_prep (this, parent);
+        if (!mdc)
+                goto out;
+
+        LOCK (&mdc->lock);
+        {
+                gen = mdc->dir_gen;
+        }
+        UNLOCK (&mdc->lock);
+out:
+        return gen;
+}
+
+
+/* 'name' may now exist in 'parent': called both when an entry creating
+   fop is wound and when it returns, so that negative lookups and listings
+   racing with it are not cached either. */
+void
+mdc_dentry_added (xlator_t *this, inode_t *parent, const char *name)
+{
+        struct md_cache      *mdc   = NULL;
+        struct mdc_neg_entry *entry = NULL;
+        uint32_t              hash  = 0, b1 = 0, b2 = 0;
+
+        if (!parent || !name)
+                return;
+
+        if (mdc_inode_ctx_get (this, parent, &mdc) != 0)
+                return;
+
+        mdc_name_bits (name, &hash, &b1, &b2);
+
+        LOCK (&mdc->lock);
+        {
+                mdc->dir_gen++;
+
+                if (mdc->neg) {
+                        entry = __mdc_neg_find (mdc->neg, name, hash);
+                        if (entry) {
+                                list_del (&entry->list);
+                                GF_FREE (entry);
+                                mdc->neg->count--;
+                        }
+                }
+
+                if (mdc->dir_bits) {
+                        mdc_bit_set (mdc->dir_bits, b1);
+                        mdc_bit_set (mdc->dir_bits, b2);
+                }
+        }
+        UNLOCK (&mdc->lock);
+}
+
+
+void
+mdc_dentry_neg_add (xlator_t *this, inode_t *parent, const char *name,
+                    uint32_t gen)
+{
+        struct mdc_conf      *conf  = NULL;
+        struct md_cache      *mdc   = NULL;
+        struct mdc_neg_entry *entry = NULL;
+        uint32_t              hash  = 0, b1 = 0, b2 = 0;
+        time_t                now   = 0;
+        int                   i     = 0;
+
+        conf = this->private;
+        if (!conf->neg_max)
+                return;
+
+        mdc = mdc_inode_prep (this, parent);
+        if (!mdc)
+                return;
+
+        mdc_name_bits (name, &hash, &b1, &b2);
+        time (&now);
+
+        LOCK (&mdc->lock);
+        {
+                if (mdc->dir_gen != gen)
+                        goto unlock;
+
+                if (!mdc->neg) {
+                        mdc->neg = GF_CALLOC (1, sizeof (*mdc->neg),
+                                              gf_mdc_mt_mdc_neg_t);
+                        if (!mdc->neg)
+                                goto unlock;
+
+                        for (i = 0; i < MDC_NEG_BUCKETS; i++)
+                                INIT_LIST_HEAD (&mdc->neg->buckets[i]);
+                }
+
+                entry = __mdc_neg_find (mdc->neg, name, hash);
+                if (entry) {
+                        entry->time = now;
+                        goto unlock;
+                }
+
+                if (mdc->neg->count >= conf->neg_max) {
+                        __mdc_neg_free (mdc->neg, _gf_true, now,
+                                        conf->timeout);
+                        if (mdc->neg->count >= conf->neg_max)
+                                __mdc_neg_free (mdc->neg, _gf_false, 0, 0);
+                }
+
+                entry = GF_CALLOC (1, sizeof (*entry) + strlen (name) + 1,
+                                   gf_mdc_mt_mdc_neg_entry_t);
+                if (!entry)
+                        goto unlock;
+
+                strcpy (entry->name, name);
+                entry->hash = hash;
+                entry->time = now;
+                list_add (&entry->list,
+                          &mdc->neg->buckets[hash % MDC_NEG_BUCKETS]);
+                mdc->neg->count++;
+        }
+unlock:
+        UNLOCK (&mdc->lock);
+}
+
+
+/* true if 'name' is known not to exist in 'parent' */
+gf_boolean_t
+mdc_dentry_absent (xlator_t *this, inode_t *parent, const char *name)
+{
+        struct mdc_conf      *conf   = NULL;
+        struct md_cache      *mdc    = NULL;
+        struct mdc_neg_entry *entry  = NULL;
+        uint32_t              hash   = 0, b1 = 0, b2 = 0;
+        time_t                now    = 0;
+        gf_boolean_t          absent = _gf_false;
+
+        conf = this->private;
+
+        if (mdc_inode_ctx_get (this, parent, &mdc) != 0)
+                goto out;
+
+        mdc_name_bits (name, &hash, &b1, &b2);
+        time (&now);
+
+        LOCK (&mdc->lock);
+        {
+                if (mdc->dir_bits) {
+                        if (now > mdc->dir_time + conf->timeout) {
+                                GF_FREE (mdc->dir_bits);
+                                mdc->dir_bits = NULL;
+                        } else if (!mdc_bit_isset (mdc->dir_bits, b1)
+                                   || !mdc_bit_isset (mdc->dir_bits, b2)) {
+                                absent = _gf_true;
+                                goto unlock;
+                        }
+                }
+
+                if (!mdc->neg)
+                        goto unlock;
+
+                entry = __mdc_neg_find (mdc->neg, name, hash);
+                if (!entry)
+                        goto unlock;
+
+                if (now > entry->time + conf->timeout) {
+                        list_del (&entry->list);
+                        GF_FREE (entry);
+                        mdc->neg->count--;
+                        goto unlock;
+                }
+
+                absent = _gf_true;
+        }
+unlock:
+        UNLOCK (&mdc->lock);
+out:
+        return absent;
+}
+
+
+static struct mdc_listing *
+mdc_listing_get (xlator_t *this, fd_t *fd, gf_boolean_t create)
+{
+        struct mdc_listing *listing = NULL;
+        uint64_t            value   = 0;
+
+        LOCK (&fd->lock);
+        {
+                if (__fd_ctx_get (fd, this, &value) == 0) {
+                        listing = (void *) (long) value;
+                        goto unlock;
+                }
+
+                if (!create)
+                        goto unlock;
+
+                listing = GF_CALLOC (1, sizeof (*listing),
+                                     gf_mdc_mt_mdc_listing_t);
+                if (!listing)
+                        goto unlock;
+
+                LOCK_INIT (&listing->lock);
+
+                if (__fd_ctx_set (fd, this, (uint64_t) (long) listing) != 0) {
+                        LOCK_DESTROY (&listing->lock);
+                        GF_FREE (listing);
+                        listing = NULL;
+                }
+        }
+unlock:
+        UNLOCK (&fd->lock);
+
+        return listing;
+}
+
+
+/* Follows a listing of the directory from offset 0 to the end; if it was
+   read through in order and no name appeared in the directory meanwhile,
+   the names it returned are all the directory has. */
+void
+mdc_dir_listing_update (xlator_t *this, fd_t *fd, off_t offset,
+                        uint32_t gen, int op_ret, gf_dirent_t *entries)
+{
+        struct mdc_listing *listing  = NULL;
+        struct md_cache    *mdc      = NULL;
+        gf_dirent_t        *entry    = NULL;
+        gf_boolean_t        complete = _gf_false;
+        uint32_t            hash     = 0, b1 = 0, b2 = 0;
+        time_t              start    = 0;
+        uint8_t             bits[MDC_DIR_BITS / 8];
+
+        listing = mdc_listing_get (this, fd, (offset == 0));
+        if (!listing)
+                return;
+
+        LOCK (&listing->lock);
+        {
+                if (offset == 0) {
+                        memset (listing->bits, 0, sizeof (listing->bits));
+                        listing->gen = gen;
+                        time (&listing->start);
+                        listing->count = 0;
+                        listing->next = 0;
+                        listing->active = 1;
+                }
+
+                if (!listing->active || (offset != listing->next)
+                    || (op_ret < 0)) {
+                        listing->active = 0;
+                        goto unlock;
+                }
+
+                if (op_ret == 0) {
+                        listing->active = 0;
+                        complete = _gf_true;
+                        gen = listing->gen;
+                        start = listing->start;
+                        memcpy (bits, listing->bits, sizeof (bits));
+                        goto unlock;
+                }
+
+                list_for_each_entry (entry, &entries->list, list) {
+                        mdc_name_bits (entry->d_name, &hash, &b1, &b2);
+                        mdc_bit_set (listing->bits, b1);
+                        mdc_bit_set (listing->bits, b2);
+                        listing->next = entry->d_off;
+                        listing->count++;
+                }
+
+                if (listing->count > MDC_DIR_MAX)
+                        listing->active = 0;
+        }
+unlock:
+        UNLOCK (&listing->lock);
+
+        if (!complete)
+                return;
+
+        mdc = mdc_inode_prep (this, fd->inode);
+        if (!mdc)
+                return;
+
+        LOCK (&mdc->lock);
+        {
+                if (mdc->dir_gen != gen)
+                        goto out;
+
+                if (!mdc->dir_bits) {
+                        mdc->dir_bits = GF_CALLOC (1, MDC_DIR_BITS / 8,
+                                                   gf_mdc_mt_dir_bits_t);
+                        if (!mdc->dir_bits)
+                                goto out;
+                }
+
+                memcpy (mdc->dir_bits, bits, MDC_DIR_BITS / 8);
+                mdc->dir_time = start;
+        }
+out:
+        UNLOCK (&mdc->lock);
+}
+
 
 void
 mdc_load_reqs (xlator_t *this, dict_t *dict)
@@ -609,10 +1050,17 @@ mdc_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
-        if (op_ret != 0)
+        if (!local)
                 goto out;
 
-        if (!local)
+        if ((op_ret == -1) && (op_errno == ENOENT) && local->loc.parent
+            && local->loc.name) {
+                mdc_dentry_neg_add (this, local->loc.parent, local->loc.name,
+                                    local->dir_gen);
+                goto out;
+        }
+
+        if (op_ret != 0)
                 goto out;
 
         if (local->loc.parent) {
@@ -647,6 +1095,16 @@ mdc_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
 
         loc_copy (&local->loc, loc);
 
+        if (loc->parent && loc->name) {
+                if (mdc_dentry_absent (this, loc->parent, loc->name)) {
+                        MDC_STACK_UNWIND (lookup, frame, -1, ENOENT, NULL,
+                                          NULL, NULL, NULL);
+                        return 0;
+                }
+
+                local->dir_gen = mdc_dentry_gen (this, loc->parent);
+        }
+
         ret = mdc_inode_iatt_get (this, loc->inode, &stbuf);
         if (ret != 0)
                 goto uncached;
@@ -875,6 +1333,9 @@ mdc_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc.parent, local->loc.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -907,6 +1368,8 @@ mdc_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc,
         loc_copy (&local->loc, loc);
         local->xattr = dict_ref (params);
 
+        mdc_dentry_added (this, loc->parent, loc->name);
+
         STACK_WIND (frame, mdc_mknod_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->mknod,
                     loc, mode, rdev, params);
@@ -923,6 +1386,9 @@ mdc_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc.parent, local->loc.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -955,6 +1421,8 @@ mdc_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc,
         loc_copy (&local->loc, loc);
         local->xattr = dict_ref (params);
 
+        mdc_dentry_added (this, loc->parent, loc->name);
+
         STACK_WIND (frame, mdc_mkdir_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->mkdir,
                     loc, mode, params);
@@ -1059,6 +1527,9 @@ mdc_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc.parent, local->loc.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -1091,6 +1562,8 @@ mdc_symlink (call_frame_t *frame, xlator_t *this, const char *linkname,
 
         local->linkname = gf_strdup (linkname);
 
+        mdc_dentry_added (this, loc->parent, loc->name);
+
         STACK_WIND (frame, mdc_symlink_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->symlink,
                     linkname, loc, params);
@@ -1108,6 +1581,9 @@ mdc_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc2.parent, local->loc2.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -1147,6 +1623,8 @@ mdc_rename (call_frame_t *frame, xlator_t *this,
         loc_copy (&local->loc, oldloc);
         loc_copy (&local->loc2, newloc);
 
+        mdc_dentry_added (this, newloc->parent, newloc->name);
+
         STACK_WIND (frame, mdc_rename_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->rename,
                     oldloc, newloc);
@@ -1163,6 +1641,9 @@ mdc_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc2.parent, local->loc2.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -1194,6 +1675,8 @@ mdc_link (call_frame_t *frame, xlator_t *this,
         loc_copy (&local->loc, oldloc);
         loc_copy (&local->loc2, newloc);
 
+        mdc_dentry_added (this, newloc->parent, newloc->name);
+
         STACK_WIND (frame, mdc_link_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->link,
                     oldloc, newloc);
@@ -1210,6 +1693,9 @@ mdc_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        if (local)
+                mdc_dentry_added (this, local->loc.parent, local->loc.name);
+
         if (op_ret != 0)
                 goto out;
 
@@ -1242,6 +1728,8 @@ mdc_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags,
         loc_copy (&local->loc, loc);
         local->xattr = dict_ref (params);
 
+        mdc_dentry_added (this, loc->parent, loc->name);
+
         STACK_WIND (frame, mdc_create_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->create,
                     loc, flags, mode, fd, params);
@@ -1656,7 +2144,16 @@ int
 mdc_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		  int op_ret, int op_errno, gf_dirent_t *entries)
 {
-        gf_dirent_t *entry      = NULL;
+        gf_dirent_t     *entry = NULL;
+        mdc_local_t     *local = NULL;
+        struct mdc_conf *conf  = NULL;
+
+        conf = this->private;
+        local = frame->local;
+
+        if (local && local->fd && conf->complete_dirs)
+                mdc_dir_listing_update (this, local->fd, local->offset,
+                                        local->dir_gen, op_ret, entries);
 
 	if (op_ret <= 0)
 		goto unwind;
@@ -1669,15 +2166,34 @@ mdc_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         }
 
 unwind:
-	STACK_UNWIND_STRICT (readdirp, frame, op_ret, op_errno, entries);
+	MDC_STACK_UNWIND (readdirp, frame, op_ret, op_errno, entries);
 	return 0;
 }
 
 
+static void
+mdc_readdirp_prep (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                   off_t offset)
+{
+        mdc_local_t *local = NULL;
+
+        local = mdc_local_get (frame);
+        if (!local)
+                return;
+
+        local->fd = fd_ref (fd);
+        local->offset = offset;
+        if (offset == 0)
+                local->dir_gen = mdc_dentry_gen (this, fd->inode);
+}
+
+
 int
 mdc_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	      size_t size, off_t offset, dict_t *xattr_req)
 {
+        mdc_readdirp_prep (frame, this, fd, offset);
+
 	STACK_WIND (frame, mdc_readdirp_cbk,
 		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->readdirp,
 		    fd, size, offset, xattr_req);
@@ -1697,6 +2213,8 @@ mdc_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd,
 		mdc_load_reqs (this, xattr_req);
 	}
 
+        mdc_readdirp_prep (frame, this, fd, offset);
+
 	STACK_WIND (frame, mdc_readdirp_cbk,
 		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->readdirp,
 		    fd, size, offset, xattr_req);
@@ -1715,6 +2233,40 @@ mdc_forget (xlator_t *this, inode_t *inode)
 }
 
 
+int
+mdc_releasedir (xlator_t *this, fd_t *fd)
+{
+        struct mdc_listing *listing = NULL;
+        uint64_t            value   = 0;
+
+        if (fd_ctx_del (fd, this, &value) != 0)
+                return 0;
+
+        listing = (void *) (long) value;
+        LOCK_DESTROY (&listing->lock);
+        GF_FREE (listing);
+
+        return 0;
+}
+
+
+int
+notify (xlator_t *this, int event, void *data, ...)
+{
+        inode_t *inode = NULL;
+
+        if (event == GF_EVENT_UPCALL) {
+                inode = gf_upcall_inode_find (this, data);
+                if (inode) {
+                        mdc_inode_invalidate (this, inode);
+                        inode_unref (inode);
+                }
+        }
+
+        return default_notify (this, event, data);
+}
+
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
@@ -1723,6 +2275,10 @@ reconfigure (xlator_t *this, dict_t *options)
 	conf = this->private;
 
 	GF_OPTION_RECONF ("timeout", conf->timeout, options, int32, out);
+        GF_OPTION_RECONF ("negative-entries", conf->neg_max, options, int32,
+                          out);
+        GF_OPTION_RECONF ("complete-dirs", conf->complete_dirs, options, bool,
+                          out);
 out:
 	return 0;
 }
@@ -1749,6 +2305,8 @@ init (xlator_t *this)
 	}
 
         GF_OPTION_INIT ("timeout", conf->timeout, int32, out);
+        GF_OPTION_INIT ("negative-entries", conf->neg_max, int32, out);
+        GF_OPTION_INIT ("complete-dirs", conf->complete_dirs, bool, out);
 
 out:
 	this->private = conf;
@@ -1794,14 +2352,35 @@ struct xlator_fops fops = {
 
 struct xlator_cbks cbks = {
         .forget      = mdc_forget,
+        .releasedir  = mdc_releasedir,
 };
 
 struct volume_options options[] = {
         { .key = {"timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min = 0,
-          .max = 60,
+          .max = 600,
           .default_value = "1",
-          .description = "Time period after which cache has to be refreshed",
+          .description = "Time period after which cache has to be refreshed. "
+                         "Values above a few seconds are only safe when the "
+                         "bricks send cache invalidations.",
+        },
+        { .key = {"negative-entries"},
+          .type = GF_OPTION_TYPE_INT,
+          .min = 0,
+          .max = 65536,
+          .default_value = "256",
+          .description = "Number of names per directory remembered not to "
+                         "exist, so that lookups of them fail without going "
+                         "to the bricks. Expire after the cache timeout. "
+                         "0 disables.",
+        },
+        { .key = {"complete-dirs"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "on",
+          .description = "After a directory was listed from start to end, "
+                         "fail lookups of names that were not in the listing "
+                         "without going to the bricks, till the cache "
+                         "timeout.",
         },
 };
@@ -19,6 +19,7 @@
 
 #include "quick-read.h"
 #include "statedump.h"
+#include "upcall-utils.h"
 
 #define QR_DEFAULT_CACHE_SIZE 134217728
 
@@ -214,12 +215,8 @@ __qr_inode_alloc (xlator_t *this, char *path, inode_t *inode)
                 goto out;
         }
 
-        INIT_LIST_HEAD (&qr_inode->lru);
-
         priority = qr_get_priority (&priv->conf, path);
 
-        list_add_tail (&qr_inode->lru, &priv->table.lru[priority]);
-
         qr_inode->inode = inode;
         qr_inode->priority = priority;
 out:
@@ -227,76 +224,19 @@ out:
 }
 
 
-/* To be called with qr_inode->table->lock held */
+/* To be called with table->lock held */
 void
-__qr_inode_free (qr_inode_t *qr_inode)
+__qr_inode_free (qr_inode_table_t *table, qr_inode_t *qr_inode)
 {
         GF_VALIDATE_OR_GOTO ("quick-read", qr_inode, out);
 
-        if (qr_inode->xattr) {
-                dict_unref (qr_inode->xattr);
-        }
-
-        list_del (&qr_inode->lru);
+        __qr_slab_release (table, qr_inode);
 
         GF_FREE (qr_inode);
 out:
         return;
 }
 
-/* To be called with priv->table.lock held */
-void
-__qr_cache_prune (xlator_t *this)
-{
-        qr_private_t     *priv          = NULL;
-        qr_conf_t        *conf          = NULL;
-        qr_inode_table_t *table         = NULL;
-        qr_inode_t        *curr         = NULL, *next = NULL;
-        int32_t           index         = 0;
-        uint64_t          size_to_prune = 0;
-        uint64_t          size_pruned   = 0;
-
-        GF_VALIDATE_OR_GOTO ("quick-read", this, out);
-        priv = this->private;
-        GF_VALIDATE_OR_GOTO (this->name, priv, out);
-
-        table = &priv->table;
-        conf = &priv->conf;
-
-        size_to_prune = table->cache_used - conf->cache_size;
-
-        for (index=0; index < conf->max_pri; index++) {
-                list_for_each_entry_safe (curr, next, &table->lru[index], lru) {
-                        size_pruned += curr->stbuf.ia_size;
-                        inode_ctx_del (curr->inode, this, NULL);
-                        __qr_inode_free (curr);
-                        if (size_pruned >= size_to_prune)
-                                goto done;
-                }
-        }
-
-done:
-        table->cache_used -= size_pruned;
-
-out:
-        return;
-}
-
-/* To be called with table->lock held */
-inline char
-__qr_need_cache_prune (qr_conf_t *conf, qr_inode_table_t *table)
-{
-        char need_prune = 0;
-
-        GF_VALIDATE_OR_GOTO ("quick-read", conf, out);
-        GF_VALIDATE_OR_GOTO ("quick-read", table, out);
-
-        need_prune = (table->cache_used > conf->cache_size);
-
-out:
-        return need_prune;
-}
-
 
 int32_t
 qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
@@ -368,7 +308,7 @@ qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         ret = inode_ctx_put (inode, this,
                                              (uint64_t)(long)qr_inode);
                         if (ret == -1) {
-                                __qr_inode_free (qr_inode);
+                                __qr_inode_free (table, qr_inode);
                                 qr_inode = NULL;
                                 op_ret = -1;
                                 op_errno = EINVAL;
@@ -391,20 +331,13 @@ qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         }
                 }
 
-                if (qr_inode->xattr) {
-                        dict_unref (qr_inode->xattr);
-                        qr_inode->xattr = NULL;
-                        table->cache_used -= qr_inode->stbuf.ia_size;
-                }
+                /* a store that fails (no room that is not being read
+                   from) just leaves the file uncached */
+                __qr_slab_store (table, conf, qr_inode, content->data,
+                                 min (content->len, buf->ia_size));
 
-                qr_inode->xattr = dict_ref (dict);
                 qr_inode->stbuf = *buf;
-                table->cache_used += buf->ia_size;
-
                 gettimeofday (&qr_inode->tv, NULL);
-                if (__qr_need_cache_prune (conf, table)) {
-                        __qr_cache_prune (this);
-                }
         }
 unlock:
         UNLOCK (&table->lock);
@@ -465,7 +398,7 @@ qr_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                 if (op_ret == 0) {
                         qr_inode = (qr_inode_t *)(long)value;
                         if (qr_inode != NULL) {
-                                if (qr_inode->xattr) {
+                                if (qr_inode->slab) {
                                         cached = 1;
                                 }
                         }
@@ -593,7 +526,8 @@ qr_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                                         qr_inode = (qr_inode_t *)(long) value;
 
                                         if (qr_inode != NULL) {
-                                                __qr_inode_free (qr_inode);
+                                                __qr_inode_free (table,
+                                                                 qr_inode);
                                         }
                                 }
                         }
@@ -699,7 +633,7 @@ qr_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
                 if (ret == 0) {
                         qr_inode = (qr_inode_t *)(long) filep;
                         if (qr_inode) {
-                                if (qr_inode->xattr) {
+                                if (qr_inode->slab) {
                                         content_cached = 1;
                                 }
                         }
@@ -843,7 +777,7 @@ qr_validate_cache_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                             || (qr_inode->stbuf.ia_mtime_nsec
                                 != buf->ia_mtime_nsec)) {
                                 inode_ctx_del (local->fd->inode, this, NULL);
-                                __qr_inode_free (qr_inode);
+                                __qr_inode_free (table, qr_inode);
                         }
                 }
         }
@@ -1071,22 +1005,19 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         qr_inode_t        *qr_inode       = NULL;
         int32_t            ret            = -1, op_ret = -1, op_errno = -1;
         uint64_t           value          = 0;
-        int                count          = -1, flags = 0, i = 0;
+        int                count          = -1, flags = 0;
         char               content_cached = 0, need_validation = 0;
         char               need_open      = 0, can_wind = 0, need_unwind = 0;
-        struct iobuf      *iobuf          = NULL;
         struct iobref     *iobref         = NULL;
         struct iatt        stbuf          = {0, };
-        data_t            *content        = NULL;
+        char              *content        = NULL;
         qr_fd_ctx_t       *qr_fd_ctx      = NULL;
         call_stub_t       *stub           = NULL;
         loc_t              loc            = {0, };
         qr_conf_t         *conf           = NULL;
-        struct iovec      *vector         = NULL;
+        struct iovec       vector         = {0, };
         char              *path           = NULL;
-        off_t              start          = 0, end = 0;
         size_t             len            = 0;
-        struct iobuf_pool *iobuf_pool     = NULL;
         qr_local_t        *local          = NULL;
         char               just_validated = 0;
         qr_private_t      *priv           = NULL;
@@ -1115,8 +1046,6 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 }
         }
 
-        iobuf_pool = this->ctx->iobuf_pool;
-
         LOCK (&table->lock);
         {
                 ret = inode_ctx_get (fd->inode, this, &value);
@@ -1124,7 +1053,7 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                         goto unlock;
 
                 qr_inode = (qr_inode_t *)(long)value;
-                if (!qr_inode || !qr_inode->xattr)
+                if (!qr_inode || !qr_inode->slab)
                         goto unlock;
 
                 if (!just_validated
@@ -1133,44 +1062,21 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                         goto unlock;
                 }
 
-                content = dict_get (qr_inode->xattr, GF_CONTENT_KEY);
+                content = __qr_slab_content (table, qr_inode, &len);
 
                 stbuf = qr_inode->stbuf;
                 content_cached = 1;
-                list_move_tail (&qr_inode->lru,
-                                &table->lru[qr_inode->priority]);
 
-                if (offset > content->len) {
-                        op_ret = 0;
-                        end = content->len;
-                } else {
-                        if ((offset + size) > content->len) {
-                                op_ret = content->len - offset;
-                                end = content->len;
-                        } else {
-                                op_ret = size;
-                                end =  offset + size;
-                        }
-                }
-
-                count = (op_ret  / iobuf_pool->default_page_size);
-                if ((op_ret % iobuf_pool->default_page_size) != 0) {
-                        count++;
-                }
-
-                if (count == 0) {
+                if (offset >= len) {
                         op_ret = 0;
+                        count = 0;
                         goto unlock;
                 }
 
-                vector = GF_CALLOC (count, sizeof (*vector), gf_qr_mt_iovec);
-                if (vector == NULL) {
-                        op_ret = -1;
-                        op_errno = ENOMEM;
-                        need_unwind = 1;
-                        goto unlock;
-                }
+                op_ret = min (size, len - offset);
 
+                /* hand out the slab itself, the ref taken here keeps the
+                   chunk from being reused till the reply is gone */
                 iobref = iobref_new ();
                 if (iobref == NULL) {
                         op_ret = -1;
@@ -1179,43 +1085,18 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                         goto unlock;
                 }
 
-                for (i = 0; i < count; i++) {
-                        /* TODO: Now that we have support for variable
-                           io-buf-sizes, i guess we need to get rid of
-                           default size here */
-                        iobuf = iobuf_get (iobuf_pool);
-                        if (iobuf == NULL) {
-                                op_ret = -1;
-                                op_errno = ENOMEM;
-                                need_unwind = 1;
-                                goto unlock;
-                        }
-
-                        start = offset + (iobuf_pool->default_page_size * i);
-
-                        if (start > end) {
-                                len = 0;
-                        } else {
-                                len = (iobuf_pool->default_page_size >
-                                       ((end - start)) ? (end - start) :
-                                       iobuf_pool->default_page_size);
-
-                                memcpy (iobuf->ptr, content->data + start, len);
-                        }
-
-                        iobref_add (iobref, iobuf);
-                        iobuf_unref (iobuf);
+                iobref_add (iobref, qr_inode->slab->iobuf);
 
-                        vector[i].iov_base = iobuf->ptr;
-                        vector[i].iov_len = len;
-                }
+                vector.iov_base = content + offset;
+                vector.iov_len = op_ret;
+                count = 1;
         }
 unlock:
         UNLOCK (&table->lock);
 
 out:
         if (content_cached || need_unwind) {
-                QR_STACK_UNWIND (readv, frame, op_ret, op_errno, vector,
+                QR_STACK_UNWIND (readv, frame, op_ret, op_errno, &vector,
                                  count, &stbuf, iobref);
 
         } else if (need_validation) {
@@ -1310,10 +1191,6 @@ out:
         }
 
 ret:
-        if (vector) {
-                GF_FREE (vector);
-        }
-
         if (iobref) {
                 iobref_unref (iobref);
         }
@@ -1409,7 +1286,7 @@ qr_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
                         qr_inode = (qr_inode_t *)(long)value;
                         if (qr_inode != NULL) {
                                 inode_ctx_del (fd->inode, this, NULL);
-                                __qr_inode_free (qr_inode);
+                                __qr_inode_free (table, qr_inode);
                         }
                 }
         }
@@ -2767,7 +2644,7 @@ qr_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 {
                                         inode_ctx_del (local->fd->inode, this,
                                                        NULL);
-                                        __qr_inode_free (qr_inode);
+                                        __qr_inode_free (table, qr_inode);
                                 }
                         }
                 }
@@ -3129,7 +3006,7 @@ qr_forget (xlator_t *this, inode_t *inode)
                 ret = inode_ctx_del (inode, this, &value);
                 if (ret == 0) {
                         qr_inode = (qr_inode_t *)(long) value;
-                        __qr_inode_free (qr_inode);
+                        __qr_inode_free (&priv->table, qr_inode);
                 }
         }
         UNLOCK (&priv->table.lock);
@@ -3162,7 +3039,8 @@ qr_inodectx_dump (xlator_t *this, inode_t *inode)
                                 "inodectx");
         gf_proc_dump_add_section (key_prefix);
 
-        gf_proc_dump_write ("entire-file-cached", "%s", qr_inode->xattr ? "yes" : "no");
+        gf_proc_dump_write ("entire-file-cached", "%s",
+                            qr_inode->slab ? "yes" : "no");
 
         if (qr_inode->tv.tv_sec) {
                 tm = localtime (&qr_inode->tv.tv_sec);
@@ -3248,8 +3126,6 @@ qr_priv_dump (xlator_t *this)
         qr_inode_table_t *table      = NULL;
         uint32_t          file_count = 0;
         uint32_t          i          = 0;
-        qr_inode_t       *curr       = NULL;
-        uint64_t          total_size = 0;
         char              key_prefix[GF_DUMP_MAX_BUF_LEN];
 
         if (!this) {
@@ -3278,17 +3154,20 @@ qr_priv_dump (xlator_t *this)
         if (!table) {
                 gf_log (this->name, GF_LOG_WARNING, "table is NULL");
                 goto out;
-        } else {
-                for (i = 0; i < conf->max_pri; i++) {
-                        list_for_each_entry (curr, &table->lru[i], lru) {
-                                file_count++;
-                                total_size += curr->stbuf.ia_size;
-                        }
-                }
         }
 
-        gf_proc_dump_write ("total_files_cached", "%d", file_count);
-        gf_proc_dump_write ("total_cache_used", "%d", total_size);
+        LOCK (&table->lock);
+        {
+                for (i = 0; i < QR_MAX_CLASSES; i++)
+                        file_count += table->classes[i].used;
+
+                gf_proc_dump_write ("total_files_cached", "%u", file_count);
+                gf_proc_dump_write ("total_cache_used", "%"PRIu64,
+                                    table->cache_used);
+
+                qr_slab_dump (table);
+        }
+        UNLOCK (&table->lock);
 
 out:
         return 0;
@@ -3378,7 +3257,12 @@ reconfigure (xlator_t *this, dict_t *options)
                         "Not reconfiguring cache-size");
                 goto out;
         }
-        conf->cache_size = cache_size_new;
+        LOCK (&priv->table.lock);
+        {
+                conf->cache_size = cache_size_new;
+                __qr_slab_shrink (&priv->table, conf);
+        }
+        UNLOCK (&priv->table.lock);
 
         ret = 0;
 out:
@@ -3491,7 +3375,7 @@ out:
 int32_t
 init (xlator_t *this)
 {
-        int32_t       ret  = -1, i = 0;
+        int32_t       ret  = -1;
         qr_private_t *priv = NULL;
         qr_conf_t    *conf = NULL;
 
@@ -3543,16 +3427,7 @@ init (xlator_t *this)
                 conf->max_pri ++;
         }
 
-        priv->table.lru = GF_CALLOC (conf->max_pri, sizeof (*priv->table.lru),
-                                     gf_common_mt_list_head);
-        if (priv->table.lru == NULL) {
-                ret = -1;
-                goto out;
-        }
-
-        for (i = 0; i < conf->max_pri; i++) {
-                INIT_LIST_HEAD (&priv->table.lru[i]);
-        }
+        qr_slab_table_init (&priv->table, this->ctx->iobuf_pool);
 
         this->local_pool = mem_pool_new (qr_local_t, 64);
         if (!this->local_pool) {
@@ -3577,14 +3452,11 @@ out:
 void
 qr_inode_table_destroy (qr_private_t *priv)
 {
-        int        i    = 0;
-        qr_conf_t *conf = NULL;
-
-        conf = &priv->conf;
-
-        for (i = 0; i < conf->max_pri; i++) {
-                GF_ASSERT (list_empty (&priv->table.lru[i]));
+        LOCK (&priv->table.lock);
+        {
+                qr_slab_table_destroy (&priv->table);
         }
+        UNLOCK (&priv->table.lock);
 
         LOCK_DESTROY (&priv->table.lock);
 
@@ -3631,6 +3503,50 @@ out:
         return;
 }
 
+/* Another client changed a file on the brick: drop the copy of it we hold
+ * so that the next open fetches it again.
+ */
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        struct gf_upcall *upcall   = NULL;
+        inode_t          *inode    = NULL;
+        qr_inode_t       *qr_inode = NULL;
+        qr_private_t     *priv     = NULL;
+        qr_inode_table_t *table    = NULL;
+        uint64_t          value    = 0;
+
+        if (event != GF_EVENT_UPCALL)
+                goto out;
+
+        upcall = data;
+        if (!(upcall->flags & (GF_UPCALL_DATA | GF_UPCALL_ATTR)))
+                goto out;
+
+        inode = gf_upcall_inode_find (this, upcall);
+        if (!inode)
+                goto out;
+
+        priv = this->private;
+        table = &priv->table;
+
+        LOCK (&table->lock);
+        {
+                if (inode_ctx_get (inode, this, &value) == 0) {
+                        qr_inode = (qr_inode_t *)(long)value;
+                        if (qr_inode != NULL) {
+                                inode_ctx_del (inode, this, NULL);
+                                __qr_inode_free (table, qr_inode);
+                        }
+                }
+        }
+        UNLOCK (&table->lock);
+
+        inode_unref (inode);
+out:
+        return default_notify (this, event, data);
+}
+
 struct xlator_fops fops = {
         .lookup      = qr_lookup,
         .open        = qr_open,
@@ -3673,8 +3589,11 @@ struct volume_options options[] = {
         { .key  = {"cache-timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min = 1,
-          .max = 60,
+          .max = 600,
           .default_value = "1",
+          .description = "Time after which a cached file is revalidated. "
+                         "Values above a few seconds are only safe when the "
+                         "bricks send cache invalidations."
         },
         { .key  = {"max-file-size"},
           .type = GF_OPTION_TYPE_SIZET,
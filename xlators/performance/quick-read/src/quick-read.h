@@ -35,6 +35,7 @@
 #include "common-utils.h"
 #include "call-stub.h"
 #include "defaults.h"
+#include "iobuf.h"
 #include <libgen.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -67,16 +68,58 @@ struct qr_local {
 };
 typedef struct qr_local qr_local_t;
 
+struct qr_slab;
+
 struct qr_inode {
-        dict_t           *xattr;
+        struct qr_slab   *slab;     /* NULL if the content is not cached */
+        uint32_t          chunk;
         inode_t          *inode;
         int               priority;
         struct iatt       stbuf;
         struct timeval    tv;
-        struct list_head  lru;
 };
 typedef struct qr_inode qr_inode_t;
 
+/* File contents live in chunks carved out of slabs. A slab is one iobuf,
+ * split into equal chunks of its class size, so that reads are answered
+ * with an iovec into the slab and a ref on its iobuf instead of a copy.
+ */
+#define QR_SLAB_SIZE        (128 * GF_UNIT_KB)
+#define QR_MIN_CHUNK_SHIFT  9                     /* 512 bytes */
+#define QR_MAX_CLASSES      12                    /* 512 bytes to 1MB */
+#define QR_CLOCK_MAX        7
+
+struct qr_chunk {
+        qr_inode_t       *owner;    /* NULL if the chunk is free */
+        uint32_t          len;
+        uint8_t           clock;
+};
+typedef struct qr_chunk qr_chunk_t;
+
+struct qr_slab {
+        struct iobuf     *iobuf;
+        int               class;
+        uint32_t          size;
+        uint32_t          nchunks;
+        uint32_t          used;
+        struct list_head  list;     /* in its class */
+        struct list_head  all;      /* in the table */
+        qr_chunk_t        chunks[0];
+};
+typedef struct qr_slab qr_slab_t;
+
+struct qr_slab_class {
+        uint32_t          chunk_size;
+        uint32_t          nslabs;
+        uint32_t          used;
+        struct list_head  slabs;
+        qr_slab_t        *hand_slab;        /* the CLOCK hand */
+        uint32_t          hand;
+        uint64_t          evictions;
+        uint64_t          misses;
+};
+typedef struct qr_slab_class qr_slab_class_t;
+
 struct qr_priority {
         char             *pattern;
         int32_t           priority;
@@ -94,9 +137,13 @@ struct qr_conf {
 typedef struct qr_conf qr_conf_t;
 
 struct qr_inode_table {
-        uint64_t          cache_used;
-        struct list_head *lru;
-        gf_lock_t         lock;
+        uint64_t            cache_used;
+        uint64_t            slab_bytes;
+        uint64_t            slab_reclaims;
+        qr_slab_class_t     classes[QR_MAX_CLASSES];
+        struct list_head    slabs;
+        struct iobuf_pool  *iobuf_pool;
+        gf_lock_t           lock;
 };
 typedef struct qr_inode_table qr_inode_table_t;
 
@@ -108,6 +155,16 @@ typedef struct qr_private qr_private_t;
 
 void qr_local_free (qr_local_t *local);
 
+void qr_slab_table_init (qr_inode_table_t *table, struct iobuf_pool *pool);
+void qr_slab_table_destroy (qr_inode_table_t *table);
+int __qr_slab_store (qr_inode_table_t *table, qr_conf_t *conf,
+                     qr_inode_t *qr_inode, char *data, size_t len);
+void __qr_slab_release (qr_inode_table_t *table, qr_inode_t *qr_inode);
+char *__qr_slab_content (qr_inode_table_t *table, qr_inode_t *qr_inode,
+                         size_t *len);
+void __qr_slab_shrink (qr_inode_table_t *table, qr_conf_t *conf);
+void qr_slab_dump (qr_inode_table_t *table);
+
 #define QR_STACK_UNWIND(op, frame, params ...) do {             \
                 qr_local_t *__local = frame->local;             \
                 frame->local = NULL;                            \
@@ -0,0 +1,461 @@
+/*
+  Copyright (c) 2012 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#include "quick-read.h"
+#include "statedump.h"
+
+/*
+ * Content store of quick-read.
+ *
+ * Every size class (512 bytes, 1KB, ... 1MB) owns a list of slabs, and
+ * every file is kept in one chunk of the smallest class it fits in. The
+ * chunk table of a slab is the index of the store: it points back to the
+ * qr_inode owning each chunk, which in turn points at its chunk.
+ *
+ * Replacement is CLOCK, per class: a hit sets the chunk's clock (higher for
+ * higher priority files), the hand decrements it and takes the first chunk
+ * found at zero. When a class has no slab to sweep and the cache-size is
+ * used up, the emptiest slab of the table is taken away from its class.
+ *
+ * Readers get a ref on the slab's iobuf. Chunks are only written to while
+ * the store holds the only ref on it, so an in-flight reply never sees its
+ * data change under it.
+ *
+ * Everything here is called with table->lock held.
+ */
+
+static int
+qr_slab_class_of (size_t len)
+{
+        size_t size  = 1 << QR_MIN_CHUNK_SHIFT;
+        int    class = 0;
+
+        while (size < len) {
+                size <<= 1;
+                class++;
+        }
+
+        if (class >= QR_MAX_CLASSES)
+                return -1;
+
+        return class;
+}
+
+
+static uint32_t
+qr_slab_size_of (qr_slab_class_t *cls)
+{
+        return max (QR_SLAB_SIZE, cls->chunk_size);
+}
+
+
+static gf_boolean_t
+qr_slab_busy (qr_slab_t *slab)
+{
+        gf_boolean_t busy = _gf_false;
+
+        LOCK (&slab->iobuf->lock);
+        {
+                busy = (slab->iobuf->ref > 1);
+        }
+        UNLOCK (&slab->iobuf->lock);
+
+        return busy;
+}
+
+
+static void
+__qr_chunk_evict (qr_inode_table_t *table, qr_slab_t *slab, uint32_t idx)
+{
+        qr_chunk_t *chunk = NULL;
+
+        chunk = &slab->chunks[idx];
+        if (chunk->owner == NULL)
+                return;
+
+        chunk->owner->slab = NULL;
+        chunk->owner = NULL;
+        table->cache_used -= chunk->len;
+        chunk->len = 0;
+
+        slab->used--;
+        table->classes[slab->class].used--;
+}
+
+
+static qr_slab_t *
+__qr_slab_new (qr_inode_table_t *table, int class)
+{
+        qr_slab_class_t *cls     = NULL;
+        qr_slab_t       *slab    = NULL;
+        uint32_t         size    = 0;
+        uint32_t         nchunks = 0;
+
+        cls = &table->classes[class];
+        size = qr_slab_size_of (cls);
+        nchunks = size / cls->chunk_size;
+
+        slab = GF_CALLOC (1, sizeof (*slab) + nchunks * sizeof (qr_chunk_t),
+                          gf_qr_mt_qr_slab_t);
+        if (slab == NULL)
+                goto out;
+
+        slab->iobuf = iobuf_get2 (table->iobuf_pool, size);
+        if (slab->iobuf == NULL) {
+                GF_FREE (slab);
+                slab = NULL;
+                goto out;
+        }
+
+        slab->class = class;
+        slab->size = size;
+        slab->nchunks = nchunks;
+
+        list_add_tail (&slab->list, &cls->slabs);
+        list_add_tail (&slab->all, &table->slabs);
+
+        cls->nslabs++;
+        table->slab_bytes += size;
+out:
+        return slab;
+}
+
+
+static void
+__qr_slab_free (qr_inode_table_t *table, qr_slab_t *slab)
+{
+        qr_slab_class_t *cls = NULL;
+        uint32_t         i   = 0;
+
+        cls = &table->classes[slab->class];
+
+        for (i = 0; i < slab->nchunks; i++)
+                __qr_chunk_evict (table, slab, i);
+
+        if (cls->hand_slab == slab) {
+                cls->hand_slab = NULL;
+                cls->hand = 0;
+        }
+
+        list_del_init (&slab->list);
+        list_del_init (&slab->all);
+
+        cls->nslabs--;
+        table->slab_bytes -= slab->size;
+
+        /* readers still holding the iobuf keep the memory till they are
+           done with it */
+        iobuf_unref (slab->iobuf);
+        GF_FREE (slab);
+}
+
+
+/* the slab with the fewest files in it, among those no one is reading */
+static qr_slab_t *
+__qr_slab_victim (qr_inode_table_t *table)
+{
+        qr_slab_t *slab   = NULL;
+        qr_slab_t *victim = NULL;
+
+        list_for_each_entry (slab, &table->slabs, all) {
+                if (victim && (slab->used >= victim->used))
+                        continue;
+
+                if (qr_slab_busy (slab))
+                        continue;
+
+                victim = slab;
+                if (victim->used == 0)
+                        break;
+        }
+
+        return victim;
+}
+
+
+static qr_slab_t *
+__qr_slab_find_free (qr_slab_class_t *cls, uint32_t *idx)
+{
+        qr_slab_t *slab = NULL;
+        uint32_t   i    = 0;
+
+        list_for_each_entry (slab, &cls->slabs, list) {
+                if (slab->used == slab->nchunks)
+                        continue;
+
+                if (qr_slab_busy (slab))
+                        continue;
+
+                for (i = 0; i < slab->nchunks; i++) {
+                        if (slab->chunks[i].owner == NULL) {
+                                *idx = i;
+                                return slab;
+                        }
+                }
+        }
+
+        return NULL;
+}
+
+
+static void
+__qr_slab_hand_next (qr_slab_class_t *cls)
+{
+        struct list_head *next = NULL;
+
+        next = cls->hand_slab->list.next;
+        if (next == &cls->slabs)
+                cls->hand_slab = NULL;
+        else
+                cls->hand_slab = list_entry (next, qr_slab_t, list);
+
+        cls->hand = 0;
+}
+
+
+static qr_slab_t *
+__qr_slab_clock (qr_inode_table_t *table, qr_slab_class_t *cls, uint32_t *idx)
+{
+        qr_slab_t  *slab  = NULL;
+        qr_chunk_t *chunk = NULL;
+        int64_t     steps = 0;
+
+        if (list_empty (&cls->slabs))
+                return NULL;
+
+        /* enough to bring every clock in the class down to zero */
+        steps = (int64_t)cls->nslabs * (qr_slab_size_of (cls) /
+                                         cls->chunk_size) * (QR_CLOCK_MAX + 1);
+
+        while (steps > 0) {
+                if (cls->hand_slab == NULL) {
+                        cls->hand_slab = list_entry (cls->slabs.next,
+                                                     qr_slab_t, list);
+                        cls->hand = 0;
+                }
+
+                slab = cls->hand_slab;
+
+                if (qr_slab_busy (slab)) {
+                        steps -= slab->nchunks - cls->hand;
+                        __qr_slab_hand_next (cls);
+                        continue;
+                }
+
+                for (; cls->hand < slab->nchunks; cls->hand++, steps--) {
+                        chunk = &slab->chunks[cls->hand];
+
+                        if (chunk->owner && chunk->clock) {
+                                chunk->clock--;
+                                continue;
+                        }
+
+                        if (chunk->owner) {
+                                __qr_chunk_evict (table, slab, cls->hand);
+                                cls->evictions++;
+                        }
+
+                        *idx = cls->hand++;
+                        return slab;
+                }
+
+                __qr_slab_hand_next (cls);
+        }
+
+        return NULL;
+}
+
+
+void
+__qr_slab_shrink (qr_inode_table_t *table, qr_conf_t *conf)
+{
+        qr_slab_t *victim = NULL;
+
+        while (table->slab_bytes > conf->cache_size) {
+                victim = __qr_slab_victim (table);
+                if (victim == NULL)
+                        break;
+
+                __qr_slab_free (table, victim);
+                table->slab_reclaims++;
+        }
+}
+
+
+int
+__qr_slab_store (qr_inode_table_t *table, qr_conf_t *conf,
+                 qr_inode_t *qr_inode, char *data, size_t len)
+{
+        qr_slab_class_t *cls    = NULL;
+        qr_slab_t       *slab   = NULL;
+        qr_slab_t       *victim = NULL;
+        qr_chunk_t      *chunk  = NULL;
+        uint32_t         idx    = 0;
+        int              class  = 0;
+
+        __qr_slab_release (table, qr_inode);
+
+        class = qr_slab_class_of (len);
+        if (class < 0)
+                return -1;
+
+        cls = &table->classes[class];
+
+        __qr_slab_shrink (table, conf);
+
+        slab = __qr_slab_find_free (cls, &idx);
+
+        if ((slab == NULL)
+            && (table->slab_bytes + qr_slab_size_of (cls) <= conf->cache_size)) {
+                slab = __qr_slab_new (table, class);
+                idx = 0;
+        }
+
+        if (slab == NULL)
+                slab = __qr_slab_clock (table, cls, &idx);
+
+        if (slab == NULL) {
+                victim = __qr_slab_victim (table);
+                if (victim) {
+                        __qr_slab_free (table, victim);
+                        table->slab_reclaims++;
+                }
+
+                if (table->slab_bytes + qr_slab_size_of (cls)
+                    <= conf->cache_size) {
+                        slab = __qr_slab_new (table, class);
+                        idx = 0;
+                }
+        }
+
+        if (slab == NULL) {
+                cls->misses++;
+                return -1;
+        }
+
+        memcpy ((char *)slab->iobuf->ptr + idx * cls->chunk_size, data, len);
+
+        chunk = &slab->chunks[idx];
+        chunk->owner = qr_inode;
+        chunk->len = len;
+        chunk->clock = 1;
+
+        slab->used++;
+        cls->used++;
+        table->cache_used += len;
+
+        qr_inode->slab = slab;
+        qr_inode->chunk = idx;
+
+        return 0;
+}
+
+
+void
+__qr_slab_release (qr_inode_table_t *table, qr_inode_t *qr_inode)
+{
+        qr_slab_t *slab = NULL;
+
+        slab = qr_inode->slab;
+        if (slab == NULL)
+                return;
+
+        GF_ASSERT (slab->chunks[qr_inode->chunk].owner == qr_inode);
+
+        __qr_chunk_evict (table, slab, qr_inode->chunk);
+}
+
+
+/* Returns the cached content of the file and counts it as a hit. */
+char *
+__qr_slab_content (qr_inode_table_t *table, qr_inode_t *qr_inode, size_t *len)
+{
+        qr_slab_t  *slab  = NULL;
+        qr_chunk_t *chunk = NULL;
+
+        slab = qr_inode->slab;
+        if (slab == NULL)
+                return NULL;
+
+        chunk = &slab->chunks[qr_inode->chunk];
+        chunk->clock = max (1, min (qr_inode->priority + 1, QR_CLOCK_MAX));
+
+        *len = chunk->len;
+
+        return (char *)slab->iobuf->ptr
+                + qr_inode->chunk * table->classes[slab->class].chunk_size;
+}
+
+
+void
+qr_slab_table_init (qr_inode_table_t *table, struct iobuf_pool *pool)
+{
+        int i = 0;
+
+        INIT_LIST_HEAD (&table->slabs);
+
+        for (i = 0; i < QR_MAX_CLASSES; i++) {
+                table->classes[i].chunk_size = 1 << (QR_MIN_CHUNK_SHIFT + i);
+                INIT_LIST_HEAD (&table->classes[i].slabs);
+        }
+
+        table->iobuf_pool = pool;
+}
+
+
+void
+qr_slab_table_destroy (qr_inode_table_t *table)
+{
+        qr_slab_t *slab = NULL, *tmp = NULL;
+
+        list_for_each_entry_safe (slab, tmp, &table->slabs, all) {
+                __qr_slab_free (table, slab);
+        }
+}
+
+
+void
+qr_slab_dump (qr_inode_table_t *table)
+{
+        qr_slab_class_t *cls = NULL;
+        char             key[GF_DUMP_MAX_BUF_LEN] = {0, };
+        int              i   = 0;
+
+        gf_proc_dump_write ("slab_bytes", "%"PRIu64, table->slab_bytes);
+        gf_proc_dump_write ("slab_reclaims", "%"PRIu64, table->slab_reclaims);
+
+        for (i = 0; i < QR_MAX_CLASSES; i++) {
+                cls = &table->classes[i];
+                if (!cls->nslabs && !cls->misses)
+                        continue;
+
+                gf_proc_dump_build_key (key, "class", "%u.slabs",
+                                        cls->chunk_size);
+                gf_proc_dump_write (key, "%u", cls->nslabs);
+                gf_proc_dump_build_key (key, "class", "%u.files",
+                                        cls->chunk_size);
+                gf_proc_dump_write (key, "%u", cls->used);
+                gf_proc_dump_build_key (key, "class", "%u.evictions",
+                                        cls->chunk_size);
+                gf_proc_dump_write (key, "%"PRIu64, cls->evictions);
+                gf_proc_dump_build_key (key, "class", "%u.misses",
+                                        cls->chunk_size);
+                gf_proc_dump_write (key, "%"PRIu64, cls->misses);
+        }
+}
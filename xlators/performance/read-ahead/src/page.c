@@ -523,8 +523,18 @@ out:
 void
 ra_page_purge (ra_page_t *page)
 {
+        ra_stream_t *stream = NULL;
+
         GF_VALIDATE_OR_GOTO ("read-ahead", page, out);
 
+        if (page->dirty) {
+                /* read ahead, but never asked for: fetch less next time */
+                stream = &page->file->streams[page->stream];
+                if (stream->window > 1)
+                        stream->window--;
+                page->file->waste++;
+        }
+
         page->prev->next = page->next;
         page->next->prev = page->prev;
 
@@ -39,7 +39,7 @@
 #include <sys/time.h>
 
 static void
-read_ahead (call_frame_t *frame, ra_file_t *file);
+read_ahead (call_frame_t *frame, ra_file_t *file, int stream);
 
 
 int
@@ -78,7 +78,6 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 file->disabled = 1;
         }
 
-        file->offset = (unsigned long long) 0;
         file->conf = conf;
         file->pages.next = &file->pages;
         file->pages.prev = &file->pages;
@@ -95,14 +94,9 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         ra_conf_unlock (conf);
 
         file->fd = fd;
-        file->page_count = conf->page_count;
         file->page_size = conf->page_size;
         pthread_mutex_init (&file->file_lock, NULL);
 
-        if (!file->disabled) {
-                file->page_count = 1;
-        }
-
         ret = fd_ctx_set (fd, this, (uint64_t)(long)file);
         if (ret == -1) {
                 gf_log (frame->this->name, GF_LOG_WARNING,
@@ -153,8 +147,6 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if ((fd->flags & O_DIRECT) || ((fd->flags & O_ACCMODE) == O_WRONLY))
                 file->disabled = 1;
 
-        file->offset = (unsigned long long) 0;
-        //file->size = fd->inode->buf.ia_size;
         file->conf = conf;
         file->pages.next = &file->pages;
         file->pages.prev = &file->pages;
@@ -171,7 +163,6 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         ra_conf_unlock (conf);
 
         file->fd = fd;
-        file->page_count = conf->page_count;
         file->page_size = conf->page_size;
         pthread_mutex_init (&file->file_lock, NULL);
 
@@ -283,75 +274,195 @@ out:
 }
 
 
-void
-read_ahead (call_frame_t *frame, ra_file_t *file)
-{
-        off_t      ra_offset   = 0;
-        size_t     ra_size     = 0;
-        off_t      trav_offset = 0;
-        ra_page_t *trav        = NULL;
-        off_t      cap         = 0;
-        char       fault       = 0;
+/* free the pages read for @stream that start before @end, does not touch
+   pages with frames waiting on them. Called with the file lock held.
+*/
 
-        GF_VALIDATE_OR_GOTO ("read-ahead", frame, out);
-        GF_VALIDATE_OR_GOTO (frame->this->name, file, out);
+static void
+__ra_stream_flush (ra_file_t *file, int stream, off_t end)
+{
+        ra_page_t *trav = NULL;
+        ra_page_t *next = NULL;
 
-        if (!file->page_count) {
-                goto out;
+        trav = file->pages.next;
+        while (trav != &file->pages && trav->offset < end) {
+                next = trav->next;
+                if (trav->stream == stream) {
+                        if (!trav->waitq)
+                                ra_page_purge (trav);
+                        else
+                                trav->stale = 1;
+                }
+                trav = next;
         }
+}
 
-        ra_size   = file->page_size * file->page_count;
-        ra_offset = floor (file->offset, file->page_size);
-        cap       = file->size ? file->size : file->offset + ra_size;
 
-        while (ra_offset < min (file->offset + ra_size, cap)) {
+/* find the stream a read of @size bytes at @offset belongs to, or start a
+   new one in place of the least recently used. Called with the file lock
+   held.
+*/
 
-                ra_file_lock (file);
-                {
-                        trav = ra_page_get (file, ra_offset);
+static int
+__ra_stream_get (ra_file_t *file, off_t offset, size_t size)
+{
+        ra_stream_t *stream  = NULL;
+        off_t        delta   = 0;
+        off_t        nearest = 0;
+        int          match   = -1;
+        int          near    = -1;
+        int          victim  = 0;
+        int          i       = 0;
+
+        file->reads++;
+
+        for (i = 0; i < RA_MAX_STREAMS; i++) {
+                stream = &file->streams[i];
+
+                if (stream->used < file->streams[victim].used)
+                        victim = i;
+                if (!stream->used)
+                        continue;
+
+                delta = offset - stream->offset;
+
+                if (stream->stride && delta == stream->stride) {
+                        stream->confirmed++;
+                        match = i;
+                        break;
                 }
-                ra_file_unlock (file);
 
-                if (!trav)
+                if (delta == stream->size) {
+                        /* a sequential reader, whatever its stride was */
+                        stream->stride = delta;
+                        stream->confirmed = 1;
+                        match = i;
                         break;
+                }
 
-                ra_offset += file->page_size;
+                /* a stream not yet following a stride may be learning one;
+                   established streams are left to their own readers */
+                if (!stream->confirmed && delta > 0
+                    && delta <= (off_t)(RA_MAX_STRIDE * file->page_size)
+                    && (near == -1 || delta < nearest)) {
+                        near = i;
+                        nearest = delta;
+                }
+        }
+
+        if (match == -1 && near != -1) {
+                match = near;
+                stream = &file->streams[match];
+                stream->stride = nearest;
+                stream->confirmed = 0;
         }
 
-        if (trav) {
-                /* comfortable enough */
+        if (match == -1) {
+                match = victim;
+                __ra_stream_flush (file, match, file->pages.prev->offset + 1);
+
+                stream = &file->streams[match];
+                memset (stream, 0, sizeof (*stream));
+                stream->window = 1;
+
+                /* reading from the start of the file is most likely the
+                   beginning of a sequential scan */
+                if (offset == 0) {
+                        stream->stride = size;
+                        stream->confirmed = 1;
+                }
+        }
+
+        stream = &file->streams[match];
+        stream->offset = offset;
+        stream->size = size;
+        stream->used = file->reads;
+
+        return match;
+}
+
+
+void
+read_ahead (call_frame_t *frame, ra_file_t *file, int stream)
+{
+        ra_stream_t  ahead       = {0, };
+        off_t        ra_offset   = 0;
+        off_t        rec_offset  = 0;
+        off_t        rec_end     = 0;
+        off_t        cap         = 0;
+        uint32_t     pages       = 0;
+        uint32_t     k           = 0;
+        ra_page_t   *trav        = NULL;
+        char         contiguous  = 0;
+        char         fault       = 0;
+
+        GF_VALIDATE_OR_GOTO ("read-ahead", frame, out);
+        GF_VALIDATE_OR_GOTO (frame->this->name, file, out);
+
+        ra_file_lock (file);
+        {
+                ahead = file->streams[stream];
+                cap = file->stbuf.ia_size;
+        }
+        ra_file_unlock (file);
+
+        if (!ahead.confirmed) {
                 goto out;
         }
 
-        trav_offset = ra_offset;
+        pages = ahead.window;
 
-        cap  = file->size ? file->size : ra_offset + ra_size;
+        /* gaps smaller than a page are cheaper to read than to skip */
+        contiguous = (ahead.stride - (off_t)ahead.size
+                      < (off_t)file->page_size);
+
+        for (k = 1; pages && k <= ahead.window; k++) {
+                if (contiguous) {
+                        rec_offset = ahead.offset + ahead.size;
+                        rec_end = rec_offset + pages * file->page_size;
+                } else {
+                        rec_offset = ahead.offset + k * ahead.stride;
+                        rec_end = rec_offset + ahead.size;
+                }
+
+                for (ra_offset = floor (rec_offset, file->page_size);
+                     pages && ra_offset < rec_end;
+                     ra_offset += file->page_size) {
+                        if (cap && ra_offset >= cap)
+                                goto out;
+
+                        pages--;
+                        fault = 0;
+
+                        ra_file_lock (file);
+                        {
+                                trav = ra_page_get (file, ra_offset);
+                                if (!trav) {
+                                        fault = 1;
+                                        trav = ra_page_create (file,
+                                                               ra_offset);
+                                        if (trav) {
+                                                trav->dirty = 1;
+                                                trav->stream = stream;
+                                        }
+                                }
+                        }
+                        ra_file_unlock (file);
 
-        while (trav_offset < min(ra_offset + ra_size, cap)) {
-                fault = 0;
-                ra_file_lock (file);
-                {
-                        trav = ra_page_get (file, trav_offset);
                         if (!trav) {
-                                fault = 1;
-                                trav = ra_page_create (file, trav_offset);
-                                if (trav)
-                                        trav->dirty = 1;
+                                /* OUT OF MEMORY */
+                                goto out;
                         }
-                }
-                ra_file_unlock (file);
 
-                if (!trav) {
-                        /* OUT OF MEMORY */
-                        break;
+                        if (fault) {
+                                gf_log (frame->this->name, GF_LOG_TRACE,
+                                        "RA at offset=%"PRId64, ra_offset);
+                                ra_page_fault (file, frame, ra_offset);
+                        }
                 }
 
-                if (fault) {
-                        gf_log (frame->this->name, GF_LOG_TRACE,
-                                "RA at offset=%"PRId64, trav_offset);
-                        ra_page_fault (file, frame, trav_offset);
-                }
-                trav_offset += file->page_size;
+                if (contiguous)
+                        break;
         }
 
 out:
@@ -371,10 +482,11 @@ ra_need_atime_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
 
 static void
-dispatch_requests (call_frame_t *frame, ra_file_t *file)
+dispatch_requests (call_frame_t *frame, ra_file_t *file, int stream)
 {
         ra_local_t   *local             = NULL;
         ra_conf_t    *conf              = NULL;
+        ra_stream_t  *ahead             = NULL;
         off_t         rounded_offset    = 0;
         off_t         rounded_end       = 0;
         off_t         trav_offset       = 0;
@@ -388,6 +500,7 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 
         local = frame->local;
         conf  = file->conf;
+        ahead = &file->streams[stream];
 
         rounded_offset = floor (local->offset, file->page_size);
         rounded_end    = roof (local->offset + local->size, file->page_size);
@@ -410,7 +523,22 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
                                 fault = 1;
                                 need_atime_update = 0;
                         }
+
+                        /* widen the window of the stream by a page for a
+                           read-ahead that came in time, double it for one
+                           that was issued too late to be ready */
+                        if (trav->dirty && trav->ready) {
+                                file->hits++;
+                                if (ahead->window < conf->page_count)
+                                        ahead->window++;
+                        } else if (trav->dirty) {
+                                file->late++;
+                                ahead->window = min (ahead->window * 2,
+                                                     conf->page_count);
+                        }
+
                         trav->dirty = 0;
+                        trav->stream = stream;
 
                         if (trav->ready) {
                                 gf_log (frame->this->name, GF_LOG_TRACE,
@@ -481,17 +609,14 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 {
         ra_file_t   *file            = NULL;
         ra_local_t  *local           = NULL;
-        ra_conf_t   *conf            = NULL;
         int          op_errno        = EINVAL;
-        char         expected_offset = 1;
+        int          stream          = 0;
         uint64_t     tmp_file        = 0;
 
         GF_ASSERT (frame);
         GF_VALIDATE_OR_GOTO (frame->this->name, this, unwind);
         GF_VALIDATE_OR_GOTO (frame->this->name, fd, unwind);
 
-        conf = this->private;
-
         gf_log (this->name, GF_LOG_TRACE,
                 "NEW REQ at offset=%"PRId64" for size=%"GF_PRI_SIZET"",
                 offset, size);
@@ -503,28 +628,15 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto disabled;
         }
 
-        if (file->offset != offset) {
-                gf_log (this->name, GF_LOG_TRACE,
-                        "unexpected offset (%"PRId64" != %"PRId64") resetting",
-                        file->offset, offset);
-
-                expected_offset = file->expected = file->page_count = 0;
-        } else {
-                gf_log (this->name, GF_LOG_TRACE,
-                        "expected offset (%"PRId64") when page_count=%d",
-                        offset, file->page_count);
-
-                if (file->expected < (conf->page_size * conf->page_count)) {
-                        file->expected += size;
-                        file->page_count = min ((file->expected
-                                                 / file->page_size),
-                                                conf->page_count);
-                }
+        ra_file_lock (file);
+        {
+                stream = __ra_stream_get (file, offset, size);
         }
+        ra_file_unlock (file);
 
-        if (!expected_offset) {
-                flush_region (frame, file, 0, file->pages.prev->offset + 1, 0);
-        }
+        gf_log (this->name, GF_LOG_TRACE,
+                "stream %d: stride=%"PRId64" window=%u", stream,
+                file->streams[stream].stride, file->streams[stream].window);
 
         local = mem_get0 (this->local_pool);
         if (!local) {
@@ -544,16 +656,19 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 
         frame->local = local;
 
-        dispatch_requests (frame, file);
+        dispatch_requests (frame, file, stream);
 
-        flush_region (frame, file, 0, floor (offset, file->page_size), 0);
+        ra_file_lock (file);
+        {
+                __ra_stream_flush (file, stream,
+                                   floor (offset, file->page_size));
+        }
+        ra_file_unlock (file);
 
-        read_ahead (frame, file);
+        read_ahead (frame, file, stream);
 
         ra_frame_return (frame);
 
-        file->offset = offset + size;
-
         return 0;
 
 unwind:
@@ -685,8 +800,12 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
         if (file) {
                 flush_region (frame, file, 0, file->pages.prev->offset+1, 1);
                 frame->local = file;
-                /* reset the read-ahead counters too */
-                file->expected = file->page_count = 0;
+                /* reset the read-ahead streams too */
+                ra_file_lock (file);
+                {
+                        memset (file->streams, 0, sizeof (file->streams));
+                }
+                ra_file_unlock (file);
         }
 
         STACK_WIND (frame, ra_writev_cbk,
@@ -797,6 +916,8 @@ ra_page_dump (struct ra_page *page)
 
         gf_proc_dump_write ("ready", "%s", page->ready ? "yes" : "no");
 
+        gf_proc_dump_write ("stream", "%d", page->stream);
+
         for (trav = page->waitq; trav; trav = trav->next) {
 		frame = trav->data;
                 sprintf (key, "waiting-frame[%d]", i++);
@@ -812,6 +933,7 @@ ra_fdctx_dump (xlator_t *this, fd_t *fd)
 {
 	ra_file_t    *file     = NULL;
         ra_page_t    *page     = NULL;
+        ra_stream_t  *stream   = NULL;
         int32_t       ret      = 0, i = 0;
         uint64_t      tmp_file = 0;
         char         *path     = NULL;
@@ -849,10 +971,27 @@ ra_fdctx_dump (xlator_t *this, fd_t *fd)
 
         gf_proc_dump_write ("page-size", "%"PRId64, file->page_size);
 
-        gf_proc_dump_write ("page-count", "%u", file->page_count);
+        gf_proc_dump_write ("hits", "%"PRIu64, file->hits);
+
+        gf_proc_dump_write ("late", "%"PRIu64, file->late);
+
+        gf_proc_dump_write ("waste", "%"PRIu64, file->waste);
+
+        for (i = 0; i < RA_MAX_STREAMS; i++) {
+                stream = &file->streams[i];
+                if (!stream->used)
+                        continue;
+
+                sprintf (key, "stream[%d]", i);
+                gf_proc_dump_write (key, "offset=%"PRId64",size=%"
+                                    GF_PRI_SIZET",stride=%"PRId64
+                                    ",confirmed=%u,window=%u",
+                                    stream->offset, stream->size,
+                                    stream->stride, stream->confirmed,
+                                    stream->window);
+        }
 
-        gf_proc_dump_write ("next-expected-offset-for-sequential-reads",
-                            "%"PRId64, file->offset);
+        i = 0;
 
         for (page = file->pages.next; page != &file->pages;
              page = page->next) {
@@ -1143,7 +1282,8 @@ struct volume_options options[] = {
           .min  = 1,
           .max  = 16,
           .default_value = "4",
-          .description = "Number of pages that will be pre-fetched"
+          .description = "Maximum number of pages that will be pre-fetched "
+                         "ahead of each stream of reads on a file"
         },
         { .key = {NULL} },
 };
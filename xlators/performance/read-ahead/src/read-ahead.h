@@ -39,6 +39,12 @@ struct ra_page;
 struct ra_file;
 struct ra_waitq;
 
+/* number of independent read streams tracked on one fd */
+#define RA_MAX_STREAMS 8
+
+/* farthest apart, in pages, two reads of one strided stream can start */
+#define RA_MAX_STRIDE  64
+
 
 struct ra_waitq {
         struct ra_waitq *next;
@@ -86,6 +92,23 @@ struct ra_page {
         struct ra_waitq  *waitq;
         struct iobref    *iobref;
         char              stale;
+        int               stream;   /* ra_file->streams[] it was read for */
+};
+
+
+/*
+ * A sequence of reads on an fd, each starting @stride bytes after the one
+ * before it. A sequential reader has a stride equal to its read size.
+ * Read-ahead is issued for a stream once a read has landed on its stride,
+ * @window pages ahead of it.
+ */
+struct ra_stream {
+        off_t             offset;    /* start of the last read */
+        size_t            size;      /* size of the last read */
+        off_t             stride;
+        uint32_t          confirmed; /* reads which landed on the stride */
+        uint32_t          window;
+        uint64_t          used;      /* ra_file->reads when last matched */
 };
 
 
@@ -95,15 +118,16 @@ struct ra_file {
         struct ra_conf    *conf;
         fd_t              *fd;
         int                disabled;
-        size_t             expected;
         struct ra_page     pages;
-        off_t              offset;
-        size_t             size;
         int32_t            refcount;
         pthread_mutex_t    file_lock;
         struct iatt        stbuf;
         uint64_t           page_size;
-        uint32_t           page_count;
+        struct ra_stream   streams[RA_MAX_STREAMS];
+        uint64_t           reads;
+        uint64_t           hits;      /* read-ahead pages found ready */
+        uint64_t           late;      /* read-ahead pages still in transit */
+        uint64_t           waste;     /* read-ahead pages dropped unread */
 };
 
 
@@ -123,6 +147,7 @@ typedef struct ra_page ra_page_t;
 typedef struct ra_file ra_file_t;
 typedef struct ra_waitq ra_waitq_t;
 typedef struct ra_fill ra_fill_t;
+typedef struct ra_stream ra_stream_t;
 
 ra_page_t *
 ra_page_get (ra_file_t *file,
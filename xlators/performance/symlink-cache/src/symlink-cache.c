@@ -31,211 +31,227 @@
 #include "compat.h"
 #include "compat-errno.h"
 #include "common-utils.h"
-
-struct symlink_cache {
-	time_t ctime;
-	char   *readlink;
-};
-
-
-static int
-symlink_inode_ctx_get (inode_t *inode, xlator_t *this, void **ctx)
+#include "defaults.h"
+#include "statedump.h"
+#include "upcall-utils.h"
+#include "symlink-cache-mem-types.h"
+
+/* Targets of symlinks, kept in a table of their own keyed by gfid instead
+ * of in the inode ctx, so that they outlive the inodes the fuse bridge
+ * forgets and are bounded by the options below rather than by the inode
+ * table. An entry is valid as long as the ctime of the symlink it was read
+ * with, which every lookup checks, and the least recently used entries go
+ * first when the table is over 'cache-size' bytes or 'max-entries' entries.
+ */
+
+#define SC_MIN_BUCKETS  1024
+
+typedef struct sc_entry {
+        struct list_head  hash;
+        struct list_head  lru;
+        uuid_t            gfid;
+        uint32_t          ctime;
+        uint32_t          ctime_nsec;
+        size_t            len;
+        char              target[0];
+} sc_entry_t;
+
+typedef struct sc_conf {
+        gf_lock_t         lock;
+        struct list_head *buckets;
+        uint32_t          bucket_count;
+        struct list_head  lru;          /* most recently used first */
+        uint64_t          cache_size;
+        uint64_t          max_entries;
+        gf_boolean_t      prefetch;
+        uint64_t          cache_used;   /* bytes, entries included */
+        uint64_t          entries;
+        uint64_t          hits;
+        uint64_t          misses;
+        uint64_t          prefetched;
+        uint64_t          evictions;
+        uint64_t          invalidations;
+} sc_conf_t;
+
+
+#define SC_ENTRY_SIZE(len)  (sizeof (sc_entry_t) + (len) + 1)
+
+
+static uint32_t
+sc_hash (sc_conf_t *conf, uuid_t gfid)
 {
-	int ret = 0;
-	uint64_t tmp_ctx = 0;
-	ret = inode_ctx_get (inode, this, &tmp_ctx);
-	if (-1 == ret)
-		gf_log (this->name, GF_LOG_ERROR, "dict get failed");
-	else
-		*ctx = (void *)(long)tmp_ctx;
+        uint32_t ret = 0;
 
-	return 0;
+        ret = gfid[15] + (gfid[14] << 8) + (gfid[13] << 16) + (gfid[12] << 24);
+
+        return ret % conf->bucket_count;
 }
 
 
-static int
-symlink_inode_ctx_set (inode_t *inode, xlator_t *this, void *ctx)
+static sc_entry_t *
+__sc_entry_find (sc_conf_t *conf, uuid_t gfid)
 {
-	int ret = 0;
-	ret = inode_ctx_put (inode, this, (uint64_t)(long) ctx);
-	if (-1 == ret)
-		gf_log (this->name, GF_LOG_ERROR, "dict set failed");
+        sc_entry_t *entry = NULL;
 
-	return 0;
+        list_for_each_entry (entry, &conf->buckets[sc_hash (conf, gfid)],
+                             hash) {
+                if (uuid_compare (entry->gfid, gfid) == 0)
+                        return entry;
+        }
+
+        return NULL;
 }
 
 
-int
-sc_cache_update (xlator_t *this, inode_t *inode, const char *link)
+static void
+__sc_entry_destroy (sc_conf_t *conf, sc_entry_t *entry)
 {
-	struct symlink_cache *sc = NULL;
+        list_del (&entry->hash);
+        list_del (&entry->lru);
 
-	symlink_inode_ctx_get (inode, this, VOID(&sc));
-	if (!sc)
-		return 0;
+        conf->cache_used -= SC_ENTRY_SIZE (entry->len);
+        conf->entries--;
 
-	if (!sc->readlink) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"updating cache: %s", link);
+        GF_FREE (entry);
+}
 
-		sc->readlink = strdup (link);
-	} else {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"not updating existing cache: %s with %s",
-			sc->readlink, link);
-	}
 
-	return 0;
+static void
+__sc_prune (sc_conf_t *conf)
+{
+        sc_entry_t *entry = NULL;
+
+        while (!list_empty (&conf->lru)
+               && ((conf->cache_used > conf->cache_size)
+                   || (conf->entries > conf->max_entries))) {
+                entry = list_entry (conf->lru.prev, sc_entry_t, lru);
+                __sc_entry_destroy (conf, entry);
+                conf->evictions++;
+        }
 }
 
 
-int
-sc_cache_set (xlator_t *this, inode_t *inode, struct iatt *buf,
+static void
+sc_cache_set (xlator_t *this, uuid_t gfid, struct iatt *buf,
               const char *link)
 {
-	struct symlink_cache *sc = NULL;
-	int                   ret = -1;
-	int                   need_set = 0;
-
-
-	symlink_inode_ctx_get (inode, this, VOID(&sc));
-	if (!sc) {
-		need_set = 1;
-		sc = CALLOC (1, sizeof (*sc));
-		if (!sc) {
-			gf_log (this->name, GF_LOG_ERROR,
-				"out of memory :(");
-			goto err;
-		}
-	}
+        sc_conf_t  *conf  = NULL;
+        sc_entry_t *entry = NULL;
+        size_t      len   = 0;
 
-	if (sc->readlink) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"replacing old cache: %s with new cache: %s",
-			sc->readlink, link);
-		FREE (sc->readlink);
-		sc->readlink = NULL;
-	}
-
-	if (link) {
-		sc->readlink = strdup (link);
-		if (!sc->readlink) {
-			gf_log (this->name, GF_LOG_ERROR,
-				"out of memory :(");
-			goto err;
-		}
-	}
+        conf = this->private;
 
-	sc->ctime = buf->ia_ctime;
+        if (uuid_is_null (gfid) || !link)
+                return;
 
-	gf_log (this->name, GF_LOG_DEBUG,
-		"setting symlink cache: %s", link);
+        len = strlen (link);
+        if (SC_ENTRY_SIZE (len) > conf->cache_size)
+                return;
 
-	if (need_set) {
-		ret = symlink_inode_ctx_set (inode, this, sc);
+        entry = GF_CALLOC (1, SC_ENTRY_SIZE (len), gf_sc_mt_sc_entry_t);
+        if (!entry)
+                return;
 
-		if (ret < 0) {
-			gf_log (this->name, GF_LOG_ERROR,
-				"could not set inode context (%s)",
-				strerror (-ret));
-			goto err;
-		}
-	}
+        uuid_copy (entry->gfid, gfid);
+        entry->ctime      = buf->ia_ctime;
+        entry->ctime_nsec = buf->ia_ctime_nsec;
+        entry->len        = len;
+        memcpy (entry->target, link, len + 1);
 
-	return 0;
-err:
-
-	if (sc) {
-		if (sc->readlink)
-			FREE (sc->readlink);
-		sc->readlink = NULL;
-		FREE (sc);
-	}
+        LOCK (&conf->lock);
+        {
+                /* the one cached before is stale or the same */
+                sc_entry_t *old = __sc_entry_find (conf, gfid);
+                if (old)
+                        __sc_entry_destroy (conf, old);
+
+                list_add (&entry->hash,
+                          &conf->buckets[sc_hash (conf, gfid)]);
+                list_add (&entry->lru, &conf->lru);
+                conf->cache_used += SC_ENTRY_SIZE (len);
+                conf->entries++;
+
+                __sc_prune (conf);
+        }
+        UNLOCK (&conf->lock);
 
-	return -1;
+        gf_log (this->name, GF_LOG_TRACE, "caching %s -> %s",
+                uuid_utoa (gfid), link);
 }
 
 
-int
-sc_cache_flush (xlator_t *this, inode_t *inode)
+static void
+sc_cache_flush (xlator_t *this, uuid_t gfid)
 {
-	struct symlink_cache *sc = NULL;
+        sc_conf_t  *conf  = NULL;
+        sc_entry_t *entry = NULL;
 
-	symlink_inode_ctx_get (inode, this, VOID(&sc));
-	if (!sc)
-		return 0;
+        conf = this->private;
 
-	if (sc->readlink) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"flushing cache: %s", sc->readlink);
+        if (uuid_is_null (gfid))
+                return;
 
-		FREE (sc->readlink);
-		sc->readlink = NULL;
-	}
-
-	FREE (sc);
-
-	return 0;
+        LOCK (&conf->lock);
+        {
+                entry = __sc_entry_find (conf, gfid);
+                if (entry) {
+                        __sc_entry_destroy (conf, entry);
+                        conf->invalidations++;
+                }
+        }
+        UNLOCK (&conf->lock);
 }
 
 
-int
-sc_cache_validate (xlator_t *this, inode_t *inode, struct iatt *buf)
+/* drops the target cached for @gfid if the symlink changed since */
+static void
+sc_cache_validate (xlator_t *this, uuid_t gfid, struct iatt *buf)
 {
-	struct symlink_cache *sc = NULL;
-	uint64_t tmp_sc = 0;
-
-	if (!IA_ISLNK (buf->ia_type)) {
-		sc_cache_flush (this, inode);
-		return 0;
-	}
-
-	symlink_inode_ctx_get (inode, this, VOID(&sc));
-
-	if (!sc) {
-		sc_cache_set (this, inode, buf, NULL);
-		inode_ctx_get (inode, this, &tmp_sc);
-
-		if (!sc) {
-			gf_log (this->name, GF_LOG_ERROR,
-				"out of memory :(");
-			return 0;
-		}
-		sc = (struct symlink_cache *)(long)tmp_sc;
-	}
-
-	if (sc->ctime == buf->ia_ctime)
-		return 0;
-
-	/* STALE */
-	if (sc->readlink) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"flushing cache: %s", sc->readlink);
-
-		FREE (sc->readlink);
-		sc->readlink = NULL;
-	}
+        sc_conf_t  *conf  = NULL;
+        sc_entry_t *entry = NULL;
 
-	sc->ctime = buf->ia_ctime;
+        conf = this->private;
 
-	return 0;
+        LOCK (&conf->lock);
+        {
+                entry = __sc_entry_find (conf, gfid);
+                if (entry && ((entry->ctime != buf->ia_ctime)
+                              || (entry->ctime_nsec != buf->ia_ctime_nsec))) {
+                        __sc_entry_destroy (conf, entry);
+                        conf->invalidations++;
+                }
+        }
+        UNLOCK (&conf->lock);
 }
 
 
-
-int
-sc_cache_get (xlator_t *this, inode_t *inode, char **link)
+/* returns a copy of the target cached for @gfid, NULL on a miss */
+static char *
+sc_cache_get (xlator_t *this, uuid_t gfid, size_t size)
 {
-	struct symlink_cache *sc = NULL;
+        sc_conf_t  *conf  = NULL;
+        sc_entry_t *entry = NULL;
+        char       *link  = NULL;
 
-	symlink_inode_ctx_get (inode, this, VOID(&sc));
+        conf = this->private;
 
-	if (!sc)
-		return 0;
+        LOCK (&conf->lock);
+        {
+                entry = __sc_entry_find (conf, gfid);
+                if (entry && (entry->len <= size)) {
+                        link = gf_strdup (entry->target);
+                        if (link) {
+                                list_move (&entry->lru, &conf->lru);
+                                conf->hits++;
+                        }
+                }
+
+                if (!link)
+                        conf->misses++;
+        }
+        UNLOCK (&conf->lock);
 
-	if (link && sc->readlink)
-		*link = strdup (sc->readlink);
-	return 0;
+        return link;
 }
 
 
@@ -244,11 +260,9 @@ sc_readlink_cbk (call_frame_t *frame, void *cookie,
 		 xlator_t *this, int op_ret, int op_errno,
 		 const char *link, struct iatt *sbuf)
 {
-	if (op_ret > 0)
-		sc_cache_update (this, frame->local, link);
-
-	inode_unref (frame->local);
-	frame->local = NULL;
+        /* a target filling all of @size may be cut short */
+	if ((op_ret > 0) && (op_ret < (long) cookie) && sbuf)
+		sc_cache_set (this, sbuf->ia_gfid, sbuf, link);
 
         STACK_UNWIND_STRICT (readlink, frame, op_ret, op_errno, link, sbuf);
         return 0;
@@ -262,7 +276,8 @@ sc_readlink (call_frame_t *frame, xlator_t *this,
 	char *link = NULL;
         struct iatt buf = {0, };
 
-	sc_cache_get (this, loc->inode, &link);
+        if (loc->inode && !uuid_is_null (loc->inode->gfid))
+                link = sc_cache_get (this, loc->inode->gfid, size);
 
 	if (link) {
 		/* cache hit */
@@ -276,16 +291,14 @@ sc_readlink (call_frame_t *frame, xlator_t *this,
                   is 0 filled
                 */
 		STACK_UNWIND_STRICT (readlink, frame, strlen (link), 0, link, &buf);
-		FREE (link);
+		GF_FREE (link);
 		return 0;
 	}
 
-	frame->local = inode_ref (loc->inode);
-
-        STACK_WIND (frame, sc_readlink_cbk,
-                    FIRST_CHILD(this),
-                    FIRST_CHILD(this)->fops->readlink,
-                    loc, size);
+        STACK_WIND_COOKIE (frame, sc_readlink_cbk, (void *) (long) size,
+                           FIRST_CHILD(this),
+                           FIRST_CHILD(this)->fops->readlink,
+                           loc, size);
 
 	return 0;
 }
@@ -299,10 +312,13 @@ sc_symlink_cbk (call_frame_t *frame, void *cookie,
 {
 	if (op_ret == 0) {
 		if (frame->local) {
-			sc_cache_set (this, inode, buf, frame->local);
+			sc_cache_set (this, buf->ia_gfid, buf, frame->local);
 		}
 	}
 
+        GF_FREE (frame->local);
+        frame->local = NULL;
+
         STACK_UNWIND_STRICT (symlink, frame, op_ret, op_errno, inode, buf, preparent,
                       postparent);
         return 0;
@@ -313,7 +329,7 @@ int
 sc_symlink (call_frame_t *frame, xlator_t *this,
 	    const char *dst, loc_t *src, dict_t *params)
 {
-	frame->local = strdup (dst);
+	frame->local = gf_strdup (dst);
 
         STACK_WIND (frame, sc_symlink_cbk,
                     FIRST_CHILD(this),
@@ -324,17 +340,79 @@ sc_symlink (call_frame_t *frame, xlator_t *this,
 }
 
 
+int
+sc_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+               struct iatt *postparent)
+{
+        inode_t *inode = NULL;
+
+        inode = frame->local;
+        frame->local = NULL;
+
+        if ((op_ret == 0) && inode && IA_ISLNK (inode->ia_type))
+                sc_cache_flush (this, inode->gfid);
+
+        if (inode)
+                inode_unref (inode);
+
+        STACK_UNWIND_STRICT (unlink, frame, op_ret, op_errno, preparent,
+                             postparent);
+        return 0;
+}
+
+
+int
+sc_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        if (loc->inode)
+                frame->local = inode_ref (loc->inode);
+
+        STACK_WIND (frame, sc_unlink_cbk,
+                    FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->unlink,
+                    loc);
+
+        return 0;
+}
+
+
 int
 sc_lookup_cbk (call_frame_t *frame, void *cookie,
 	       xlator_t *this, int op_ret, int op_errno,
 	       inode_t *inode, struct iatt *buf, dict_t *xattr,
                struct iatt *postparent)
 {
-	if (op_ret == 0)
-		sc_cache_validate (this, inode, buf);
-	else
-		sc_cache_flush (this, inode);
+        sc_conf_t *conf = NULL;
+        char      *link = NULL;
+        int        ret  = 0;
+
+        conf = this->private;
+
+	if (op_ret == 0) {
+                if (!IA_ISLNK (buf->ia_type))
+                        goto unwind;
+
+                if (xattr)
+                        ret = dict_get_str (xattr, GF_READLINK_KEY, &link);
+
+                if (link && (ret == 0)) {
+                        sc_cache_set (this, buf->ia_gfid, buf, link);
+
+                        LOCK (&conf->lock);
+                        {
+                                conf->prefetched++;
+                        }
+                        UNLOCK (&conf->lock);
+                } else {
+                        sc_cache_validate (this, buf->ia_gfid, buf);
+                }
+        } else if ((op_errno == ENOENT) || (op_errno == ESTALE)) {
+                if (inode)
+                        sc_cache_flush (this, inode->gfid);
+        }
 
+unwind:
         STACK_UNWIND_STRICT (lookup, frame, op_ret, op_errno, inode, buf, xattr, postparent);
         return 0;
 }
@@ -344,29 +422,128 @@ int
 sc_lookup (call_frame_t *frame, xlator_t *this,
 	   loc_t *loc, dict_t *xattr_req)
 {
+        sc_conf_t *conf     = NULL;
+        dict_t    *new_dict = NULL;
+        int        ret      = 0;
+
+        conf = this->private;
+
+        if (!conf->prefetch)
+                goto wind;
+
+        if (!xattr_req) {
+                new_dict = xattr_req = dict_new ();
+                if (!xattr_req)
+                        goto wind;
+        }
+
+        /* have the brick read the target if it is a symlink */
+        ret = dict_set_uint32 (xattr_req, GF_READLINK_KEY, 1);
+        if (ret < 0)
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "cannot request the symlink target of %s", loc->path);
+
+wind:
         STACK_WIND (frame, sc_lookup_cbk,
                     FIRST_CHILD(this),
                     FIRST_CHILD(this)->fops->lookup,
                     loc, xattr_req);
 
+        if (new_dict)
+                dict_unref (new_dict);
+
+        return 0;
+}
+
+
+int
+sc_priv_dump (xlator_t *this)
+{
+        sc_conf_t *conf = NULL;
+        char       key_prefix[GF_DUMP_MAX_BUF_LEN];
+
+        conf = this->private;
+        if (!conf)
+                return -1;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.performance.symlink-cache",
+                                "priv");
+
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_write ("cache_size", "%"PRIu64, conf->cache_size);
+        gf_proc_dump_write ("max_entries", "%"PRIu64, conf->max_entries);
+        gf_proc_dump_write ("prefetch", "%d", conf->prefetch);
+
+        LOCK (&conf->lock);
+        {
+                gf_proc_dump_write ("cache_used", "%"PRIu64, conf->cache_used);
+                gf_proc_dump_write ("entries", "%"PRIu64, conf->entries);
+                gf_proc_dump_write ("hits", "%"PRIu64, conf->hits);
+                gf_proc_dump_write ("misses", "%"PRIu64, conf->misses);
+                gf_proc_dump_write ("prefetched", "%"PRIu64, conf->prefetched);
+                gf_proc_dump_write ("evictions", "%"PRIu64, conf->evictions);
+                gf_proc_dump_write ("invalidations", "%"PRIu64,
+                                    conf->invalidations);
+        }
+        UNLOCK (&conf->lock);
+
         return 0;
 }
 
 
 int
-sc_forget (xlator_t *this,
-	   inode_t *inode)
+notify (xlator_t *this, int event, void *data, ...)
 {
-	sc_cache_flush (this, inode);
+        struct gf_upcall *upcall = NULL;
+
+        if (event == GF_EVENT_UPCALL) {
+                upcall = data;
+                sc_cache_flush (this, upcall->gfid);
+        }
 
+        return default_notify (this, event, data);
+}
+
+
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        sc_conf_t *conf = NULL;
+
+        conf = this->private;
+
+        GF_OPTION_RECONF ("cache-size", conf->cache_size, options, size, out);
+        GF_OPTION_RECONF ("max-entries", conf->max_entries, options, uint64,
+                          out);
+        GF_OPTION_RECONF ("prefetch", conf->prefetch, options, bool, out);
+
+        LOCK (&conf->lock);
+        {
+                __sc_prune (conf);
+        }
+        UNLOCK (&conf->lock);
+out:
         return 0;
 }
 
 
-int32_t 
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int     ret = -1;
+
+        ret = xlator_mem_acct_init (this, gf_sc_mt_end + 1);
+        return ret;
+}
+
+
+int32_t
 init (xlator_t *this)
 {
-	
+        sc_conf_t *conf = NULL;
+        uint32_t   i    = 0;
+
         if (!this->children || this->children->next)
         {
                 gf_log (this->name, GF_LOG_ERROR,
@@ -380,13 +557,60 @@ init (xlator_t *this)
 			"dangling volume. check volfile ");
 	}
 
+        conf = GF_CALLOC (1, sizeof (*conf), gf_sc_mt_sc_conf_t);
+        if (!conf)
+                return -1;
+
+        LOCK_INIT (&conf->lock);
+        INIT_LIST_HEAD (&conf->lru);
+
+        GF_OPTION_INIT ("cache-size", conf->cache_size, size, err);
+        GF_OPTION_INIT ("max-entries", conf->max_entries, uint64, err);
+        GF_OPTION_INIT ("prefetch", conf->prefetch, bool, err);
+
+        /* sized for max-entries as set at start, a larger value set later
+           only makes the chains longer */
+        conf->bucket_count = max (SC_MIN_BUCKETS, conf->max_entries / 4);
+        conf->buckets = GF_CALLOC (conf->bucket_count,
+                                   sizeof (struct list_head),
+                                   gf_sc_mt_list_head);
+        if (!conf->buckets)
+                goto err;
+
+        for (i = 0; i < conf->bucket_count; i++)
+                INIT_LIST_HEAD (&conf->buckets[i]);
+
+        this->private = conf;
+
         return 0;
+err:
+        LOCK_DESTROY (&conf->lock);
+        GF_FREE (conf);
+
+        return -1;
 }
 
 
 void
 fini (xlator_t *this)
 {
+        sc_conf_t  *conf  = NULL;
+        sc_entry_t *entry = NULL, *tmp = NULL;
+
+        conf = this->private;
+        if (!conf)
+                return;
+
+        this->private = NULL;
+
+        list_for_each_entry_safe (entry, tmp, &conf->lru, lru) {
+                __sc_entry_destroy (conf, entry);
+        }
+
+        LOCK_DESTROY (&conf->lock);
+        GF_FREE (conf->buckets);
+        GF_FREE (conf);
+
         return;
 }
 
@@ -395,13 +619,39 @@ struct xlator_fops fops = {
 	.lookup      = sc_lookup,
 	.symlink     = sc_symlink,
 	.readlink    = sc_readlink,
+        .unlink      = sc_unlink,
 };
 
 
 struct xlator_cbks cbks = {
-        .forget  = sc_forget,
+};
+
+struct xlator_dumpops dumpops = {
+        .priv       = sc_priv_dump,
 };
 
 struct volume_options options[] = {
+        { .key  = {"cache-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 0,
+          .max  = 1 * GF_UNIT_GB,
+          .default_value = "4MB",
+          .description = "Bytes the cached symlink targets may take, "
+                         "entries included."
+        },
+        { .key  = {"max-entries"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 64 * GF_UNIT_MB,
+          .default_value = "65536",
+          .description = "Number of symlink targets cached at most."
+        },
+        { .key  = {"prefetch"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "on",
+          .description = "Have lookups of symlinks bring the target along, "
+                         "so that the readlink which usually follows is "
+                         "answered from the cache."
+        },
 	{ .key = {NULL} },
 };
@@ -35,6 +35,8 @@
 #include "common-utils.h"
 #include "call-stub.h"
 #include "statedump.h"
+#include "rb.h"
+#include "compound-fop-utils.h"
 #include "write-behind-mem-types.h"
 
 #define MAX_VECTOR_COUNT  8
@@ -44,21 +46,38 @@
 typedef struct list_head list_head_t;
 struct wb_conf;
 struct wb_page;
-struct wb_file;
+struct wb_inode;
+
+/* Write-behind state of an inode, shared by all the fds open on it, so that
+ * writes through any of them are ordered, aggregated and coalesced against
+ * each other.
+ */
+typedef struct wb_inode {
+        size_t            window_conf;
+        size_t            window_current;
+        size_t            aggregate_current;
+        int32_t           op_ret;
+        int32_t           op_errno;
+        list_head_t       request;
+        list_head_t       passive_requests;
+        struct rb_table  *dirty;        /* writes not yet wound, by offset */
+        size_t            dirty_max;    /* largest write in 'dirty' */
+        uint64_t          gen;          /* requests queued so far */
+        uint64_t          barrier;      /* non-write requests queued so far */
+        uint64_t          bytes_coalesced;
+        uint64_t          writes_coalesced;
+        uint64_t          fsyncs_merged;
+        inode_t          *inode;
+        gf_lock_t         lock;
+        xlator_t         *this;
+} wb_inode_t;
 
 typedef struct wb_file {
         int          disabled;
         uint64_t     disable_till;
-        size_t       window_conf;
-        size_t       window_current;
         int32_t      flags;
-        size_t       aggregate_current;
-        int32_t      refcount;
-        int32_t      op_ret;
-        int32_t      op_errno;
-        list_head_t  request;
-        list_head_t  passive_requests;
         fd_t        *fd;
+        wb_inode_t  *wb_inode;
         gf_lock_t    lock;
         xlator_t    *this;
 }wb_file_t;
@@ -68,11 +87,15 @@ typedef struct wb_request {
         list_head_t     winds;
         list_head_t     unwinds;
         list_head_t     other_requests;
+        list_head_t     followers;      /* fsyncs answered by this one */
         call_stub_t    *stub;
         size_t          write_size;
         int32_t         refcount;
-        wb_file_t      *file;
+        wb_inode_t     *wb_inode;
         glusterfs_fop_t fop;
+        uint64_t        gen;            /* position in the queue */
+        uint64_t        barrier;        /* non-write requests queued before */
+        int             compound_step;  /* write step it was wound as */
         union {
                 struct  {
                         char write_behind;
@@ -86,6 +109,8 @@ typedef struct wb_request {
                                              * whatever data currently present in
                                              * request queue.
                                              */
+                        char append;        /* fd was opened with O_APPEND */
+                        char dirty;         /* indexed in wb_inode->dirty */
 
                 }write_request;
 
@@ -102,34 +127,150 @@ struct wb_conf {
         gf_boolean_t enable_O_SYNC;
         gf_boolean_t flush_behind;
         gf_boolean_t enable_trickling_writes;
+        gf_boolean_t compound_fops;
+        gf_lock_t    lock;
+        uint64_t     bytes_coalesced;
+        uint64_t     writes_coalesced;
+        uint64_t     fsyncs_merged;
 };
 
 typedef struct wb_local {
-        list_head_t     winds;
-        int32_t         flags;
-        int32_t         wbflags;
-        struct wb_file *file;
-        wb_request_t   *request;
-        int             op_ret;
-        int             op_errno;
-        call_frame_t   *frame;
-        int32_t         reply_count;
+        list_head_t      winds;
+        int32_t          flags;
+        int32_t          wbflags;
+        struct wb_inode *wb_inode;
+        fd_t            *fd;
+        wb_request_t    *request;
+        int              op_ret;
+        int              op_errno;
+        call_frame_t    *frame;
+        int32_t          reply_count;
 } wb_local_t;
 
 typedef struct wb_conf wb_conf_t;
 typedef struct wb_page wb_page_t;
 
 int32_t
-wb_process_queue (call_frame_t *frame, wb_file_t *file);
+wb_process_queue (call_frame_t *frame, wb_inode_t *wb_inode);
+
+ssize_t
+wb_sync (call_frame_t *frame, wb_inode_t *wb_inode, list_head_t *winds);
 
 ssize_t
-wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds);
+wb_sync_compound (call_frame_t *frame, wb_inode_t *wb_inode,
+                  list_head_t *winds, wb_request_t *flush);
 
 ssize_t
 __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_size,
                  char enable_trickling_writes);
 
 
+/* dirty ranges are ordered by offset, and by age among equal offsets */
+static int
+wb_dirty_cmp (const void *a, const void *b, void *param)
+{
+        const wb_request_t *r1 = a;
+        const wb_request_t *r2 = b;
+        off_t               o1 = r1->stub->args.writev.off;
+        off_t               o2 = r2->stub->args.writev.off;
+
+        if (o1 != o2) {
+                return (o1 < o2) ? -1 : 1;
+        }
+
+        if (r1->gen != r2->gen) {
+                return (r1->gen < r2->gen) ? -1 : 1;
+        }
+
+        return 0;
+}
+
+
+static void
+__wb_dirty_add (wb_request_t *request)
+{
+        wb_inode_t  *wb_inode = NULL;
+        void       **slot     = NULL;
+
+        wb_inode = request->wb_inode;
+
+        /* failing to index a write only costs the chance to coalesce it */
+        slot = rb_probe (wb_inode->dirty, request);
+        if ((slot == NULL) || (*slot != request)) {
+                return;
+        }
+
+        request->flags.write_request.dirty = 1;
+
+        if (request->write_size > wb_inode->dirty_max) {
+                wb_inode->dirty_max = request->write_size;
+        }
+}
+
+
+static void
+__wb_dirty_del (wb_request_t *request)
+{
+        wb_inode_t *wb_inode = NULL;
+
+        if (!request->flags.write_request.dirty) {
+                return;
+        }
+
+        wb_inode = request->wb_inode;
+
+        rb_delete (wb_inode->dirty, request);
+        request->flags.write_request.dirty = 0;
+
+        if (rb_count (wb_inode->dirty) == 0) {
+                wb_inode->dirty_max = 0;
+        }
+}
+
+
+/* Among the dirty writes in the subtree at @node, find the most recently
+ * queued one which is older than @request and overlaps or adjoins it. No
+ * dirty write starts before @low and reaches @request.
+ */
+static wb_request_t *
+__wb_dirty_latest (struct rb_node *node, wb_request_t *request, off_t low,
+                   wb_request_t *found)
+{
+        wb_request_t *tmp   = NULL;
+        off_t         start = 0, end = 0, offset = 0;
+
+        if (node == NULL) {
+                goto out;
+        }
+
+        start = request->stub->args.writev.off;
+        end = start + request->write_size;
+
+        tmp = node->rb_data;
+        offset = tmp->stub->args.writev.off;
+
+        if (offset >= low) {
+                found = __wb_dirty_latest (node->rb_link[0], request, low,
+                                           found);
+        }
+
+        if ((offset >= low) && (offset <= end)
+            && ((offset + tmp->write_size) >= start)
+            && (tmp->gen < request->gen)
+            && ((found == NULL) || (tmp->gen > found->gen))) {
+                found = tmp;
+        }
+
+        if (offset <= end) {
+                found = __wb_dirty_latest (node->rb_link[1], request, low,
+                                           found);
+        }
+
+out:
+        return found;
+}
+
+
 static int
 __wb_request_unref (wb_request_t *this)
 {
@@ -147,6 +288,7 @@ __wb_request_unref (wb_request_t *this)
         if (this->refcount == 0) {
                 list_del_init (&this->list);
                 if (this->stub && this->stub->fop == GF_FOP_WRITE) {
+                        __wb_dirty_del (this);
                         call_stub_destroy (this->stub);
                 }
 
@@ -161,18 +303,18 @@ out:
 static int
 wb_request_unref (wb_request_t *this)
 {
-        wb_file_t *file = NULL;
-        int        ret  = -1;
+        wb_inode_t *wb_inode = NULL;
+        int         ret      = -1;
 
         GF_VALIDATE_OR_GOTO ("write-behind", this, out);
 
-        file = this->file;
+        wb_inode = this->wb_inode;
 
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
                 ret = __wb_request_unref (this);
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
 out:
         return ret;
@@ -201,16 +343,16 @@ out:
 wb_request_t *
 wb_request_ref (wb_request_t *this)
 {
-        wb_file_t *file = NULL;
+        wb_inode_t *wb_inode = NULL;
 
         GF_VALIDATE_OR_GOTO ("write-behind", this, out);
 
-        file = this->file;
-        LOCK (&file->lock);
+        wb_inode = this->wb_inode;
+        LOCK (&wb_inode->lock);
         {
                 this = __wb_request_ref (this);
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
 out:
         return this;
@@ -218,16 +360,18 @@ out:
 
 
 wb_request_t *
-wb_enqueue (wb_file_t *file, call_stub_t *stub)
+wb_enqueue (wb_inode_t *wb_inode, call_stub_t *stub)
 {
-        wb_request_t *request = NULL, *tmp = NULL;
-        call_frame_t *frame   = NULL;
-        wb_local_t   *local   = NULL;
-        struct iovec *vector  = NULL;
-        int32_t       count   = 0;
+        wb_request_t *request  = NULL, *tmp = NULL;
+        call_frame_t *frame    = NULL;
+        wb_local_t   *local    = NULL;
+        struct iovec *vector   = NULL;
+        int32_t       count    = 0;
+        uint64_t      tmp_file = 0;
+        wb_file_t    *file     = NULL;
 
-        GF_VALIDATE_OR_GOTO ("write-behind", file, out);
-        GF_VALIDATE_OR_GOTO (file->this->name, stub, out);
+        GF_VALIDATE_OR_GOTO ("write-behind", wb_inode, out);
+        GF_VALIDATE_OR_GOTO (wb_inode->this->name, stub, out);
 
         request = GF_CALLOC (1, sizeof (*request), gf_wb_mt_wb_request_t);
         if (request == NULL) {
@@ -238,9 +382,10 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
         INIT_LIST_HEAD (&request->winds);
         INIT_LIST_HEAD (&request->unwinds);
         INIT_LIST_HEAD (&request->other_requests);
+        INIT_LIST_HEAD (&request->followers);
 
         request->stub = stub;
-        request->file = file;
+        request->wb_inode = wb_inode;
         request->fop  = stub->fop;
 
         frame = stub->frame;
@@ -260,11 +405,22 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
                 }
 
                 request->flags.write_request.virgin = 1;
+
+                if (!fd_ctx_get (stub->args.writev.fd, wb_inode->this,
+                                 &tmp_file)) {
+                        file = (wb_file_t *)(long)tmp_file;
+                }
+
+                if ((file != NULL) && (file->flags & O_APPEND)) {
+                        request->flags.write_request.append = 1;
+                }
         }
 
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
-                list_add_tail (&request->list, &file->request);
+                request->gen = ++wb_inode->gen;
+
+                list_add_tail (&request->list, &wb_inode->request);
                 if (stub->fop == GF_FOP_WRITE) {
                         /* reference for stack winding */
                         __wb_request_ref (request);
@@ -272,45 +428,164 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
                         /* reference for stack unwinding */
                         __wb_request_ref (request);
 
-                        file->aggregate_current += request->write_size;
+                        wb_inode->aggregate_current += request->write_size;
+
+                        request->barrier = wb_inode->barrier;
+                        __wb_dirty_add (request);
                 } else {
-                        list_for_each_entry (tmp, &file->request, list) {
+                        list_for_each_entry (tmp, &wb_inode->request, list) {
                                 if (tmp->stub && tmp->stub->fop
                                     == GF_FOP_WRITE) {
                                         tmp->flags.write_request.flush_all = 1;
                                 }
                         }
 
+                        /* writes queued from now on cannot be coalesced
+                         * with the ones before this request */
+                        request->barrier = ++wb_inode->barrier;
+
                         /*reference for resuming */
                         __wb_request_ref (request);
                 }
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
 out:
         return request;
 }
 
 
+static wb_inode_t *
+__wb_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        uint64_t    value    = 0;
+        wb_inode_t *wb_inode = NULL;
+
+        if (__inode_ctx_get (inode, this, &value) == 0) {
+                wb_inode = (wb_inode_t *)(long)value;
+        }
+
+        return wb_inode;
+}
+
+
+wb_inode_t *
+wb_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        wb_inode_t *wb_inode = NULL;
+
+        GF_VALIDATE_OR_GOTO ("write-behind", this, out);
+        GF_VALIDATE_OR_GOTO (this->name, inode, out);
+
+        LOCK (&inode->lock);
+        {
+                wb_inode = __wb_inode_ctx_get (this, inode);
+        }
+        UNLOCK (&inode->lock);
+
+out:
+        return wb_inode;
+}
+
+
+wb_inode_t *
+wb_inode_create (xlator_t *this, inode_t *inode)
+{
+        wb_inode_t *wb_inode = NULL;
+        wb_conf_t  *conf     = NULL;
+
+        GF_VALIDATE_OR_GOTO ("write-behind", this, out);
+        GF_VALIDATE_OR_GOTO (this->name, inode, out);
+
+        conf = this->private;
+
+        LOCK (&inode->lock);
+        {
+                wb_inode = __wb_inode_ctx_get (this, inode);
+                if (wb_inode != NULL) {
+                        goto unlock;
+                }
+
+                wb_inode = GF_CALLOC (1, sizeof (*wb_inode),
+                                      gf_wb_mt_wb_inode_t);
+                if (wb_inode == NULL) {
+                        goto unlock;
+                }
+
+                wb_inode->dirty = rb_create (wb_dirty_cmp, NULL, NULL);
+                if (wb_inode->dirty == NULL) {
+                        GF_FREE (wb_inode);
+                        wb_inode = NULL;
+                        goto unlock;
+                }
+
+                INIT_LIST_HEAD (&wb_inode->request);
+                INIT_LIST_HEAD (&wb_inode->passive_requests);
+
+                wb_inode->this = this;
+                wb_inode->inode = inode;
+                wb_inode->window_conf = conf->window_size;
+
+                LOCK_INIT (&wb_inode->lock);
+
+                __inode_ctx_put (inode, this, (uint64_t)(long)wb_inode);
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+out:
+        return wb_inode;
+}
+
+
+void
+wb_inode_destroy (wb_inode_t *wb_inode)
+{
+        wb_conf_t *conf = NULL;
+
+        GF_VALIDATE_OR_GOTO ("write-behind", wb_inode, out);
+
+        conf = wb_inode->this->private;
+
+        LOCK (&conf->lock);
+        {
+                conf->bytes_coalesced += wb_inode->bytes_coalesced;
+                conf->writes_coalesced += wb_inode->writes_coalesced;
+                conf->fsyncs_merged += wb_inode->fsyncs_merged;
+        }
+        UNLOCK (&conf->lock);
+
+        rb_destroy (wb_inode->dirty, NULL);
+        LOCK_DESTROY (&wb_inode->lock);
+        GF_FREE (wb_inode);
+
+out:
+        return;
+}
+
+
 wb_file_t *
 wb_file_create (xlator_t *this, fd_t *fd, int32_t flags)
 {
-        wb_file_t *file = NULL;
-        wb_conf_t *conf = NULL;
+        wb_file_t  *file     = NULL;
+        wb_conf_t  *conf     = NULL;
+        wb_inode_t *wb_inode = NULL;
 
         GF_VALIDATE_OR_GOTO ("write-behind", this, out);
         GF_VALIDATE_OR_GOTO (this->name, fd, out);
 
         conf = this->private;
 
+        wb_inode = wb_inode_create (this, fd->inode);
+        if (wb_inode == NULL) {
+                goto out;
+        }
+
         file = GF_CALLOC (1, sizeof (*file), gf_wb_mt_wb_file_t);
         if (file == NULL) {
                 goto out;
         }
 
-        INIT_LIST_HEAD (&file->request);
-        INIT_LIST_HEAD (&file->passive_requests);
-
         /*
           fd_ref() not required, file should never decide the existence of
           an fd
@@ -318,9 +593,8 @@ wb_file_create (xlator_t *this, fd_t *fd, int32_t flags)
         file->fd= fd;
         file->disable_till = conf->disable_till;
         file->this = this;
-        file->refcount = 1;
-        file->window_conf = conf->window_size;
         file->flags = flags;
+        file->wb_inode = wb_inode;
 
         LOCK_INIT (&file->lock);
 
@@ -334,23 +608,46 @@ out:
 void
 wb_file_destroy (wb_file_t *file)
 {
-        int32_t refcount = 0;
-
         GF_VALIDATE_OR_GOTO ("write-behind", file, out);
 
-        LOCK (&file->lock);
-        {
-                refcount = --file->refcount;
+        LOCK_DESTROY (&file->lock);
+        GF_FREE (file);
+
+out:
+        return;
+}
+
+
+/* the per-inode state behind @fd, creating it if @fd was not opened through
+ * write-behind; NULL for directories, or when it cannot be had */
+static int
+wb_fd_inode_get (xlator_t *this, fd_t *fd, wb_inode_t **wb_inode)
+{
+        uint64_t   tmp_file = 0;
+        wb_file_t *file     = NULL;
+
+        *wb_inode = NULL;
+
+        if (IA_ISDIR (fd->inode->ia_type)) {
+                return 0;
+        }
+
+        if (fd_ctx_get (fd, this, &tmp_file)) {
+                file = wb_file_create (this, fd, 0);
+        } else {
+                file = (wb_file_t *)(long)tmp_file;
+                if (file == NULL) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "wb_file not found for fd %p", fd);
+                        return -1;
+                }
         }
-        UNLOCK (&file->lock);
 
-        if (!refcount){
-                LOCK_DESTROY (&file->lock);
-                GF_FREE (file);
+        if (file != NULL) {
+                *wb_inode = file->wb_inode;
         }
 
-out:
-        return;
+        return 0;
 }
 
 
@@ -360,7 +657,7 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
 {
         wb_local_t   *local             = NULL;
         list_head_t  *winds             = NULL;
-        wb_file_t    *file              = NULL;
+        wb_inode_t   *wb_inode          = NULL;
         wb_request_t *request           = NULL, *dummy = NULL;
         wb_local_t   *per_request_local = NULL;
         int32_t       ret               = -1;
@@ -372,10 +669,12 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         local = frame->local;
         winds = &local->winds;
 
-        file = local->file;
-        GF_VALIDATE_OR_GOTO (this->name, file, out);
+        wb_inode = local->wb_inode;
+        GF_VALIDATE_OR_GOTO (this->name, wb_inode, out);
+
+        fd = local->fd;
 
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
                 list_for_each_entry_safe (request, dummy, winds, winds) {
                         request->flags.write_request.got_reply = 1;
@@ -388,29 +687,28 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                         }
 
                         if (request->flags.write_request.write_behind) {
-                                file->window_current -= request->write_size;
+                                wb_inode->window_current -= request->write_size;
                         }
 
                         __wb_request_unref (request);
                 }
 
                 if (op_ret == -1) {
-                        file->op_ret = op_ret;
-                        file->op_errno = op_errno;
+                        wb_inode->op_ret = op_ret;
+                        wb_inode->op_errno = op_errno;
                 }
-                fd = file->fd;
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
-        ret = wb_process_queue (frame, file);
+        ret = wb_process_queue (frame, wb_inode);
         if (ret == -1) {
                 if (errno == ENOMEM) {
-                        LOCK (&file->lock);
+                        LOCK (&wb_inode->lock);
                         {
-                                file->op_ret = -1;
-                                file->op_errno = ENOMEM;
+                                wb_inode->op_ret = -1;
+                                wb_inode->op_errno = ENOMEM;
                         }
-                        UNLOCK (&file->lock);
+                        UNLOCK (&wb_inode->lock);
                 }
 
                 gf_log (this->name, GF_LOG_WARNING,
@@ -428,7 +726,7 @@ out:
 
 
 ssize_t
-wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
+wb_sync (call_frame_t *frame, wb_inode_t *wb_inode, list_head_t *winds)
 {
         wb_request_t   *dummy         = NULL, *request = NULL;
         wb_request_t   *first_request = NULL, *next = NULL;
@@ -444,15 +742,15 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
         fd_t           *fd            = NULL;
         int32_t         op_errno      = -1;
 
-        GF_VALIDATE_OR_GOTO_WITH_ERROR ((file ? file->this->name
+        GF_VALIDATE_OR_GOTO_WITH_ERROR ((wb_inode ? wb_inode->this->name
                                          : "write-behind"), frame,
                                         out, bytes, -1);
-        GF_VALIDATE_OR_GOTO_WITH_ERROR (frame->this->name, file, out, bytes,
-                                        -1);
+        GF_VALIDATE_OR_GOTO_WITH_ERROR (frame->this->name, wb_inode, out,
+                                        bytes, -1);
         GF_VALIDATE_OR_GOTO_WITH_ERROR (frame->this->name, winds, out, bytes,
                                         -1);
 
-        conf = file->this->private;
+        conf = wb_inode->this->private;
         list_for_each_entry (request, winds, winds) {
                 total_count += request->stub->args.writev.count;
                 if (total_count > 0) {
@@ -461,8 +759,8 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
         }
 
         if (total_count == 0) {
-                gf_log (file->this->name, GF_LOG_TRACE, "no vectors are to be"
-                        "synced");
+                gf_log (wb_inode->this->name, GF_LOG_TRACE, "no vectors are to"
+                        "be synced");
                 goto out;
         }
 
@@ -532,16 +830,13 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
                                 goto out;
                         }
 
-                        sync_frame->local = local;
-                        local->file = file;
+                        /* the writes may have come through different fds of
+                         * the inode, any of them will do for the batch */
+                        fd = fd_ref (first_request->stub->args.writev.fd);
 
-                        LOCK (&file->lock);
-                        {
-                                fd = file->fd;
-                        }
-                        UNLOCK (&file->lock);
-
-                        fd_ref (fd);
+                        sync_frame->local = local;
+                        local->wb_inode = wb_inode;
+                        local->fd = fd;
 
                         bytes += current_size;
                         STACK_WIND (sync_frame, wb_sync_cbk,
@@ -602,13 +897,13 @@ out:
                         }
                 }
 
-                if (file != NULL) {
-                        LOCK (&file->lock);
+                if (wb_inode != NULL) {
+                        LOCK (&wb_inode->lock);
                         {
-                                file->op_ret = -1;
-                                file->op_errno = op_errno;
+                                wb_inode->op_ret = -1;
+                                wb_inode->op_errno = op_errno;
                         }
-                        UNLOCK (&file->lock);
+                        UNLOCK (&wb_inode->lock);
                 }
         }
 
@@ -616,6 +911,223 @@ out:
 }
 
 
+int32_t
+wb_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno,
+                 compound_args_cbk_t *args_cbk)
+{
+        compound_args_t   *args              = NULL;
+        wb_local_t        *local             = NULL;
+        wb_inode_t        *wb_inode          = NULL;
+        wb_request_t      *request           = NULL, *dummy = NULL;
+        wb_request_t      *flush             = NULL;
+        wb_local_t        *per_request_local = NULL;
+        call_stub_t       *stub              = NULL;
+        int32_t            step_ret          = 0, step_errno = 0;
+        int32_t            ret               = -1;
+
+        args = cookie;
+        local = frame->local;
+        wb_inode = local->wb_inode;
+        flush = local->request;
+
+        LOCK (&wb_inode->lock);
+        {
+                list_for_each_entry_safe (request, dummy, &local->winds,
+                                          winds) {
+                        step_ret = op_ret;
+                        step_errno = op_errno;
+                        if (args_cbk != NULL) {
+                                step_ret = args_cbk->rsp[request->compound_step].op_ret;
+                                step_errno = args_cbk->rsp[request->compound_step].op_errno;
+                        }
+
+                        request->flags.write_request.got_reply = 1;
+
+                        if (!request->flags.write_request.write_behind
+                            && (step_ret == -1)) {
+                                per_request_local = request->stub->frame->local;
+                                per_request_local->op_ret = step_ret;
+                                per_request_local->op_errno = step_errno;
+                        }
+
+                        if (request->flags.write_request.write_behind) {
+                                wb_inode->window_current -= request->write_size;
+                        }
+
+                        if (step_ret == -1) {
+                                wb_inode->op_ret = step_ret;
+                                wb_inode->op_errno = step_errno;
+                        }
+
+                        __wb_request_unref (request);
+                }
+
+                /* like wb_ffr_cbk, the flush reports the failure of the
+                 * writes before it */
+                if (wb_inode->op_ret == -1) {
+                        op_ret = wb_inode->op_ret;
+                        op_errno = wb_inode->op_errno;
+
+                        wb_inode->op_ret = 0;
+                } else if (args_cbk != NULL) {
+                        op_ret = args_cbk->rsp[args->count - 1].op_ret;
+                        op_errno = args_cbk->rsp[args->count - 1].op_errno;
+                }
+
+                stub = flush->stub;
+                flush->stub = NULL;
+        }
+        UNLOCK (&wb_inode->lock);
+
+        wb_request_unref (flush);
+
+        STACK_UNWIND_STRICT (flush, stub->frame, op_ret, op_errno);
+        call_stub_destroy (stub);
+
+        ret = wb_process_queue (frame, wb_inode);
+        if (ret == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "request queue processing failed");
+        }
+
+        compound_args_destroy (args);
+        fd_unref (local->fd);
+
+        STACK_DESTROY (frame->root);
+
+        return 0;
+}
+
+
+/* Winds the writes in @winds together with @flush, which is queued right
+ * behind them, as a single compound fop: the writes go in batches as in
+ * wb_sync, the flush is answered when the chain returns. Returns -1 without
+ * winding anything if the chain could not be built.
+ */
+ssize_t
+wb_sync_compound (call_frame_t *frame, wb_inode_t *wb_inode,
+                  list_head_t *winds, wb_request_t *flush)
+{
+        wb_request_t    *request       = NULL;
+        wb_request_t    *first_request = NULL, *next = NULL;
+        compound_args_t *args          = NULL;
+        compound_req_t  *req           = NULL;
+        call_frame_t    *sync_frame    = NULL;
+        wb_local_t      *local         = NULL;
+        wb_conf_t       *conf          = NULL;
+        size_t           current_size  = 0;
+        ssize_t          bytes         = 0;
+        int32_t          count         = 0;
+
+        conf = wb_inode->this->private;
+
+        args = compound_args_new ();
+        if (args == NULL) {
+                goto err;
+        }
+
+        list_for_each_entry (request, winds, winds) {
+                if (first_request == NULL) {
+                        req = compound_args_add (args, GF_FOP_WRITE);
+                        if (req == NULL) {
+                                goto err;
+                        }
+
+                        req->vector = GF_CALLOC (MAX_VECTOR_COUNT,
+                                                 sizeof (struct iovec),
+                                                 gf_wb_mt_iovec);
+                        req->iobref = iobref_new ();
+                        if ((req->vector == NULL) || (req->iobref == NULL)) {
+                                goto err;
+                        }
+
+                        first_request = request;
+                        req->fd = fd_ref (request->stub->args.writev.fd);
+                        req->offset = request->stub->args.writev.off;
+                        req->flags = request->stub->args.writev.flags;
+                        current_size = 0;
+                }
+
+                memcpy (&req->vector[req->count],
+                        request->stub->args.writev.vector,
+                        VECTORSIZE (request->stub->args.writev.count));
+                req->count += request->stub->args.writev.count;
+
+                if (request->stub->args.writev.iobref) {
+                        iobref_merge (req->iobref,
+                                      request->stub->args.writev.iobref);
+                }
+
+                current_size += request->write_size;
+                request->compound_step = args->count - 1;
+
+                next = NULL;
+                if (request->winds.next != winds) {
+                        next = list_entry (request->winds.next,
+                                           wb_request_t, winds);
+                }
+
+                if ((!next)
+                    || ((req->count + next->stub->args.writev.count)
+                        > MAX_VECTOR_COUNT)
+                    || ((current_size + next->write_size)
+                        > conf->aggregate_size)) {
+                        req->size = current_size;
+                        bytes += current_size;
+                        first_request = NULL;
+                }
+        }
+
+        req = compound_args_add (args, GF_FOP_FLUSH);
+        if (req == NULL) {
+                goto err;
+        }
+        req->fd = fd_ref (flush->stub->args.flush.fd);
+
+        /* @frame is whatever drove the queue, the flush has to go down
+           with the lk-owner of its own caller (see wb_flush_helper) */
+        sync_frame = copy_frame (flush->stub->frame);
+        if (sync_frame == NULL) {
+                goto err;
+        }
+
+        local = mem_get0 (THIS->local_pool);
+        if (local == NULL) {
+                goto err;
+        }
+
+        INIT_LIST_HEAD (&local->winds);
+        list_splice_init (winds, &local->winds);
+
+        local->wb_inode = wb_inode;
+        local->request = flush;
+        local->fd = fd_ref (args->req[0].fd);
+        sync_frame->local = local;
+
+        count = args->count;
+        STACK_WIND_COOKIE (sync_frame, wb_compound_cbk, args,
+                           FIRST_CHILD(sync_frame->this),
+                           FIRST_CHILD(sync_frame->this)->fops->compound,
+                           args);
+
+        gf_log (wb_inode->this->name, GF_LOG_TRACE,
+                "wound %"GF_PRI_SIZET" bytes in %d writes with the flush",
+                bytes, count - 1);
+
+        return bytes;
+
+err:
+        if (sync_frame != NULL) {
+                STACK_DESTROY (sync_frame->root);
+        }
+
+        compound_args_destroy (args);
+
+        return -1;
+}
+
+
 int32_t
 wb_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
              int32_t op_errno, struct iatt *buf)
@@ -623,15 +1135,14 @@ wb_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         wb_local_t   *local         = NULL;
         wb_request_t *request       = NULL;
         call_frame_t *process_frame = NULL;
-        wb_file_t    *file          = NULL;
+        wb_inode_t   *wb_inode      = NULL;
         int32_t       ret           = -1;
-        fd_t         *fd            = NULL;
 
         GF_ASSERT (frame);
         GF_ASSERT (this);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
 
         request = local->request;
         if (request) {
@@ -649,15 +1160,15 @@ wb_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         }
 
         if (process_frame != NULL) {
-                ret = wb_process_queue (process_frame, file);
+                ret = wb_process_queue (process_frame, wb_inode);
                 if (ret == -1) {
-                        if ((errno == ENOMEM) && (file != NULL)) {
-                                LOCK (&file->lock);
+                        if ((errno == ENOMEM) && (wb_inode != NULL)) {
+                                LOCK (&wb_inode->lock);
                                 {
-                                        file->op_ret = -1;
-                                        file->op_errno = ENOMEM;
+                                        wb_inode->op_ret = -1;
+                                        wb_inode->op_errno = ENOMEM;
                                 }
-                                UNLOCK (&file->lock);
+                                UNLOCK (&wb_inode->lock);
                         }
 
                         gf_log (this->name, GF_LOG_WARNING,
@@ -667,16 +1178,6 @@ wb_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                 STACK_DESTROY (process_frame->root);
         }
 
-        if (file) {
-                LOCK (&file->lock);
-                {
-                        fd = file->fd;
-                }
-                UNLOCK (&file->lock);
-
-                fd_unref (fd);
-        }
-
         return 0;
 }
 
@@ -696,10 +1197,8 @@ wb_stat_helper (call_frame_t *frame, xlator_t *this, loc_t *loc)
 int32_t
 wb_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
 {
-        wb_file_t    *file     = NULL;
-        fd_t         *iter_fd  = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
         int32_t       ret      = -1, op_errno = EINVAL;
@@ -709,16 +1208,7 @@ wb_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
         GF_VALIDATE_OR_GOTO (frame->this->name, loc, unwind);
 
         if (loc->inode) {
-                /* FIXME: fd_lookup extends life of fd till stat returns */
-                iter_fd = fd_lookup (loc->inode, frame->root->pid);
-                if (iter_fd) {
-                        if (!fd_ctx_get (iter_fd, this, &tmp_file)) {
-                                file = (wb_file_t *)(long)tmp_file;
-                        } else {
-                                fd_unref (iter_fd);
-                                iter_fd = NULL;
-                        }
-                }
+                wb_inode = wb_inode_ctx_get (this, loc->inode);
         }
 
         local = mem_get0 (this->local_pool);
@@ -727,24 +1217,24 @@ wb_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
 
-        if (file) {
+        if (wb_inode) {
                 stub = fop_stat_stub (frame, wb_stat_helper, loc);
                 if (stub == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -762,10 +1252,6 @@ unwind:
                 call_stub_destroy (stub);
         }
 
-        if (iter_fd != NULL) {
-                fd_unref (iter_fd);
-        }
-
         return 0;
 }
 
@@ -774,20 +1260,20 @@ int32_t
 wb_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
               int32_t op_errno, struct iatt *buf)
 {
-        wb_local_t   *local   = NULL;
-        wb_request_t *request = NULL;
-        wb_file_t    *file    = NULL;
-        int32_t       ret     = -1;
+        wb_local_t   *local    = NULL;
+        wb_request_t *request  = NULL;
+        wb_inode_t   *wb_inode = NULL;
+        int32_t       ret      = -1;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
 
         request = local->request;
-        if ((file != NULL) && (request != NULL)) {
+        if ((wb_inode != NULL) && (request != NULL)) {
                 wb_request_unref (request);
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         if (errno == ENOMEM) {
                                 op_ret = -1;
@@ -820,9 +1306,8 @@ wb_fstat_helper (call_frame_t *frame, xlator_t *this, fd_t *fd)
 int32_t
 wb_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
 {
-        wb_file_t    *file     = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
         int32_t       ret      = -1;
@@ -833,17 +1318,9 @@ wb_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
         GF_VALIDATE_OR_GOTO (frame->this->name, fd, unwind);
 
 
-        if ((!IA_ISDIR (fd->inode->ia_type))
-            && fd_ctx_get (fd, this, &tmp_file)) {
-                file = wb_file_create (this, fd, 0);
-        } else {
-                file = (wb_file_t *)(long)tmp_file;
-                if ((!IA_ISDIR (fd->inode->ia_type)) && (file == NULL)) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "wb_file not found for fd %p", fd);
-                        op_errno = EBADFD;
-                        goto unwind;
-                }
+        if (wb_fd_inode_get (this, fd, &wb_inode) == -1) {
+                op_errno = EBADFD;
+                goto unwind;
         }
 
         local = mem_get0 (this->local_pool);
@@ -852,18 +1329,18 @@ wb_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
 
-        if (file) {
+        if (wb_inode) {
                 stub = fop_fstat_stub (frame, wb_fstat_helper, fd);
                 if (stub == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
@@ -872,7 +1349,7 @@ wb_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 /*
                   FIXME:should the request queue be emptied in case of error?
                 */
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -902,18 +1379,17 @@ wb_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         wb_local_t   *local         = NULL;
         wb_request_t *request       = NULL;
-        wb_file_t    *file          = NULL;
+        wb_inode_t   *wb_inode      = NULL;
         call_frame_t *process_frame = NULL;
         int32_t       ret           = -1;
-        fd_t         *fd            = NULL;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
         request = local->request;
 
-        if ((request != NULL) && (file != NULL)) {
+        if ((request != NULL) && (wb_inode != NULL)) {
                 process_frame = copy_frame (frame);
                 if (process_frame == NULL) {
                         op_ret = -1;
@@ -929,15 +1405,15 @@ wb_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         }
 
         if (process_frame != NULL) {
-                ret = wb_process_queue (process_frame, file);
+                ret = wb_process_queue (process_frame, wb_inode);
                 if (ret == -1) {
-                        if ((errno == ENOMEM) && (file != NULL)) {
-                                LOCK (&file->lock);
+                        if ((errno == ENOMEM) && (wb_inode != NULL)) {
+                                LOCK (&wb_inode->lock);
                                 {
-                                        file->op_ret = -1;
-                                        file->op_errno = ENOMEM;
+                                        wb_inode->op_ret = -1;
+                                        wb_inode->op_errno = ENOMEM;
                                 }
-                                UNLOCK (&file->lock);
+                                UNLOCK (&wb_inode->lock);
                         }
 
                         gf_log (this->name, GF_LOG_WARNING,
@@ -947,16 +1423,6 @@ wb_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 STACK_DESTROY (process_frame->root);
         }
 
-        if (file) {
-                LOCK (&file->lock);
-                {
-                        fd = file->fd;
-                }
-                UNLOCK (&file->lock);
-
-                fd_unref (fd);
-        }
-
         return 0;
 }
 
@@ -978,10 +1444,8 @@ wb_truncate_helper (call_frame_t *frame, xlator_t *this, loc_t *loc,
 int32_t
 wb_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
 {
-        wb_file_t    *file     = NULL;
-        fd_t         *iter_fd  = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
         int32_t       ret      = -1, op_errno = EINVAL;
@@ -991,18 +1455,7 @@ wb_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
         GF_VALIDATE_OR_GOTO (frame->this->name, loc, unwind);
 
         if (loc->inode) {
-                /*
-                  FIXME: fd_lookup extends life of fd till the execution of
-                  truncate_cbk
-                */
-                iter_fd = fd_lookup (loc->inode, frame->root->pid);
-                if (iter_fd) {
-                        if (!fd_ctx_get (iter_fd, this, &tmp_file)){
-                                file = (wb_file_t *)(long)tmp_file;
-                        } else {
-                                fd_unref (iter_fd);
-                        }
-                }
+                wb_inode = wb_inode_ctx_get (this, loc->inode);
         }
 
         local = mem_get0 (this->local_pool);
@@ -1011,10 +1464,10 @@ wb_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
-        if (file) {
+        if (wb_inode) {
                 stub = fop_truncate_stub (frame, wb_truncate_helper, loc,
                                           offset);
                 if (stub == NULL) {
@@ -1022,13 +1475,13 @@ wb_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -1056,20 +1509,20 @@ wb_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
                   struct iatt *postbuf)
 {
-        wb_local_t   *local   = NULL;
-        wb_request_t *request = NULL;
-        wb_file_t    *file    = NULL;
-        int32_t       ret     = -1;
+        wb_local_t   *local    = NULL;
+        wb_request_t *request  = NULL;
+        wb_inode_t   *wb_inode = NULL;
+        int32_t       ret      = -1;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
         request = local->request;
 
-        if ((request != NULL) && (file != NULL)) {
+        if ((request != NULL) && (wb_inode != NULL)) {
                 wb_request_unref (request);
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         if (errno == ENOMEM) {
                                 op_ret = -1;
@@ -1104,30 +1557,21 @@ wb_ftruncate_helper (call_frame_t *frame, xlator_t *this, fd_t *fd,
 int32_t
 wb_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
 {
-        wb_file_t    *file     = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
-        int32_t       ret      = -1;
-        int           op_errno = EINVAL;
-
-        GF_ASSERT (frame);
-        GF_VALIDATE_OR_GOTO (frame->this->name, this, unwind);
-        GF_VALIDATE_OR_GOTO (frame->this->name, fd, unwind);
-
-
-        if ((!IA_ISDIR (fd->inode->ia_type))
-            && fd_ctx_get (fd, this, &tmp_file)) {
-                file = wb_file_create (this, fd, 0);
-        } else {
-                file = (wb_file_t *)(long)tmp_file;
-                if ((!IA_ISDIR (fd->inode->ia_type)) && (file == NULL)) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "wb_file not found for fd %p", fd);
-                        op_errno = EBADFD;
-                        goto unwind;
-                }
+        int32_t       ret      = -1;
+        int           op_errno = EINVAL;
+
+        GF_ASSERT (frame);
+        GF_VALIDATE_OR_GOTO (frame->this->name, this, unwind);
+        GF_VALIDATE_OR_GOTO (frame->this->name, fd, unwind);
+
+
+        if (wb_fd_inode_get (this, fd, &wb_inode) == -1) {
+                op_errno = EBADFD;
+                goto unwind;
         }
 
         local = mem_get0 (this->local_pool);
@@ -1136,11 +1580,11 @@ wb_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
 
-        if (file) {
+        if (wb_inode) {
                 stub = fop_ftruncate_stub (frame, wb_ftruncate_helper, fd,
                                            offset);
                 if (stub == NULL) {
@@ -1148,13 +1592,13 @@ wb_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -1185,14 +1629,13 @@ wb_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         wb_local_t   *local         = NULL;
         wb_request_t *request       = NULL;
         call_frame_t *process_frame = NULL;
-        wb_file_t    *file          = NULL;
+        wb_inode_t   *wb_inode      = NULL;
         int32_t       ret           = -1;
-        fd_t         *fd            = NULL;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
         request = local->request;
 
         if (request) {
@@ -1211,15 +1654,15 @@ wb_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         }
 
         if (request && (process_frame != NULL)) {
-                ret = wb_process_queue (process_frame, file);
+                ret = wb_process_queue (process_frame, wb_inode);
                 if (ret == -1) {
-                        if ((errno == ENOMEM) && (file != NULL)) {
-                                LOCK (&file->lock);
+                        if ((errno == ENOMEM) && (wb_inode != NULL)) {
+                                LOCK (&wb_inode->lock);
                                 {
-                                        file->op_ret = -1;
-                                        file->op_errno = ENOMEM;
+                                        wb_inode->op_ret = -1;
+                                        wb_inode->op_errno = ENOMEM;
                                 }
-                                UNLOCK (&file->lock);
+                                UNLOCK (&wb_inode->lock);
                         }
 
                         gf_log (this->name, GF_LOG_WARNING,
@@ -1229,16 +1672,6 @@ wb_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 STACK_DESTROY (process_frame->root);
         }
 
-        if (file) {
-                LOCK (&file->lock);
-                {
-                        fd = file->fd;
-                }
-                UNLOCK (&file->lock);
-
-                fd_unref (fd);
-        }
-
         return 0;
 }
 
@@ -1260,10 +1693,8 @@ int32_t
 wb_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
             struct iatt *stbuf, int32_t valid)
 {
-        wb_file_t    *file     = NULL;
-        fd_t         *iter_fd  = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
         int32_t       ret      = -1, op_errno = EINVAL;
@@ -1288,24 +1719,12 @@ wb_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
         }
 
         if (loc->inode) {
-                /*
-                  FIXME: fd_lookup extends life of fd till the execution
-                  of wb_utimens_cbk
-                */
-                iter_fd = fd_lookup (loc->inode, frame->root->pid);
-                if (iter_fd) {
-                        if (!fd_ctx_get (iter_fd, this, &tmp_file)) {
-                                file = (wb_file_t *)(long)tmp_file;
-                        } else {
-                                fd_unref (iter_fd);
-                        }
-                }
-
+                wb_inode = wb_inode_ctx_get (this, loc->inode);
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
-        if (file) {
+        if (wb_inode) {
                 stub = fop_setattr_stub (frame, wb_setattr_helper, loc, stbuf,
                                          valid);
                 if (stub == NULL) {
@@ -1313,13 +1732,13 @@ wb_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -1478,13 +1897,17 @@ wb_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
                 LOCK (&file->lock);
                 {
-                        /* If O_DIRECT then, we disable caching */
+                        /* If O_DIRECT then, we disable caching. The window
+                         * is shared with the other fds on the inode, so
+                         * this fd's writes bypass it instead of shrinking
+                         * it.
+                         */
                         if (frame->local) {
                                 if (((flags & O_DIRECT) == O_DIRECT)
                                     || ((flags & O_ACCMODE) == O_RDONLY)
                                     || (((flags & O_SYNC) == O_SYNC)
                                         && (conf->enable_O_SYNC == _gf_true))) {
-                                        file->window_conf = 0;
+                                        file->disabled = 1;
                                 }
                         }
                 }
@@ -1525,26 +1948,31 @@ unwind:
 }
 
 
+
+
 /* Mark all the contiguous write requests for winding starting from head of
  * request list. Stops marking at the first non-write request found. If
  * file is opened with O_APPEND, make sure all the writes marked for winding
- * will fit into a single write call to server.
+ * will fit into a single write call to server, through its own fd.
  */
 size_t
-__wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
+__wb_mark_wind_all (wb_inode_t *wb_inode, list_head_t *list,
+                    list_head_t *winds)
 {
         wb_request_t *request         = NULL;
         size_t        size            = 0;
         char          first_request   = 1;
+        char          append          = 0;
         off_t         offset_expected = 0;
+        fd_t         *fd              = NULL;
         wb_conf_t    *conf            = NULL;
         int           count           = 0;
 
-        GF_VALIDATE_OR_GOTO ("write-behind", file, out);
-        GF_VALIDATE_OR_GOTO (file->this->name, list, out);
-        GF_VALIDATE_OR_GOTO (file->this->name, winds, out);
+        GF_VALIDATE_OR_GOTO ("write-behind", wb_inode, out);
+        GF_VALIDATE_OR_GOTO (wb_inode->this->name, list, out);
+        GF_VALIDATE_OR_GOTO (wb_inode->this->name, winds, out);
 
-        conf = file->this->private;
+        conf = wb_inode->this->private;
 
         list_for_each_entry (request, list, list)
         {
@@ -1558,15 +1986,19 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
                                 first_request = 0;
                                 offset_expected
                                         = request->stub->args.writev.off;
+                                fd = request->stub->args.writev.fd;
                         }
 
                         if (request->stub->args.writev.off != offset_expected) {
                                 break;
                         }
 
-                        if ((file->flags & O_APPEND)
-                            && (((size + request->write_size)
-                                 > conf->aggregate_size)
+                        append |= request->flags.write_request.append;
+
+                        if (append
+                            && ((request->stub->args.writev.fd != fd)
+                                || ((size + request->write_size)
+                                    > conf->aggregate_size)
                                 || ((count + request->stub->args.writev.count)
                                     > MAX_VECTOR_COUNT))) {
                                 break;
@@ -1574,10 +2006,11 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
 
                         size += request->write_size;
                         offset_expected += request->write_size;
-                        file->aggregate_current -= request->write_size;
+                        wb_inode->aggregate_current -= request->write_size;
                         count += request->stub->args.writev.count;
 
                         request->flags.write_request.stack_wound = 1;
+                        __wb_dirty_del (request);
                         list_add_tail (&request->winds, winds);
                 }
         }
@@ -1655,7 +2088,7 @@ __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_conf,
         char          incomplete_writes      = 0;
         char          non_contiguous_writes  = 0;
         wb_request_t *request                = NULL;
-        wb_file_t    *file                   = NULL;
+        wb_inode_t   *wb_inode               = NULL;
         char          wind_all               = 0;
         int32_t       ret                    = 0;
 
@@ -1667,13 +2100,13 @@ __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_conf,
         }
 
         request = list_entry (list->next, typeof (*request), list);
-        file = request->file;
+        wb_inode = request->wb_inode;
 
         ret = __wb_can_wind (list, &other_fop_in_queue,
                              &non_contiguous_writes, &incomplete_writes,
                              &wind_all);
         if (ret == -1) {
-                gf_log (file->this->name, GF_LOG_WARNING,
+                gf_log (wb_inode->this->name, GF_LOG_WARNING,
                         "cannot decide whether to wind or not");
                 goto out;
         }
@@ -1681,9 +2114,9 @@ __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_conf,
         if (!incomplete_writes && ((enable_trickling_writes)
                                    || (wind_all) || (non_contiguous_writes)
                                    || (other_fop_in_queue)
-                                   || (file->aggregate_current
+                                   || (wb_inode->aggregate_current
                                        >= aggregate_conf))) {
-                size = __wb_mark_wind_all (file, list, winds);
+                size = __wb_mark_wind_all (wb_inode, list, winds);
         }
 
 out:
@@ -1696,14 +2129,14 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
 {
         size_t        written_behind = 0;
         wb_request_t *request        = NULL;
-        wb_file_t    *file           = NULL;
+        wb_inode_t   *wb_inode       = NULL;
 
         if (list_empty (list)) {
                 goto out;
         }
 
         request = list_entry (list->next, typeof (*request), list);
-        file = request->file;
+        wb_inode = request->wb_inode;
 
         list_for_each_entry (request, list, list)
         {
@@ -1719,7 +2152,7 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
                                 list_add_tail (&request->unwinds, unwinds);
 
                                 if (!request->flags.write_request.got_reply) {
-                                        file->window_current
+                                        wb_inode->window_current
                                                 += request->write_size;
                                 }
                         }
@@ -1736,8 +2169,8 @@ out:
 void
 __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
 {
-        wb_request_t *request = NULL;
-        wb_file_t    *file    = NULL;
+        wb_request_t *request  = NULL;
+        wb_inode_t   *wb_inode = NULL;
 
         GF_VALIDATE_OR_GOTO ("write-behind", list, out);
         GF_VALIDATE_OR_GOTO ("write-behind", unwinds, out);
@@ -1747,12 +2180,12 @@ __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
         }
 
         request = list_entry (list->next, typeof (*request), list);
-        file = request->file;
+        wb_inode = request->wb_inode;
 
-        if (file->window_current <= file->window_conf) {
+        if (wb_inode->window_current <= wb_inode->window_conf) {
                 __wb_mark_unwind_till (list, unwinds,
-                                       file->window_conf
-                                       - file->window_current);
+                                       wb_inode->window_conf
+                                       - wb_inode->window_current);
         }
 
 out:
@@ -1760,10 +2193,82 @@ out:
 }
 
 
+static int
+__wb_request_in_winds (wb_request_t *request, list_head_t *winds)
+{
+        wb_request_t *trav = NULL;
+
+        list_for_each_entry (trav, winds, winds) {
+                if (trav == request) {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+
+/* A flush queued right behind the writes just marked for winding, with no
+ * other write before it left to wind or still waiting for its reply, can go
+ * down in a compound fop with them instead of waiting for their replies.
+ * Returns the flush, marked so that it is not resumed on its own.
+ */
+wb_request_t *
+__wb_mark_compound_flush (list_head_t *list, list_head_t *winds)
+{
+        wb_request_t *request = NULL;
+        int           count   = 0;
+
+        list_for_each_entry (request, winds, winds) {
+                count++;
+        }
+
+        if ((count == 0) || (count >= GF_COMPOUND_MAX_FOPS)) {
+                goto out;
+        }
+
+        list_for_each_entry (request, list, list) {
+                if (request->stub == NULL) {
+                        break;
+                }
+
+                if (request->stub->fop == GF_FOP_WRITE) {
+                        if (!request->flags.write_request.stack_wound) {
+                                break;
+                        }
+
+                        /* wound earlier: the flush must not overtake it,
+                           and has to see its error */
+                        if (!request->flags.write_request.got_reply
+                            && !__wb_request_in_winds (request, winds)) {
+                                break;
+                        }
+                        continue;
+                }
+
+                if ((request->stub->fop != GF_FOP_FLUSH)
+                    || request->flags.other_requests.marked_for_resume) {
+                        break;
+                }
+
+                request->flags.other_requests.marked_for_resume = 1;
+                return request;
+        }
+
+out:
+        return NULL;
+}
+
+
+/* Collect the non-write requests at the head of the queue for resuming.
+ * All the writes they wait for have been acknowledged by the time they get
+ * here, so of the fsyncs among them only the first one goes down, with the
+ * others riding on its reply.
+ */
 uint32_t
 __wb_get_other_requests (list_head_t *list, list_head_t *other_requests)
 {
-        wb_request_t *request = NULL;
+        wb_request_t *request = NULL, *fsync = NULL;
         uint32_t      count   = 0;
 
         GF_VALIDATE_OR_GOTO ("write-behind", list, out);
@@ -1775,12 +2280,29 @@ __wb_get_other_requests (list_head_t *list, list_head_t *other_requests)
                         break;
                 }
 
-                if (!request->flags.other_requests.marked_for_resume) {
-                        request->flags.other_requests.marked_for_resume = 1;
-                        list_add_tail (&request->other_requests,
-                                       other_requests);
-                        count++;
+                if (request->flags.other_requests.marked_for_resume) {
+                        continue;
+                }
+
+                request->flags.other_requests.marked_for_resume = 1;
+
+                if (request->fop == GF_FOP_FSYNC) {
+                        if (fsync != NULL) {
+                                if (!request->stub->args.fsync.datasync) {
+                                        fsync->stub->args.fsync.datasync = 0;
+                                }
+
+                                list_add_tail (&request->other_requests,
+                                               &fsync->followers);
+                                request->wb_inode->fsyncs_merged++;
+                                continue;
+                        }
+
+                        fsync = request;
                 }
+
+                list_add_tail (&request->other_requests, other_requests);
+                count++;
         }
 
 out:
@@ -1818,7 +2340,7 @@ out:
 
 
 int32_t
-wb_resume_other_requests (call_frame_t *frame, wb_file_t *file,
+wb_resume_other_requests (call_frame_t *frame, wb_inode_t *wb_inode,
                           list_head_t *other_requests)
 {
         int32_t       ret          = -1;
@@ -1827,9 +2349,9 @@ wb_resume_other_requests (call_frame_t *frame, wb_file_t *file,
         char          wind         = 0;
         call_stub_t  *stub         = NULL;
 
-        GF_VALIDATE_OR_GOTO ((file ? file->this->name : "write-behind"), frame,
-                             out);
-        GF_VALIDATE_OR_GOTO (frame->this->name, file, out);
+        GF_VALIDATE_OR_GOTO ((wb_inode ? wb_inode->this->name
+                              : "write-behind"), frame, out);
+        GF_VALIDATE_OR_GOTO (frame->this->name, wb_inode, out);
         GF_VALIDATE_OR_GOTO (frame->this->name, other_requests, out);
 
         if (list_empty (other_requests)) {
@@ -1842,11 +2364,11 @@ wb_resume_other_requests (call_frame_t *frame, wb_file_t *file,
                 wind = request->stub->wind;
                 stub = request->stub;
 
-                LOCK (&file->lock);
+                LOCK (&wb_inode->lock);
                 {
                         request->stub = NULL;
                 }
-                UNLOCK (&file->lock);
+                UNLOCK (&wb_inode->lock);
 
                 if (!wind) {
                         wb_request_unref (request);
@@ -1859,7 +2381,7 @@ wb_resume_other_requests (call_frame_t *frame, wb_file_t *file,
         ret = 0;
 
         if (fops_removed > 0) {
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (frame->this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -1872,26 +2394,41 @@ out:
 
 
 int32_t
-wb_do_ops (call_frame_t *frame, wb_file_t *file, list_head_t *winds,
-           list_head_t *unwinds, list_head_t *other_requests)
+wb_do_ops (call_frame_t *frame, wb_inode_t *wb_inode, list_head_t *winds,
+           list_head_t *unwinds, list_head_t *other_requests,
+           wb_request_t *flush)
 {
         int32_t ret = -1, write_requests_removed = 0;
 
-        GF_VALIDATE_OR_GOTO ((file ? file->this->name : "write-behind"),
-                             frame, out);
-        GF_VALIDATE_OR_GOTO (frame->this->name, file, out);
+        GF_VALIDATE_OR_GOTO ((wb_inode ? wb_inode->this->name
+                              : "write-behind"), frame, out);
+        GF_VALIDATE_OR_GOTO (frame->this->name, wb_inode, out);
 
         ret = wb_stack_unwind (unwinds);
 
         write_requests_removed = ret;
 
-        ret = wb_sync (frame, file, winds);
+        if (flush != NULL) {
+                ret = wb_sync_compound (frame, wb_inode, winds, flush);
+                if (ret == -1) {
+                        /* let the flush wait for the writes as usual */
+                        LOCK (&wb_inode->lock);
+                        {
+                                flush->flags.other_requests.marked_for_resume
+                                        = 0;
+                        }
+                        UNLOCK (&wb_inode->lock);
+                }
+        }
+
+        if (flush == NULL || ret == -1)
+                ret = wb_sync (frame, wb_inode, winds);
         if (ret == -1) {
                 gf_log (frame->this->name, GF_LOG_WARNING,
                         "syncing of write requests failed");
         }
 
-        ret = wb_resume_other_requests (frame, file, other_requests);
+        ret = wb_resume_other_requests (frame, wb_inode, other_requests);
         if (ret == -1) {
                 gf_log (frame->this->name, GF_LOG_WARNING,
                         "cannot resume non-write requests in request queue");
@@ -1903,7 +2440,7 @@ wb_do_ops (call_frame_t *frame, wb_file_t *file, list_head_t *winds,
          * blocked on the writes just unwound.
          */
         if (write_requests_removed > 0) {
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (frame->this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -1915,17 +2452,38 @@ out:
 }
 
 
+/* Fold @request into @holder, an older write not yet wound which overlaps
+ * or adjoins it. The data of @request is newer, so it wins wherever the two
+ * overlap. The result has to fit in a single iobuf of @page_size.
+ */
 inline int
-__wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
+__wb_copy_into_holder (wb_request_t *holder, wb_request_t *request,
+                       size_t page_size)
 {
-        char          *ptr    = NULL;
-        struct iobuf  *iobuf  = NULL;
-        struct iobref *iobref = NULL;
-        int            ret    = -1;
+        char          *ptr      = NULL;
+        struct iobuf  *iobuf    = NULL;
+        struct iobref *iobref   = NULL;
+        wb_inode_t    *wb_inode = NULL;
+        off_t          h_start  = 0, r_start = 0, start = 0, end = 0;
+        size_t         size     = 0, overlap = 0;
+        int            ret      = -1;
+
+        wb_inode = holder->wb_inode;
+
+        h_start = holder->stub->args.writev.off;
+        r_start = request->stub->args.writev.off;
+
+        start = min (h_start, r_start);
+        end = max (h_start + holder->write_size,
+                   r_start + request->write_size);
+        size = end - start;
+
+        if (size > page_size) {
+                goto out;
+        }
 
         if (holder->flags.write_request.virgin) {
-                /* TODO: check the required size */
-                iobuf = iobuf_get (request->file->this->ctx->iobuf_pool);
+                iobuf = iobuf_get (wb_inode->this->ctx->iobuf_pool);
                 if (iobuf == NULL) {
                         goto out;
                 }
@@ -1940,15 +2498,17 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 if (ret != 0) {
                         iobuf_unref (iobuf);
                         iobref_unref (iobref);
-                        gf_log (request->file->this->name, GF_LOG_WARNING,
+                        gf_log (wb_inode->this->name, GF_LOG_WARNING,
                                 "cannot add iobuf (%p) into iobref (%p)",
                                 iobuf, iobref);
                         goto out;
                 }
 
-                iov_unload (iobuf->ptr, holder->stub->args.writev.vector,
+                iov_unload (iobuf->ptr + (h_start - start),
+                            holder->stub->args.writev.vector,
                             holder->stub->args.writev.count);
                 holder->stub->args.writev.vector[0].iov_base = iobuf->ptr;
+                holder->stub->args.writev.count = 1;
 
                 iobref_unref (holder->stub->args.writev.iobref);
                 holder->stub->args.writev.iobref = iobref;
@@ -1956,18 +2516,36 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 iobuf_unref (iobuf);
 
                 holder->flags.write_request.virgin = 0;
+        } else if (r_start < h_start) {
+                ptr = holder->stub->args.writev.vector[0].iov_base;
+                memmove (ptr + (h_start - start), ptr, holder->write_size);
         }
 
-        ptr = holder->stub->args.writev.vector[0].iov_base + holder->write_size;
+        ptr = holder->stub->args.writev.vector[0].iov_base;
 
-        iov_unload (ptr, request->stub->args.writev.vector,
+        iov_unload (ptr + (r_start - start), request->stub->args.writev.vector,
                     request->stub->args.writev.count);
 
-        holder->stub->args.writev.vector[0].iov_len += request->write_size;
-        holder->write_size += request->write_size;
+        overlap = holder->write_size + request->write_size - size;
+
+        /* the offset is the key of the dirty index */
+        __wb_dirty_del (holder);
+        holder->stub->args.writev.off = start;
+        holder->stub->args.writev.vector[0].iov_len = size;
+        holder->write_size = size;
+        __wb_dirty_add (holder);
+
+        __wb_dirty_del (request);
+
+        /* both were accounted in full in the window and the aggregate */
+        wb_inode->window_current -= overlap;
+        wb_inode->aggregate_current -= overlap;
+
+        wb_inode->bytes_coalesced += request->write_size;
+        wb_inode->writes_coalesced++;
 
         request->flags.write_request.stack_wound = 1;
-        list_move_tail (&request->list, &request->file->passive_requests);
+        list_move_tail (&request->list, &wb_inode->passive_requests);
 
         ret = 0;
 out:
@@ -1975,54 +2553,50 @@ out:
 }
 
 
-/* this procedure assumes that write requests have only one vector to write */
+/* Coalesce each write just acknowledged to the application into the latest
+ * older write it overlaps or adjoins, as long as that one has not been wound
+ * yet and no other request is queued between them which the write would
+ * have to be ordered against. Sequential writes append to their predecessor,
+ * and rewrites or small writes around the same region collapse into one.
+ */
 void
-__wb_collapse_write_bufs (list_head_t *requests, size_t page_size)
+__wb_collapse_write_bufs (list_head_t *unwinds, size_t page_size)
 {
-        off_t         offset_expected = 0;
-        size_t        space_left      = 0;
-        wb_request_t *request         = NULL, *tmp = NULL, *holder = NULL;
-        int           ret             = 0;
+        wb_request_t *request  = NULL, *holder = NULL;
+        wb_inode_t   *wb_inode = NULL;
+        off_t         low      = 0;
+        int           ret      = 0;
 
-        GF_VALIDATE_OR_GOTO ("write-behind", requests, out);
+        GF_VALIDATE_OR_GOTO ("write-behind", unwinds, out);
 
-        list_for_each_entry_safe (request, tmp, requests, list) {
-                if ((request->stub == NULL)
-                    || (request->stub->fop != GF_FOP_WRITE)
-                    || (request->flags.write_request.stack_wound)) {
-                        holder = NULL;
+        list_for_each_entry (request, unwinds, unwinds) {
+                if (!request->flags.write_request.dirty
+                    || request->flags.write_request.append
+                    || (request->write_size == 0)) {
                         continue;
                 }
 
-                if (request->flags.write_request.write_behind) {
-                        if (holder == NULL) {
-                                holder = request;
-                                continue;
-                        }
-
-                        offset_expected = holder->stub->args.writev.off
-                                + holder->write_size;
-
-                        if (request->stub->args.writev.off != offset_expected) {
-                                holder = request;
-                                continue;
-                        }
+                wb_inode = request->wb_inode;
 
-                        space_left = page_size - holder->write_size;
+                low = request->stub->args.writev.off - wb_inode->dirty_max;
 
-                        if (space_left >= request->write_size) {
-                                ret = __wb_copy_into_holder (holder, request);
-                                if (ret != 0) {
-                                        break;
-                                }
+                holder = __wb_dirty_latest (wb_inode->dirty->rb_root, request,
+                                            low, NULL);
+                if ((holder == NULL)
+                    || (holder->barrier != request->barrier)
+                    || !holder->flags.write_request.write_behind
+                    || holder->flags.write_request.append) {
+                        continue;
+                }
 
-                                __wb_request_unref (request);
-                        } else {
-                                holder = request;
-                        }
-                } else {
-                        break;
+                ret = __wb_copy_into_holder (holder, request, page_size);
+                if (ret != 0) {
+                        continue;
                 }
+
+                /* the reference for winding, it stays around till the
+                 * application gets its reply */
+                __wb_request_unref (request);
         }
 
 out:
@@ -2031,9 +2605,10 @@ out:
 
 
 int32_t
-wb_process_queue (call_frame_t *frame, wb_file_t *file)
+wb_process_queue (call_frame_t *frame, wb_inode_t *wb_inode)
 {
         list_head_t winds  = {0, }, unwinds = {0, }, other_requests = {0, };
+        wb_request_t *flush = NULL;
         size_t      size   = 0;
         wb_conf_t  *conf   = NULL;
         uint32_t    count  = 0;
@@ -2043,39 +2618,45 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
         INIT_LIST_HEAD (&unwinds);
         INIT_LIST_HEAD (&other_requests);
 
-        GF_VALIDATE_OR_GOTO ((file ? file->this->name : "write-behind"), frame,
-                             out);
-        GF_VALIDATE_OR_GOTO (file->this->name, frame, out);
+        GF_VALIDATE_OR_GOTO ((wb_inode ? wb_inode->this->name
+                              : "write-behind"), frame, out);
+        GF_VALIDATE_OR_GOTO (wb_inode->this->name, frame, out);
 
-        conf = file->this->private;
-        GF_VALIDATE_OR_GOTO (file->this->name, conf, out);
+        conf = wb_inode->this->private;
+        GF_VALIDATE_OR_GOTO (wb_inode->this->name, conf, out);
 
         size = conf->aggregate_size;
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
                 /*
-                 * make sure requests are marked for unwinding and adjacent
-                 * contiguous write buffers (each of size less than that of
-                 * an iobuf) are packed properly so that iobufs are filled to
-                 * their maximum capacity, before calling __wb_mark_winds.
+                 * make sure requests are marked for unwinding and the ones
+                 * just unwound are coalesced into the writes still waiting
+                 * to be wound, so that iobufs are filled to their maximum
+                 * capacity, before calling __wb_mark_winds.
                  */
-                __wb_mark_unwinds (&file->request, &unwinds);
+                __wb_mark_unwinds (&wb_inode->request, &unwinds);
 
-                __wb_collapse_write_bufs (&file->request,
-                                          file->this->ctx->page_size);
+                __wb_collapse_write_bufs (&unwinds,
+                                          wb_inode->this->ctx->page_size);
 
-                count = __wb_get_other_requests (&file->request,
+                count = __wb_get_other_requests (&wb_inode->request,
                                                  &other_requests);
 
                 if (count == 0) {
-                        __wb_mark_winds (&file->request, &winds, size,
+                        __wb_mark_winds (&wb_inode->request, &winds, size,
                                          conf->enable_trickling_writes);
+
+                        if (conf->compound_fops) {
+                                flush = __wb_mark_compound_flush
+                                        (&wb_inode->request, &winds);
+                        }
                 }
 
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
-        ret = wb_do_ops (frame, file, &winds, &unwinds, &other_requests);
+        ret = wb_do_ops (frame, wb_inode, &winds, &unwinds, &other_requests,
+                         flush);
 
 out:
         return ret;
@@ -2099,6 +2680,7 @@ wb_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
            int32_t count, off_t offset, uint32_t flags, struct iobref *iobref)
 {
         wb_file_t    *file          = NULL;
+        wb_inode_t   *wb_inode      = NULL;
         char          wb_disabled   = 0;
         call_frame_t *process_frame = NULL;
         size_t        size          = 0;
@@ -2133,13 +2715,19 @@ wb_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
         }
 
         if (file != NULL) {
-                LOCK (&file->lock);
+                wb_inode = file->wb_inode;
+
+                LOCK (&wb_inode->lock);
                 {
-                        op_ret = file->op_ret;
-                        op_errno = file->op_errno;
+                        op_ret = wb_inode->op_ret;
+                        op_errno = wb_inode->op_errno;
 
-                        file->op_ret = 0;
+                        wb_inode->op_ret = 0;
+                }
+                UNLOCK (&wb_inode->lock);
 
+                LOCK (&file->lock);
+                {
                         if ((op_ret == 0)
                             && (file->disabled || file->disable_till)) {
                                 if (size > file->disable_till) {
@@ -2181,7 +2769,7 @@ wb_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
         }
 
         frame->local = local;
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         stub = fop_writev_stub (frame, NULL, fd, vector, count, offset, flags,
                                 iobref);
@@ -2190,13 +2778,13 @@ wb_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
                 goto unwind;
         }
 
-        request = wb_enqueue (file, stub);
+        request = wb_enqueue (wb_inode, stub);
         if (request == NULL) {
                 op_errno = ENOMEM;
                 goto unwind;
         }
 
-        ret = wb_process_queue (process_frame, file);
+        ret = wb_process_queue (process_frame, wb_inode);
         if (ret == -1) {
                 gf_log (this->name, GF_LOG_WARNING,
                         "request queue processing failed");
@@ -2226,21 +2814,21 @@ wb_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
               int32_t op_errno, struct iovec *vector, int32_t count,
               struct iatt *stbuf, struct iobref *iobref)
 {
-        wb_local_t   *local   = NULL;
-        wb_file_t    *file    = NULL;
-        wb_request_t *request = NULL;
-        int32_t       ret     = 0;
+        wb_local_t   *local    = NULL;
+        wb_inode_t   *wb_inode = NULL;
+        wb_request_t *request  = NULL;
+        int32_t       ret      = 0;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
         request = local->request;
 
-        if ((request != NULL) && (file != NULL)) {
+        if ((request != NULL) && (wb_inode != NULL)) {
                 wb_request_unref (request);
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         if (errno == ENOMEM) {
                                 op_ret = -1;
@@ -2274,9 +2862,8 @@ int32_t
 wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
           off_t offset, uint32_t flags)
 {
-        wb_file_t    *file     = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         int32_t       ret      = -1, op_errno = 0;
         wb_request_t *request  = NULL;
@@ -2287,17 +2874,9 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, fd, unwind, op_errno,
                                         EINVAL);
 
-        if ((!IA_ISDIR (fd->inode->ia_type))
-            && fd_ctx_get (fd, this, &tmp_file)) {
-                file = wb_file_create (this, fd, 0);
-        } else {
-                file = (wb_file_t *)(long)tmp_file;
-                if ((!IA_ISDIR (fd->inode->ia_type)) && (file == NULL)) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "wb_file not found for fd %p", fd);
-                        op_errno = EBADFD;
-                        goto unwind;
-                }
+        if (wb_fd_inode_get (this, fd, &wb_inode) == -1) {
+                op_errno = EBADFD;
+                goto unwind;
         }
 
         local = mem_get0 (this->local_pool);
@@ -2306,10 +2885,10 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
-        if (file) {
+        if (wb_inode) {
                 stub = fop_readv_stub (frame, wb_readv_helper, fd, size,
                                        offset, flags);
                 if (stub == NULL) {
@@ -2317,14 +2896,14 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         call_stub_destroy (stub);
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -2356,25 +2935,25 @@ int32_t
 wb_ffr_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
             int32_t op_errno)
 {
-        wb_local_t *local = NULL;
-        wb_file_t  *file  = NULL;
+        wb_local_t *local    = NULL;
+        wb_inode_t *wb_inode = NULL;
 
         GF_ASSERT (frame);
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
 
-        if (file != NULL) {
-                LOCK (&file->lock);
+        if (wb_inode != NULL) {
+                LOCK (&wb_inode->lock);
                 {
-                        if (file->op_ret == -1) {
-                                op_ret = file->op_ret;
-                                op_errno = file->op_errno;
+                        if (wb_inode->op_ret == -1) {
+                                op_ret = wb_inode->op_ret;
+                                op_errno = wb_inode->op_errno;
 
-                                file->op_ret = 0;
+                                wb_inode->op_ret = 0;
                         }
                 }
-                UNLOCK (&file->lock);
+                UNLOCK (&wb_inode->lock);
         }
 
         STACK_UNWIND_STRICT (flush, frame, op_ret, op_errno);
@@ -2388,7 +2967,7 @@ wb_flush_helper (call_frame_t *frame, xlator_t *this, fd_t *fd)
 {
         wb_conf_t    *conf        = NULL;
         wb_local_t   *local       = NULL;
-        wb_file_t    *file        = NULL;
+        wb_inode_t   *wb_inode    = NULL;
         call_frame_t *flush_frame = NULL, *process_frame = NULL;
         int32_t       op_ret      = -1, op_errno = -1, ret = -1;
 
@@ -2399,14 +2978,14 @@ wb_flush_helper (call_frame_t *frame, xlator_t *this, fd_t *fd)
         conf = this->private;
 
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
 
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
-                op_ret = file->op_ret;
-                op_errno = file->op_errno;
+                op_ret = wb_inode->op_ret;
+                op_errno = wb_inode->op_errno;
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
         if (local && local->request) {
                 process_frame = copy_frame (frame);
@@ -2433,7 +3012,7 @@ wb_flush_helper (call_frame_t *frame, xlator_t *this, fd_t *fd)
         }
 
         if (process_frame != NULL) {
-                ret = wb_process_queue (process_frame, file);
+                ret = wb_process_queue (process_frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -2458,9 +3037,8 @@ int32_t
 wb_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
 {
         wb_conf_t    *conf        = NULL;
-        wb_file_t    *file        = NULL;
+        wb_inode_t   *wb_inode    = NULL;
         wb_local_t   *local       = NULL;
-        uint64_t      tmp_file    = 0;
         call_stub_t  *stub        = NULL;
         call_frame_t *flush_frame = NULL;
         wb_request_t *request     = NULL;
@@ -2475,27 +3053,19 @@ wb_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
         conf = this->private;
 
 
-        if ((!IA_ISDIR (fd->inode->ia_type))
-            && fd_ctx_get (fd, this, &tmp_file)) {
-                file = wb_file_create (this, fd, 0);
-        } else {
-                file = (wb_file_t *)(long)tmp_file;
-                if ((!IA_ISDIR (fd->inode->ia_type)) && (file == NULL)) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "wb_file not found for fd %p", fd);
-                        op_errno = EBADFD;
-                        goto unwind;
-                }
+        if (wb_fd_inode_get (this, fd, &wb_inode) == -1) {
+                op_errno = EBADFD;
+                goto unwind;
         }
 
-        if (file != NULL) {
+        if (wb_inode != NULL) {
                 local = mem_get0 (this->local_pool);
                 if (local == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                local->file = file;
+                local->wb_inode = wb_inode;
 
                 frame->local = local;
 
@@ -2505,14 +3075,14 @@ wb_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         call_stub_destroy (stub);
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -2548,32 +3118,55 @@ static int32_t
 wb_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
               int32_t op_errno, struct iatt *prebuf, struct iatt *postbuf)
 {
-        wb_local_t   *local   = NULL;
-        wb_file_t    *file    = NULL;
-        wb_request_t *request = NULL;
-        int32_t       ret     = -1;
+        wb_local_t   *local     = NULL;
+        wb_inode_t   *wb_inode  = NULL;
+        wb_request_t *request   = NULL, *follower = NULL, *tmp = NULL;
+        call_stub_t  *stub      = NULL;
+        list_head_t   followers = {0, };
+        int32_t       ret       = -1;
 
         GF_ASSERT (frame);
 
+        INIT_LIST_HEAD (&followers);
+
         local = frame->local;
-        file = local->file;
+        wb_inode = local->wb_inode;
         request = local->request;
 
-        if (file != NULL) {
-                LOCK (&file->lock);
+        if (wb_inode != NULL) {
+                LOCK (&wb_inode->lock);
                 {
-                        if (file->op_ret == -1) {
-                                op_ret = file->op_ret;
-                                op_errno = file->op_errno;
+                        if (wb_inode->op_ret == -1) {
+                                op_ret = wb_inode->op_ret;
+                                op_errno = wb_inode->op_errno;
+
+                                wb_inode->op_ret = 0;
+                        }
 
-                                file->op_ret = 0;
+                        if (request) {
+                                list_splice_init (&request->followers,
+                                                  &followers);
                         }
                 }
-                UNLOCK (&file->lock);
+                UNLOCK (&wb_inode->lock);
+
+                /* the fsyncs which were queued along with this one */
+                list_for_each_entry_safe (follower, tmp, &followers,
+                                          other_requests) {
+                        list_del_init (&follower->other_requests);
+
+                        stub = follower->stub;
+
+                        STACK_UNWIND_STRICT (fsync, stub->frame, op_ret,
+                                             op_errno, prebuf, postbuf);
+
+                        wb_request_unref (follower);
+                        call_stub_destroy (stub);
+                }
 
                 if (request) {
                         wb_request_unref (request);
-                        ret = wb_process_queue (frame, file);
+                        ret = wb_process_queue (frame, wb_inode);
                         if (ret == -1) {
                                 if (errno == ENOMEM) {
                                         op_ret = -1;
@@ -2606,9 +3199,8 @@ wb_fsync_helper (call_frame_t *frame, xlator_t *this, fd_t *fd,
 int32_t
 wb_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
 {
-        wb_file_t    *file     = NULL;
+        wb_inode_t   *wb_inode = NULL;
         wb_local_t   *local    = NULL;
-        uint64_t      tmp_file = 0;
         call_stub_t  *stub     = NULL;
         wb_request_t *request  = NULL;
         int32_t       ret      = -1, op_errno = 0;
@@ -2620,17 +3212,9 @@ wb_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
                                         op_errno, EINVAL);
 
 
-        if ((!IA_ISDIR (fd->inode->ia_type))
-            && fd_ctx_get (fd, this, &tmp_file)) {
-                file = wb_file_create (this, fd, 0);
-        } else {
-                file = (wb_file_t *)(long)tmp_file;
-                if ((!IA_ISDIR (fd->inode->ia_type)) && (file == NULL)) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "wb_file not found for fd %p", fd);
-                        op_errno = EBADFD;
-                        goto unwind;
-                }
+        if (wb_fd_inode_get (this, fd, &wb_inode) == -1) {
+                op_errno = EBADFD;
+                goto unwind;
         }
 
         local = mem_get0 (this->local_pool);
@@ -2639,25 +3223,25 @@ wb_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
                 goto unwind;
         }
 
-        local->file = file;
+        local->wb_inode = wb_inode;
 
         frame->local = local;
 
-        if (file) {
+        if (wb_inode) {
                 stub = fop_fsync_stub (frame, wb_fsync_helper, fd, datasync);
                 if (stub == NULL) {
                         op_errno = ENOMEM;
                         goto unwind;
                 }
 
-                request = wb_enqueue (file, stub);
+                request = wb_enqueue (wb_inode, stub);
                 if (request == NULL) {
                         op_errno = ENOMEM;
                         call_stub_destroy (stub);
                         goto unwind;
                 }
 
-                ret = wb_process_queue (frame, file);
+                ret = wb_process_queue (frame, wb_inode);
                 if (ret == -1) {
                         gf_log (this->name, GF_LOG_WARNING,
                                 "request queue processing failed");
@@ -2688,13 +3272,34 @@ wb_release (xlator_t *this, fd_t *fd)
         file = (wb_file_t *) (long) file_ptr;
 
         if (file != NULL) {
-                LOCK (&file->lock);
+                wb_file_destroy (file);
+        }
+
+out:
+        return 0;
+}
+
+
+int32_t
+wb_forget (xlator_t *this, inode_t *inode)
+{
+        uint64_t    tmp_inode = 0;
+        wb_inode_t *wb_inode  = NULL;
+
+        GF_VALIDATE_OR_GOTO ("write-behind", this, out);
+        GF_VALIDATE_OR_GOTO (this->name, inode, out);
+
+        inode_ctx_del (inode, this, &tmp_inode);
+        wb_inode = (wb_inode_t *)(long)tmp_inode;
+
+        if (wb_inode != NULL) {
+                LOCK (&wb_inode->lock);
                 {
-                        GF_ASSERT (list_empty (&file->request));
+                        GF_ASSERT (list_empty (&wb_inode->request));
                 }
-                UNLOCK (&file->lock);
+                UNLOCK (&wb_inode->lock);
 
-                wb_file_destroy (file);
+                wb_inode_destroy (wb_inode);
         }
 
 out:
@@ -2726,6 +3331,19 @@ wb_priv_dump (xlator_t *this)
         gf_proc_dump_write ("flush_behind", "%d", conf->flush_behind);
         gf_proc_dump_write ("enable_trickling_writes", "%d",
                             conf->enable_trickling_writes);
+        gf_proc_dump_write ("compound_fops", "%d", conf->compound_fops);
+
+        /* of the inodes forgotten so far, the live ones dump their own */
+        LOCK (&conf->lock);
+        {
+                gf_proc_dump_write ("bytes_coalesced", "%"PRIu64,
+                                    conf->bytes_coalesced);
+                gf_proc_dump_write ("writes_coalesced", "%"PRIu64,
+                                    conf->writes_coalesced);
+                gf_proc_dump_write ("fsyncs_merged", "%"PRIu64,
+                                    conf->fsyncs_merged);
+        }
+        UNLOCK (&conf->lock);
 
         ret = 0;
 out:
@@ -2773,6 +3391,9 @@ __wb_dump_requests (struct list_head *head, char *prefix, char passive)
 
                         flag = request->flags.write_request.flush_all;
                         gf_proc_dump_write ("flush_all", "%d", flag);
+
+                        flag = request->flags.write_request.dirty;
+                        gf_proc_dump_write ("dirty", "%d", flag);
                 } else {
                         flag = request->flags.other_requests.marked_for_resume;
                         gf_proc_dump_write ("marked_for_resume", "%d", flag);
@@ -2824,33 +3445,86 @@ wb_file_dump (xlator_t *this, fd_t *fd)
 
         gf_proc_dump_write ("disable_till", "%lu", file->disable_till);
 
-        gf_proc_dump_write ("window_conf", "%"GF_PRI_SIZET, file->window_conf);
-
-        gf_proc_dump_write ("window_current", "%"GF_PRI_SIZET, file->window_current);
-
         gf_proc_dump_write ("flags", "%s", (file->flags & O_APPEND) ? "O_APPEND"
                             : "!O_APPEND");
 
-        gf_proc_dump_write ("aggregate_current", "%"GF_PRI_SIZET, file->aggregate_current);
+        gf_proc_dump_write ("wb_inode", "%p", file->wb_inode);
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int
+wb_inode_dump (xlator_t *this, inode_t *inode)
+{
+        wb_inode_t *wb_inode                        = NULL;
+        int32_t     ret                             = -1;
+        char       *path                            = NULL;
+        char        key_prefix[GF_DUMP_MAX_BUF_LEN] = {0, };
+
+        if ((inode == NULL) || (this == NULL)) {
+                ret = 0;
+                goto out;
+        }
+
+        wb_inode = wb_inode_ctx_get (this, inode);
+        if (wb_inode == NULL) {
+                ret = 0;
+                goto out;
+        }
+
+        gf_proc_dump_build_key (key_prefix, "xlator.performance.write-behind",
+                                "wb_inode");
 
-        gf_proc_dump_write ("refcount", "%d", file->refcount);
+        gf_proc_dump_add_section (key_prefix);
 
-        gf_proc_dump_write ("op_ret", "%d", file->op_ret);
+        __inode_path (inode, NULL, &path);
+        if (path != NULL) {
+                gf_proc_dump_write ("path", "%s", path);
+                GF_FREE (path);
+        }
 
-        gf_proc_dump_write ("op_errno", "%d", file->op_errno);
+        gf_proc_dump_write ("inode", "%p", inode);
 
-        LOCK (&file->lock);
+        LOCK (&wb_inode->lock);
         {
-                if (!list_empty (&file->request)) {
-                        __wb_dump_requests (&file->request, key_prefix, 0);
+                gf_proc_dump_write ("window_conf", "%"GF_PRI_SIZET,
+                                    wb_inode->window_conf);
+
+                gf_proc_dump_write ("window_current", "%"GF_PRI_SIZET,
+                                    wb_inode->window_current);
+
+                gf_proc_dump_write ("aggregate_current", "%"GF_PRI_SIZET,
+                                    wb_inode->aggregate_current);
+
+                gf_proc_dump_write ("dirty_count", "%"GF_PRI_SIZET,
+                                    rb_count (wb_inode->dirty));
+
+                gf_proc_dump_write ("bytes_coalesced", "%"PRIu64,
+                                    wb_inode->bytes_coalesced);
+
+                gf_proc_dump_write ("writes_coalesced", "%"PRIu64,
+                                    wb_inode->writes_coalesced);
+
+                gf_proc_dump_write ("fsyncs_merged", "%"PRIu64,
+                                    wb_inode->fsyncs_merged);
+
+                gf_proc_dump_write ("op_ret", "%d", wb_inode->op_ret);
+
+                gf_proc_dump_write ("op_errno", "%d", wb_inode->op_errno);
+
+                if (!list_empty (&wb_inode->request)) {
+                        __wb_dump_requests (&wb_inode->request, key_prefix, 0);
                 }
 
-                if (!list_empty (&file->passive_requests)) {
-                        __wb_dump_requests (&file->passive_requests, key_prefix,
-                                            1);
+                if (!list_empty (&wb_inode->passive_requests)) {
+                        __wb_dump_requests (&wb_inode->passive_requests,
+                                            key_prefix, 1);
                 }
         }
-        UNLOCK (&file->lock);
+        UNLOCK (&wb_inode->lock);
 
         ret = 0;
 out:
@@ -2892,6 +3566,9 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("flush-behind", conf->flush_behind, options, bool,
                           out);
 
+        GF_OPTION_RECONF ("compound-fops", conf->compound_fops, options, bool,
+                          out);
+
         ret = 0;
 out:
         return ret;
@@ -2922,6 +3599,8 @@ init (xlator_t *this)
                 goto out;
         }
 
+        LOCK_INIT (&conf->lock);
+
         GF_OPTION_INIT("enable-O_SYNC", conf->enable_O_SYNC, bool, out);
 
         /* configure 'options aggregate-size <size>' */
@@ -2955,6 +3634,8 @@ init (xlator_t *this)
         GF_OPTION_INIT ("enable-trickling-writes", conf->enable_trickling_writes,
                         bool, out);
 
+        GF_OPTION_INIT ("compound-fops", conf->compound_fops, bool, out);
+
         this->local_pool = mem_pool_new (wb_local_t, 64);
         if (!this->local_pool) {
                 ret = -1;
@@ -2988,6 +3669,7 @@ fini (xlator_t *this)
         }
 
         this->private = NULL;
+        LOCK_DESTROY (&conf->lock);
         GF_FREE (conf);
 
 out:
@@ -3010,12 +3692,14 @@ struct xlator_fops fops = {
 };
 
 struct xlator_cbks cbks = {
-        .release  = wb_release
+        .release  = wb_release,
+        .forget   = wb_forget,
 };
 
 struct xlator_dumpops dumpops = {
         .priv      =  wb_priv_dump,
         .fdctx     =  wb_file_dump,
+        .inodectx  =  wb_inode_dump,
 };
 
 struct volume_options options[] = {
@@ -3033,7 +3717,8 @@ struct volume_options options[] = {
           .min  = 512 * GF_UNIT_KB,
           .max  = 1 * GF_UNIT_GB,
           .default_value = "1MB",
-          .description = "Size of the per-file write-behind buffer. "
+          .description = "Size of the write-behind buffer of a file, "
+                         "shared by all the fds open on it. "
 
         },
         { .key = {"disable-for-first-nbytes"},
@@ -3050,5 +3735,16 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "on",
         },
+        { .key = {"compound-fops"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Send the writes still pending at flush time "
+                         "together with the flush as one compound fop, "
+                         "saving a round trip on close. The chain reaches "
+                         "the brick as one when only distribute is between "
+                         "write-behind and the client; replicate sends its "
+                         "fops one by one, so the option gains nothing on "
+                         "replicated volumes."
+        },
         { .key = {NULL} },
 };
@@ -24,9 +24,11 @@
 
 #include "client.h"
 #include "rpc-clnt.h"
+#include "defaults.h"
+#include "upcall-utils.h"
 
 int
-client_cbk_null (void *data)
+client_cbk_null (struct rpc_clnt *rpc, void *mydata, void *data)
 {
         gf_log (THIS->name, GF_LOG_WARNING,
                 "this function should not be called");
@@ -34,7 +36,7 @@ client_cbk_null (void *data)
 }
 
 int
-client_cbk_fetchspec (void *data)
+client_cbk_fetchspec (struct rpc_clnt *rpc, void *mydata, void *data)
 {
         gf_log (THIS->name, GF_LOG_WARNING,
                 "this function should not be called");
@@ -42,17 +44,55 @@ client_cbk_fetchspec (void *data)
 }
 
 int
-client_cbk_ino_flush (void *data)
+client_cbk_ino_flush (struct rpc_clnt *rpc, void *mydata, void *data)
 {
         gf_log (THIS->name, GF_LOG_WARNING,
                 "this function should not be called");
         return 0;
 }
 
+/* The brick saw another client modify an inode we may have cached: pass it
+ * up the graph so that the caching translators and the fuse bridge can drop
+ * what they hold for it.
+ */
+int
+client_cbk_cache_invalidation (struct rpc_clnt *rpc, void *mydata, void *data)
+{
+        xlator_t                        *this   = NULL;
+        struct iovec                    *iov    = NULL;
+        gfs3_cbk_cache_invalidation_req  req    = {{0,},};
+        struct gf_upcall                 upcall = {0,};
+        int                              ret    = -1;
+
+        this = mydata;
+        iov  = data;
+
+        ret = xdr_to_generic (*iov, &req,
+                              (xdrproc_t)xdr_gfs3_cbk_cache_invalidation_req);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "failed to decode the cache invalidation request");
+                goto out;
+        }
+
+        memcpy (upcall.gfid, req.gfid, 16);
+        upcall.flags = req.flags;
+
+        gf_log (this->name, GF_LOG_TRACE, "cache invalidation of %s "
+                "(flags 0x%x)", uuid_utoa (upcall.gfid), upcall.flags);
+
+        ret = default_notify (this, GF_EVENT_UPCALL, &upcall);
+out:
+        return ret;
+}
+
 rpcclnt_cb_actor_t gluster_cbk_actors[] = {
         [GF_CBK_NULL]      = {"NULL",      GF_CBK_NULL,      client_cbk_null },
         [GF_CBK_FETCHSPEC] = {"FETCHSPEC", GF_CBK_FETCHSPEC, client_cbk_fetchspec },
         [GF_CBK_INO_FLUSH] = {"INO_FLUSH", GF_CBK_INO_FLUSH, client_cbk_ino_flush },
+        [GF_CBK_CACHE_INVALIDATION] = {"CACHE_INVALIDATION",
+                                       GF_CBK_CACHE_INVALIDATION,
+                                       client_cbk_cache_invalidation },
 };
 
 
@@ -1312,6 +1312,7 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         int32_t               op_errno      = 0;
         gf_boolean_t          auth_fail     = _gf_false;
         uint32_t              lk_ver        = 0;
+        uint32_t              compound_fops = 0;
 
         frame = myframe;
         this  = frame->this;
@@ -1402,6 +1403,11 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
 
         gf_log (this->name, GF_LOG_DEBUG, "clnt-lk-version = %d, "
                 "server-lk-version = %d", client_get_lk_ver (conf), lk_ver);
+
+        conf->compound_fops = _gf_false;
+        ret = dict_get_uint32 (reply, "compound-fops", &compound_fops);
+        if (!ret && compound_fops)
+                conf->compound_fops = _gf_true;
         /* TODO: currently setpeer path is broken */
         /*
         if (process_uuid && req->conn &&
@@ -1435,6 +1441,11 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         conf->connecting = 0;
         conf->connected = 1;
 
+        if (conf->channels) {
+                conf->channels[0].ready = 1;
+                client_channels_connect (this);
+        }
+
         conf->need_different_port = 0;
 
         if (lk_ver != client_get_lk_ver (conf)) {
@@ -1606,6 +1617,158 @@ fail:
         return ret;
 }
 
+int
+client_channel_setvolume_cbk (struct rpc_req *req, struct iovec *iov,
+                              int count, void *myframe)
+{
+        call_frame_t     *frame = NULL;
+        xlator_t         *this  = NULL;
+        clnt_conf_t      *conf  = NULL;
+        clnt_channel_t   *ch    = NULL;
+        gf_setvolume_rsp  rsp   = {0,};
+        int               ret   = 0;
+
+        frame = myframe;
+        this  = frame->this;
+        conf  = this->private;
+        ch    = frame->local;
+        frame->local = NULL;
+
+        if (-1 == req->rpc_status) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "received RPC status error on channel %d", ch->index);
+                goto out;
+        }
+
+        ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gf_setvolume_rsp);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
+                goto out;
+        }
+
+        if (-1 == rsp.op_ret) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "SETVOLUME on channel %d failed: %s, reconnecting it",
+                        ch->index, strerror (gf_error_to_errno (rsp.op_errno)));
+                rpc_transport_disconnect (ch->rpc->conn.trans);
+                goto out;
+        }
+
+        if (!conf->channels[0].ready) {
+                /* the first channel went down meanwhile, attach again
+                   along with it */
+                rpc_transport_disconnect (ch->rpc->conn.trans);
+                goto out;
+        }
+
+        rpc_clnt_set_connected (&ch->rpc->conn);
+        ch->ready = 1;
+
+        gf_log (this->name, GF_LOG_INFO, "channel %d connected to %s",
+                ch->index, ch->rpc->conn.trans->peerinfo.identifier);
+out:
+        if (rsp.dict.dict_val)
+                free (rsp.dict.dict_val);
+
+        STACK_DESTROY (frame->root);
+
+        return 0;
+}
+
+/* Attaches a further channel to the connection of the first one: the
+   options of the first channel's SETVOLUME are still in this->options,
+   with the same process-uuid the server binds the transport to the same
+   client. No version dump or portmap, the first channel did those. */
+int
+client_channel_setvolume (xlator_t *this, clnt_channel_t *ch)
+{
+        int               ret     = -1;
+        gf_setvolume_req  req     = {{0,},};
+        call_frame_t     *fr      = NULL;
+        clnt_conf_t      *conf    = NULL;
+        dict_t           *options = NULL;
+        struct iobuf     *iobuf   = NULL;
+        struct iobref    *iobref  = NULL;
+        struct iovec      iov     = {0, };
+
+        options = this->options;
+        conf    = this->private;
+
+        ret = dict_set_int16 (options, "clnt-lk-version",
+                              client_get_lk_ver (conf));
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "failed to set clnt-lk-version(%"PRIu32") in handshake msg",
+                        client_get_lk_ver (conf));
+        }
+
+        ret = -1;
+        req.dict.dict_len = dict_serialized_length (options);
+        if (req.dict.dict_len < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to get serialized length of dict");
+                goto out;
+        }
+        req.dict.dict_val = GF_CALLOC (1, req.dict.dict_len,
+                                       gf_client_mt_clnt_req_buf_t);
+        if (!req.dict.dict_val)
+                goto out;
+
+        ret = dict_serialize (options, req.dict.dict_val);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to serialize dictionary");
+                goto out;
+        }
+
+        ret = -1;
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool,
+                            xdr_sizeof ((xdrproc_t)xdr_gf_setvolume_req,
+                                        &req));
+        if (!iobuf)
+                goto out;
+
+        iobref = iobref_new ();
+        if (!iobref)
+                goto out;
+        iobref_add (iobref, iobuf);
+
+        iov.iov_base = iobuf->ptr;
+        iov.iov_len  = iobuf_size (iobuf);
+
+        ret = xdr_serialize_generic (iov, &req,
+                                     (xdrproc_t)xdr_gf_setvolume_req);
+        if (ret == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "XDR payload creation failed");
+                goto out;
+        }
+        iov.iov_len = ret;
+
+        fr = create_frame (this, this->ctx->pool);
+        if (!fr) {
+                ret = -1;
+                goto out;
+        }
+        fr->local = ch;
+
+        /* on failure this unwinds through the cbk, which destroys fr */
+        ret = rpc_clnt_submit (ch->rpc, conf->handshake, GF_HNDSK_SETVOLUME,
+                               client_channel_setvolume_cbk, &iov, 1, NULL, 0,
+                               iobref, fr, NULL, 0, NULL, 0, NULL);
+out:
+        if (iobref)
+                iobref_unref (iobref);
+
+        if (iobuf)
+                iobuf_unref (iobuf);
+
+        if (req.dict.dict_val)
+                GF_FREE (req.dict.dict_val);
+
+        return ret;
+}
+
 int
 select_server_supported_programs (xlator_t *this, gf_prog_detail *prog)
 {
@@ -1720,6 +1883,7 @@ client_query_portmap_cbk (struct rpc_req *req, struct iovec *iov, int count, voi
 
         config.remote_port = rsp.port;
         rpc_clnt_reconfig (conf->rpc, &config);
+        conf->brick_port = rsp.port;
         conf->skip_notify = 1;
 
 out:
@@ -264,6 +264,42 @@ clnt_readdirp_rsp_cleanup (gfs3_readdirp_rsp *rsp)
         return 0;
 }
 
+int
+clnt_compound_req_cleanup (gfs3_compound_req_entry *entries, int count)
+{
+        int i = 0;
+
+        for (i = 0; i < count; i++) {
+                if (entries[i].dict.dict_val)
+                        GF_FREE (entries[i].dict.dict_val);
+        }
+
+        GF_FREE (entries);
+
+        return 0;
+}
+
+int
+clnt_compound_rsp_cleanup (gfs3_compound_rsp *rsp)
+{
+        gfs3_compound_rsp_entry *prev = NULL;
+        gfs3_compound_rsp_entry *trav = NULL;
+
+        trav = rsp->reply;
+        prev = trav;
+        while (trav) {
+                trav = trav->nextentry;
+                /* on client, the rpc lib allocates this */
+                free (prev->dict.dict_val);
+                free (prev);
+                prev = trav;
+        }
+
+        free (rsp->xdata.xdata_val);
+
+        return 0;
+}
+
 int
 clnt_readdir_rsp_cleanup (gfs3_readdir_rsp *rsp)
 {
@@ -282,3 +318,113 @@ clnt_readdir_rsp_cleanup (gfs3_readdir_rsp *rsp)
 
         return 0;
 }
+
+#define CLIENT_REQ_GFID(op, type, field)                                \
+        case op:                                                        \
+                found = ((type *)req)->field;                           \
+                break
+
+/* Copies into @gfid the gfid of the inode a fop request is about: the inode
+   itself, or the parent for the fops which create or remove a name. -1 if
+   there is none (fd not known any more, unknown procedure). */
+int
+client_req_gfid (clnt_conf_t *conf, int procnum, void *req, uuid_t gfid)
+{
+        clnt_fd_ctx_t           *fdctx  = NULL;
+        gfs3_compound_req_entry *entry  = NULL;
+        char                    *found  = NULL;
+        int64_t                  fd     = -1;
+        int                      ret    = -1;
+
+        switch (procnum) {
+        CLIENT_REQ_GFID (GFS3_OP_STAT, gfs3_stat_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_READLINK, gfs3_readlink_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_MKNOD, gfs3_mknod_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_MKDIR, gfs3_mkdir_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_UNLINK, gfs3_unlink_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_RMDIR, gfs3_rmdir_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_SYMLINK, gfs3_symlink_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_RENAME, gfs3_rename_req, oldgfid);
+        CLIENT_REQ_GFID (GFS3_OP_LINK, gfs3_link_req, oldgfid);
+        CLIENT_REQ_GFID (GFS3_OP_TRUNCATE, gfs3_truncate_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_OPEN, gfs3_open_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_READ, gfs3_read_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_WRITE, gfs3_write_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_STATFS, gfs3_statfs_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FLUSH, gfs3_flush_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FSYNC, gfs3_fsync_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_SETXATTR, gfs3_setxattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_GETXATTR, gfs3_getxattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_REMOVEXATTR, gfs3_removexattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_OPENDIR, gfs3_opendir_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FSYNCDIR, gfs3_fsyncdir_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_ACCESS, gfs3_access_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_CREATE, gfs3_create_req, pargfid);
+        CLIENT_REQ_GFID (GFS3_OP_FTRUNCATE, gfs3_ftruncate_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FSTAT, gfs3_fstat_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_LK, gfs3_lk_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_READDIR, gfs3_readdir_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_INODELK, gfs3_inodelk_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FINODELK, gfs3_finodelk_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_ENTRYLK, gfs3_entrylk_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FENTRYLK, gfs3_fentrylk_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_XATTROP, gfs3_xattrop_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FXATTROP, gfs3_fxattrop_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FGETXATTR, gfs3_fgetxattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FSETXATTR, gfs3_fsetxattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_SETATTR, gfs3_setattr_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_READDIRP, gfs3_readdirp_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_RELEASE, gfs3_release_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_RELEASEDIR, gfs3_releasedir_req, gfid);
+        CLIENT_REQ_GFID (GFS3_OP_FREMOVEXATTR, gfs3_fremovexattr_req, gfid);
+
+        case GFS3_OP_LOOKUP:
+                /* a named lookup does not know the gfid yet */
+                found = ((gfs3_lookup_req *)req)->gfid;
+                if (uuid_is_null ((unsigned char *)found))
+                        found = ((gfs3_lookup_req *)req)->pargfid;
+                break;
+
+        case GFS3_OP_COMPOUND:
+                entry = ((gfs3_compound_req *)req)->request;
+                if (!entry)
+                        break;
+                found = entry->gfid;
+                if (uuid_is_null ((unsigned char *)found))
+                        found = entry->pargfid;
+                break;
+
+        case GFS3_OP_FSETATTR:
+        case GFS3_OP_RCHECKSUM:
+                /* only the remote fd goes on the wire */
+                if (procnum == GFS3_OP_FSETATTR)
+                        fd = ((gfs3_fsetattr_req *)req)->fd;
+                else
+                        fd = ((gfs3_rchecksum_req *)req)->fd;
+
+                pthread_mutex_lock (&conf->lock);
+                {
+                        list_for_each_entry (fdctx, &conf->saved_fds,
+                                             sfd_pos) {
+                                if ((fdctx->remote_fd == fd) &&
+                                    fdctx->inode) {
+                                        uuid_copy (gfid, fdctx->inode->gfid);
+                                        ret = 0;
+                                        break;
+                                }
+                        }
+                }
+                pthread_mutex_unlock (&conf->lock);
+                goto out;
+
+        default:
+                break;
+        }
+
+        if (found) {
+                memcpy (gfid, found, sizeof (uuid_t));
+                ret = 0;
+        }
+out:
+        return ret;
+}
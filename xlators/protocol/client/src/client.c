@@ -29,6 +29,7 @@
 #include "glusterfs.h"
 #include "statedump.h"
 #include "compat-errno.h"
+#include "compound-fop-utils.h"
 
 #include "glusterfs3.h"
 
@@ -148,6 +149,104 @@ out:
         return ret;
 }
 
+/* A fop goes out on the channel of the inode it is about, so that all the
+   requests on an inode, its fds and its locks reach the server over one
+   connection, in the order they were sent. Everything else (handshake,
+   portmap, dump, mgmt) takes the first channel, and so do fops whose channel
+   is not attached, which are returned in @fallback. A channel is used again
+   only once the fops which went on the first channel in its place have been
+   answered (see client_channel_fence ()). */
+struct rpc_clnt *
+client_channel_select (xlator_t *this, rpc_clnt_prog_t *prog, int procnum,
+                       void *req, clnt_channel_t **fallback)
+{
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *ch      = NULL;
+        uuid_t          gfid    = {0, };
+        uint32_t        hash    = 0;
+        uint32_t        fence   = 0;
+        int             drained = 0;
+
+        conf = this->private;
+        *fallback = NULL;
+
+        if ((conf->channel_count < 2) || !conf->channels ||
+            !req || (prog != conf->fops))
+                goto primary;
+
+        if (client_req_gfid (conf, procnum, req, gfid))
+                goto primary;
+
+        /* the tail of a (random) uuid */
+        memcpy (&hash, &gfid[12], sizeof (hash));
+        ch = &conf->channels[hash % conf->channel_count];
+
+        if (ch->index == 0)
+                goto primary;
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                if (ch->ready && !ch->draining) {
+                        drained = 1;
+                } else if (ch->ready && !ch->unfenced) {
+                        fence = ch->fence;
+                        drained = -1;
+                }
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        if (drained == 1)
+                return ch->rpc;
+
+        if (drained == -1 && !rpc_clnt_xid_outstanding (conf->rpc, fence)) {
+                drained = 0;
+                pthread_mutex_lock (&conf->lock);
+                {
+                        /* unless another fop went on the first channel
+                           meanwhile */
+                        if (!ch->unfenced && (ch->fence == fence)) {
+                                ch->draining = 0;
+                                drained = 1;
+                        }
+                }
+                pthread_mutex_unlock (&conf->lock);
+
+                if (drained)
+                        return ch->rpc;
+        }
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                ch->draining = 1;
+                ch->unfenced++;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        *fallback = ch;
+primary:
+        return conf->rpc;
+}
+
+
+/* A fop of @ch was submitted on the first channel: @ch is not used again
+   before the first channel has answered every call up to this one. */
+void
+client_channel_fence (clnt_conf_t *conf, clnt_channel_t *ch)
+{
+        uint32_t xid = 0;
+
+        xid = rpc_clnt_last_xid (conf->rpc);
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                /* other fops of @ch may have got theirs meanwhile */
+                if ((int32_t)(xid - ch->fence) > 0)
+                        ch->fence = xid;
+                ch->unfenced--;
+        }
+        pthread_mutex_unlock (&conf->lock);
+}
+
 int
 client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                        rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbkfn,
@@ -165,6 +264,8 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         struct iobref  *new_iobref = NULL;
         ssize_t         xdr_size   = 0;
         struct rpc_req  rpcreq     = {0, };
+        struct rpc_clnt *rpc       = NULL;
+        clnt_channel_t  *fallback  = NULL;
 
         GF_VALIDATE_OR_GOTO ("client", this, out);
         GF_VALIDATE_OR_GOTO (this->name, prog, out);
@@ -232,9 +333,12 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         }
 
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbkfn, &iov, count,
+        rpc = client_channel_select (this, prog, procnum, req, &fallback);
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbkfn, &iov, count,
                                NULL, 0, new_iobref, frame, rsphdr, rsphdr_count,
                                rsp_payload, rsp_payload_count, rsp_iobref);
+        if (fallback)
+                client_channel_fence (conf, fallback);
 
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_DEBUG, "rpc_clnt_submit failed");
@@ -1914,6 +2018,41 @@ out:
 }
 
 
+int32_t
+client_compound (call_frame_t *frame, xlator_t *this, compound_args_t *args)
+{
+        int          ret  = -1;
+        clnt_conf_t *conf = NULL;
+        rpc_clnt_procedure_t *proc = NULL;
+        clnt_args_t  cargs = {0,};
+
+        conf = this->private;
+        if (!conf || !conf->fops)
+                goto out;
+
+        /* older servers get the steps one at a time */
+        if (!conf->compound_fops)
+                return compound_fop_split (frame, this, args);
+
+        cargs.compound_args = args;
+
+        proc = &conf->fops->proctable[GF_FOP_COMPOUND];
+        if (!proc) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "rpc procedure not found for %s",
+                        gf_fop_list[GF_FOP_COMPOUND]);
+                goto out;
+        }
+        if (proc->fn)
+                ret = proc->fn (frame, this, &cargs);
+out:
+        if (ret)
+                STACK_UNWIND_STRICT (compound, frame, -1, ENOTCONN, NULL);
+
+	return 0;
+}
+
+
 int32_t
 client_getspec (call_frame_t *frame, xlator_t *this, const char *key,
                 int32_t flags)
@@ -2038,6 +2177,11 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
                 break;
         }
         case RPC_CLNT_DISCONNECT:
+                /* the other channels belong to this connection, the
+                   server must see all of them go to release its fds and
+                   locks */
+                client_channels_disconnect (this);
+
                 if (!conf->lk_heal)
                         client_mark_fd_bad (this);
                 else
@@ -2084,6 +2228,172 @@ out:
 }
 
 
+static int
+client_channel_same_peer (clnt_conf_t *conf, clnt_channel_t *ch)
+{
+        peer_info_t *first = NULL;
+        peer_info_t *peer  = NULL;
+
+        first = &conf->rpc->conn.trans->peerinfo;
+        peer  = &ch->rpc->conn.trans->peerinfo;
+
+        return ((first->sockaddr_len == peer->sockaddr_len) &&
+                !memcmp (&first->sockaddr, &peer->sockaddr,
+                         first->sockaddr_len));
+}
+
+
+/* Until the first channel is attached the others may have connected to
+   glusterd instead of the brick; point them at the port the portmapper
+   gave. The port lasts for one connect, like for the first channel. */
+static void
+client_channel_set_port (clnt_conf_t *conf, clnt_channel_t *ch)
+{
+        struct rpc_clnt_config config = {0, };
+
+        if (!conf->brick_port)
+                return;
+
+        config.remote_port = conf->brick_port;
+        rpc_clnt_reconfig (ch->rpc, &config);
+}
+
+
+void
+client_channels_connect (xlator_t *this)
+{
+        clnt_conf_t    *conf = NULL;
+        clnt_channel_t *ch   = NULL;
+        int             i    = 0;
+
+        conf = this->private;
+
+        for (i = 1; i < conf->channel_count; i++) {
+                ch = &conf->channels[i];
+                if (ch->ready)
+                        continue;
+
+                if (!ch->started) {
+                        client_channel_set_port (conf, ch);
+                        ch->started = 1;
+                        rpc_clnt_start (ch->rpc);
+                        continue;
+                }
+
+                if (!ch->connected) {
+                        /* picked up by its reconnect timer */
+                        client_channel_set_port (conf, ch);
+                        continue;
+                }
+
+                if (client_channel_same_peer (conf, ch)) {
+                        client_channel_setvolume (this, ch);
+                } else {
+                        client_channel_set_port (conf, ch);
+                        rpc_transport_disconnect (ch->rpc->conn.trans);
+                }
+        }
+}
+
+
+void
+client_channels_disconnect (xlator_t *this)
+{
+        clnt_conf_t    *conf = NULL;
+        clnt_channel_t *ch   = NULL;
+        int             i    = 0;
+
+        conf = this->private;
+        if (!conf->channels)
+                return;
+
+        conf->channels[0].ready = 0;
+
+        for (i = 1; i < conf->channel_count; i++) {
+                ch = &conf->channels[i];
+                ch->ready = 0;
+
+                if (ch->connected)
+                        rpc_transport_disconnect (ch->rpc->conn.trans);
+        }
+}
+
+
+int
+client_channel_notify (struct rpc_clnt *rpc, void *mydata,
+                       rpc_clnt_event_t event, void *data)
+{
+        clnt_channel_t *ch   = NULL;
+        xlator_t       *this = NULL;
+        clnt_conf_t    *conf = NULL;
+
+        ch   = mydata;
+        this = ch->this;
+        conf = this->private;
+        if (!conf || !conf->channels)
+                goto out;
+
+        switch (event) {
+        case RPC_CLNT_CONNECT:
+                gf_log (this->name, GF_LOG_DEBUG, "channel %d connected",
+                        ch->index);
+                ch->connected = 1;
+
+                /* else attached once the first channel is */
+                if (!conf->channels[0].ready)
+                        break;
+
+                if (client_channel_same_peer (conf, ch)) {
+                        client_channel_setvolume (this, ch);
+                } else {
+                        client_channel_set_port (conf, ch);
+                        rpc_transport_disconnect (ch->rpc->conn.trans);
+                }
+                break;
+
+        case RPC_CLNT_DISCONNECT:
+                if (ch->ready)
+                        gf_log (this->name, GF_LOG_INFO,
+                                "channel %d disconnected, its fops go on "
+                                "channel 0 until it is back and they are "
+                                "answered", ch->index);
+                ch->connected = 0;
+                ch->ready = 0;
+
+                if (conf->channels[0].ready)
+                        client_channel_set_port (conf, ch);
+                break;
+
+        default:
+                gf_log (this->name, GF_LOG_TRACE,
+                        "got some other RPC event %d on channel %d", event,
+                        ch->index);
+                break;
+        }
+
+out:
+        return 0;
+}
+
+
+static void
+client_channels_disable (clnt_conf_t *conf)
+{
+        int             i    = 0;
+
+        if (!conf->channels)
+                return;
+
+        conf->channels[0].ready = 0;
+
+        for (i = 1; i < conf->channel_count; i++) {
+                conf->channels[i].ready = 0;
+                if (conf->channels[i].rpc)
+                        rpc_clnt_disable (conf->channels[i].rpc);
+        }
+}
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
@@ -2115,6 +2425,7 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                 }
                 pthread_mutex_unlock (&conf->lock);
 
+                client_channels_disable (conf);
                 rpc_clnt_disable (conf->rpc);
                 break;
 
@@ -2147,6 +2458,8 @@ build_client_config (xlator_t *this, clnt_conf_t *conf)
         GF_OPTION_INIT ("ping-timeout", conf->opt.ping_timeout,
                         int32, out);
 
+        GF_OPTION_INIT ("channel-count", conf->channel_count, int32, out);
+
         GF_OPTION_INIT ("remote-subvolume", conf->opt.remote_subvolume,
                         path, out);
         if (!conf->opt.remote_subvolume)
@@ -2178,6 +2491,95 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static void
+client_destroy_channels (clnt_conf_t *conf)
+{
+        clnt_channel_t *ch   = NULL;
+        int             i    = 0;
+
+        if (!conf->channels)
+                return;
+
+        client_channels_disable (conf);
+
+        for (i = 1; i < conf->channel_count; i++) {
+                ch = &conf->channels[i];
+                if (!ch->rpc)
+                        continue;
+
+                rpc_clnt_register_notify (ch->rpc, NULL, NULL);
+                /* cleanup the saved-frames before last unref */
+                rpc_clnt_connection_cleanup (&ch->rpc->conn);
+                rpc_clnt_unref (ch->rpc);
+        }
+
+        GF_FREE (conf->channels);
+        conf->channels = NULL;
+}
+
+
+static int
+client_init_channels (xlator_t *this)
+{
+        clnt_conf_t    *conf = NULL;
+        clnt_channel_t *ch   = NULL;
+        char           *name = NULL;
+        int             ret  = -1;
+        int             i    = 0;
+
+        conf = this->private;
+
+        conf->channels = GF_CALLOC (conf->channel_count,
+                                    sizeof (*conf->channels),
+                                    gf_client_mt_clnt_channel_t);
+        if (!conf->channels)
+                goto out;
+
+        for (i = 0; i < conf->channel_count; i++) {
+                ch = &conf->channels[i];
+                ch->this  = this;
+                ch->index = i;
+
+                if (i == 0) {
+                        ch->rpc = conf->rpc;
+                        continue;
+                }
+
+                ret = gf_asprintf (&name, "%s-channel-%d", this->name, i);
+                if (ret == -1)
+                        goto out;
+
+                ch->rpc = rpc_clnt_new (this->options, this->ctx, name, 0);
+                GF_FREE (name);
+                if (!ch->rpc) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "failed to initialize RPC of channel %d", i);
+                        ret = -1;
+                        goto out;
+                }
+
+                ret = rpc_clnt_register_notify (ch->rpc, client_channel_notify,
+                                                ch);
+                if (ret)
+                        goto out;
+
+                /* the server sends upcalls on any of the connections of a
+                   client */
+                ret = rpcclnt_cbk_program_register (ch->rpc,
+                                                    &gluster_cbk_prog);
+                if (ret)
+                        goto out;
+        }
+
+        if (conf->channel_count > 1)
+                gf_log (this->name, GF_LOG_INFO, "using %d channels",
+                        conf->channel_count);
+        ret = 0;
+out:
+        return ret;
+}
+
+
 int
 client_destroy_rpc (xlator_t *this)
 {
@@ -2189,6 +2591,8 @@ client_destroy_rpc (xlator_t *this)
                 goto out;
 
         if (conf->rpc) {
+                client_destroy_channels (conf);
+
                 /* cleanup the saved-frames before last unref */
                 rpc_clnt_connection_cleanup (&conf->rpc->conn);
 
@@ -2244,6 +2648,10 @@ client_init_rpc (xlator_t *this)
                 goto out;
         }
 
+        ret = client_init_channels (this);
+        if (ret)
+                goto out;
+
         ret = 0;
 
         gf_log (this->name, GF_LOG_DEBUG, "client init successful");
@@ -2427,6 +2835,8 @@ fini (xlator_t *this)
         this->private = NULL;
 
         if (conf) {
+                client_destroy_channels (conf);
+
                 if (conf->rpc) {
                         /* cleanup the saved-frames before last unref */
                         rpc_clnt_connection_cleanup (&conf->rpc->conn);
@@ -2526,13 +2936,21 @@ client_priv_dump (xlator_t *this)
         }
 
         gf_proc_dump_write("connecting", "%d", conf->connecting);
+        gf_proc_dump_write("compound_fops", "%d", conf->compound_fops);
 
-        if (conf->rpc) {
-                gf_proc_dump_write("total_bytes_read", "%"PRIu64,
-                                   conf->rpc->conn.trans->total_bytes_read);
+        if (conf->rpc)
+                rpc_transport_stats_dump (conf->rpc->conn.trans, NULL);
+
+        for (i = 1; conf->channels && (i < conf->channel_count); i++) {
+                if (!conf->channels[i].rpc)
+                        continue;
+
+                sprintf (key, "channel.%d.ready", i);
+                gf_proc_dump_write (key, "%d", conf->channels[i].ready);
 
-                gf_proc_dump_write("total_bytes_written", "%"PRIu64,
-                                   conf->rpc->conn.trans->total_bytes_write);
+                sprintf (key, "channel.%d", i);
+                rpc_transport_stats_dump (conf->channels[i].rpc->conn.trans,
+                                          key);
         }
         pthread_mutex_unlock(&conf->lock);
 
@@ -2606,6 +3024,7 @@ struct xlator_fops fops = {
         .setattr     = client_setattr,
         .fsetattr    = client_fsetattr,
         .getspec     = client_getspec,
+        .compound    = client_compound,
 };
 
 
@@ -2670,5 +3089,14 @@ struct volume_options options[] = {
          .min  = GF_MIN_SOCKET_WINDOW_SIZE,
          .max  = GF_MAX_SOCKET_WINDOW_SIZE
         },
+        { .key   = {"channel-count"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = CLIENT_MAX_CHANNELS,
+          .default_value = "1",
+          .description = "Number of connections to the brick. Fops on "
+                         "different files are spread over them, those on "
+                         "one file always use the same one."
+        },
         { .key   = {NULL} },
 };
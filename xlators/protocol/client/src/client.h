@@ -37,6 +37,7 @@
 #define CLIENT_DUMP_LOCKS     "trusted.glusterfs.clientlk-dump"
 #define GF_MAX_SOCKET_WINDOW_SIZE  (1 * GF_UNIT_MB)
 #define GF_MIN_SOCKET_WINDOW_SIZE  (0)
+#define CLIENT_MAX_CHANNELS        16
 
 typedef enum {
         GF_LK_HEAL_IN_PROGRESS,
@@ -78,6 +79,27 @@ struct clnt_options {
         int   ping_timeout;
 };
 
+/* One of the 'channel-count' connections to the brick. channels[0] is
+   conf->rpc, which does the handshake (versions, portmap, SETVOLUME, fd
+   reopen). The others are connected once it is attached, and only send a
+   SETVOLUME with the same process-uuid, so that the server binds them to
+   the same client connection (fds, locks) as the first one. */
+typedef struct clnt_channel {
+        struct rpc_clnt       *rpc;
+        xlator_t              *this;
+        int                    index;
+        char                   started;
+        char                   connected; /* transport is up */
+        char                   ready;   /* attached to the remote volume,
+                                           fops can be sent on it */
+        char                   draining; /* its fops went on channel 0,
+                                            wait for the replies up to */
+        uint32_t               fence;    /* this xid there (under
+                                            conf->lock) */
+        int                    unfenced; /* fops on their way to channel 0
+                                            whose xid is not in fence yet */
+} clnt_channel_t;
+
 typedef struct clnt_conf {
         struct rpc_clnt       *rpc;
         struct clnt_options    opt;
@@ -118,6 +140,12 @@ typedef struct clnt_conf {
                                                       means dont register, true
                                                       means register */
         char                   parent_down;
+        gf_boolean_t           compound_fops; /* the server runs COMPOUND
+                                                 chains, see setvolume */
+        int32_t                channel_count;
+        clnt_channel_t        *channels;
+        int                    brick_port; /* from the portmapper, 0 if
+                                              remote-port is the brick */
 } clnt_conf_t;
 
 typedef struct _client_fd_ctx {
@@ -164,6 +192,7 @@ typedef struct client_local {
         int32_t              cmd;
         struct list_head     lock_list;
         pthread_mutex_t      mutex;
+        compound_args_t     *compound_args;
 } clnt_local_t;
 
 typedef struct client_args {
@@ -197,6 +226,7 @@ typedef struct client_args {
         gf_xattrop_flags_t  optype;
         int32_t             valid;
         int32_t             len;
+        compound_args_t    *compound_args;
 } clnt_args_t;
 
 typedef ssize_t (*gfs_serialize_t) (struct iovec outmsg, void *args);
@@ -224,6 +254,8 @@ int unserialize_rsp_direntp (xlator_t *this, fd_t *fd,
 
 int clnt_readdir_rsp_cleanup (gfs3_readdir_rsp *rsp);
 int clnt_readdirp_rsp_cleanup (gfs3_readdirp_rsp *rsp);
+int clnt_compound_req_cleanup (gfs3_compound_req_entry *entries, int count);
+int clnt_compound_rsp_cleanup (gfs3_compound_rsp *rsp);
 int client_attempt_lock_recovery (xlator_t *this, clnt_fd_ctx_t *fdctx);
 int32_t delete_granted_locks_owner (fd_t *fd, gf_lkowner_t *owner);
 int client_add_lock_for_recovery (fd_t *fd, struct gf_flock *flock,
@@ -248,4 +280,14 @@ int client_mark_fd_bad (xlator_t *this);
 int client_set_lk_version (xlator_t *this);
 
 int client_fd_lk_list_empty (fd_lk_ctx_t *lk_ctx, gf_boolean_t use_try_lock);
+
+int client_req_gfid (clnt_conf_t *conf, int procnum, void *req,
+                     uuid_t gfid);
+struct rpc_clnt *client_channel_select (xlator_t *this, rpc_clnt_prog_t *prog,
+                                        int procnum, void *req,
+                                        clnt_channel_t **fallback);
+void client_channel_fence (clnt_conf_t *conf, clnt_channel_t *ch);
+void client_channels_connect (xlator_t *this);
+void client_channels_disconnect (xlator_t *this);
+int client_channel_setvolume (xlator_t *this, clnt_channel_t *ch);
 #endif /* !_CLIENT_H */
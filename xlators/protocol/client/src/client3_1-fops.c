@@ -26,6 +26,7 @@
 #include "glusterfs3-xdr.h"
 #include "glusterfs3.h"
 #include "compat-errno.h"
+#include "compound-fop-utils.h"
 
 int32_t client3_getspec (call_frame_t *frame, xlator_t *this, void *data);
 void client_start_ping (void *data);
@@ -48,6 +49,8 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
         struct iobref  *new_iobref = NULL;
         ssize_t         xdr_size   = 0;
         struct rpc_req  rpcreq     = {0, };
+        struct rpc_clnt *rpc       = NULL;
+        clnt_channel_t  *fallback  = NULL;
 
         start_ping = 0;
 
@@ -97,9 +100,12 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
         }
 
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbkfn, &iov, count,
+        rpc = client_channel_select (this, prog, procnum, req, &fallback);
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbkfn, &iov, count,
                                payload, payloadcnt, new_iobref, frame, NULL, 0,
                                NULL, 0, NULL);
+        if (fallback)
+                client_channel_fence (conf, fallback);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_DEBUG, "rpc_clnt_submit failed");
         }
@@ -843,6 +849,7 @@ client3_1_getxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
         int                ret      = 0;
         clnt_local_t    *local    = NULL;
         xlator_t         *this       = NULL;
+        struct iobuf     *iobuf      = NULL;
 
         this = THIS;
 
@@ -855,6 +862,16 @@ client3_1_getxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
         }
 
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, iov->iov_len);
+        if (!iobuf) {
+                rsp.op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+        /* the dict is decoded straight into memory its values can keep
+           referring to, see dict_unserialize_iobuf () */
+        rsp.dict.dict_val = iobuf_ptr (iobuf);
+
         ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_getxattr_rsp);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
@@ -865,10 +882,10 @@ client3_1_getxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
         op_errno = gf_error_to_errno (rsp.op_errno);
         if (-1 != rsp.op_ret) {
-                GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, dict,
-                                              (rsp.dict.dict_val),
-                                              (rsp.dict.dict_len), rsp.op_ret,
-                                              op_errno, out);
+                GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (frame->this, dict,
+                                                    (rsp.dict.dict_val),
+                                                    (rsp.dict.dict_len), iobuf,
+                                                    rsp.op_ret, op_errno, out);
         }
 
 out:
@@ -881,12 +898,8 @@ out:
 
         CLIENT_STACK_UNWIND (getxattr, frame, rsp.op_ret, op_errno, dict);
 
-        if (rsp.dict.dict_val) {
-                /* don't use GF_FREE, this memory was allocated by libc
-                 */
-                free (rsp.dict.dict_val);
-                rsp.dict.dict_val = NULL;
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         if (dict)
                 dict_unref (dict);
@@ -905,6 +918,7 @@ client3_1_fgetxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
         int                 op_errno = EINVAL;
         clnt_local_t     *local    = NULL;
         xlator_t         *this       = NULL;
+        struct iobuf     *iobuf      = NULL;
 
         this = THIS;
 
@@ -916,6 +930,14 @@ client3_1_fgetxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 op_errno = ENOTCONN;
                 goto out;
         }
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, iov->iov_len);
+        if (!iobuf) {
+                rsp.op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+        rsp.dict.dict_val = iobuf_ptr (iobuf);
+
         ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_fgetxattr_rsp);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
@@ -926,10 +948,10 @@ client3_1_fgetxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
         op_errno = gf_error_to_errno (rsp.op_errno);
         if (-1 != rsp.op_ret) {
-                GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, dict,
-                                              (rsp.dict.dict_val),
-                                              (rsp.dict.dict_len), rsp.op_ret,
-                                              op_errno, out);
+                GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (frame->this, dict,
+                                                    (rsp.dict.dict_val),
+                                                    (rsp.dict.dict_len), iobuf,
+                                                    rsp.op_ret, op_errno, out);
         }
 out:
         if (rsp.op_ret == -1) {
@@ -939,12 +961,8 @@ out:
         }
 
         CLIENT_STACK_UNWIND (fgetxattr, frame, rsp.op_ret, op_errno, dict);
-        if (rsp.dict.dict_val) {
-                /* don't use GF_FREE, this memory was allocated by libc
-                 */
-                free (rsp.dict.dict_val);
-                rsp.dict.dict_val = NULL;
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         if (dict)
                 dict_unref (dict);
@@ -1355,6 +1373,7 @@ client3_1_xattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
         int               op_errno = EINVAL;
         clnt_local_t   *local    = NULL;
         xlator_t         *this       = NULL;
+        struct iobuf     *iobuf      = NULL;
 
         this = THIS;
 
@@ -1366,6 +1385,14 @@ client3_1_xattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 op_errno = ENOTCONN;
                 goto out;
         }
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, iov->iov_len);
+        if (!iobuf) {
+                rsp.op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+        rsp.dict.dict_val = iobuf_ptr (iobuf);
+
         ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_xattrop_rsp);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
@@ -1376,10 +1403,10 @@ client3_1_xattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
         op_errno = rsp.op_errno;
         if (-1 != rsp.op_ret) {
-                GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, dict,
-                                              (rsp.dict.dict_val),
-                                              (rsp.dict.dict_len), rsp.op_ret,
-                                              op_errno, out);
+                GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (frame->this, dict,
+                                                    (rsp.dict.dict_val),
+                                                    (rsp.dict.dict_len), iobuf,
+                                                    rsp.op_ret, op_errno, out);
         }
 
 out:
@@ -1393,12 +1420,8 @@ out:
         CLIENT_STACK_UNWIND (xattrop, frame, rsp.op_ret,
                              gf_error_to_errno (op_errno), dict);
 
-        if (rsp.dict.dict_val) {
-                /* don't use GF_FREE, this memory was allocated by libc
-                 */
-                free (rsp.dict.dict_val);
-                rsp.dict.dict_val = NULL;
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         if (dict)
                 dict_unref (dict);
@@ -1417,6 +1440,7 @@ client3_1_fxattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
         int                op_errno = 0;
         clnt_local_t    *local    = NULL;
         xlator_t         *this       = NULL;
+        struct iobuf     *iobuf      = NULL;
 
         this = THIS;
 
@@ -1429,6 +1453,14 @@ client3_1_fxattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
         }
 
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, iov->iov_len);
+        if (!iobuf) {
+                rsp.op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+        rsp.dict.dict_val = iobuf_ptr (iobuf);
+
         ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_fxattrop_rsp);
         if (ret < 0) {
                 rsp.op_ret = -1;
@@ -1438,10 +1470,10 @@ client3_1_fxattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
         }
         op_errno = rsp.op_errno;
         if (-1 != rsp.op_ret) {
-                GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, dict,
-                                              (rsp.dict.dict_val),
-                                              (rsp.dict.dict_len), rsp.op_ret,
-                                              op_errno, out);
+                GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (frame->this, dict,
+                                                    (rsp.dict.dict_val),
+                                                    (rsp.dict.dict_len), iobuf,
+                                                    rsp.op_ret, op_errno, out);
         }
 
 out:
@@ -1454,12 +1486,8 @@ out:
         CLIENT_STACK_UNWIND (fxattrop, frame, rsp.op_ret,
                              gf_error_to_errno (op_errno), dict);
 
-        if (rsp.dict.dict_val) {
-                /* don't use GF_FREE, this memory was allocated by libc
-                 */
-                free (rsp.dict.dict_val);
-                rsp.dict.dict_val = NULL;
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         if (dict)
                 dict_unref (dict);
@@ -2101,6 +2129,7 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
         dict_t          *xattr      = NULL;
         inode_t         *inode      = NULL;
         xlator_t        *this       = NULL;
+        struct iobuf    *iobuf      = NULL;
 
         this = THIS;
 
@@ -2114,6 +2143,14 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
         }
 
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, iov->iov_len);
+        if (!iobuf) {
+                rsp.op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+        rsp.dict.dict_val = iobuf_ptr (iobuf);
+
         ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_lookup_rsp);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
@@ -2131,9 +2168,10 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
         rsp.op_ret = -1;
         gf_stat_to_iatt (&rsp.stat, &stbuf);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, xattr, (rsp.dict.dict_val),
-                                      (rsp.dict.dict_len), rsp.op_ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (frame->this, xattr,
+                                            (rsp.dict.dict_val),
+                                            (rsp.dict.dict_len), iobuf,
+                                            rsp.op_ret, op_errno, out);
 
         if ((!uuid_is_null (inode->gfid))
             && (uuid_compare (stbuf.ia_gfid, inode->gfid) != 0)) {
@@ -2166,11 +2204,8 @@ out:
         if (xattr)
                 dict_unref (xattr);
 
-        if (rsp.dict.dict_val) {
-                /* don't use GF_FREE, this memory was allocated by libc
-                 */
-                free (rsp.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return 0;
 }
@@ -5004,6 +5039,499 @@ unwind:
 }
 
 
+static int
+client_compound_op (glusterfs_fop_t fop)
+{
+        switch (fop) {
+        case GF_FOP_LOOKUP:
+                return GFS3_OP_LOOKUP;
+        case GF_FOP_OPEN:
+                return GFS3_OP_OPEN;
+        case GF_FOP_CREATE:
+                return GFS3_OP_CREATE;
+        case GF_FOP_READ:
+                return GFS3_OP_READ;
+        case GF_FOP_WRITE:
+                return GFS3_OP_WRITE;
+        case GF_FOP_FLUSH:
+                return GFS3_OP_FLUSH;
+        case GF_FOP_RELEASE:
+                return GFS3_OP_RELEASE;
+        default:
+                return -1;
+        }
+}
+
+
+/* was @fd opened by a step before @idx */
+static gf_boolean_t
+client_compound_chain_fd (compound_args_t *args, int idx, fd_t *fd)
+{
+        int i = 0;
+
+        for (i = 0; i < idx; i++) {
+                if (((args->req[i].fop == GF_FOP_OPEN) ||
+                     (args->req[i].fop == GF_FOP_CREATE)) &&
+                    (args->req[i].fd == fd))
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+/* was @inode resolved by a step before @idx */
+static gf_boolean_t
+client_compound_chain_inode (compound_args_t *args, int idx, inode_t *inode)
+{
+        int i = 0;
+
+        for (i = 0; i < idx; i++) {
+                if (((args->req[i].fop == GF_FOP_LOOKUP) ||
+                     (args->req[i].fop == GF_FOP_CREATE)) &&
+                    (args->req[i].loc.inode == inode))
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+/* is @fd released by a step after @idx */
+static gf_boolean_t
+client_compound_released (compound_args_t *args, int idx, fd_t *fd)
+{
+        int i = 0;
+
+        for (i = idx + 1; i < args->count; i++) {
+                if ((args->req[i].fop == GF_FOP_RELEASE) &&
+                    (args->req[i].fd == fd))
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+static void
+client_compound_set_fdctx (xlator_t *this, compound_req_t *creq,
+                           int64_t remote_fd)
+{
+        clnt_conf_t   *conf  = NULL;
+        clnt_fd_ctx_t *fdctx = NULL;
+
+        conf = this->private;
+
+        fdctx = GF_CALLOC (1, sizeof (*fdctx), gf_client_mt_clnt_fdctx_t);
+        if (!fdctx) {
+                /* later fops go out on an anonymous fd */
+                gf_log (this->name, GF_LOG_WARNING,
+                        "%s: out of memory, remote fd %"PRId64" is lost",
+                        creq->loc.path, remote_fd);
+                return;
+        }
+
+        fdctx->remote_fd     = remote_fd;
+        fdctx->inode         = inode_ref (creq->fd->inode);
+        fdctx->flags         = creq->flags;
+        fdctx->lk_ctx        = fd_lk_ctx_ref (creq->fd->lk_ctx);
+        fdctx->lk_heal_state = GF_LK_HEAL_DONE;
+
+        INIT_LIST_HEAD (&fdctx->sfd_pos);
+        INIT_LIST_HEAD (&fdctx->lock_list);
+
+        this_fd_set_ctx (creq->fd, this, &creq->loc, fdctx);
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                list_add_tail (&fdctx->sfd_pos, &conf->saved_fds);
+        }
+        pthread_mutex_unlock (&conf->lock);
+}
+
+
+/* the brick already forgot the fd, drop it without sending a RELEASE */
+static void
+client_compound_forget_fd (xlator_t *this, fd_t *fd)
+{
+        clnt_conf_t   *conf   = NULL;
+        clnt_fd_ctx_t *fdctx  = NULL;
+        fd_lk_ctx_t   *lk_ctx = NULL;
+
+        conf = this->private;
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                fdctx = this_fd_del_ctx (fd, this);
+                if (fdctx) {
+                        list_del_init (&fdctx->sfd_pos);
+                        lk_ctx = fdctx->lk_ctx;
+                        fdctx->lk_ctx = NULL;
+                }
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        if (!fdctx)
+                return;
+
+        if (lk_ctx)
+                fd_lk_ctx_unref (lk_ctx);
+
+        inode_unref (fdctx->inode);
+        GF_FREE (fdctx);
+}
+
+
+int
+client3_1_compound_cbk (struct rpc_req *req, struct iovec *iov, int count,
+                        void *myframe)
+{
+        call_frame_t            *frame    = NULL;
+        clnt_local_t            *local    = NULL;
+        compound_args_t         *args     = NULL;
+        compound_args_cbk_t     *args_cbk = NULL;
+        compound_req_t          *creq     = NULL;
+        compound_rsp_t          *crsp     = NULL;
+        gfs3_compound_rsp        rsp      = {0,};
+        gfs3_compound_rsp_entry *trav     = NULL;
+        char                    *payload  = NULL;
+        size_t                   left     = 0;
+        int                      ret      = 0;
+        int                      i        = 0;
+        int32_t                  op_ret   = -1;
+        int32_t                  op_errno = 0;
+        xlator_t                *this     = NULL;
+
+        this = THIS;
+
+        frame = myframe;
+        local = frame->local;
+        args  = local->compound_args;
+
+        if (-1 == req->rpc_status) {
+                op_errno = ENOTCONN;
+                goto out;
+        }
+
+        ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_compound_rsp);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
+                op_errno = EINVAL;
+                goto out;
+        }
+
+        /* the data of the READ steps follows the reply, in step order */
+        payload = (char *)iov->iov_base + ret;
+        left    = iov->iov_len - ret;
+
+        args_cbk = compound_args_cbk_new (args->count);
+        if (!args_cbk) {
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        for (trav = rsp.reply, i = 0; trav && (i < args->count);
+             trav = trav->nextentry, i++) {
+                creq = &args->req[i];
+                crsp = &args_cbk->rsp[i];
+
+                crsp->op_ret   = trav->op_ret;
+                crsp->op_errno = gf_error_to_errno (trav->op_errno);
+                if (trav->op_ret < 0)
+                        continue;
+
+                switch (creq->fop) {
+                case GF_FOP_LOOKUP:
+                        gf_stat_to_iatt (&trav->stat, &crsp->stat);
+                        gf_stat_to_iatt (&trav->poststat, &crsp->poststat);
+                        GF_PROTOCOL_DICT_UNSERIALIZE (frame->this, crsp->xattr,
+                                                      (trav->dict.dict_val),
+                                                      (trav->dict.dict_len),
+                                                      ret, crsp->op_errno,
+                                                      step_err);
+                        break;
+                case GF_FOP_CREATE:
+                        gf_stat_to_iatt (&trav->stat, &crsp->stat);
+                        gf_stat_to_iatt (&trav->prestat, &crsp->prestat);
+                        gf_stat_to_iatt (&trav->poststat, &crsp->poststat);
+                        /* fall through */
+                case GF_FOP_OPEN:
+                        if (!client_compound_released (args, i, creq->fd))
+                                client_compound_set_fdctx (frame->this, creq,
+                                                           trav->fd);
+                        break;
+                case GF_FOP_READ:
+                        gf_stat_to_iatt (&trav->stat, &crsp->stat);
+                        if (trav->size > left) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "short compound reply (%u bytes of "
+                                        "read data, %lu left)", trav->size,
+                                        (unsigned long)left);
+                                crsp->op_errno = EINVAL;
+                                goto step_err;
+                        }
+                        crsp->vector = GF_CALLOC (1, sizeof (struct iovec),
+                                                  gf_common_mt_iovec);
+                        if (!crsp->vector) {
+                                crsp->op_errno = ENOMEM;
+                                goto step_err;
+                        }
+                        crsp->vector[0].iov_base = payload;
+                        crsp->vector[0].iov_len  = trav->size;
+                        crsp->count  = 1;
+                        crsp->iobref = iobref_ref (req->rsp_iobref);
+
+                        payload += trav->size;
+                        left    -= trav->size;
+                        break;
+                case GF_FOP_WRITE:
+                        gf_stat_to_iatt (&trav->prestat, &crsp->prestat);
+                        gf_stat_to_iatt (&trav->poststat, &crsp->poststat);
+                        break;
+                case GF_FOP_FLUSH:
+                        if (!fd_is_anonymous (creq->fd))
+                                delete_granted_locks_owner (creq->fd,
+                                                            &local->owner);
+                        break;
+                case GF_FOP_RELEASE:
+                        if (!client_compound_chain_fd (args, i, creq->fd))
+                                client_compound_forget_fd (frame->this,
+                                                           creq->fd);
+                        break;
+                default:
+                        break;
+                }
+
+                continue;
+step_err:
+                crsp->op_ret = -1;
+                if (rsp.op_ret == 0) {
+                        rsp.op_ret   = -1;
+                        rsp.op_errno = gf_errno_to_error (crsp->op_errno);
+                }
+        }
+
+        op_ret   = rsp.op_ret;
+        op_errno = gf_error_to_errno (rsp.op_errno);
+out:
+        if (op_ret == -1) {
+                gf_log (this->name, ((op_errno == ENOENT) ? GF_LOG_DEBUG :
+                                     GF_LOG_WARNING),
+                        "remote operation failed: %s",
+                        strerror (op_errno));
+        }
+
+        CLIENT_STACK_UNWIND (compound, frame, op_ret, op_errno, args_cbk);
+
+        compound_args_cbk_destroy (args_cbk);
+        clnt_compound_rsp_cleanup (&rsp);
+
+        return 0;
+}
+
+
+int32_t
+client3_1_compound (call_frame_t *frame, xlator_t *this, void *data)
+{
+        clnt_args_t             *args       = NULL;
+        clnt_conf_t             *conf       = NULL;
+        clnt_local_t            *local      = NULL;
+        compound_args_t         *cargs      = NULL;
+        compound_req_t          *creq       = NULL;
+        gfs3_compound_req        req        = {0,};
+        gfs3_compound_req_entry *entries    = NULL;
+        gfs3_compound_req_entry *entry      = NULL;
+        struct iovec            *payload    = NULL;
+        int                      payloadcnt = 0;
+        struct iobref           *iobref     = NULL;
+        int64_t                  remote_fd  = -1;
+        int                      op_errno   = ESTALE;
+        int                      ret        = 0;
+        int                      i          = 0;
+
+        if (!frame || !this || !data)
+                goto unwind;
+
+        args  = data;
+        conf  = this->private;
+        cargs = args->compound_args;
+
+        if (!cargs->count || (cargs->count > GF_COMPOUND_MAX_FOPS)) {
+                op_errno = EINVAL;
+                goto unwind;
+        }
+
+        local = mem_get0 (this->local_pool);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto unwind;
+        }
+        local->compound_args = cargs;
+        local->owner = frame->root->lk_owner;
+        frame->local = local;
+
+        entries = GF_CALLOC (cargs->count, sizeof (*entries),
+                             gf_client_mt_compound_req_t);
+        iobref = iobref_new ();
+        if (!entries || !iobref) {
+                op_errno = ENOMEM;
+                goto unwind;
+        }
+
+        for (i = 0; i < cargs->count; i++) {
+                if (cargs->req[i].fop == GF_FOP_WRITE)
+                        payloadcnt += cargs->req[i].count;
+        }
+        if (payloadcnt) {
+                payload = GF_CALLOC (payloadcnt, sizeof (*payload),
+                                     gf_common_mt_iovec);
+                if (!payload) {
+                        op_errno = ENOMEM;
+                        goto unwind;
+                }
+                payloadcnt = 0;
+        }
+
+        for (i = 0; i < cargs->count; i++) {
+                creq  = &cargs->req[i];
+                entry = &entries[i];
+
+                if (i + 1 < cargs->count)
+                        entry->nextentry = &entries[i + 1];
+
+                entry->op = client_compound_op (creq->fop);
+                if (entry->op < 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "%s can not be part of a compound fop",
+                                gf_fop_list[creq->fop]);
+                        op_errno = ENOTSUP;
+                        goto unwind;
+                }
+
+                entry->fd    = -1;
+                entry->bname = "";
+
+                if (creq->fd) {
+                        if (client_compound_chain_fd (cargs, i, creq->fd)) {
+                                remote_fd = GF_COMPOUND_CHAIN_FD;
+                        } else if ((creq->fop == GF_FOP_OPEN) ||
+                                   (creq->fop == GF_FOP_CREATE)) {
+                                remote_fd = -1;
+                        } else {
+                                CLIENT_GET_REMOTE_FD (conf, creq->fd,
+                                                      remote_fd, op_errno,
+                                                      unwind);
+                        }
+                        entry->fd = remote_fd;
+                        memcpy (entry->gfid, creq->fd->inode->gfid, 16);
+                }
+
+                switch (creq->fop) {
+                case GF_FOP_LOOKUP:
+                        if (creq->loc.parent) {
+                                if (!uuid_is_null (creq->loc.parent->gfid))
+                                        memcpy (entry->pargfid,
+                                                creq->loc.parent->gfid, 16);
+                                else
+                                        memcpy (entry->pargfid,
+                                                creq->loc.pargfid, 16);
+                                if (creq->loc.name)
+                                        entry->bname = (char *)creq->loc.name;
+                        } else if (!uuid_is_null (creq->loc.inode->gfid)) {
+                                memcpy (entry->gfid, creq->loc.inode->gfid,
+                                        16);
+                        } else {
+                                memcpy (entry->gfid, creq->loc.gfid, 16);
+                        }
+                        GF_PROTOCOL_DICT_SERIALIZE (this, creq->xattr,
+                                                    (&entry->dict.dict_val),
+                                                    entry->dict.dict_len,
+                                                    op_errno, unwind);
+                        break;
+                case GF_FOP_OPEN:
+                        /* a null gfid is the inode an earlier step of the
+                           chain looked up or created */
+                        if (!uuid_is_null (creq->loc.inode->gfid))
+                                memcpy (entry->gfid, creq->loc.inode->gfid,
+                                        16);
+                        else if (!uuid_is_null (creq->loc.gfid))
+                                memcpy (entry->gfid, creq->loc.gfid, 16);
+                        else if (!client_compound_chain_inode
+                                 (cargs, i, creq->loc.inode)) {
+                                op_errno = EINVAL;
+                                goto unwind;
+                        }
+                        entry->flags = gf_flags_from_flags (creq->flags);
+                        break;
+                case GF_FOP_CREATE:
+                        if (!creq->loc.parent) {
+                                op_errno = EINVAL;
+                                goto unwind;
+                        }
+                        if (!uuid_is_null (creq->loc.parent->gfid))
+                                memcpy (entry->pargfid,
+                                        creq->loc.parent->gfid, 16);
+                        else
+                                memcpy (entry->pargfid, creq->loc.pargfid, 16);
+                        entry->bname = (char *)creq->loc.name;
+                        entry->flags = gf_flags_from_flags (creq->flags);
+                        entry->mode  = creq->mode;
+                        GF_PROTOCOL_DICT_SERIALIZE (this, creq->xattr,
+                                                    (&entry->dict.dict_val),
+                                                    entry->dict.dict_len,
+                                                    op_errno, unwind);
+                        break;
+                case GF_FOP_READ:
+                        entry->size   = creq->size;
+                        entry->offset = creq->offset;
+                        entry->flags  = creq->flags;
+                        break;
+                case GF_FOP_WRITE:
+                        entry->size   = iov_length (creq->vector, creq->count);
+                        entry->offset = creq->offset;
+                        entry->flags  = creq->flags;
+
+                        memcpy (&payload[payloadcnt], creq->vector,
+                                creq->count * sizeof (*payload));
+                        payloadcnt += creq->count;
+                        if (creq->iobref)
+                                iobref_merge (iobref, creq->iobref);
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        req.request = entries;
+
+        ret = client_submit_vec_request (this, &req, frame, conf->fops,
+                                         GFS3_OP_COMPOUND,
+                                         client3_1_compound_cbk,
+                                         payload, payloadcnt, iobref,
+                                         (xdrproc_t)xdr_gfs3_compound_req);
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING, "failed to send the fop");
+        }
+
+        clnt_compound_req_cleanup (entries, cargs->count);
+        GF_FREE (payload);
+        iobref_unref (iobref);
+
+        return 0;
+unwind:
+        CLIENT_STACK_UNWIND (compound, frame, -1, op_errno, NULL);
+
+        if (entries)
+                clnt_compound_req_cleanup (entries, cargs->count);
+        if (payload)
+                GF_FREE (payload);
+        if (iobref)
+                iobref_unref (iobref);
+
+        return 0;
+}
+
+
 
 /* Table Specific to FOPS */
 
@@ -5054,6 +5582,7 @@ rpc_clnt_procedure_t clnt3_1_fop_actors[GF_FOP_MAXVALUE] = {
         [GF_FOP_RELEASEDIR]  = { "RELEASEDIR",  client3_1_releasedir },
         [GF_FOP_GETSPEC]     = { "GETSPEC",     client3_getspec },
         [GF_FOP_FREMOVEXATTR] = { "FREMOVEXATTR", client3_1_fremovexattr },
+        [GF_FOP_COMPOUND]    = { "COMPOUND",    client3_1_compound },
 };
 
 /* Used From RPC-CLNT library to log proper name of procedure based on number */
@@ -5102,6 +5631,7 @@ char *clnt3_1_fop_names[GFS3_OP_MAXVALUE] = {
         [GFS3_OP_RELEASE]     = "RELEASE",
         [GFS3_OP_RELEASEDIR]  = "RELEASEDIR",
         [GFS3_OP_FREMOVEXATTR] = "FREMOVEXATTR",
+        [GFS3_OP_COMPOUND]    = "COMPOUND",
 };
 
 rpc_clnt_prog_t clnt3_1_fop_prog = {
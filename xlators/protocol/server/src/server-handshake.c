@@ -441,9 +441,16 @@ server_setvolume (rpcsvc_request_t *req)
                                                   INTERNAL_LOCKS | POSIX_LOCKS);
         }
 
-        if (req->trans->xl_private != conn)
+        if (req->trans->xl_private != conn) {
                 req->trans->xl_private = conn;
 
+                pthread_mutex_lock (&conn->lock);
+                {
+                        conn->xprt_count++;
+                }
+                pthread_mutex_unlock (&conn->lock);
+        }
+
         ret = dict_get_int32 (params, "fops-version", &fop_version);
         if (ret < 0) {
                 ret = dict_set_str (reply, "ERROR",
@@ -632,6 +639,11 @@ server_setvolume (rpcsvc_request_t *req)
                 gf_log (this->name, GF_LOG_WARNING,
                         "failed to set 'clnt-lk-version'");
 
+        ret = dict_set_uint32 (reply, "compound-fops", 1);
+        if (ret)
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "failed to set 'compound-fops'");
+
         ret = dict_set_uint64 (reply, "transport-ptr",
                                ((uint64_t) (long) req->trans));
         if (ret)
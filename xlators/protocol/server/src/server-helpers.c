@@ -79,6 +79,93 @@ server_resolve_wipe (server_resolve_t *resolve)
 }
 
 
+void
+server_compound_wipe (server_compound_t *compound)
+{
+        gfs3_compound_req_entry *prev = NULL;
+        gfs3_compound_req_entry *trav = NULL;
+        int                      i    = 0;
+
+        trav = compound->req.request;
+        prev = trav;
+        while (trav) {
+                trav = trav->nextentry;
+                /* the rpc lib allocates these */
+                free (prev->bname);
+                free (prev->dict.dict_val);
+                free (prev);
+                prev = trav;
+        }
+        free (compound->req.xdata.xdata_val);
+
+        if (compound->rsp) {
+                for (i = 0; i < compound->count; i++) {
+                        if (compound->rsp[i].dict.dict_val)
+                                GF_FREE (compound->rsp[i].dict.dict_val);
+                }
+                GF_FREE (compound->rsp);
+        }
+
+        if (compound->inode)
+                inode_unref (compound->inode);
+
+        if (compound->req_iobref)
+                iobref_unref (compound->req_iobref);
+
+        if (compound->iobref)
+                iobref_unref (compound->iobref);
+
+        GF_FREE (compound);
+}
+
+
+/* clears what the previous step of a COMPOUND request left in @state */
+void
+server_compound_state_reset (server_state_t *state)
+{
+        if (state->fd) {
+                fd_unref (state->fd);
+                state->fd = NULL;
+        }
+
+        if (state->params) {
+                dict_unref (state->params);
+                state->params = NULL;
+        }
+
+        if (state->iobref) {
+                iobref_unref (state->iobref);
+                state->iobref = NULL;
+        }
+
+        if (state->dict) {
+                dict_unref (state->dict);
+                state->dict = NULL;
+        }
+
+        server_loc_wipe (&state->loc);
+        server_loc_wipe (&state->loc2);
+        memset (&state->loc, 0, sizeof (state->loc));
+        memset (&state->loc2, 0, sizeof (state->loc2));
+
+        server_resolve_wipe (&state->resolve);
+        server_resolve_wipe (&state->resolve2);
+        memset (&state->resolve, 0, sizeof (state->resolve));
+        memset (&state->resolve2, 0, sizeof (state->resolve2));
+        state->resolve.fd_no  = -1;
+        state->resolve2.fd_no = -1;
+
+        state->resolve_now   = NULL;
+        state->loc_now       = NULL;
+        state->payload_count = 0;
+        state->size          = 0;
+        state->offset        = 0;
+        state->flags         = 0;
+        state->mode          = 0;
+        state->is_revalidate = 0;
+}
+
+
 void
 free_state (server_state_t *state)
 {
@@ -128,6 +215,9 @@ free_state (server_state_t *state)
         server_resolve_wipe (&state->resolve);
         server_resolve_wipe (&state->resolve2);
 
+        if (state->compound)
+                server_compound_wipe (state->compound);
+
         GF_FREE (state);
 }
 
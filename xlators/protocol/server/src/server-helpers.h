@@ -47,6 +47,9 @@ void free_state (server_state_t *state);
 
 void server_loc_wipe (loc_t *loc);
 
+void server_compound_wipe (server_compound_t *compound);
+void server_compound_state_reset (server_state_t *state);
+
 int32_t
 gf_add_locker (server_connection_t *conn, const char *volume,
                loc_t *loc,
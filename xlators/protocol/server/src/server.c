@@ -35,6 +35,13 @@
 #include "defaults.h"
 #include "authenticate.h"
 #include "rpcsvc.h"
+#include "upcall-utils.h"
+
+rpcsvc_cbk_program_t server_cbk_prog = {
+        .progname  = "Gluster Callback",
+        .prognum   = GLUSTER_CBK_PROGRAM,
+        .progver   = GLUSTER_CBK_VERSION,
+};
 
 void
 grace_time_handler (void *data)
@@ -358,6 +365,7 @@ server_priv (xlator_t *this)
         char              key[GF_DUMP_MAX_BUF_LEN] = {0,};
         uint64_t          total_read = 0;
         uint64_t          total_write = 0;
+        int               count = 0;
         int32_t           ret  = -1;
 
         GF_VALIDATE_OR_GOTO ("server", this, out);
@@ -381,6 +389,21 @@ server_priv (xlator_t *this)
         gf_proc_dump_build_key(key, "server", "total-bytes-write");
         gf_proc_dump_write(key, "%"PRIu64, total_write);
 
+        pthread_mutex_lock (&conf->mutex);
+        {
+                list_for_each_entry (xprt, &conf->xprt_list, list) {
+                        snprintf (key, sizeof (key), "server.xprt.%d.peer",
+                                  count);
+                        gf_proc_dump_write (key, "%s",
+                                            xprt->peerinfo.identifier);
+
+                        snprintf (key, sizeof (key), "server.xprt.%d", count);
+                        rpc_transport_stats_dump (xprt, key);
+                        count++;
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
         ret = 0;
 out:
         return ret;
@@ -624,6 +647,8 @@ server_rpc_notify (rpcsvc_t *rpc, void *xl, rpcsvc_event_t event,
                    void *data)
 {
         gf_boolean_t         detached   = _gf_false;
+        gf_boolean_t         last_xprt  = _gf_false;
+        gf_boolean_t         put_bind   = _gf_false;
         xlator_t            *this       = NULL;
         rpc_transport_t     *xprt       = NULL;
         server_connection_t *conn       = NULL;
@@ -678,9 +703,21 @@ server_rpc_notify (rpcsvc_t *rpc, void *xl, rpcsvc_event_t event,
                 gf_log (this->name, GF_LOG_INFO, "disconnecting connection"
                         "from %s", conn->id);
 
+                if (conf->lk_heal)
+                        put_server_conn_state (this, xprt);
+
+                pthread_mutex_lock (&conn->lock);
+                {
+                        last_xprt = (--conn->xprt_count == 0);
+                }
+                pthread_mutex_unlock (&conn->lock);
+
                 /* If lock self heal is off, then destroy the
-                   conn object, else register a grace timer event */
-                if (!conf->lk_heal) {
+                   conn object, else register a grace timer event.
+                   While other channels of the client are still
+                   connected, only the binding of this transport
+                   goes away, the fds and locks stay. */
+                if (!conf->lk_heal || !last_xprt) {
                         server_conn_ref (conn);
                         server_connection_put (this, conn, &detached);
                         if (detached)
@@ -689,13 +726,17 @@ server_rpc_notify (rpcsvc_t *rpc, void *xl, rpcsvc_event_t event,
                                                            POSIX_LOCKS);
                         server_conn_unref (conn);
                 } else {
-                        put_server_conn_state (this, xprt);
                         server_connection_cleanup (this, conn, INTERNAL_LOCKS);
 
                         pthread_mutex_lock (&conn->lock);
                         {
-                                if (conn->timer)
+                                /* the binding of this transport is handed
+                                   over to the timer, or dropped if one is
+                                   running already */
+                                if (conn->timer) {
+                                        put_bind = _gf_true;
                                         goto unlock;
+                                }
 
                                 gf_log (this->name, GF_LOG_INFO, "starting a grace "
                                         "timer for %s", conn->id);
@@ -707,6 +748,9 @@ server_rpc_notify (rpcsvc_t *rpc, void *xl, rpcsvc_event_t event,
                         }
                 unlock:
                         pthread_mutex_unlock (&conn->lock);
+
+                        if (put_bind)
+                                server_connection_put (this, conn, NULL);
                 }
                 break;
         case RPCSVC_EVENT_TRANSPORT_DESTROY:
@@ -1114,11 +1158,73 @@ fini (xlator_t *this)
         return;
 }
 
+/* Push a cache invalidation raised by features/upcall to the client it is
+ * meant for. The client is known by its connection; if it went away in the
+ * meantime there is nobody left to tell.
+ */
+int
+server_upcall_notify (xlator_t *this, struct gf_upcall *upcall)
+{
+        server_conf_t                   *conf  = NULL;
+        rpc_transport_t                 *xprt  = NULL;
+        rpc_transport_t                 *trans = NULL;
+        gfs3_cbk_cache_invalidation_req  req   = {{0,},};
+        struct iovec                     iov   = {0,};
+        char                             buf[64] = {0,};
+        ssize_t                          len   = 0;
+        int                              ret   = -1;
+
+        conf = this->private;
+
+        memcpy (req.gfid, upcall->gfid, 16);
+        req.flags = upcall->flags;
+
+        iov.iov_base = buf;
+        iov.iov_len  = sizeof (buf);
+        len = xdr_serialize_generic (iov, &req,
+                                     (xdrproc_t)xdr_gfs3_cbk_cache_invalidation_req);
+        if (len == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "failed to encode the cache invalidation request");
+                goto out;
+        }
+        iov.iov_len = len;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                list_for_each_entry (xprt, &conf->xprt_list, list) {
+                        if (xprt->xl_private == upcall->client) {
+                                trans = rpc_transport_ref (xprt);
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        if (!trans)
+                goto out;
+
+        gf_log (this->name, GF_LOG_TRACE, "sending cache invalidation of %s "
+                "(flags 0x%x) to %s", uuid_utoa (upcall->gfid),
+                upcall->flags, trans->peerinfo.identifier);
+
+        ret = rpcsvc_callback_submit (conf->rpc, trans, &server_cbk_prog,
+                                      GF_CBK_CACHE_INVALIDATION, &iov, 1);
+
+        rpc_transport_unref (trans);
+out:
+        return ret;
+}
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
         int          ret = 0;
         switch (event) {
+        case GF_EVENT_UPCALL:
+                ret = server_upcall_notify (this, data);
+                break;
         default:
                 default_notify (this, event, data);
                 break;
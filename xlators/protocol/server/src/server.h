@@ -65,6 +65,9 @@ struct _server_connection {
         char               *id;
         int                 ref;
         int                 bind_ref;
+        int                 xprt_count; /* transports bound to it (a client
+                                           can have several channels),
+                                           protected by lock */
         pthread_mutex_t     lock;
         fdtable_t          *fdtable;
         struct _lock_table *ltable;
@@ -150,6 +153,33 @@ typedef struct {
 
 typedef int (*server_resume_fn_t) (call_frame_t *frame, xlator_t *bound_xl);
 
+/* a COMPOUND request, whose steps run one after the other on the frame of
+   the request (see server_compound_next ()) */
+typedef struct {
+        gfs3_compound_req        req;
+        gfs3_compound_req_entry *next;
+        gfs3_compound_rsp_entry *rsp;
+        int                      count;
+        int                      idx;
+        int32_t                  op_ret;
+        int32_t                  op_errno;
+
+        /* what the steps so far opened or looked up, for the later steps
+           which refer to it */
+        int64_t                  fd_no;
+        inode_t                 *inode;
+
+        /* data of the WRITE steps not consumed yet */
+        struct iovec             payload[MAX_IOVEC];
+        int                      payload_count;
+        struct iobref           *req_iobref;
+
+        /* data of the READ steps, sent after the reply */
+        struct iovec             vector[MAX_IOVEC];
+        int                      vector_count;
+        struct iobref           *iobref;
+} server_compound_t;
+
 int
 resolve_and_resume (call_frame_t *frame, server_resume_fn_t fn);
 
@@ -197,6 +227,7 @@ struct _server_state {
         struct gf_flock      flock;
         const char       *volume;
         dir_entry_t      *entry;
+        server_compound_t *compound;
 };
 
 extern struct rpcsvc_program gluster_handshake_prog;
@@ -28,6 +28,7 @@
 #include "glusterfs3-xdr.h"
 #include "glusterfs3.h"
 #include "compat-errno.h"
+#include "compound-fop-utils.h"
 
 #include "md5.h"
 #include "xdr-nfs3.h"
@@ -2814,12 +2815,22 @@ server_create (rpcsvc_request_t *req)
         gfs3_create_req  args     = {{0,},};
         int              ret      = -1;
         int              op_errno = 0;
+        struct iobuf    *iobuf    = NULL;
 
         if (!req)
                 return ret;
 
         args.bname = alloca (req->msg[0].iov_len);
 
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        /* decode the dict straight into memory its values can keep
+           referring to */
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_create_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -2842,10 +2853,10 @@ server_create (rpcsvc_request_t *req)
         }
 
         /* Unserialize the dictionary */
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, params,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, params,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->params = params;
 
@@ -2863,10 +2874,8 @@ server_create (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_create_resume);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 out:
@@ -2876,10 +2885,8 @@ out:
         if (params)
                 dict_unref (params);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 }
@@ -3398,13 +3405,19 @@ server_setxattr (rpcsvc_request_t *req)
         gfs3_setxattr_req    args                  = {{0,},};
         int32_t              ret                   = -1;
         int                  op_errno = 0;
+        struct iobuf        *iobuf                 = NULL;
 
         if (!req)
                 return ret;
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
 
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_setxattr_req)) {
                 //failed to decode msg;
@@ -3431,10 +3444,10 @@ server_setxattr (rpcsvc_request_t *req)
         state->flags            = args.flags;
         memcpy (state->resolve.gfid, args.gfid, 16);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, dict,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->dict = dict;
 
@@ -3444,6 +3457,8 @@ server_setxattr (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_setxattr_resume);
 
+        iobuf_unref (iobuf);
+
         return ret;
 out:
         if (dict)
@@ -3452,6 +3467,9 @@ out:
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
+        if (iobuf)
+                iobuf_unref (iobuf);
+
         return ret;
 }
 
@@ -3467,13 +3485,20 @@ server_fsetxattr (rpcsvc_request_t *req)
         gfs3_fsetxattr_req   args                 = {{0,},};
         int32_t              ret                  = -1;
         int                  op_errno = 0;
+        struct iobuf        *iobuf                = NULL;
 
         if (!req)
                 return ret;
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_fsetxattr_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3500,22 +3525,27 @@ server_fsetxattr (rpcsvc_request_t *req)
         state->flags             = args.flags;
         memcpy (state->resolve.gfid, args.gfid, 16);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, dict,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->dict = dict;
 
         ret = 0;
         resolve_and_resume (frame, server_fsetxattr_resume);
 
+        iobuf_unref (iobuf);
+
         return ret;
 out:
         if (dict)
                 dict_unref (dict);
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
+        if (iobuf)
+                iobuf_unref (iobuf);
+
         return ret;
 }
 
@@ -3531,13 +3561,20 @@ server_fxattrop (rpcsvc_request_t *req)
         gfs3_fxattrop_req    args                 = {{0,},};
         int32_t              ret                  = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                = NULL;
 
         if (!req)
                 return ret;
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_fxattrop_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3564,16 +3601,18 @@ server_fxattrop (rpcsvc_request_t *req)
         state->flags           = args.flags;
         memcpy (state->resolve.gfid, args.gfid, 16);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, dict,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->dict = dict;
 
         ret = 0;
         resolve_and_resume (frame, server_fxattrop_resume);
 
+        iobuf_unref (iobuf);
+
         return ret;
 
 out:
@@ -3582,6 +3621,9 @@ out:
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
+        if (iobuf)
+                iobuf_unref (iobuf);
+
         return ret;
 }
 
@@ -3597,13 +3639,19 @@ server_xattrop (rpcsvc_request_t *req)
         gfs3_xattrop_req     args                  = {{0,},};
         int32_t              ret                   = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                 = NULL;
 
         if (!req)
                 return ret;
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
 
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_xattrop_req)) {
                 //failed to decode msg;
@@ -3630,16 +3678,18 @@ server_xattrop (rpcsvc_request_t *req)
         state->flags           = args.flags;
         memcpy (state->resolve.gfid, args.gfid, 16);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, dict,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->dict = dict;
 
         ret = 0;
         resolve_and_resume (frame, server_xattrop_resume);
 
+        iobuf_unref (iobuf);
+
         return ret;
 out:
         if (dict)
@@ -3648,6 +3698,9 @@ out:
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
+        if (iobuf)
+                iobuf_unref (iobuf);
+
         return ret;
 }
 
@@ -3894,10 +3947,18 @@ server_readdirp (rpcsvc_request_t *req)
         size_t               headers_size = 0;
         int                  ret          = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf        = NULL;
 
         if (!req)
                 return ret;
 
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_readdirp_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3935,10 +3996,10 @@ server_readdirp (rpcsvc_request_t *req)
         state->offset = args.offset;
         memcpy (state->resolve.gfid, args.gfid, 16);
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, state->dict,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, state->dict,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
 
         ret = 0;
@@ -3947,9 +4008,8 @@ out:
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 }
@@ -4063,12 +4123,20 @@ server_mknod (rpcsvc_request_t *req)
         gfs3_mknod_req       args                   = {{0,},};
         int                  ret                    = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                  = NULL;
 
         if (!req)
                 return ret;
 
         args.bname = alloca (req->msg[0].iov_len);
 
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_mknod_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -4090,10 +4158,10 @@ server_mknod (rpcsvc_request_t *req)
                 goto out;
         }
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, params,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, params,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->params = params;
 
@@ -4107,10 +4175,8 @@ server_mknod (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_mknod_resume);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 out:
@@ -4120,10 +4186,8 @@ out:
         if (params)
                 dict_unref (params);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 
@@ -4139,12 +4203,20 @@ server_mkdir (rpcsvc_request_t *req)
         gfs3_mkdir_req       args                   = {{0,},};
         int                  ret                    = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                  = NULL;
 
         if (!req)
                 return ret;
 
         args.bname = alloca (req->msg[0].iov_len);
 
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_mkdir_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -4165,10 +4237,10 @@ server_mkdir (rpcsvc_request_t *req)
                 req->rpc_err = GARBAGE_ARGS;
                 goto out;
         }
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, params,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, params,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->params = params;
 
@@ -4181,10 +4253,8 @@ server_mkdir (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_mkdir_resume);
 
-        if (args.dict.dict_val != NULL) {
-                /* memory allocated by libc, don't use GF_FREE */
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 out:
@@ -4194,10 +4264,8 @@ out:
         if (params)
                 dict_unref (params);
 
-        if (args.dict.dict_val != NULL) {
-                /* memory allocated by libc, don't use GF_FREE */
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 }
@@ -4554,6 +4622,7 @@ server_symlink (rpcsvc_request_t *req)
         gfs3_symlink_req     args                  = {{0,},};
         int                  ret                   = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                 = NULL;
 
         if (!req)
                 return ret;
@@ -4561,6 +4630,13 @@ server_symlink (rpcsvc_request_t *req)
         args.bname    = alloca (req->msg[0].iov_len);
         args.linkname = alloca (4096);
 
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
+
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_symlink_req)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -4582,10 +4658,10 @@ server_symlink (rpcsvc_request_t *req)
                 goto out;
         }
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, params,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, params,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
 
         state->params = params;
 
@@ -4597,10 +4673,8 @@ server_symlink (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_symlink_resume);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
         return ret;
 out:
         if (op_errno)
@@ -4609,10 +4683,8 @@ out:
         if (params)
                 dict_unref (params);
 
-        /* memory allocated by libc, don't use GF_FREE */
-        if (args.dict.dict_val != NULL) {
-                free (args.dict.dict_val);
-        }
+        if (iobuf)
+                iobuf_unref (iobuf);
 
         return ret;
 }
@@ -4877,13 +4949,20 @@ server_lookup (rpcsvc_request_t *req)
         gfs3_lookup_req      args                   = {{0,},};
         int                  ret                    = -1;
         int              op_errno = 0;
+        struct iobuf        *iobuf                  = NULL;
 
         GF_VALIDATE_OR_GOTO ("server", req, err);
 
         conn = req->trans->xl_private;
 
         args.bname         = alloca (req->msg[0].iov_len);
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
+
+        iobuf = iobuf_get2 (req->svc->ctx->iobuf_pool, req->msg[0].iov_len);
+        if (!iobuf) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+        args.dict.dict_val = iobuf_ptr (iobuf);
 
         if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_lookup_req)) {
                 //failed to decode msg;
@@ -4919,15 +4998,17 @@ server_lookup (rpcsvc_request_t *req)
                 memcpy (state->resolve.gfid, args.gfid, 16);
         }
 
-        GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, xattr_req,
-                                      (args.dict.dict_val),
-                                      (args.dict.dict_len), ret,
-                                      op_errno, out);
+        GF_PROTOCOL_DICT_UNSERIALIZE_IOBUF (state->conn->bound_xl, xattr_req,
+                                            (args.dict.dict_val),
+                                            (args.dict.dict_len), iobuf,
+                                            ret, op_errno, out);
         state->dict = xattr_req;
 
         ret = 0;
         resolve_and_resume (frame, server_lookup_resume);
 
+        iobuf_unref (iobuf);
+
         return ret;
 out:
         if (xattr_req)
@@ -4937,6 +5018,9 @@ out:
                            NULL, NULL);
         ret = 0;
 err:
+        if (iobuf)
+                iobuf_unref (iobuf);
+
         return ret;
 }
 
@@ -4982,6 +5066,719 @@ out:
 }
 
 
+/* COMPOUND: the steps of the chain run one after the other on the frame of
+   the request, each one resolved and wound the way its own fop is */
+
+static glusterfs_fop_t
+server_compound_fop (int op)
+{
+        switch (op) {
+        case GFS3_OP_LOOKUP:
+                return GF_FOP_LOOKUP;
+        case GFS3_OP_OPEN:
+                return GF_FOP_OPEN;
+        case GFS3_OP_CREATE:
+                return GF_FOP_CREATE;
+        case GFS3_OP_READ:
+                return GF_FOP_READ;
+        case GFS3_OP_WRITE:
+                return GF_FOP_WRITE;
+        case GFS3_OP_FLUSH:
+                return GF_FOP_FLUSH;
+        case GFS3_OP_RELEASE:
+                return GF_FOP_RELEASE;
+        default:
+                return GF_FOP_NULL;
+        }
+}
+
+
+int server_compound_next (call_frame_t *frame);
+
+static int
+server_compound_step_done (call_frame_t *frame, int32_t op_ret,
+                           int32_t op_errno)
+{
+        server_state_t          *state    = NULL;
+        server_compound_t       *compound = NULL;
+        gfs3_compound_rsp_entry *rsp      = NULL;
+
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+        rsp      = &compound->rsp[compound->idx];
+
+        rsp->op_ret   = op_ret;
+        rsp->op_errno = gf_errno_to_error (op_errno);
+
+        if (op_ret < 0) {
+                gf_log (frame->this->name,
+                        ((op_errno == ENOENT) ? GF_LOG_TRACE : GF_LOG_INFO),
+                        "%"PRId64": COMPOUND %d/%d %s %s (%s) ==> %"PRId32
+                        " (%s)", frame->root->unique, compound->idx + 1,
+                        compound->count, gf_fop_list[frame->root->op],
+                        state->loc.path ? state->loc.path : "",
+                        state->loc.inode ? uuid_utoa (state->loc.inode->gfid) :
+                        "--", op_ret, strerror (op_errno));
+
+                if (compound->op_ret == 0) {
+                        compound->op_ret   = -1;
+                        compound->op_errno = op_errno;
+                }
+        }
+
+        compound->idx++;
+
+        return server_compound_next (frame);
+}
+
+
+static void
+server_compound_set_inode (server_compound_t *compound, inode_t *inode)
+{
+        if (compound->inode)
+                inode_unref (compound->inode);
+        compound->inode = inode;
+}
+
+
+int
+server_compound_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno,
+                            inode_t *inode, struct iatt *stbuf, dict_t *dict,
+                            struct iatt *postparent)
+{
+        server_state_t          *state      = NULL;
+        server_compound_t       *compound   = NULL;
+        gfs3_compound_rsp_entry *rsp        = NULL;
+        inode_t                 *root_inode = NULL;
+        inode_t                 *link_inode = NULL;
+        loc_t                    fresh_loc  = {0,};
+        uuid_t                   rootgfid   = {0,};
+
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+        rsp      = &compound->rsp[compound->idx];
+
+        if (state->is_revalidate == 1 && op_ret == -1) {
+                state->is_revalidate = 2;
+                loc_copy (&fresh_loc, &state->loc);
+                inode_unref (fresh_loc.inode);
+                fresh_loc.inode = inode_new (state->itable);
+
+                STACK_WIND (frame, server_compound_lookup_cbk,
+                            BOUND_XL (frame), BOUND_XL (frame)->fops->lookup,
+                            &fresh_loc, state->dict);
+
+                loc_wipe (&fresh_loc);
+                return 0;
+        }
+
+        if (op_ret == 0) {
+                if (dict) {
+                        GF_PROTOCOL_DICT_SERIALIZE (this, dict,
+                                                    (&rsp->dict.dict_val),
+                                                    rsp->dict.dict_len,
+                                                    op_errno, err);
+                }
+
+                root_inode = BOUND_XL(frame)->itable->root;
+                if (inode == root_inode) {
+                        /* we just looked up root ("/") */
+                        stbuf->ia_ino = 1;
+                        rootgfid[15]  = 1;
+                        uuid_copy (stbuf->ia_gfid, rootgfid);
+                        if (inode->ia_type == 0)
+                                inode->ia_type = stbuf->ia_type;
+                }
+
+                gf_stat_from_iatt (&rsp->stat, stbuf);
+                gf_stat_from_iatt (&rsp->poststat, postparent);
+
+                if (!__is_root_gfid (inode->gfid)) {
+                        link_inode = inode_link (inode, state->loc.parent,
+                                                 state->loc.name, stbuf);
+                        if (link_inode)
+                                inode_lookup (link_inode);
+                } else {
+                        link_inode = inode_ref (inode);
+                }
+
+                /* an OPEN later in the chain opens it */
+                if (link_inode)
+                        server_compound_set_inode (compound, link_inode);
+        } else {
+                if (state->is_revalidate && op_errno == ENOENT) {
+                        if (!__is_root_gfid (state->loc.inode->gfid)) {
+                                inode_unlink (state->loc.inode,
+                                              state->loc.parent,
+                                              state->loc.name);
+                        }
+                }
+        }
+
+        return server_compound_step_done (frame, op_ret, op_errno);
+err:
+        return server_compound_step_done (frame, -1, op_errno);
+}
+
+
+int
+server_compound_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        server_connection_t *conn     = NULL;
+        server_state_t      *state    = NULL;
+        server_compound_t   *compound = NULL;
+        uint64_t             fd_no    = 0;
+
+        conn     = SERVER_CONNECTION (frame);
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+
+        if (op_ret >= 0) {
+                fd_bind (fd);
+                fd_no = gf_fd_unused_get (conn->fdtable, fd);
+                fd_ref (fd);
+
+                compound->rsp[compound->idx].fd = fd_no;
+                compound->fd_no = fd_no;
+        }
+
+        return server_compound_step_done (frame, op_ret, op_errno);
+}
+
+
+int
+server_compound_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno,
+                            fd_t *fd, inode_t *inode, struct iatt *stbuf,
+                            struct iatt *preparent, struct iatt *postparent)
+{
+        server_connection_t     *conn       = NULL;
+        server_state_t          *state      = NULL;
+        server_compound_t       *compound   = NULL;
+        gfs3_compound_rsp_entry *rsp        = NULL;
+        inode_t                 *link_inode = NULL;
+        uint64_t                 fd_no      = 0;
+
+        conn     = SERVER_CONNECTION (frame);
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+        rsp      = &compound->rsp[compound->idx];
+
+        if (op_ret < 0)
+                goto out;
+
+        link_inode = inode_link (inode, state->loc.parent, state->loc.name,
+                                 stbuf);
+        if (!link_inode) {
+                op_ret   = -1;
+                op_errno = ENOENT;
+                goto out;
+        }
+
+        if (link_inode != inode) {
+                /* see server_create_cbk () */
+                inode_unref (fd->inode);
+                fd->inode = inode_ref (link_inode);
+        }
+
+        inode_lookup (link_inode);
+        server_compound_set_inode (compound, link_inode);
+
+        fd_bind (fd);
+        fd_no = gf_fd_unused_get (conn->fdtable, fd);
+        fd_ref (fd);
+
+        rsp->fd         = fd_no;
+        compound->fd_no = fd_no;
+
+        gf_stat_from_iatt (&rsp->stat, stbuf);
+        gf_stat_from_iatt (&rsp->prestat, preparent);
+        gf_stat_from_iatt (&rsp->poststat, postparent);
+out:
+        return server_compound_step_done (frame, op_ret, op_errno);
+}
+
+
+int
+server_compound_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno,
+                           struct iovec *vector, int32_t count,
+                           struct iatt *stbuf, struct iobref *iobref)
+{
+        server_state_t          *state    = NULL;
+        server_compound_t       *compound = NULL;
+        gfs3_compound_rsp_entry *rsp      = NULL;
+
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+        rsp      = &compound->rsp[compound->idx];
+
+        if (op_ret < 0)
+                goto out;
+
+        if (compound->vector_count + count > MAX_IOVEC) {
+                op_ret   = -1;
+                op_errno = EFBIG;
+                goto out;
+        }
+
+        memcpy (&compound->vector[compound->vector_count], vector,
+                count * sizeof (*vector));
+        compound->vector_count += count;
+        if (iobref)
+                iobref_merge (compound->iobref, iobref);
+
+        rsp->size = op_ret;
+        gf_stat_from_iatt (&rsp->stat, stbuf);
+out:
+        return server_compound_step_done (frame, op_ret, op_errno);
+}
+
+
+int
+server_compound_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno,
+                            struct iatt *prebuf, struct iatt *postbuf)
+{
+        server_state_t          *state    = NULL;
+        server_compound_t       *compound = NULL;
+        gfs3_compound_rsp_entry *rsp      = NULL;
+
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+        rsp      = &compound->rsp[compound->idx];
+
+        if (op_ret >= 0) {
+                gf_stat_from_iatt (&rsp->prestat, prebuf);
+                gf_stat_from_iatt (&rsp->poststat, postbuf);
+        }
+
+        return server_compound_step_done (frame, op_ret, op_errno);
+}
+
+
+int
+server_compound_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno)
+{
+        return server_compound_step_done (frame, op_ret, op_errno);
+}
+
+
+int
+server_compound_resume (call_frame_t *frame, xlator_t *bound_xl)
+{
+        server_state_t *state = NULL;
+
+        state = CALL_STATE (frame);
+
+        if (state->resolve.op_ret != 0)
+                return server_compound_step_done (frame,
+                                                  state->resolve.op_ret,
+                                                  state->resolve.op_errno);
+
+        switch (frame->root->op) {
+        case GF_FOP_LOOKUP:
+                if (!state->loc.inode)
+                        state->loc.inode = inode_new (state->itable);
+                else
+                        state->is_revalidate = 1;
+
+                STACK_WIND (frame, server_compound_lookup_cbk,
+                            bound_xl, bound_xl->fops->lookup,
+                            &state->loc, state->dict);
+                break;
+
+        case GF_FOP_OPEN:
+                state->fd = fd_create (state->loc.inode, frame->root->pid);
+                if (!state->fd)
+                        return server_compound_step_done (frame, -1, ENOMEM);
+                state->fd->flags = state->flags;
+
+                STACK_WIND (frame, server_compound_open_cbk,
+                            bound_xl, bound_xl->fops->open,
+                            &state->loc, state->flags, state->fd, 0);
+                break;
+
+        case GF_FOP_CREATE:
+                if (state->loc.inode)
+                        inode_unref (state->loc.inode);
+                state->loc.inode = inode_new (state->itable);
+
+                state->fd = fd_create (state->loc.inode, frame->root->pid);
+                if (!state->fd)
+                        return server_compound_step_done (frame, -1, ENOMEM);
+                state->fd->flags = state->flags;
+
+                STACK_WIND (frame, server_compound_create_cbk,
+                            bound_xl, bound_xl->fops->create,
+                            &state->loc, state->flags, state->mode,
+                            state->fd, state->params);
+                break;
+
+        case GF_FOP_READ:
+                STACK_WIND (frame, server_compound_readv_cbk,
+                            bound_xl, bound_xl->fops->readv,
+                            state->fd, state->size, state->offset,
+                            state->flags);
+                break;
+
+        case GF_FOP_WRITE:
+                STACK_WIND (frame, server_compound_writev_cbk,
+                            bound_xl, bound_xl->fops->writev,
+                            state->fd, state->payload_vector,
+                            state->payload_count, state->offset,
+                            state->flags, state->iobref);
+                break;
+
+        case GF_FOP_FLUSH:
+                STACK_WIND (frame, server_compound_flush_cbk,
+                            bound_xl, bound_xl->fops->flush, state->fd);
+                break;
+
+        default:
+                return server_compound_step_done (frame, -1, ENOTSUP);
+        }
+
+        return 0;
+}
+
+
+/* hands the next @size bytes of the WRITE data to the step in @state */
+static int
+server_compound_payload (server_compound_t *compound, server_state_t *state,
+                         size_t size)
+{
+        struct iovec *iov = NULL;
+        size_t        len = 0;
+
+        while (size && compound->payload_count) {
+                if (state->payload_count == MAX_IOVEC)
+                        return -1;
+
+                iov = &compound->payload[0];
+                len = min (size, iov->iov_len);
+
+                state->payload_vector[state->payload_count].iov_base =
+                        iov->iov_base;
+                state->payload_vector[state->payload_count].iov_len = len;
+                state->payload_count++;
+                state->size += len;
+
+                iov->iov_base += len;
+                iov->iov_len  -= len;
+                size          -= len;
+
+                if (!iov->iov_len) {
+                        compound->payload_count--;
+                        memmove (&compound->payload[0], &compound->payload[1],
+                                 compound->payload_count * sizeof (*iov));
+                }
+        }
+
+        return size ? -1 : 0;
+}
+
+
+/* fills @state for the step like the handler of its fop does, returns an
+   errno if the step can not be run */
+static int
+server_compound_prepare (call_frame_t *frame, gfs3_compound_req_entry *entry)
+{
+        server_state_t    *state    = NULL;
+        server_compound_t *compound = NULL;
+        dict_t            *dict     = NULL;
+        int                ret      = 0;
+        int                op_errno = 0;
+
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+
+        switch (frame->root->op) {
+        case GF_FOP_LOOKUP:
+                state->resolve.type = RESOLVE_DONTCARE;
+                if (entry->bname && strcmp (entry->bname, "")) {
+                        memcpy (state->resolve.pargfid, entry->pargfid, 16);
+                        state->resolve.bname = gf_strdup (entry->bname);
+                } else {
+                        memcpy (state->resolve.gfid, entry->gfid, 16);
+                }
+                break;
+
+        case GF_FOP_OPEN:
+                state->resolve.type = RESOLVE_MUST;
+                state->flags        = gf_flags_to_flags (entry->flags);
+                memcpy (state->resolve.gfid, entry->gfid, 16);
+
+                /* opens what an earlier LOOKUP of the chain found */
+                if (uuid_is_null (state->resolve.gfid)) {
+                        if (!compound->inode)
+                                return EINVAL;
+                        uuid_copy (state->resolve.gfid,
+                                   compound->inode->gfid);
+                }
+                break;
+
+        case GF_FOP_CREATE:
+                state->resolve.bname = gf_strdup (entry->bname);
+                state->mode          = entry->mode;
+                state->flags         = gf_flags_to_flags (entry->flags);
+                memcpy (state->resolve.pargfid, entry->pargfid, 16);
+
+                if (state->flags & O_EXCL)
+                        state->resolve.type = RESOLVE_NOT;
+                else
+                        state->resolve.type = RESOLVE_DONTCARE;
+                break;
+
+        case GF_FOP_READ:
+                state->resolve.type = RESOLVE_MUST;
+                state->size         = entry->size;
+                state->offset       = entry->offset;
+                state->flags        = entry->flags;
+                break;
+
+        case GF_FOP_WRITE:
+                state->resolve.type = RESOLVE_MUST;
+                state->offset       = entry->offset;
+                state->flags        = entry->flags;
+                state->iobref       = iobref_ref (compound->req_iobref);
+
+                if (server_compound_payload (compound, state, entry->size))
+                        return EINVAL;
+                break;
+
+        case GF_FOP_FLUSH:
+                state->resolve.type = RESOLVE_MUST;
+                break;
+
+        default:
+                return ENOTSUP;
+        }
+
+        switch (frame->root->op) {
+        case GF_FOP_READ:
+        case GF_FOP_WRITE:
+        case GF_FOP_FLUSH:
+                memcpy (state->resolve.gfid, entry->gfid, 16);
+
+                if (entry->fd != GF_COMPOUND_CHAIN_FD) {
+                        state->resolve.fd_no = entry->fd;
+                        break;
+                }
+
+                /* the fd an earlier OPEN or CREATE of the chain opened */
+                if (compound->fd_no < 0)
+                        return EBADF;
+                state->resolve.fd_no = compound->fd_no;
+                break;
+
+        case GF_FOP_LOOKUP:
+                GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
+                                              (entry->dict.dict_val),
+                                              (entry->dict.dict_len), ret,
+                                              op_errno, out);
+                state->dict = dict;
+                break;
+
+        case GF_FOP_CREATE:
+                GF_PROTOCOL_DICT_UNSERIALIZE (state->conn->bound_xl, dict,
+                                              (entry->dict.dict_val),
+                                              (entry->dict.dict_len), ret,
+                                              op_errno, out);
+                state->params = dict;
+                break;
+
+        default:
+                break;
+        }
+
+        return 0;
+out:
+        if (dict)
+                dict_unref (dict);
+
+        return op_errno ? op_errno : ENOMEM;
+}
+
+
+static int
+server_compound_reply (call_frame_t *frame)
+{
+        server_state_t     *state    = NULL;
+        server_compound_t  *compound = NULL;
+        rpcsvc_request_t   *req      = NULL;
+        gfs3_compound_rsp   rsp      = {0,};
+        int                 i        = 0;
+
+        req      = frame->local;
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+
+        for (i = 0; i < compound->count - 1; i++)
+                compound->rsp[i].nextentry = &compound->rsp[i + 1];
+
+        rsp.op_ret   = compound->op_ret;
+        rsp.op_errno = gf_errno_to_error (compound->op_errno);
+        rsp.reply    = compound->rsp;
+
+        server_submit_reply (frame, req, &rsp, compound->vector,
+                             compound->vector_count, compound->iobref,
+                             (xdrproc_t)xdr_gfs3_compound_rsp);
+
+        return 0;
+}
+
+
+int
+server_compound_next (call_frame_t *frame)
+{
+        server_connection_t     *conn     = NULL;
+        server_state_t          *state    = NULL;
+        server_compound_t       *compound = NULL;
+        gfs3_compound_req_entry *entry    = NULL;
+        gfs3_compound_rsp_entry *rsp      = NULL;
+        int64_t                  fd_no    = -1;
+        int                      op_errno = 0;
+
+        conn     = SERVER_CONNECTION (frame);
+        state    = CALL_STATE (frame);
+        compound = state->compound;
+
+        for (; compound->idx < compound->count; compound->idx++) {
+                entry = compound->next;
+                compound->next = entry->nextentry;
+
+                rsp = &compound->rsp[compound->idx];
+                rsp->op = entry->op;
+
+                if (entry->op == GFS3_OP_RELEASE) {
+                        /* runs even after a failed step, so that the chain
+                           does not leak the fds it opened */
+                        fd_no = entry->fd;
+                        if (fd_no == GF_COMPOUND_CHAIN_FD) {
+                                fd_no = compound->fd_no;
+                                compound->fd_no = -1;
+                        }
+                        if (fd_no >= 0)
+                                gf_fd_put (conn->fdtable, fd_no);
+                        continue;
+                }
+
+                if (compound->op_ret < 0) {
+                        rsp->op_ret   = -1;
+                        rsp->op_errno = gf_errno_to_error (ECANCELED);
+                        continue;
+                }
+
+                server_compound_state_reset (state);
+                frame->root->op = server_compound_fop (entry->op);
+
+                op_errno = server_compound_prepare (frame, entry);
+                if (op_errno)
+                        return server_compound_step_done (frame, -1,
+                                                          op_errno);
+
+                resolve_and_resume (frame, server_compound_resume);
+                return 0;
+        }
+
+        return server_compound_reply (frame);
+}
+
+
+int
+server_compound (rpcsvc_request_t *req)
+{
+        server_state_t          *state    = NULL;
+        call_frame_t            *frame    = NULL;
+        server_compound_t       *compound = NULL;
+        gfs3_compound_req_entry *trav     = NULL;
+        ssize_t                  len      = 0;
+        int                      i        = 0;
+        int                      ret      = -1;
+
+        if (!req)
+                return ret;
+
+        compound = GF_CALLOC (1, sizeof (*compound), gf_server_mt_compound_t);
+        if (!compound) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        len = xdr_to_generic (req->msg[0], &compound->req,
+                              (xdrproc_t)xdr_gfs3_compound_req);
+        if (len == 0) {
+                //failed to decode msg;
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        for (trav = compound->req.request; trav; trav = trav->nextentry)
+                compound->count++;
+
+        if (!compound->count || (compound->count > GF_COMPOUND_MAX_FOPS)) {
+                gf_log ("server", GF_LOG_WARNING,
+                        "compound request of %d fops", compound->count);
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        compound->rsp = GF_CALLOC (compound->count, sizeof (*compound->rsp),
+                                   gf_server_mt_compound_t);
+        compound->iobref = iobref_new ();
+        if (!compound->rsp || !compound->iobref) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        frame = get_frame_from_request (req);
+        if (!frame) {
+                // something wrong, mostly insufficient memory
+                req->rpc_err = GARBAGE_ARGS; /* TODO */
+                goto out;
+        }
+        frame->root->op = GF_FOP_COMPOUND;
+
+        state = CALL_STATE (frame);
+        if (!state->conn->bound_xl) {
+                /* auth failure, request on subvolume without setvolume */
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        /* the WRITE steps take their data from here in order */
+        if (len < req->msg[0].iov_len) {
+                compound->payload[0].iov_base = (req->msg[0].iov_base + len);
+                compound->payload[0].iov_len  = req->msg[0].iov_len - len;
+                compound->payload_count = 1;
+        }
+
+        for (i = 1; i < req->count; i++) {
+                compound->payload[compound->payload_count++] = req->msg[i];
+        }
+
+        if (req->iobref)
+                compound->req_iobref = iobref_ref (req->iobref);
+
+        compound->fd_no = -1;
+        compound->next  = compound->req.request;
+        state->compound = compound;
+
+        ret = 0;
+        server_compound_next (frame);
+        return ret;
+out:
+        if (compound)
+                server_compound_wipe (compound);
+
+        return ret;
+}
+
+
 rpcsvc_actor_t glusterfs3_1_fop_actors[] = {
         [GFS3_OP_NULL]        = { "NULL",       GFS3_OP_NULL, server_null, NULL, NULL, 0},
         [GFS3_OP_STAT]        = { "STAT",       GFS3_OP_STAT, server_stat, NULL, NULL, 0},
@@ -5027,6 +5824,7 @@ rpcsvc_actor_t glusterfs3_1_fop_actors[] = {
         [GFS3_OP_RELEASE]     = { "RELEASE",    GFS3_OP_RELEASE, server_release, NULL, NULL, 0},
         [GFS3_OP_RELEASEDIR]  = { "RELEASEDIR", GFS3_OP_RELEASEDIR, server_releasedir, NULL, NULL, 0},
         [GFS3_OP_FREMOVEXATTR] = { "FREMOVEXATTR", GFS3_OP_FREMOVEXATTR, server_fremovexattr, NULL, NULL, 0},
+        [GFS3_OP_COMPOUND]    = { "COMPOUND",   GFS3_OP_COMPOUND, server_compound, NULL, NULL, 0},
 };
 
 
@@ -91,6 +91,9 @@ posix_xattr_ignorable (char *key, posix_xattr_filler_t *filler)
         if ((!strcmp (key, GF_CONTENT_KEY))
             && (!IA_ISREG (filler->stbuf->ia_type)))
                 ignore = _gf_true;
+        if ((!strcmp (key, GF_READLINK_KEY))
+            && (!IA_ISLNK (filler->stbuf->ia_type)))
+                ignore = _gf_true;
 out:
         return ignore;
 }
@@ -168,6 +171,29 @@ _posix_xattr_get_set (dict_t *xattr_req,
                         if (databuf)
                                 GF_FREE (databuf);
                 }
+        } else if (!strcmp (key, GF_READLINK_KEY)) {
+                /* symlink target request */
+                databuf = GF_CALLOC (1, PATH_MAX + 1, gf_posix_mt_char);
+                if (!databuf)
+                        goto out;
+
+                ret = readlink (filler->real_path, databuf, PATH_MAX);
+                if (ret <= 0) {
+                        gf_log (filler->this->name, GF_LOG_DEBUG,
+                                "readlink on %s failed: %s",
+                                filler->real_path, strerror (errno));
+                        GF_FREE (databuf);
+                        goto out;
+                }
+                databuf[ret] = '\0';
+
+                ret = dict_set_dynstr (filler->xattr, key, databuf);
+                if (ret < 0) {
+                        gf_log (filler->this->name, GF_LOG_WARNING,
+                                "failed to set dict value. key: %s, path: %s",
+                                key, filler->real_path);
+                        GF_FREE (databuf);
+                }
         } else if (!strcmp (key, GLUSTERFS_OPEN_FD_COUNT)) {
                 loc = filler->loc;
                 if (loc && !list_empty (&loc->inode->fd_list)) {
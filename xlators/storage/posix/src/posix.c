@@ -2816,6 +2816,7 @@ posix_fsetxattr (call_frame_t *frame, xlator_t *this,
         int                _fd          = -1;
         data_pair_t * trav              = NULL;
         int           ret               = -1;
+        char *        algo              = NULL;
 
         DECLARE_OLD_FS_ID_VAR;
         SET_FS_ID (frame->root->uid, frame->root->gid);
@@ -2836,6 +2837,17 @@ posix_fsetxattr (call_frame_t *frame, xlator_t *this,
 
         dict_del (dict, GFID_XATTR_KEY);
 
+        if (!dict_get_str (dict, GF_XATTR_RCHECKSUM_KEY, &algo)) {
+                pfd->strong_checksum = gf_rsync_strong_checksum_get (algo);
+                if (!pfd->strong_checksum) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "unknown rchecksum algorithm %s", algo);
+                        op_errno = EINVAL;
+                        goto out;
+                }
+                dict_del (dict, GF_XATTR_RCHECKSUM_KEY);
+        }
+
         trav = dict->members_list;
 
         while (trav) {
@@ -3769,7 +3781,10 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         }
 
         weak_checksum = gf_rsync_weak_checksum (buf, len);
-        gf_rsync_strong_checksum (buf, len, strong_checksum);
+        if (pfd->strong_checksum)
+                pfd->strong_checksum (buf, len, strong_checksum);
+        else
+                gf_rsync_strong_checksum (buf, len, strong_checksum);
 
         GF_FREE (buf);
 
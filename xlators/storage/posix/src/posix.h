@@ -51,6 +51,7 @@
 #include "inode.h"
 #include "compat.h"
 #include "timer.h"
+#include "checksum.h"
 #include "posix-mem-types.h"
 #include "posix-handle.h"
 
@@ -67,6 +68,8 @@ struct posix_fd {
         int     odirect;
         int     op_performed;
         struct list_head list; /* to add to the janitor list */
+        gf_rsync_checksum_fn strong_checksum; /* for rchecksum, NULL
+                                                 for md5 */
 };
 
 